@@ -1,3 +1,17 @@
+// Servidor de registo. Uso: reg_server [-d diretoria] [-p porto] [-t validade] [-w trabalhadores] [-v]
+//
+// Os pedidos UDP são tratados por trabalhadores (um por CPU por omissão), cada um com o seu socket
+// SO_REUSEPORT e com receção/envio em lotes (recvmmsg/sendmmsg). O registo está dividido por net_id
+// em partes com mutex próprio. O ritmo de pedidos é mostrado a cada RATE_REPORT_INTERVAL_S segundos;
+// cada pedido só é registado no ecrã com -v.
+//
+// Os registos são temporários: cada REG ou UPDATE vale por -t segundos (LEASE_TTL_S por omissão) e
+// os nós renovam-no periodicamente. Um nó que termina sem UNREG sai da lista quando o registo expira.
+//
+// Com -d, o registo sobrevive a reinícios: as alterações vão para um diário (WAL) e o estado completo
+// para instantâneos periódicos, reaplicados no arranque (ver "Persistência").
+
+#define _GNU_SOURCE // recvmmsg/sendmmsg
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,298 +19,1884 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
 
 // Definições
 #define REG_UDP_PORT 59000
 #define MAX_BUFFER_SIZE 512
-#define MAX_NODES_PER_NET 100 // Número máximo de nós por rede
-#define MAX_NETS 10           // Número máximo de redes
+#define NODESLIST_MAX_ENTRIES 8      // Pontos de entrada recomendados por resposta NODES
+#define PREFERRED_MAX_DEGREE 6       // Nós com mais vizinhos só são recomendados depois dos restantes
+#define NODESLIST_PAGE_BYTES 1400     // Tamanho máximo de uma página de NODESLIST (cabe num datagrama sem fragmentar)
+#define NODE_LINE_MAX 52              // "ip porto grau profundidade\n" com um IP de 15 carateres e inteiros de 11
+#define NODESLIST_PAGE_ENTRIES 64     // Máximo de nós por página de NODESLIST (os que não cabem ficam para a seguinte)
+#define TCP_QUERY_TIMEOUT_S 1         // Tempo máximo de leitura/escrita de uma consulta TCP
+#define TCP_QUERY_DEADLINE_S 5        // Tempo máximo de uma conexão de consulta TCP inteira
+#define MAX_TCP_QUERY_CONNECTIONS 32  // Consultas TCP servidas em simultâneo (as restantes são fechadas)
+#define REGISTRY_SHARDS 16            // Partes independentes do registo (cada uma com o seu mutex)
+#define RECV_BATCH 32                 // Datagramas recebidos/enviados por chamada de sistema
+#define MAX_WORKERS 64
+#define RATE_REPORT_INTERVAL_S 5      // Intervalo entre relatórios do ritmo de pedidos
+#define LEASE_TTL_S 30                // Validade por omissão de um registo sem renovação (REG ou UPDATE)
+#define MAX_REPORTED_VALUE 9999      // Grau e profundidade aceites num REG/UPDATE (-1: desconhecido)
+#define MAX_SUBSCRIBERS_PER_NET 1024 // Subscritores de uma rede (cada alteração gera uma notificação a cada um)
+#define REQUEST_TAG_MAX_DIGITS 10    // Etiqueta de um pedido (" #<n>", n sem sinal de 32 bits)
+#define LEASE_TICK_MS 1000            // Resolução da roda de expiração
+#define LEASE_WHEEL_SLOTS 64          // Posições da roda (uma volta = 64 s)
+#define SNAPSHOT_INTERVAL_S 60        // Intervalo entre instantâneos do registo (se houve alterações)
+#define SNAPSHOT_MAX_WAL_RECORDS 100000 // Registos no diário que forçam um instantâneo antecipado
+#define INITIAL_NODE_CAPACITY 8      // Capacidade inicial do array de nós de uma rede
+#define INITIAL_REGISTRY_CAPACITY 16 // Capacidade inicial da tabela de redes (potência de 2)
+
+// As tabelas de dispersão usam endereçamento aberto com sondagem linear e capacidade em potências
+// de 2; crescem para o dobro quando a ocupação (incluindo lápides) passa de metade.
+#define SLOT_EMPTY -1
+#define SLOT_TOMBSTONE -2
+
+static int verbose = 0; // -v: registar cada pedido
+#define LOG_VERBOSE(...)         \
+    do                           \
+    {                            \
+        if (verbose)             \
+            printf(__VA_ARGS__); \
+    } while (0)
+
+// Contadores de pedidos por tipo (cada trabalhador escreve só nos seus; a thread principal soma-os)
+typedef enum
+{
+    REQUEST_REG,
+    REQUEST_UNREG,
+    REQUEST_UPDATE,
+    REQUEST_NODES,
+    REQUEST_SUBSCRIBE,
+    REQUEST_UNSUBSCRIBE,
+    REQUEST_OTHER,
+    NUM_REQUEST_TYPES
+} RequestType;
+
+typedef struct
+{
+    volatile unsigned long count[NUM_REQUEST_TYPES];
+} __attribute__((aligned(64))) RequestCounters;
+
+typedef struct
+{
+    RequestCounters counters;
+    int sock_fd;
+    pthread_t thread;
+} Worker;
 
 // Estrutura para representar um nó registado
 typedef struct
 {
     char ip[16]; // Considerando IPv4 "XXX.XXX.XXX.XXX\0"
     int tcp_port;
-    int is_valid; // 1 se o slot está em uso, 0 caso contrário
+    int degree; // Número de vizinhos comunicado pelo nó (-1 se desconhecido)
+    int depth;  // Profundidade na árvore comunicada pelo nó (-1 se desconhecida)
+    long long lease_expires_ms; // O registo expira neste instante se não for renovado
+    unsigned int lease_gen;     // Identifica a entrada da roda de expiração deste registo
 } NodeInfo;
 
-// Estrutura para uma rede e seus nós
+// Subscritor das alterações de uma rede (endereço UDP de onde veio o SUBSCRIBE)
+typedef struct
+{
+    struct sockaddr_in addr;
+    long long expires_ms;
+} Subscriber;
+
+// Estrutura para uma rede e seus nós: array denso (para listar) e índice por endereço (para procurar)
 typedef struct
 {
     int net_id;
-    NodeInfo nodes[MAX_NODES_PER_NET];
+    NodeInfo *nodes; // Nós registados, em posições 0..node_count-1
     int node_count;
-    int is_valid; // 1 se esta rede está em uso
+    int node_capacity;
+    int *index;         // Tabela de dispersão ip:porto -> posição em nodes (ou SLOT_EMPTY/SLOT_TOMBSTONE)
+    int index_capacity; // Potência de 2
+    int index_used;     // Posições ocupadas ou com lápide
+    unsigned long long seq; // Número da última alteração de membros (JOINED/LEFT)
+    Subscriber *subscribers;
+    int subscriber_count;
+    int subscriber_capacity;
 } Network;
 
-// Array de redes
-Network networks[MAX_NETS];
+// Registo de redes: tabela de dispersão net_id -> rede
+typedef struct
+{
+    Network **slots; // NULL = vazio; TOMBSTONE_NETWORK = lápide
+    int capacity;    // Potência de 2
+    int count;       // Redes existentes
+    int used;        // Posições ocupadas ou com lápide
+} Registry;
+
+static Network tombstone_network;
+#define TOMBSTONE_NETWORK (&tombstone_network)
+
+// Roda de expiração dos registos (uma por parte do registo). Cada registo tem uma entrada na posição
+// do instante em que expira. Renovar um registo só atualiza lease_expires_ms; quando a posição
+// antiga é percorrida, a entrada é reagendada para a nova expiração (ou o nó é removido se expirou).
+typedef struct
+{
+    int net_id;
+    char ip[16];
+    int tcp_port;
+    unsigned int gen; // Entradas de registos já removidos (outra geração) são descartadas
+} LeaseEntry;
+
+typedef struct
+{
+    LeaseEntry *entries;
+    int count;
+    int capacity;
+} LeaseBucket;
+
+typedef struct
+{
+    LeaseBucket buckets[LEASE_WHEEL_SLOTS];
+    long long current_tick; // Último tick já processado (instante / LEASE_TICK_MS)
+    unsigned int next_gen;
+} LeaseWheel;
+
+// O registo é dividido em REGISTRY_SHARDS partes independentes (rede net_id na parte net_id % REGISTRY_SHARDS),
+// cada uma com o seu mutex, para que os trabalhadores só se bloqueiem entre si quando tratam redes da mesma parte
+typedef struct
+{
+    pthread_mutex_t lock;
+    Registry registry;
+    LeaseWheel wheel;
+} RegistryShard;
+
+RegistryShard shards[REGISTRY_SHARDS];
+static int lease_ttl_s = LEASE_TTL_S; // -t: validade dos registos
+
+static long long now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// O seq de uma rede nova começa no relógio de parede (µs), para nunca recuar quando a rede é apagada
+// e criada de novo ou quando o servidor reinicia
+static unsigned long long initial_network_seq()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static RegistryShard *shard_for_network(int net_id)
+{
+    return &shards[(unsigned int)net_id % REGISTRY_SHARDS];
+}
+
+// Dispersão de inteiros (net_id)
+static unsigned int hash_int(unsigned int x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+// Dispersão FNV-1a de ip:porto
+static unsigned int hash_address(const char *ip, int tcp_port)
+{
+    unsigned int h = 2166136261u;
+    for (const char *c = ip; *c; c++)
+    {
+        h = (h ^ (unsigned char)*c) * 16777619u;
+    }
+    h = (h ^ (unsigned int)(tcp_port & 0xff)) * 16777619u;
+    h = (h ^ (unsigned int)(tcp_port >> 8)) * 16777619u;
+    return h;
+}
+
+static void *checked_calloc(size_t count, size_t size)
+{
+    void *ptr = calloc(count, size);
+    if (!ptr)
+    {
+        perror("Error allocating memory");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
 
 // Função para inicializar as estruturas de dados das redes
 void init_networks()
 {
-    for (int i = 0; i < MAX_NETS; i++)
+    for (int i = 0; i < REGISTRY_SHARDS; i++)
     {
-        networks[i].is_valid = 0;
-        networks[i].net_id = -1;
-        networks[i].node_count = 0;
-        for (int j = 0; j < MAX_NODES_PER_NET; j++)
+        Registry *reg = &shards[i].registry;
+        pthread_mutex_init(&shards[i].lock, NULL);
+        reg->capacity = INITIAL_REGISTRY_CAPACITY;
+        reg->slots = checked_calloc(reg->capacity, sizeof(Network *));
+        reg->count = 0;
+        reg->used = 0;
+        shards[i].wheel.current_tick = now_ms() / LEASE_TICK_MS;
+    }
+}
+
+// Reconstrói a tabela de redes com a capacidade indicada (descarta as lápides)
+static void resize_registry(Registry *reg, int new_capacity)
+{
+    Network **old_slots = reg->slots;
+    int old_capacity = reg->capacity;
+
+    reg->slots = checked_calloc(new_capacity, sizeof(Network *));
+    reg->capacity = new_capacity;
+    reg->used = reg->count;
+    for (int i = 0; i < old_capacity; i++)
+    {
+        Network *net = old_slots[i];
+        if (net && net != TOMBSTONE_NETWORK)
         {
-            networks[i].nodes[j].is_valid = 0;
+            unsigned int pos = hash_int(net->net_id) & (new_capacity - 1);
+            while (reg->slots[pos])
+            {
+                pos = (pos + 1) & (new_capacity - 1);
+            }
+            reg->slots[pos] = net;
         }
     }
+    free(old_slots);
 }
 
-// Função para encontrar ou criar uma rede
-Network *find_or_create_network(int net_id)
+// Posição da rede na tabela, ou -1 se não existe
+static int find_network_slot(Registry *reg, int net_id)
 {
-    // Tenta encontrar
-    for (int i = 0; i < MAX_NETS; i++)
+    unsigned int pos = hash_int(net_id) & (reg->capacity - 1);
+    while (reg->slots[pos])
     {
-        if (networks[i].is_valid && networks[i].net_id == net_id)
+        if (reg->slots[pos] != TOMBSTONE_NETWORK && reg->slots[pos]->net_id == net_id)
         {
-            return &networks[i];
+            return pos;
         }
+        pos = (pos + 1) & (reg->capacity - 1);
+    }
+    return -1;
+}
+
+// Função para encontrar uma rede (sem a criar)
+Network *find_network(Registry *reg, int net_id)
+{
+    int slot = find_network_slot(reg, net_id);
+    return (slot == -1) ? NULL : reg->slots[slot];
+}
+
+// Função para encontrar ou criar uma rede
+Network *find_or_create_network(Registry *reg, int net_id)
+{
+    Network *net = find_network(reg, net_id);
+    if (net)
+    {
+        return net;
+    }
+
+    if ((reg->used + 1) * 2 > reg->capacity)
+    {
+        // Duplica se as redes existentes ocupam mais de um quarto; caso contrário basta limpar as lápides
+        int new_capacity = ((reg->count + 1) * 4 > reg->capacity) ? reg->capacity * 2 : reg->capacity;
+        resize_registry(reg, new_capacity);
+    }
+
+    net = checked_calloc(1, sizeof(Network));
+    net->net_id = net_id;
+    net->seq = initial_network_seq();
+    net->node_capacity = INITIAL_NODE_CAPACITY;
+    net->nodes = checked_calloc(net->node_capacity, sizeof(NodeInfo));
+    net->index_capacity = INITIAL_NODE_CAPACITY * 2;
+    net->index = checked_calloc(net->index_capacity, sizeof(int));
+    memset(net->index, 0xff, net->index_capacity * sizeof(int)); // Todas as posições a SLOT_EMPTY
+
+    unsigned int pos = hash_int(net_id) & (reg->capacity - 1);
+    while (reg->slots[pos] && reg->slots[pos] != TOMBSTONE_NETWORK)
+    {
+        pos = (pos + 1) & (reg->capacity - 1);
+    }
+    if (!reg->slots[pos])
+    {
+        reg->used++;
+    }
+    reg->slots[pos] = net;
+    reg->count++;
+    LOG_VERBOSE("Created new network: %03d\n", net_id);
+    return net;
+}
+
+// Apaga uma rede vazia
+static void destroy_network(Registry *reg, Network *net)
+{
+    int slot = find_network_slot(reg, net->net_id);
+    if (slot != -1)
+    {
+        reg->slots[slot] = TOMBSTONE_NETWORK;
+        reg->count--;
     }
-    // Se não encontrou, tenta criar num slot vazio
-    for (int i = 0; i < MAX_NETS; i++)
+    free(net->nodes);
+    free(net->index);
+    free(net->subscribers);
+    free(net);
+}
+
+// Posição no índice do nó ip:porto, ou -1 se não está registado
+static int find_index_slot(Network *net, const char *ip, int tcp_port)
+{
+    unsigned int mask = net->index_capacity - 1;
+    unsigned int pos = hash_address(ip, tcp_port) & mask;
+    while (net->index[pos] != SLOT_EMPTY)
     {
-        if (!networks[i].is_valid)
+        int idx = net->index[pos];
+        if (idx >= 0 && net->nodes[idx].tcp_port == tcp_port && strcmp(net->nodes[idx].ip, ip) == 0)
         {
-            networks[i].is_valid = 1;
-            networks[i].net_id = net_id;
-            networks[i].node_count = 0;
-            printf("Created new network: %03d\n", net_id);
-            return &networks[i];
+            return pos;
         }
+        pos = (pos + 1) & mask;
     }
-    fprintf(stderr, "Error: No space for new network %d\n", net_id);
-    return NULL; // Sem espaço para mais redes
+    return -1;
 }
 
-// Função para adicionar um nó a uma rede
-int add_node_to_network(Network *net, const char *ip, int tcp_port)
+// Insere no índice a posição idx do array de nós (o nó não pode já lá estar)
+static void index_insert(Network *net, int idx)
+{
+    unsigned int mask = net->index_capacity - 1;
+    unsigned int pos = hash_address(net->nodes[idx].ip, net->nodes[idx].tcp_port) & mask;
+    while (net->index[pos] >= 0)
+    {
+        pos = (pos + 1) & mask;
+    }
+    if (net->index[pos] == SLOT_EMPTY)
+    {
+        net->index_used++;
+    }
+    net->index[pos] = idx;
+}
+
+// Reconstrói o índice de uma rede com a capacidade indicada
+static void rebuild_index(Network *net, int new_capacity)
 {
-    if (net->node_count >= MAX_NODES_PER_NET)
+    free(net->index);
+    net->index_capacity = new_capacity;
+    net->index = checked_calloc(new_capacity, sizeof(int));
+    memset(net->index, 0xff, new_capacity * sizeof(int));
+    net->index_used = 0;
+    for (int i = 0; i < net->node_count; i++)
     {
-        fprintf(stderr, "Error: Network %03d is full. Cannot add node %s:%d\n", net->net_id, ip, tcp_port);
-        return -1; // Rede cheia
+        index_insert(net, i);
     }
+}
 
+// Função para adicionar um nó a uma rede
+int add_node_to_network(Network *net, const char *ip, int tcp_port)
+{
     // Verificar se o nó já existe
-    for (int i = 0; i < MAX_NODES_PER_NET; i++)
+    if (find_index_slot(net, ip, tcp_port) != -1)
     {
-        if (net->nodes[i].is_valid && strcmp(net->nodes[i].ip, ip) == 0 && net->nodes[i].tcp_port == tcp_port)
-        {
-            printf("Node %s:%d already exists in net %03d.\n", ip, tcp_port, net->net_id);
-            return 0; // Nó já existe
-        }
+        LOG_VERBOSE("Node %s:%d already exists in net %03d.\n", ip, tcp_port, net->net_id);
+        return 0; // Nó já existe
     }
 
-    // Adicionar num slot vazio
-    for (int i = 0; i < MAX_NODES_PER_NET; i++)
+    if (net->node_count == net->node_capacity)
     {
-        if (!net->nodes[i].is_valid)
+        NodeInfo *nodes = realloc(net->nodes, net->node_capacity * 2 * sizeof(NodeInfo));
+        if (!nodes)
         {
-            strcpy(net->nodes[i].ip, ip);
-            net->nodes[i].tcp_port = tcp_port;
-            net->nodes[i].is_valid = 1;
-            net->node_count++;
-            printf("Added node %s:%d to net %03d. Total nodes: %d\n", ip, tcp_port, net->net_id, net->node_count);
-            return 1; // Sucesso
+            fprintf(stderr, "Error: Out of memory. Cannot add node %s:%d to net %03d\n", ip, tcp_port, net->net_id);
+            return -1;
         }
+        net->nodes = nodes;
+        net->node_capacity *= 2;
+    }
+    if ((net->index_used + 1) * 2 > net->index_capacity)
+    {
+        // Duplica se os nós ocupam mais de um quarto; caso contrário basta limpar as lápides
+        int new_capacity = ((net->node_count + 1) * 4 > net->index_capacity) ? net->index_capacity * 2 : net->index_capacity;
+        rebuild_index(net, new_capacity);
     }
-    return -1; // Não deveria chegar aqui se a contagem estiver correta
+
+    NodeInfo *info = &net->nodes[net->node_count];
+    strncpy(info->ip, ip, sizeof(info->ip) - 1);
+    info->ip[sizeof(info->ip) - 1] = '\0';
+    info->tcp_port = tcp_port;
+    info->degree = -1;
+    info->depth = -1;
+    index_insert(net, net->node_count);
+    net->node_count++;
+    LOG_VERBOSE("Added node %s:%d to net %03d. Total nodes: %d\n", ip, tcp_port, net->net_id, net->node_count);
+    return 1; // Sucesso
+}
+
+// Função para encontrar um nó registado numa rede
+NodeInfo *find_node_in_network(Network *net, const char *ip, int tcp_port)
+{
+    int slot = find_index_slot(net, ip, tcp_port);
+    return (slot == -1) ? NULL : &net->nodes[net->index[slot]];
 }
 
 // Função para remover um nó de uma rede
-int remove_node_from_network(Network *net, const char *ip, int tcp_port)
+int remove_node_from_network(Registry *reg, Network *net, const char *ip, int tcp_port)
 {
     if (!net)
         return 0;
 
-    for (int i = 0; i < MAX_NODES_PER_NET; i++)
+    int slot = find_index_slot(net, ip, tcp_port);
+    if (slot == -1)
+    {
+        return 0; // Nó não encontrado
+    }
+
+    // O último nó do array ocupa o lugar do removido, para o array continuar denso
+    int idx = net->index[slot];
+    net->index[slot] = SLOT_TOMBSTONE;
+    int last = net->node_count - 1;
+    if (idx != last)
+    {
+        net->index[find_index_slot(net, net->nodes[last].ip, net->nodes[last].tcp_port)] = idx;
+        net->nodes[idx] = net->nodes[last];
+    }
+    net->node_count--;
+    LOG_VERBOSE("Removed node %s:%d from net %03d. Remaining nodes: %d\n", ip, tcp_port, net->net_id, net->node_count);
+
+    // Se a rede ficar vazia (e sem subscritores), é apagada
+    if (net->node_count == 0 && net->subscriber_count == 0)
+    {
+        LOG_VERBOSE("Network %03d is now empty and removed.\n", net->net_id);
+        destroy_network(reg, net);
+    }
+    return 1; // Sucesso
+}
+
+// --- Subscrições de membros ---
+// "SUBSCRIBE <net>" inscreve o endereço UDP do remetente na rede e é respondido com a lista de membros
+// ("MEMBERS <net> <seq> <total>" e as linhas "ip porto" que couberem numa página). A partir daí, cada
+// entrada ou saída de um nó é enviada aos subscritores como "JOINED|LEFT <net> <seq> <ip> <porto>",
+// com seq consecutivos. Um cliente que deteta uma falha na sequência volta a enviar SUBSCRIBE (ou usa o
+// canal TCP, cujo cabeçalho também leva o seq). As subscrições expiram como os registos e são
+// renovadas com novos SUBSCRIBE.
+
+// Mensagens por enviar aos subscritores. Cada thread acumula as suas enquanto trata um lote
+// (com as partes do registo bloqueadas) e envia-as no fim do lote, já sem bloqueios.
+typedef struct
+{
+    struct sockaddr_in addr;
+    int len;
+    char message[80];
+} Notification;
+
+typedef struct
+{
+    Notification *items;
+    int count;
+    int capacity;
+} NotificationQueue;
+
+static __thread NotificationQueue notifications;
+
+// Remove os subscritores expirados da rede
+static void prune_subscribers(Network *net, long long now)
+{
+    for (int i = 0; i < net->subscriber_count;)
+    {
+        if (net->subscribers[i].expires_ms <= now)
+        {
+            net->subscribers[i] = net->subscribers[--net->subscriber_count];
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+// Avança o seq da rede e coloca a alteração na fila de cada subscritor. Chamada com o mutex da parte bloqueado.
+static void notify_subscribers(Network *net, const char *event, const char *ip, int tcp_port)
+{
+    net->seq++;
+    prune_subscribers(net, now_ms());
+    for (int i = 0; i < net->subscriber_count; i++)
     {
-        if (net->nodes[i].is_valid && strcmp(net->nodes[i].ip, ip) == 0 && net->nodes[i].tcp_port == tcp_port)
+        if (notifications.count == notifications.capacity)
         {
-            net->nodes[i].is_valid = 0; // Marcar como inválido
-            net->node_count--;
-            printf("Removed node %s:%d from net %03d. Remaining nodes: %d\n", ip, tcp_port, net->net_id, net->node_count);
-            // Se a rede ficar vazia, podemos marcá-la como inválida também
-            if (net->node_count == 0)
+            int new_capacity = notifications.capacity ? notifications.capacity * 2 : RECV_BATCH;
+            Notification *items = realloc(notifications.items, new_capacity * sizeof(Notification));
+            if (!items)
             {
-                net->is_valid = 0;
-                printf("Network %03d is now empty and removed.\n", net->net_id);
+                fprintf(stderr, "Error: Out of memory. Dropping %s notification for net %03d\n", event, net->net_id);
+                return; // O subscritor deteta a falha na sequência e volta a sincronizar
             }
-            return 1; // Sucesso
+            notifications.items = items;
+            notifications.capacity = new_capacity;
         }
+        Notification *item = &notifications.items[notifications.count++];
+        item->addr = net->subscribers[i].addr;
+        item->len = snprintf(item->message, sizeof(item->message), "%s %03d %llu %s %d", event, net->net_id, net->seq, ip, tcp_port);
     }
-    return 0; // Nó não encontrado
 }
 
-void handle_reg_message(int sock_fd, struct sockaddr_in *client_addr, socklen_t client_len, const char *message)
+// Envia as notificações acumuladas pela thread atual
+static void flush_notifications(int sock_fd)
 {
-    int net_id;
-    char ip_str[16];
-    int tcp_port;
-    char response[MAX_BUFFER_SIZE];
-
-    if (sscanf(message, "REG %d %s %d", &net_id, ip_str, &tcp_port) == 3)
+    struct mmsghdr msgs[RECV_BATCH];
+    struct iovec iov[RECV_BATCH];
+    int done = 0;
+    while (done < notifications.count)
     {
-        Network *net = find_or_create_network(net_id);
-        if (net && add_node_to_network(net, ip_str, tcp_port) != -1)
+        int batch = notifications.count - done < RECV_BATCH ? notifications.count - done : RECV_BATCH;
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < batch; i++)
         {
-            strcpy(response, "OKREG");
-            printf("REG: Node %s:%d registered in net %03d.\n", ip_str, tcp_port, net_id);
+            Notification *item = &notifications.items[done + i];
+            iov[i].iov_base = item->message;
+            iov[i].iov_len = item->len;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &item->addr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(item->addr);
         }
-        else
+        int sent = sendmmsg(sock_fd, msgs, batch, 0);
+        if (sent <= 0)
         {
-            strcpy(response, "ERROR: Could not register node");
-            fprintf(stderr, "REG: Failed to register node %s:%d in net %03d\n", ip_str, tcp_port, net_id);
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            perror("Error sending notifications");
+            break;
         }
-        sendto(sock_fd, response, strlen(response), 0, (struct sockaddr *)client_addr, client_len);
+        done += sent;
     }
-    else
+    notifications.count = 0;
+}
+
+// --- Persistência (opção -d) ---
+// Cada alteração do registo é acrescentada ao diário (WAL) como a linha do protocolo que a reproduz:
+// "REG net ip porto grau profundidade" ou "UNREG net ip porto". As renovações sem alterações não
+// são escritas. Periodicamente o estado completo é escrito num instantâneo (ficheiro temporário +
+// rename) e o diário recomeça. No arranque, o instantâneo e o diário são reaplicados.
+static char wal_path[PATH_MAX];
+static char wal_old_path[PATH_MAX];  // Diário anterior ao instantâneo em escrita
+static char snapshot_path[PATH_MAX];
+static char snapshot_tmp_path[PATH_MAX];
+static char state_dir[PATH_MAX];
+static FILE *wal_file = NULL; // NULL = sem persistência
+static pthread_mutex_t wal_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_rwlock_t wal_sync_lock = PTHREAD_RWLOCK_INITIALIZER; // Impede fechar o diário durante um fdatasync
+static unsigned long wal_appended = 0; // Registos escritos desde o arranque
+static unsigned long wal_synced = 0;   // Registos já em disco
+static unsigned long wal_since_snapshot = 0;
+
+// Acrescenta um registo ao diário. Chamada com o mutex da parte do registo bloqueado, o que mantém
+// a ordem das alterações de cada nó.
+static void wal_append(const char *format, ...)
+{
+    if (!wal_file)
     {
-        fprintf(stderr, "Malformed REG message: %s\n", message);
+        return;
     }
+    va_list args;
+    va_start(args, format);
+    pthread_mutex_lock(&wal_lock);
+    vfprintf(wal_file, format, args);
+    wal_appended++;
+    wal_since_snapshot++;
+    pthread_mutex_unlock(&wal_lock);
+    va_end(args);
 }
 
-void handle_unreg_message(int sock_fd, struct sockaddr_in *client_addr, socklen_t client_len, const char *message)
+// Garante que os registos já escritos estão em disco. Os trabalhadores chamam-na uma vez por lote,
+// antes de enviar as respostas: um OKREG/OKUNREG só é enviado depois de a alteração ser durável.
+static void wal_commit()
 {
-    int net_id;
-    char ip_str[16];
-    int tcp_port;
-    char response[MAX_BUFFER_SIZE];
+    if (!wal_file)
+    {
+        return;
+    }
+    pthread_rwlock_rdlock(&wal_sync_lock);
+    pthread_mutex_lock(&wal_lock);
+    unsigned long target = wal_appended;
+    int need_sync = (wal_synced < target);
+    if (need_sync && fflush(wal_file) != 0)
+    {
+        perror("Error writing WAL");
+    }
+    int fd = fileno(wal_file);
+    pthread_mutex_unlock(&wal_lock);
 
-    if (sscanf(message, "UNREG %d %s %d", &net_id, ip_str, &tcp_port) == 3)
+    if (need_sync)
     {
-        Network *net = find_or_create_network(net_id); // find_or_create para garantir que a rede existe
-        if (net && remove_node_from_network(net, ip_str, tcp_port))
+        if (fdatasync(fd) != 0)
         {
-            strcpy(response, "OKUNREG");
-            printf("UNREG: Node %s:%d unregistered from net %03d.\n", ip_str, tcp_port, net_id);
+            perror("Error syncing WAL");
         }
-        else
+        pthread_mutex_lock(&wal_lock);
+        if (target > wal_synced)
         {
-            strcpy(response, "ERROR: Could not unregister node or node not found");
-            fprintf(stderr, "UNREG: Failed to unregister node %s:%d from net %03d\n", ip_str, tcp_port, net_id);
+            wal_synced = target;
         }
-        sendto(sock_fd, response, strlen(response), 0, (struct sockaddr *)client_addr, client_len);
+        pthread_mutex_unlock(&wal_lock);
     }
-    else
+    pthread_rwlock_unlock(&wal_sync_lock);
+}
+
+// Coloca a entrada na posição da roda do instante expires_ms (no mínimo, a do próximo tick)
+static void schedule_lease(LeaseWheel *wheel, const LeaseEntry *entry, long long expires_ms)
+{
+    long long tick = expires_ms / LEASE_TICK_MS;
+    if (tick <= wheel->current_tick)
+    {
+        tick = wheel->current_tick + 1;
+    }
+    LeaseBucket *bucket = &wheel->buckets[tick % LEASE_WHEEL_SLOTS];
+    if (bucket->count == bucket->capacity)
     {
-        fprintf(stderr, "Malformed UNREG message: %s\n", message);
+        int new_capacity = bucket->capacity ? bucket->capacity * 2 : INITIAL_NODE_CAPACITY;
+        LeaseEntry *entries = realloc(bucket->entries, new_capacity * sizeof(LeaseEntry));
+        if (!entries)
+        {
+            perror("Error allocating lease entries");
+            exit(EXIT_FAILURE);
+        }
+        bucket->entries = entries;
+        bucket->capacity = new_capacity;
     }
+    bucket->entries[bucket->count++] = *entry;
 }
 
-void handle_nodes_request(int sock_fd, struct sockaddr_in *client_addr, socklen_t client_len, const char *message)
+// Cria ou renova o registo de um nó (novo = acabou de ser adicionado e ainda não está na roda)
+static void renew_lease(RegistryShard *shard, Network *net, NodeInfo *info, int is_new)
 {
-    int net_id;
-    char response[MAX_BUFFER_SIZE];
-    char temp_buffer[MAX_BUFFER_SIZE];
-    int offset = 0;
+    info->lease_expires_ms = now_ms() + (long long)lease_ttl_s * 1000;
+    if (is_new)
+    {
+        LeaseEntry entry;
+        entry.net_id = net->net_id;
+        strcpy(entry.ip, info->ip);
+        entry.tcp_port = info->tcp_port;
+        entry.gen = info->lease_gen = ++shard->wheel.next_gen;
+        schedule_lease(&shard->wheel, &entry, info->lease_expires_ms);
+    }
+}
+
+// Percorre as posições da roda até ao instante atual e remove os registos expirados.
+// Devolve o número de nós removidos. Chamada com o mutex da parte bloqueado.
+static int expire_leases(RegistryShard *shard, long long now)
+{
+    LeaseWheel *wheel = &shard->wheel;
+    long long now_tick = now / LEASE_TICK_MS;
+    int expired = 0;
 
-    if (sscanf(message, "NODES %d", &net_id) == 1)
+    // Depois de uma pausa longa basta uma volta completa
+    if (now_tick - wheel->current_tick > LEASE_WHEEL_SLOTS)
+    {
+        wheel->current_tick = now_tick - LEASE_WHEEL_SLOTS;
+    }
+    while (wheel->current_tick < now_tick)
     {
-        // Inicia a resposta com o cabeçalho
-        offset += snprintf(response + offset, sizeof(response) - offset, "NODESLIST %03d\n", net_id);
+        wheel->current_tick++;
+        LeaseBucket due = wheel->buckets[wheel->current_tick % LEASE_WHEEL_SLOTS];
+        memset(&wheel->buckets[wheel->current_tick % LEASE_WHEEL_SLOTS], 0, sizeof(LeaseBucket));
 
-        Network *net = find_or_create_network(net_id);
-        if (net)
+        for (int i = 0; i < due.count; i++)
         {
-            for (int i = 0; i < MAX_NODES_PER_NET; i++)
+            LeaseEntry *entry = &due.entries[i];
+            Network *net = find_network(&shard->registry, entry->net_id);
+            NodeInfo *info = net ? find_node_in_network(net, entry->ip, entry->tcp_port) : NULL;
+            if (!info || info->lease_gen != entry->gen)
             {
-                if (net->nodes[i].is_valid)
-                {
-                    offset += snprintf(response + offset, sizeof(response) - offset, "%s %d\n",
-                                       net->nodes[i].ip, net->nodes[i].tcp_port);
-                    if (offset >= MAX_BUFFER_SIZE - 1)
-                    { // Prevenção de overflow
-                        fprintf(stderr, "Warning: NODESLIST response truncated due to buffer size limit.\n");
-                        break;
-                    }
-                }
+                continue; // Registo removido entretanto (UNREG)
+            }
+            if (info->lease_expires_ms > now)
+            {
+                schedule_lease(wheel, entry, info->lease_expires_ms); // Renovado desde o agendamento
+                continue;
             }
+            printf("Lease of node %s:%d in net %03d expired.\n", entry->ip, entry->tcp_port, entry->net_id);
+            notify_subscribers(net, "LEFT", entry->ip, entry->tcp_port);
+            remove_node_from_network(&shard->registry, net, entry->ip, entry->tcp_port);
+            wal_append("UNREG %03d %s %d\n", entry->net_id, entry->ip, entry->tcp_port);
+            expired++;
         }
-        // Garante que a string está terminada em null, mesmo se snprintf não o fizer no último char
-        response[offset] = '\0';
-        sendto(sock_fd, response, strlen(response), 0, (struct sockaddr *)client_addr, client_len);
-        printf("NODES: Sent list for net %03d to %s:%d\n", net_id, inet_ntoa(client_addr->sin_addr), ntohs(client_addr->sin_port));
-    }
-    else
-    {
-        fprintf(stderr, "Malformed NODES request: %s\n", message);
+        free(due.entries);
     }
+    return expired;
 }
 
-int main()
+// Campos de um nó dentro dos limites do protocolo: rede 000-999, IPv4 válido, porto 1-65535, grau e
+// profundidade entre -1 (desconhecido) e MAX_REPORTED_VALUE. Os pedidos e os registos do diário fora
+// destes limites são recusados antes de chegarem ao registo.
+static int valid_node_fields(int net_id, const char *ip, int tcp_port, int degree, int depth)
 {
-    int sock_fd;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    char buffer[MAX_BUFFER_SIZE];
-
-    init_networks(); // Inicializa as estruturas de dados das redes
+    struct in_addr addr;
+    return net_id >= 0 && net_id <= 999 && inet_pton(AF_INET, ip, &addr) == 1 && tcp_port >= 1 && tcp_port <= 65535 &&
+           degree >= -1 && degree <= MAX_REPORTED_VALUE && depth >= -1 && depth <= MAX_REPORTED_VALUE;
+}
 
-    // Criar socket UDP
-    sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock_fd < 0)
+// Regista ou renova um nó com o estado indicado. Devolve 1 se o nó é novo ou o estado mudou
+// (alteração a escrever no diário), 0 se foi só uma renovação, -1 em caso de erro.
+// Chamada com o mutex da parte bloqueado.
+static int register_node(RegistryShard *shard, int net_id, const char *ip, int tcp_port, int degree, int depth)
+{
+    Network *net = find_or_create_network(&shard->registry, net_id);
+    int added = net ? add_node_to_network(net, ip, tcp_port) : -1;
+    if (added == -1)
     {
-        perror("Error creating socket");
-        exit(EXIT_FAILURE);
+        return -1;
     }
-
-    // Configurar endereço do servidor
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY; // Escutar em todas as interfaces
-    server_addr.sin_port = htons(REG_UDP_PORT);
-
-    // Bind do socket ao endereço e porta
-    if (bind(sock_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    NodeInfo *info = find_node_in_network(net, ip, tcp_port);
+    int changed = (added == 1 || info->degree != degree || info->depth != depth);
+    if (added == 1)
     {
-        perror("Error binding socket");
-        close(sock_fd);
-        exit(EXIT_FAILURE);
+        notify_subscribers(net, "JOINED", ip, tcp_port);
     }
+    info->degree = degree;
+    info->depth = depth;
+    renew_lease(shard, net, info, added == 1);
+    return changed;
+}
 
-    printf("Registration server listening on port %d\n", REG_UDP_PORT);
-
-    while (1)
+// Aplica um ficheiro de registos (instantâneo ou diário). Uma última linha incompleta (escrita
+// interrompida) é ignorada. Devolve o número de registos aplicados, ou -1 se o ficheiro não existe.
+static long replay_state_file(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return -1;
+    }
+    char line[MAX_BUFFER_SIZE];
+    long applied = 0;
+    while (fgets(line, sizeof(line), file))
     {
-        ssize_t bytes_received = recvfrom(sock_fd, buffer, MAX_BUFFER_SIZE - 1, 0,
-                                          (struct sockaddr *)&client_addr, &client_len);
-        if (bytes_received < 0)
+        if (!strchr(line, '\n'))
         {
-            perror("Error receiving data");
-            continue;
+            fprintf(stderr, "Ignoring incomplete record at the end of %s\n", path);
+            break;
         }
-        buffer[bytes_received] = '\0'; // Null-terminate the received data
-
-        printf("Received: '%s' from %s:%d\n", buffer, inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
-
-        // Processar a mensagem
-        if (strncmp(buffer, "REG", 3) == 0)
+        int net_id, tcp_port, degree, depth;
+        char ip[16];
+        if (sscanf(line, "REG %d %15s %d %d %d", &net_id, ip, &tcp_port, &degree, &depth) == 5 &&
+            valid_node_fields(net_id, ip, tcp_port, degree, depth))
         {
-            handle_reg_message(sock_fd, &client_addr, client_len, buffer);
+            RegistryShard *shard = shard_for_network(net_id);
+            register_node(shard, net_id, ip, tcp_port, degree, depth);
+            applied++;
         }
-        else if (strncmp(buffer, "UNREG", 5) == 0)
+        else if (sscanf(line, "UNREG %d %15s %d", &net_id, ip, &tcp_port) == 3 && valid_node_fields(net_id, ip, tcp_port, -1, -1))
         {
-            handle_unreg_message(sock_fd, &client_addr, client_len, buffer);
+            RegistryShard *shard = shard_for_network(net_id);
+            Network *net = find_network(&shard->registry, net_id);
+            remove_node_from_network(&shard->registry, net, ip, tcp_port);
+            applied++;
         }
-        else if (strncmp(buffer, "NODES", 5) == 0)
+        else
         {
-            handle_nodes_request(sock_fd, &client_addr, client_len, buffer);
+            fprintf(stderr, "Ignoring malformed record in %s: %s", path, line);
         }
-        else
+    }
+    fclose(file);
+    return applied;
+}
+
+// Acrescenta o conteúdo de src ao fim de dst e apaga src
+static int append_file(const char *src, const char *dst)
+{
+    FILE *in = fopen(src, "r");
+    FILE *out = fopen(dst, "a");
+    int ok = (in && out);
+    char buffer[8192];
+    size_t n;
+    while (ok && (n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    {
+        ok = (fwrite(buffer, 1, n, out) == n);
+    }
+    if (out && (fflush(out) != 0 || fsync(fileno(out)) != 0))
+    {
+        ok = 0;
+    }
+    if (in)
+        fclose(in);
+    if (out)
+        fclose(out);
+    return ok ? unlink(src) : -1;
+}
+
+static void sync_state_dir()
+{
+    int dir_fd = open(state_dir, O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+}
+
+// Escreve um instantâneo do registo. Com todas as partes bloqueadas, o estado é copiado para memória
+// e o diário passa a ser o diário anterior (wal.old); a escrita em disco é feita já sem bloqueios.
+// Se o processo terminar a meio, o arranque aplica o instantâneo antigo, o wal.old e o diário novo.
+static void write_snapshot()
+{
+    size_t capacity = 4096;
+    size_t len = 0;
+    char *buffer = checked_calloc(capacity, 1);
+    long nodes = 0;
+
+    for (int i = 0; i < REGISTRY_SHARDS; i++)
+    {
+        pthread_mutex_lock(&shards[i].lock);
+    }
+    for (int i = 0; i < REGISTRY_SHARDS; i++)
+    {
+        Registry *reg = &shards[i].registry;
+        for (int s = 0; s < reg->capacity; s++)
         {
-            fprintf(stderr, "Unknown message type: %s\n", buffer);
-            char response[] = "ERROR: Unknown command";
-            sendto(sock_fd, response, strlen(response), 0, (struct sockaddr *)&client_addr, client_len);
+            Network *net = reg->slots[s];
+            if (!net || net == TOMBSTONE_NETWORK)
+            {
+                continue;
+            }
+            for (int n = 0; n < net->node_count; n++)
+            {
+                NodeInfo *info = &net->nodes[n];
+                int written;
+                while ((written = snprintf(buffer + len, capacity - len, "REG %03d %s %d %d %d\n", net->net_id, info->ip,
+                                           info->tcp_port, info->degree, info->depth)) >= 0 &&
+                       (size_t)written >= capacity - len)
+                {
+                    capacity *= 2; // A linha não coube: cresce e escreve-a de novo
+                    buffer = realloc(buffer, capacity);
+                    if (!buffer)
+                    {
+                        perror("Error allocating snapshot");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                if (written > 0)
+                {
+                    len += written;
+                }
+                nodes++;
+            }
         }
     }
 
-    close(sock_fd);
-    return 0;
-}
\ No newline at end of file
+    // Roda o diário. Se um instantâneo anterior falhou, o wal.old ainda existe e o diário junta-se a ele.
+    pthread_rwlock_wrlock(&wal_sync_lock);
+    pthread_mutex_lock(&wal_lock);
+    fflush(wal_file);
+    fdatasync(fileno(wal_file));
+    fclose(wal_file);
+    if (access(wal_old_path, F_OK) == 0 ? append_file(wal_path, wal_old_path) != 0 : rename(wal_path, wal_old_path) != 0)
+    {
+        perror("Error rotating WAL");
+    }
+    wal_file = fopen(wal_path, "a");
+    if (!wal_file)
+    {
+        perror("Error opening WAL");
+        exit(EXIT_FAILURE);
+    }
+    wal_synced = wal_appended;
+    wal_since_snapshot = 0;
+    pthread_mutex_unlock(&wal_lock);
+    pthread_rwlock_unlock(&wal_sync_lock);
+    for (int i = REGISTRY_SHARDS - 1; i >= 0; i--)
+    {
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+
+    FILE *file = fopen(snapshot_tmp_path, "w");
+    int ok = (file && fwrite(buffer, 1, len, file) == len && fflush(file) == 0 && fsync(fileno(file)) == 0);
+    if (file)
+    {
+        fclose(file);
+    }
+    free(buffer);
+    if (!ok || rename(snapshot_tmp_path, snapshot_path) != 0)
+    {
+        perror("Error writing snapshot (WAL kept)");
+        return;
+    }
+    sync_state_dir();
+    unlink(wal_old_path); // Já incluído no instantâneo
+    LOG_VERBOSE("Snapshot written: %ld nodes\n", nodes);
+}
+
+// Recupera o registo a partir de dir (instantâneo e diários) e abre o diário para novas alterações
+static void init_persistence(const char *dir)
+{
+    snprintf(state_dir, sizeof(state_dir), "%s", dir);
+    snprintf(wal_path, sizeof(wal_path), "%s/reg_server.wal", dir);
+    snprintf(wal_old_path, sizeof(wal_old_path), "%s/reg_server.wal.old", dir);
+    snprintf(snapshot_path, sizeof(snapshot_path), "%s/reg_server.snap", dir);
+    snprintf(snapshot_tmp_path, sizeof(snapshot_tmp_path), "%s/reg_server.snap.tmp", dir);
+
+    long long start = now_ms();
+    long snapshot_records = replay_state_file(snapshot_path);
+    long old_records = replay_state_file(wal_old_path);
+    long wal_records = replay_state_file(wal_path);
+    long restored = 0;
+    for (int i = 0; i < REGISTRY_SHARDS; i++)
+    {
+        Registry *reg = &shards[i].registry;
+        for (int s = 0; s < reg->capacity; s++)
+        {
+            if (reg->slots[s] && reg->slots[s] != TOMBSTONE_NETWORK)
+            {
+                restored += reg->slots[s]->node_count;
+            }
+        }
+    }
+    printf("Restored %ld nodes from %s in %lld ms (snapshot %ld, WAL %ld records)\n", restored, dir,
+           now_ms() - start, snapshot_records > 0 ? snapshot_records : 0,
+           (old_records > 0 ? old_records : 0) + (wal_records > 0 ? wal_records : 0));
+
+    wal_file = fopen(wal_path, "a");
+    if (!wal_file)
+    {
+        perror("Error opening WAL");
+        exit(EXIT_FAILURE);
+    }
+    write_snapshot(); // Compacta já o que foi reaplicado
+}
+
+// Os handlers escrevem a resposta em response e devolvem o seu tamanho (0 se não há resposta).
+// Cada um bloqueia apenas a parte do registo onde está a rede do pedido.
+
+size_t handle_reg_message(const char *message, char *response, size_t response_size)
+{
+    int net_id;
+    char ip_str[16];
+    int tcp_port;
+
+    int degree = -1;
+    int depth = -1;
+
+    // O grau e a profundidade são opcionais (clientes antigos enviam apenas "REG net ip port")
+    if (sscanf(message, "REG %d %15s %d %d %d", &net_id, ip_str, &tcp_port, &degree, &depth) < 3 ||
+        !valid_node_fields(net_id, ip_str, tcp_port, degree, depth))
+    {
+        fprintf(stderr, "Malformed or invalid REG message: %s\n", message);
+        return 0;
+    }
+
+    RegistryShard *shard = shard_for_network(net_id);
+    pthread_mutex_lock(&shard->lock);
+    int result = register_node(shard, net_id, ip_str, tcp_port, degree, depth); // Um REG repetido renova o registo
+    if (result == 1)
+    {
+        wal_append("REG %03d %s %d %d %d\n", net_id, ip_str, tcp_port, degree, depth);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    int ok = (result != -1);
+
+    if (ok)
+    {
+        LOG_VERBOSE("REG: Node %s:%d registered in net %03d.\n", ip_str, tcp_port, net_id);
+        return snprintf(response, response_size, "OKREG %d", lease_ttl_s); // Validade do registo em segundos
+    }
+    fprintf(stderr, "REG: Failed to register node %s:%d in net %03d\n", ip_str, tcp_port, net_id);
+    return snprintf(response, response_size, "ERROR: Could not register node");
+}
+
+size_t handle_unreg_message(const char *message, char *response, size_t response_size)
+{
+    int net_id;
+    char ip_str[16];
+    int tcp_port;
+
+    if (sscanf(message, "UNREG %d %15s %d", &net_id, ip_str, &tcp_port) != 3 || !valid_node_fields(net_id, ip_str, tcp_port, -1, -1))
+    {
+        fprintf(stderr, "Malformed or invalid UNREG message: %s\n", message);
+        return 0;
+    }
+
+    RegistryShard *shard = shard_for_network(net_id);
+    pthread_mutex_lock(&shard->lock);
+    Network *net = find_network(&shard->registry, net_id);
+    int ok = (net && find_node_in_network(net, ip_str, tcp_port));
+    if (ok)
+    {
+        notify_subscribers(net, "LEFT", ip_str, tcp_port);
+        remove_node_from_network(&shard->registry, net, ip_str, tcp_port);
+        wal_append("UNREG %03d %s %d\n", net_id, ip_str, tcp_port);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (ok)
+    {
+        LOG_VERBOSE("UNREG: Node %s:%d unregistered from net %03d.\n", ip_str, tcp_port, net_id);
+        return snprintf(response, response_size, "OKUNREG");
+    }
+    fprintf(stderr, "UNREG: Failed to unregister node %s:%d from net %03d\n", ip_str, tcp_port, net_id);
+    return snprintf(response, response_size, "ERROR: Could not unregister node or node not found");
+}
+
+size_t handle_update_message(const char *message, char *response, size_t response_size)
+{
+    int net_id;
+    char ip_str[16];
+    int tcp_port;
+    int degree;
+    int depth;
+
+    if (sscanf(message, "UPDATE %d %15s %d %d %d", &net_id, ip_str, &tcp_port, &degree, &depth) != 5 ||
+        !valid_node_fields(net_id, ip_str, tcp_port, degree, depth))
+    {
+        fprintf(stderr, "Malformed or invalid UPDATE message: %s\n", message);
+        return 0;
+    }
+
+    RegistryShard *shard = shard_for_network(net_id);
+    pthread_mutex_lock(&shard->lock);
+    Network *net = find_network(&shard->registry, net_id);
+    NodeInfo *info = net ? find_node_in_network(net, ip_str, tcp_port) : NULL;
+    if (info)
+    {
+        if (info->degree != degree || info->depth != depth)
+        {
+            wal_append("REG %03d %s %d %d %d\n", net_id, ip_str, tcp_port, degree, depth);
+        }
+        info->degree = degree;
+        info->depth = depth;
+        renew_lease(shard, net, info, 0);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (info)
+    {
+        LOG_VERBOSE("UPDATE: Node %s:%d in net %03d has degree %d, depth %d.\n", ip_str, tcp_port, net_id, degree, depth);
+        return snprintf(response, response_size, "OKUPDATE");
+    }
+    fprintf(stderr, "UPDATE: Node %s:%d is not registered in net %03d\n", ip_str, tcp_port, net_id);
+    return snprintf(response, response_size, "ERROR: Node not registered");
+}
+
+// SUBSCRIBE <net>: inscreve (ou renova) o remetente e responde com a lista de membros. Uma rede sem
+// membros não é criada (os nós subscrevem depois do seu REG); a resposta é só a lista vazia.
+size_t handle_subscribe_message(const char *message, const struct sockaddr_in *from, char *response, size_t response_size)
+{
+    int net_id;
+    if (sscanf(message, "SUBSCRIBE %d", &net_id) != 1 || net_id < 0 || net_id > 999)
+    {
+        fprintf(stderr, "Malformed or invalid SUBSCRIBE message: %s\n", message);
+        return 0;
+    }
+
+    RegistryShard *shard = shard_for_network(net_id);
+    pthread_mutex_lock(&shard->lock);
+    Network *net = find_network(&shard->registry, net_id);
+    if (!net)
+    {
+        pthread_mutex_unlock(&shard->lock);
+        return snprintf(response, response_size, "MEMBERS %03d 0 0\n", net_id);
+    }
+    long long now = now_ms();
+    prune_subscribers(net, now);
+
+    Subscriber *subscriber = NULL;
+    for (int i = 0; i < net->subscriber_count; i++)
+    {
+        if (net->subscribers[i].addr.sin_addr.s_addr == from->sin_addr.s_addr && net->subscribers[i].addr.sin_port == from->sin_port)
+        {
+            subscriber = &net->subscribers[i];
+            break;
+        }
+    }
+    if (!subscriber)
+    {
+        if (net->subscriber_count == MAX_SUBSCRIBERS_PER_NET)
+        {
+            pthread_mutex_unlock(&shard->lock);
+            LOG_VERBOSE("SUBSCRIBE: net %03d already has %d subscribers\n", net_id, MAX_SUBSCRIBERS_PER_NET);
+            return snprintf(response, response_size, "ERROR: Too many subscribers");
+        }
+        if (net->subscriber_count == net->subscriber_capacity)
+        {
+            int new_capacity = net->subscriber_capacity ? net->subscriber_capacity * 2 : INITIAL_NODE_CAPACITY;
+            Subscriber *subscribers = realloc(net->subscribers, new_capacity * sizeof(Subscriber));
+            if (!subscribers)
+            {
+                pthread_mutex_unlock(&shard->lock);
+                fprintf(stderr, "Error: Out of memory. Cannot add subscriber to net %03d\n", net_id);
+                return snprintf(response, response_size, "ERROR: Could not subscribe");
+            }
+            net->subscribers = subscribers;
+            net->subscriber_capacity = new_capacity;
+        }
+        subscriber = &net->subscribers[net->subscriber_count++];
+        subscriber->addr = *from;
+    }
+    subscriber->expires_ms = now + (long long)lease_ttl_s * 1000;
+
+    // Lista de membros: "ip porto" por linha, enquanto couber na página
+    size_t len = snprintf(response, response_size, "MEMBERS %03d %llu %d\n", net_id, net->seq, net->node_count);
+    for (int i = 0; i < net->node_count; i++)
+    {
+        int written = snprintf(response + len, response_size - len, "%s %d\n", net->nodes[i].ip, net->nodes[i].tcp_port);
+        if (written < 0 || (size_t)written >= response_size - len)
+        {
+            response[len] = '\0';
+            break; // O cliente vê que a lista está incompleta (linhas < total) e usa o canal TCP
+        }
+        len += written;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    char from_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &from->sin_addr, from_ip, sizeof(from_ip));
+    LOG_VERBOSE("SUBSCRIBE: %s:%d subscribed to net %03d\n", from_ip, ntohs(from->sin_port), net_id);
+    return len;
+}
+
+// UNSUBSCRIBE <net>: cancela a subscrição do remetente
+size_t handle_unsubscribe_message(const char *message, const struct sockaddr_in *from, char *response, size_t response_size)
+{
+    int net_id;
+    if (sscanf(message, "UNSUBSCRIBE %d", &net_id) != 1)
+    {
+        fprintf(stderr, "Malformed UNSUBSCRIBE message: %s\n", message);
+        return 0;
+    }
+
+    RegistryShard *shard = shard_for_network(net_id);
+    pthread_mutex_lock(&shard->lock);
+    Network *net = find_network(&shard->registry, net_id);
+    if (net)
+    {
+        for (int i = 0; i < net->subscriber_count; i++)
+        {
+            if (net->subscribers[i].addr.sin_addr.s_addr == from->sin_addr.s_addr && net->subscribers[i].addr.sin_port == from->sin_port)
+            {
+                net->subscribers[i] = net->subscribers[--net->subscriber_count];
+                break;
+            }
+        }
+        if (net->node_count == 0 && net->subscriber_count == 0)
+        {
+            destroy_network(&shard->registry, net);
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return snprintf(response, response_size, "OKUNSUBSCRIBE %03d", net_id);
+}
+
+// Ordem de recomendação dos pontos de entrada: primeiro os nós com grau abaixo de PREFERRED_MAX_DEGREE,
+// depois os de profundidade conhecida, por profundidade crescente e, em empate, por grau crescente.
+// Assim a árvore cresce larga e pouco profunda em vez de em cadeia.
+int compare_attach_points(const void *a, const void *b)
+{
+    const NodeInfo *x = *(const NodeInfo *const *)a;
+    const NodeInfo *y = *(const NodeInfo *const *)b;
+
+    int x_saturated = x->degree >= PREFERRED_MAX_DEGREE;
+    int y_saturated = y->degree >= PREFERRED_MAX_DEGREE;
+    if (x_saturated != y_saturated)
+        return x_saturated - y_saturated;
+
+    int x_unknown = x->depth < 0;
+    int y_unknown = y->depth < 0;
+    if (x_unknown != y_unknown)
+        return x_unknown - y_unknown;
+    if (x->depth != y->depth)
+        return x->depth - y->depth;
+    return x->degree - y->degree;
+}
+
+// Chave de paginação de um nó: o endereço IPv4 e o porto num só número. Não depende da posição do
+// nó no array nem no índice, que mudam com as remoções e as reconstruções do índice.
+static long long node_page_key(const NodeInfo *info)
+{
+    struct in_addr addr;
+    if (inet_pton(AF_INET, info->ip, &addr) != 1)
+    {
+        addr.s_addr = 0;
+    }
+    return ((long long)ntohl(addr.s_addr) << 16) | (info->tcp_port & 0xffff);
+}
+
+// Escreve em out as linhas "ip porto grau profundidade" dos nós com chave maior do que cursor, por
+// ordem crescente de chave, enquanto couberem em capacity bytes. Como a página continua a partir da
+// chave do último nó enviado, remoções e entradas durante a paginação não fazem saltar nem repetir
+// os restantes nós. Devolve o cursor da página seguinte, ou -1 se a lista terminou.
+static long long format_nodes_page(Network *net, long long cursor, char *out, size_t capacity, size_t *len)
+{
+    // Seleção das NODESLIST_PAGE_ENTRIES chaves seguintes numa só passagem (inserção numa lista curta ordenada)
+    NodeInfo *page[NODESLIST_PAGE_ENTRIES];
+    long long keys[NODESLIST_PAGE_ENTRIES];
+    int count = 0;
+    int remaining = 0; // Nós depois do cursor que não entraram na seleção
+    for (int i = 0; i < net->node_count; i++)
+    {
+        long long key = node_page_key(&net->nodes[i]);
+        if (key <= cursor)
+        {
+            continue;
+        }
+        if (count == NODESLIST_PAGE_ENTRIES && key > keys[count - 1])
+        {
+            remaining++;
+            continue;
+        }
+        if (count == NODESLIST_PAGE_ENTRIES)
+        {
+            count--; // O último sai da seleção
+            remaining++;
+        }
+        int pos = count++;
+        while (pos > 0 && keys[pos - 1] > key)
+        {
+            page[pos] = page[pos - 1];
+            keys[pos] = keys[pos - 1];
+            pos--;
+        }
+        page[pos] = &net->nodes[i];
+        keys[pos] = key;
+    }
+
+    *len = 0;
+    for (int i = 0; i < count; i++)
+    {
+        NodeInfo *info = page[i];
+        int written = snprintf(out + *len, capacity - *len, "%s %d %d %d\n", info->ip, info->tcp_port, info->degree, info->depth);
+        if (written < 0 || (size_t)written >= capacity - *len)
+        {
+            out[*len] = '\0';
+            return i > 0 ? keys[i - 1] : cursor; // Não coube: fica para a próxima página
+        }
+        *len += written;
+    }
+    return remaining > 0 ? keys[count - 1] : -1;
+}
+
+// NODES <net> <cursor>: página da lista completa de membros (cursor 0 na primeira página).
+// Resposta: "NODESLIST <net> <cursor seguinte|-1> <total>\n" seguido das linhas dos nós.
+static size_t handle_nodes_page_request(int net_id, long long cursor, char *response, size_t response_size)
+{
+    char body[NODESLIST_PAGE_BYTES - 64]; // O resto fica para o cabeçalho
+    size_t body_len = 0;
+    long long next = -1;
+    int total = 0;
+
+    RegistryShard *shard = shard_for_network(net_id);
+    pthread_mutex_lock(&shard->lock);
+    Network *net = find_network(&shard->registry, net_id);
+    if (net)
+    {
+        total = net->node_count;
+        next = format_nodes_page(net, cursor, body, sizeof(body), &body_len);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    size_t len = snprintf(response, response_size, "NODESLIST %03d %lld %d\n", net_id, next, total);
+    if (len + body_len > response_size)
+    {
+        body_len = response_size - len;
+    }
+    memcpy(response + len, body, body_len);
+    LOG_VERBOSE("NODES: Sent page after %lld of net %03d (next %lld, total %d)\n", cursor, net_id, next, total);
+    return len + body_len;
+}
+
+size_t handle_nodes_request(const char *message, char *response, size_t response_size)
+{
+    int net_id;
+    long long cursor;
+    size_t offset = 0;
+
+    int fields = sscanf(message, "NODES %d %lld", &net_id, &cursor);
+    if (fields == 2)
+    {
+        return handle_nodes_page_request(net_id, cursor, response, response_size);
+    }
+    if (fields != 1)
+    {
+        fprintf(stderr, "Malformed NODES request: %s\n", message);
+        return 0;
+    }
+
+    // Inicia a resposta com o cabeçalho
+    offset += snprintf(response + offset, response_size - offset, "NODESLIST %03d\n", net_id);
+
+    // Lista curta de pontos de entrada recomendados: "ip porto grau profundidade"
+    RegistryShard *shard = shard_for_network(net_id);
+    pthread_mutex_lock(&shard->lock);
+    Network *net = find_network(&shard->registry, net_id); // Uma consulta não cria a rede
+    if (net)
+    {
+        // Seleção dos melhores NODESLIST_MAX_ENTRIES numa só passagem (inserção numa lista curta ordenada)
+        NodeInfo *ranked[NODESLIST_MAX_ENTRIES];
+        int count = 0;
+        for (int i = 0; i < net->node_count; i++)
+        {
+            NodeInfo *candidate = &net->nodes[i];
+            if (count == NODESLIST_MAX_ENTRIES && compare_attach_points(&candidate, &ranked[count - 1]) >= 0)
+            {
+                continue;
+            }
+            int pos = (count < NODESLIST_MAX_ENTRIES) ? count++ : count - 1;
+            while (pos > 0 && compare_attach_points(&candidate, &ranked[pos - 1]) < 0)
+            {
+                ranked[pos] = ranked[pos - 1];
+                pos--;
+            }
+            ranked[pos] = candidate;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            int written = snprintf(response + offset, response_size - offset, "%s %d %d %d\n",
+                                   ranked[i]->ip, ranked[i]->tcp_port, ranked[i]->degree, ranked[i]->depth);
+            if (written < 0 || (size_t)written >= response_size - offset)
+            { // Prevenção de overflow
+                fprintf(stderr, "Warning: NODESLIST response truncated due to buffer size limit.\n");
+                break;
+            }
+            offset += written;
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    LOG_VERBOSE("NODES: Sent list for net %03d\n", net_id);
+    return offset;
+}
+
+// Trata um pedido (já sem etiqueta) e conta-o por tipo; devolve o tamanho da resposta (0 se não há)
+static size_t dispatch_request(RequestCounters *counters, char *buffer, const struct sockaddr_in *from, char *response,
+                               size_t response_size)
+{
+
+    if (strncmp(buffer, "REG", 3) == 0)
+    {
+        counters->count[REQUEST_REG]++;
+        return handle_reg_message(buffer, response, response_size);
+    }
+    else if (strncmp(buffer, "UNREG", 5) == 0)
+    {
+        counters->count[REQUEST_UNREG]++;
+        return handle_unreg_message(buffer, response, response_size);
+    }
+    else if (strncmp(buffer, "UPDATE", 6) == 0)
+    {
+        counters->count[REQUEST_UPDATE]++;
+        return handle_update_message(buffer, response, response_size);
+    }
+    else if (strncmp(buffer, "NODES", 5) == 0)
+    {
+        counters->count[REQUEST_NODES]++;
+        return handle_nodes_request(buffer, response, response_size);
+    }
+    else if (strncmp(buffer, "SUBSCRIBE", 9) == 0)
+    {
+        counters->count[REQUEST_SUBSCRIBE]++;
+        return handle_subscribe_message(buffer, from, response, response_size);
+    }
+    else if (strncmp(buffer, "UNSUBSCRIBE", 11) == 0)
+    {
+        counters->count[REQUEST_UNSUBSCRIBE]++;
+        return handle_unsubscribe_message(buffer, from, response, response_size);
+    }
+
+    counters->count[REQUEST_OTHER]++;
+    fprintf(stderr, "Unknown message type: %s\n", buffer);
+    return snprintf(response, response_size, "ERROR: Unknown command");
+}
+
+// Etiqueta opcional no fim de um pedido (" #<n>"), que o cliente usa para associar cada resposta ao
+// seu pedido. É retirada do pedido (os campos seguem como antes) e devolvida; NULL se não há.
+static const char *take_request_tag(char *buffer)
+{
+    char *hash = strrchr(buffer, '#');
+    if (!hash || hash == buffer || hash[-1] != ' ')
+    {
+        return NULL;
+    }
+    size_t digits = strspn(hash + 1, "0123456789");
+    if (digits == 0 || digits > REQUEST_TAG_MAX_DIGITS || hash[1 + digits] != '\0')
+    {
+        return NULL;
+    }
+    hash[-1] = '\0';
+    return hash + 1;
+}
+
+// Ecoa a etiqueta no fim da primeira linha da resposta; devolve o novo tamanho
+static size_t append_reply_tag(char *response, size_t len, size_t response_size, const char *tag)
+{
+    size_t tag_len = strlen(tag) + 2; // " #<n>"
+    if (len == 0 || len + tag_len >= response_size)
+    {
+        return len;
+    }
+    char *newline = memchr(response, '\n', len);
+    size_t line_len = newline ? (size_t)(newline - response) : len;
+    memmove(response + line_len + tag_len, response + line_len, len - line_len);
+    response[line_len] = ' ';
+    response[line_len + 1] = '#';
+    memcpy(response + line_len + 2, tag, tag_len - 2);
+    response[len + tag_len] = '\0';
+    return len + tag_len;
+}
+
+// Trata um datagrama recebido; devolve o tamanho da resposta (0 se não há)
+static size_t handle_datagram(RequestCounters *counters, char *buffer, const struct sockaddr_in *from, char *response,
+                              size_t response_size)
+{
+    LOG_VERBOSE("Received: '%s'\n", buffer);
+
+    const char *tag = take_request_tag(buffer);
+    if (!tag)
+    {
+        return dispatch_request(counters, buffer, from, response, response_size);
+    }
+    // Espaço reservado para a etiqueta: as páginas de NODESLIST enchem o buffer
+    size_t len = dispatch_request(counters, buffer, from, response, response_size - REQUEST_TAG_MAX_DIGITS - 2);
+    return append_reply_tag(response, len, response_size, tag);
+}
+
+// Trabalhador: recebe até RECV_BATCH datagramas de uma vez (recvmmsg), trata-os e envia todas as
+// respostas de uma vez (sendmmsg). Cada trabalhador tem o seu socket no mesmo porto (SO_REUSEPORT);
+// o kernel distribui os clientes pelos sockets, e os datagramas de um cliente chegam sempre ao mesmo.
+static void *worker_main(void *arg)
+{
+    Worker *worker = arg;
+    struct mmsghdr in_msgs[RECV_BATCH];
+    struct mmsghdr out_msgs[RECV_BATCH];
+    struct iovec in_iov[RECV_BATCH];
+    struct iovec out_iov[RECV_BATCH];
+    struct sockaddr_in addrs[RECV_BATCH];
+    char(*in_bufs)[MAX_BUFFER_SIZE] = checked_calloc(RECV_BATCH, MAX_BUFFER_SIZE);
+    char(*out_bufs)[NODESLIST_PAGE_BYTES] = checked_calloc(RECV_BATCH, NODESLIST_PAGE_BYTES);
+
+    memset(in_msgs, 0, sizeof(in_msgs));
+    memset(out_msgs, 0, sizeof(out_msgs));
+    for (int i = 0; i < RECV_BATCH; i++)
+    {
+        in_iov[i].iov_base = in_bufs[i];
+        in_iov[i].iov_len = MAX_BUFFER_SIZE - 1;
+        in_msgs[i].msg_hdr.msg_iov = &in_iov[i];
+        in_msgs[i].msg_hdr.msg_iovlen = 1;
+        in_msgs[i].msg_hdr.msg_name = &addrs[i];
+    }
+
+    while (1)
+    {
+        for (int i = 0; i < RECV_BATCH; i++)
+        {
+            in_msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
+        int received = recvmmsg(worker->sock_fd, in_msgs, RECV_BATCH, MSG_WAITFORONE, NULL);
+        if (received < 0)
+        {
+            if (errno != EINTR)
+            {
+                perror("Error receiving data");
+            }
+            continue;
+        }
+
+        int replies = 0;
+        for (int i = 0; i < received; i++)
+        {
+            in_bufs[i][in_msgs[i].msg_len] = '\0'; // Null-terminate the received data
+            size_t len = handle_datagram(&worker->counters, in_bufs[i], &addrs[i], out_bufs[replies], NODESLIST_PAGE_BYTES);
+            if (len == 0)
+            {
+                continue;
+            }
+            out_iov[replies].iov_base = out_bufs[replies];
+            out_iov[replies].iov_len = len;
+            out_msgs[replies].msg_hdr.msg_iov = &out_iov[replies];
+            out_msgs[replies].msg_hdr.msg_iovlen = 1;
+            out_msgs[replies].msg_hdr.msg_name = &addrs[i];
+            out_msgs[replies].msg_hdr.msg_namelen = in_msgs[i].msg_hdr.msg_namelen;
+            replies++;
+        }
+
+        wal_commit(); // As alterações do lote ficam duráveis antes das respostas
+
+        int sent = 0;
+        while (sent < replies)
+        {
+            int n = sendmmsg(worker->sock_fd, out_msgs + sent, replies - sent, 0);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                perror("Error sending replies");
+                break;
+            }
+            sent += n;
+        }
+        flush_notifications(worker->sock_fd); // Alterações do lote para os subscritores
+    }
+    return NULL;
+}
+
+// Canal TCP de consulta: o cliente envia "NODES <net>\n" e recebe a lista completa de membros,
+// no formato das páginas ("NODESLIST <net> -1 <total> <seq>\n" e as linhas), sem limite de tamanho.
+// O seq é o da última alteração incluída, para os subscritores continuarem a partir dele.
+// Cada conexão é servida de uma só vez por uma thread própria, com tempos máximos por leitura e
+// escrita e um prazo para a conexão inteira.
+static void handle_tcp_query(int conn_fd, struct sockaddr_in client_addr)
+{
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
+
+    struct timeval timeout = {TCP_QUERY_TIMEOUT_S, 0};
+    setsockopt(conn_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(conn_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    long long deadline_ms = now_ms() + TCP_QUERY_DEADLINE_S * 1000LL;
+
+    char request[MAX_BUFFER_SIZE];
+    size_t received = 0;
+    while (received < sizeof(request) - 1 && !memchr(request, '\n', received) && now_ms() < deadline_ms)
+    {
+        ssize_t n = read(conn_fd, request + received, sizeof(request) - 1 - received);
+        if (n <= 0)
+        {
+            break;
+        }
+        received += n;
+    }
+    request[received] = '\0';
+
+    int net_id;
+    if (sscanf(request, "NODES %d", &net_id) != 1)
+    {
+        fprintf(stderr, "Malformed TCP query from %s:%d: %s\n", client_ip, ntohs(client_addr.sin_port), request);
+        close(conn_fd);
+        return;
+    }
+
+    // A resposta é construída com a parte do registo bloqueada e enviada depois de a libertar
+    RegistryShard *shard = shard_for_network(net_id);
+    pthread_mutex_lock(&shard->lock);
+    Network *net = find_network(&shard->registry, net_id);
+    int total = net ? net->node_count : 0;
+    unsigned long long seq = net ? net->seq : 0;
+    // Cabeçalho + "ip porto grau profundidade\n" por nó, cada linha com no máximo NODE_LINE_MAX bytes
+    size_t capacity = 64 + (size_t)total * NODE_LINE_MAX;
+    char *response = malloc(capacity);
+    size_t len = 0;
+    if (response)
+    {
+        len = snprintf(response, capacity, "NODESLIST %03d %d %d %llu\n", net_id, -1, total, seq);
+        for (int i = 0; net && i < net->node_count; i++)
+        {
+            NodeInfo *info = &net->nodes[i];
+            int written = snprintf(response + len, capacity - len, "%s %d %d %d\n", info->ip, info->tcp_port, info->degree, info->depth);
+            if (written < 0 || (size_t)written >= capacity - len)
+            {
+                break; // Não acontece com NODE_LINE_MAX; a resposta fica só com as linhas completas
+            }
+            len += written;
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+    if (!response)
+    {
+        perror("Error allocating TCP response");
+        close(conn_fd);
+        return;
+    }
+
+    size_t sent = 0;
+    while (sent < len)
+    {
+        if (now_ms() >= deadline_ms)
+        {
+            fprintf(stderr, "TCP query from %s:%d exceeded %d s, closing\n", client_ip, ntohs(client_addr.sin_port),
+                    TCP_QUERY_DEADLINE_S);
+            break;
+        }
+        ssize_t n = write(conn_fd, response + sent, len - sent);
+        if (n <= 0)
+        {
+            perror("Error sending TCP response");
+            break;
+        }
+        sent += n;
+    }
+    LOG_VERBOSE("NODES (TCP): Sent %d nodes of net %03d to %s:%d\n", total, net_id, client_ip, ntohs(client_addr.sin_port));
+    free(response);
+    close(conn_fd);
+}
+
+// Conexões de consulta TCP em curso (cada uma na sua thread)
+static pthread_mutex_t tcp_query_lock = PTHREAD_MUTEX_INITIALIZER;
+static int tcp_query_active = 0;
+
+typedef struct
+{
+    int conn_fd;
+    struct sockaddr_in client_addr;
+} TcpQuery;
+
+static void *tcp_query_connection_main(void *arg)
+{
+    TcpQuery *query = arg;
+    handle_tcp_query(query->conn_fd, query->client_addr);
+    free(query);
+    pthread_mutex_lock(&tcp_query_lock);
+    tcp_query_active--;
+    pthread_mutex_unlock(&tcp_query_lock);
+    return NULL;
+}
+
+// Thread do canal TCP de consulta: aceita as conexões e entrega cada uma a uma thread própria, para
+// que nem uma consulta atrase a thread principal (expiração dos registos, notificações de saída e
+// instantâneos) nem um cliente lento atrase as outras consultas
+static void *tcp_query_main(void *arg)
+{
+    int listen_fd = *(int *)arg;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    while (1)
+    {
+        TcpQuery *query = checked_calloc(1, sizeof(TcpQuery));
+        socklen_t client_len = sizeof(query->client_addr);
+        query->conn_fd = accept(listen_fd, (struct sockaddr *)&query->client_addr, &client_len);
+        if (query->conn_fd < 0)
+        {
+            perror("Error accepting TCP query");
+            free(query);
+            continue;
+        }
+
+        pthread_mutex_lock(&tcp_query_lock);
+        int accepted = tcp_query_active < MAX_TCP_QUERY_CONNECTIONS;
+        tcp_query_active += accepted;
+        pthread_mutex_unlock(&tcp_query_lock);
+        pthread_t thread;
+        if (!accepted)
+        {
+            LOG_VERBOSE("TCP query refused: %d connections in progress\n", MAX_TCP_QUERY_CONNECTIONS);
+        }
+        else if (pthread_create(&thread, &attr, tcp_query_connection_main, query) == 0)
+        {
+            continue;
+        }
+        else
+        {
+            perror("Error creating TCP query thread");
+            pthread_mutex_lock(&tcp_query_lock);
+            tcp_query_active--;
+            pthread_mutex_unlock(&tcp_query_lock);
+        }
+        close(query->conn_fd);
+        free(query);
+    }
+    return NULL;
+}
+
+// Mostra o ritmo de pedidos desde o último relatório (somando os contadores de todos os trabalhadores)
+static void report_request_rates(Worker *workers, int num_workers, unsigned long *last_totals, double elapsed_s)
+{
+    static const char *names[NUM_REQUEST_TYPES] = {"REG", "UNREG", "UPDATE", "NODES", "SUBSCRIBE", "UNSUBSCRIBE", "other"};
+    unsigned long totals[NUM_REQUEST_TYPES] = {0};
+    for (int w = 0; w < num_workers; w++)
+    {
+        for (int t = 0; t < NUM_REQUEST_TYPES; t++)
+        {
+            totals[t] += workers[w].counters.count[t];
+        }
+    }
+
+    unsigned long delta_sum = 0;
+    for (int t = 0; t < NUM_REQUEST_TYPES; t++)
+    {
+        delta_sum += totals[t] - last_totals[t];
+    }
+    if (delta_sum > 0)
+    {
+        printf("Requests: %.0f/s (", delta_sum / elapsed_s);
+        for (int t = 0; t < NUM_REQUEST_TYPES; t++)
+        {
+            printf("%s%s %.0f/s", t ? ", " : "", names[t], (totals[t] - last_totals[t]) / elapsed_s);
+        }
+        printf(")\n");
+        fflush(stdout);
+    }
+    memcpy(last_totals, totals, sizeof(totals));
+}
+
+static int open_udp_socket(int port)
+{
+    int sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock_fd < 0)
+    {
+        perror("Error creating socket");
+        exit(EXIT_FAILURE);
+    }
+    int reuse = 1;
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0)
+    {
+        perror("Error setting SO_REUSEPORT");
+    }
+
+    // Configurar endereço do servidor
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY; // Escutar em todas as interfaces
+    server_addr.sin_port = htons(port);
+
+    // Bind do socket ao endereço e porta
+    if (bind(sock_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    {
+        perror("Error binding socket");
+        close(sock_fd);
+        exit(EXIT_FAILURE);
+    }
+    return sock_fd;
+}
+
+static void print_usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-d dir] [-p port] [-t seconds] [-w workers] [-v]\n", program);
+    fprintf(stderr, "  -d dir      keep the registry in dir (WAL + snapshots) and restore it at startup\n");
+    fprintf(stderr, "  -p port     UDP/TCP port (default %d)\n", REG_UDP_PORT);
+    fprintf(stderr, "  -t seconds  registration lease TTL (default %d)\n", LEASE_TTL_S);
+    fprintf(stderr, "  -w workers  worker threads, each with its own SO_REUSEPORT socket (default: one per CPU)\n");
+    fprintf(stderr, "  -v          log every request\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int port = REG_UDP_PORT;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_workers = (cpus > 0) ? (int)cpus : 1;
+
+    const char *state_dir_arg = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:p:t:w:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            state_dir_arg = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 't':
+            lease_ttl_s = atoi(optarg);
+            break;
+        case 'w':
+            num_workers = atoi(optarg);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : EXIT_FAILURE;
+        }
+    }
+    if (num_workers < 1 || num_workers > MAX_WORKERS || port <= 0 || port > 65535 || lease_ttl_s <= 0)
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    init_networks(); // Inicializa as estruturas de dados das redes
+    if (state_dir_arg)
+    {
+        init_persistence(state_dir_arg);
+    }
+
+    Worker *workers = checked_calloc(num_workers, sizeof(Worker));
+    for (int i = 0; i < num_workers; i++)
+    {
+        workers[i].sock_fd = open_udp_socket(port);
+    }
+    for (int i = 0; i < num_workers; i++)
+    {
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0)
+        {
+            perror("Error creating worker thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Socket TCP de consulta no mesmo número de porto, servido por uma thread própria
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(port);
+    int tcp_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    if (tcp_fd < 0 || setsockopt(tcp_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+        bind(tcp_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 || listen(tcp_fd, 16) < 0)
+    {
+        perror("Error creating TCP query socket (TCP queries disabled)");
+        if (tcp_fd >= 0)
+        {
+            close(tcp_fd);
+        }
+        tcp_fd = -1;
+    }
+    pthread_t tcp_thread;
+    if (tcp_fd >= 0 && pthread_create(&tcp_thread, NULL, tcp_query_main, &tcp_fd) != 0)
+    {
+        perror("Error creating TCP query thread");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Registration server listening on port %d (UDP with %d worker(s)%s)\n", port, num_workers, tcp_fd >= 0 ? ", TCP" : "");
+    fflush(stdout);
+
+    unsigned long last_totals[NUM_REQUEST_TYPES] = {0};
+    struct timespec last_report;
+    clock_gettime(CLOCK_MONOTONIC, &last_report);
+    struct timespec last_snapshot = last_report;
+    while (1)
+    {
+        struct timespec tick = {LEASE_TICK_MS / 1000, (LEASE_TICK_MS % 1000) * 1000000L};
+        nanosleep(&tick, NULL);
+
+        // Expiração dos registos não renovados, uma parte do registo de cada vez
+        long long now_tick_ms = now_ms();
+        for (int i = 0; i < REGISTRY_SHARDS; i++)
+        {
+            pthread_mutex_lock(&shards[i].lock);
+            expire_leases(&shards[i], now_tick_ms);
+            pthread_mutex_unlock(&shards[i].lock);
+        }
+        wal_commit();
+        flush_notifications(workers[0].sock_fd); // Saídas por expiração
+        fflush(stdout);
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed_s = (now.tv_sec - last_report.tv_sec) + (now.tv_nsec - last_report.tv_nsec) / 1e9;
+        if (elapsed_s >= RATE_REPORT_INTERVAL_S)
+        {
+            report_request_rates(workers, num_workers, last_totals, elapsed_s);
+            last_report = now;
+        }
+
+        // Instantâneo periódico (ou antes, se o diário crescer muito)
+        if (wal_file && (wal_since_snapshot >= SNAPSHOT_MAX_WAL_RECORDS ||
+                         (wal_since_snapshot > 0 && now.tv_sec - last_snapshot.tv_sec >= SNAPSHOT_INTERVAL_S)))
+        {
+            write_snapshot();
+            last_snapshot = now;
+        }
+    }
+
+    return 0;
+}
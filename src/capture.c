@@ -0,0 +1,97 @@
+#include "capture.h"
+#include "topology_protocol.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+void init_capture(NDNNode *node)
+{
+    node->capture_file = NULL;
+    node->capture_messages = 0;
+    node->capture_path[0] = '\0';
+
+    const char *path = getenv("NDN_CAPTURE_FILE");
+    if (path && path[0])
+    {
+        start_capture(node, path);
+    }
+}
+
+int start_capture(NDNNode *node, const char *path)
+{
+    if (node->capture_file)
+    {
+        printf("Captura já ativa em %s.\n", node->capture_path);
+        return -1;
+    }
+    if (path)
+    {
+        snprintf(node->capture_path, sizeof(node->capture_path), "%s", path);
+    }
+    else
+    {
+        snprintf(node->capture_path, sizeof(node->capture_path), CAPTURE_FILE_FORMAT, node->tcp_port);
+    }
+
+    FILE *file = fopen(node->capture_path, "w");
+    if (!file)
+    {
+        fprintf(stderr, "Erro ao abrir a captura %s: %s\n", node->capture_path, strerror(errno));
+        return -1;
+    }
+    setvbuf(file, NULL, _IOFBF, CAPTURE_BUFFER_SIZE);
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    fprintf(file, "# ndn-capture %d %s:%d %lld\n", CAPTURE_VERSION, node->ip, node->tcp_port,
+            (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+
+    node->capture_file = file;
+    node->capture_start_us = ndn_now_us();
+    node->capture_messages = 0;
+    printf("Captura das mensagens dos vizinhos iniciada em %s.\n", node->capture_path);
+    return 0;
+}
+
+void stop_capture(NDNNode *node)
+{
+    if (!node->capture_file)
+    {
+        return;
+    }
+    fclose(node->capture_file);
+    node->capture_file = NULL;
+    printf("Captura terminada: %lu mensagem(ns) em %s.\n", node->capture_messages, node->capture_path);
+}
+
+void show_capture(NDNNode *node)
+{
+    if (node->capture_file)
+    {
+        printf("Captura ativa em %s: %lu mensagem(ns) em %.1f s.\n", node->capture_path, node->capture_messages,
+               (ndn_now_us() - node->capture_start_us) / 1e6);
+    }
+    else
+    {
+        printf("Captura inativa.\n");
+    }
+}
+
+static void capture_line(NDNNode *node, Neighbor *face, char direction, const char *message)
+{
+    int len = (int)strcspn(message, "\n");
+    fprintf(node->capture_file, "%lld %c %s:%d %.*s\n", ndn_now_us() - node->capture_start_us, direction,
+            (face && face->ip[0]) ? face->ip : "0.0.0.0", face ? face->tcp_port : 0, len, message);
+    node->capture_messages++;
+}
+
+void capture_received(NDNNode *node, Neighbor *face, const char *message)
+{
+    capture_line(node, face, 'I', message);
+}
+
+void capture_sent(NDNNode *node, int sd, const char *message)
+{
+    capture_line(node, find_neighbor_by_sd(node, sd), 'O', message);
+}
@@ -0,0 +1,43 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "ndn_node.h"
+
+// Captura das mensagens trocadas com os vizinhos, para as reproduzir mais tarde contra um nó
+// (tools/replay). Ficheiro de texto com uma linha de cabeçalho
+//   # ndn-capture 1 <ip>:<porto do nó> <início em µs desde a época>
+// e uma linha por mensagem
+//   <µs desde o início> <I|O> <ip>:<porto da interface> <mensagem sem o fim de linha>
+// (I recebida, O enviada). A variável de ambiente NDN_CAPTURE_FILE inicia a captura no arranque.
+#define CAPTURE_FILE_FORMAT "/tmp/ndn-%d.capture" // Porto TCP do nó
+#define CAPTURE_BUFFER_SIZE 65536
+#define CAPTURE_VERSION 1
+
+// Só chama as funções de captura com a captura ativa
+#define CAPTURE_RECEIVED(node, face, message)            \
+    do                                                   \
+    {                                                    \
+        if ((node)->capture_file)                        \
+        {                                                \
+            capture_received((node), (face), (message)); \
+        }                                                \
+    } while (0)
+
+#define CAPTURE_SENT(node, sd, message)            \
+    do                                             \
+    {                                              \
+        if ((node)->capture_file)                  \
+        {                                          \
+            capture_sent((node), (sd), (message)); \
+        }                                          \
+    } while (0)
+
+void init_capture(NDNNode *node);
+int start_capture(NDNNode *node, const char *path); // path NULL: caminho por omissão; -1 se falhou
+void stop_capture(NDNNode *node);
+void show_capture(NDNNode *node);
+
+void capture_received(NDNNode *node, Neighbor *face, const char *message);
+void capture_sent(NDNNode *node, int sd, const char *message);
+
+#endif // CAPTURE_H
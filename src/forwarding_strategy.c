@@ -0,0 +1,332 @@
+#include "forwarding_strategy.h"
+#include "ndn_protocol.h" // Para send_interest_message
+#include "topology_protocol.h" // Para find_neighbor_by_sd
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Estratégias ---
+
+// Inundação: todas as interfaces candidatas (comportamento original)
+static int select_flood(NDNNode *node, StrategyChoice *choice, Neighbor **candidates, int num_candidates, Neighbor **chosen)
+{
+    (void)node;
+    (void)choice;
+    for (int i = 0; i < num_candidates; i++)
+    {
+        chosen[i] = candidates[i];
+    }
+    return num_candidates;
+}
+
+// Custo esperado de uma interface: latência medida a dividir pela taxa de sucesso
+// (com suavização de Laplace). Uma interface que nunca trouxe um objeto fica com uma latência
+// pessimista, para só ser escolhida quando as conhecidas falham.
+static long long face_cost(const Neighbor *neighbor)
+{
+    long long latency_us = neighbor->fwd_latency_us;
+    if (latency_us == 0)
+    {
+        latency_us = STRATEGY_UNKNOWN_LATENCY_US;
+    }
+    long long success_permille = (neighbor->fwd_satisfied + 1) * 1000LL / (neighbor->fwd_satisfied + neighbor->fwd_nacked + 2);
+    return latency_us * 1000 / success_permille;
+}
+
+// Melhor rota: apenas a interface de menor custo (se falhar, a seguinte é tentada com o NOOBJECT)
+static int select_best_route(NDNNode *node, StrategyChoice *choice, Neighbor **candidates, int num_candidates, Neighbor **chosen)
+{
+    (void)node;
+    (void)choice;
+    int best = 0;
+    for (int i = 1; i < num_candidates; i++)
+    {
+        if (face_cost(candidates[i]) < face_cost(candidates[best]))
+        {
+            best = i;
+        }
+    }
+    chosen[0] = candidates[best];
+    return 1;
+}
+
+// Multicast para k interfaces escolhidas ao acaso
+static int select_k_random(NDNNode *node, StrategyChoice *choice, Neighbor **candidates, int num_candidates, Neighbor **chosen)
+{
+    (void)node;
+    (void)choice;
+    int k = (num_candidates < STRATEGY_RANDOM_FANOUT) ? num_candidates : STRATEGY_RANDOM_FANOUT;
+    for (int i = 0; i < k; i++)
+    {
+        int j = i + rand() % (num_candidates - i);
+        Neighbor *tmp = candidates[i];
+        candidates[i] = candidates[j];
+        candidates[j] = tmp;
+        chosen[i] = candidates[i];
+    }
+    return k;
+}
+
+// Sonda e explora: usa a última interface que satisfez o prefixo e, de STRATEGY_PROBE_PERIOD
+// em STRATEGY_PROBE_PERIOD interesses (ou sem interface aprendida), inunda para descobrir melhores
+static int select_probe_then_exploit(NDNNode *node, StrategyChoice *choice, Neighbor **candidates, int num_candidates, Neighbor **chosen)
+{
+    choice->probe_counter++;
+    if (choice->probe_counter % STRATEGY_PROBE_PERIOD != 0)
+    {
+        for (int i = 0; i < num_candidates; i++)
+        {
+            if (candidates[i]->socket_sd == choice->best_face_sd)
+            {
+                chosen[0] = candidates[i];
+                return 1;
+            }
+        }
+    }
+    return select_flood(node, choice, candidates, num_candidates, chosen);
+}
+
+static const ForwardingStrategy strategies[NUM_STRATEGIES] = {
+    [STRATEGY_FLOOD] = {"flood", select_flood},
+    [STRATEGY_BEST_ROUTE] = {"best-route", select_best_route},
+    [STRATEGY_K_RANDOM] = {"k-random", select_k_random},
+    [STRATEGY_PROBE_EXPLOIT] = {"probe", select_probe_then_exploit},
+};
+
+// --- Escolha da estratégia por prefixo ---
+
+void init_forwarding_strategies(NDNNode *node)
+{
+    for (int i = 0; i < MAX_STRATEGY_CHOICES; i++)
+    {
+        node->strategy_choices[i].is_valid = 0;
+    }
+    // A entrada 0 é o prefixo vazio, que coincide com todos os nomes
+    node->strategy_choices[0].prefix[0] = '\0';
+    node->strategy_choices[0].strategy = STRATEGY_FLOOD;
+    node->strategy_choices[0].best_face_sd = -1;
+    node->strategy_choices[0].probe_counter = 0;
+    node->strategy_choices[0].is_valid = 1;
+
+    memset(node->strategy_stats, 0, sizeof(node->strategy_stats));
+    histogram_reset(&node->retrieve_latency);
+    for (int i = 0; i < MAX_STRATEGY_CHOICES; i++)
+    {
+        histogram_reset(&node->prefix_latency[i]);
+    }
+}
+
+int strategy_from_name(const char *name)
+{
+    for (int i = 0; i < NUM_STRATEGIES; i++)
+    {
+        if (strcmp(strategies[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int set_strategy_choice(NDNNode *node, const char *prefix, int strategy)
+{
+    if (strcmp(prefix, "*") == 0)
+    {
+        prefix = "";
+    }
+
+    StrategyChoice *choice = NULL;
+    for (int i = 0; i < MAX_STRATEGY_CHOICES; i++)
+    {
+        if (node->strategy_choices[i].is_valid && strcmp(node->strategy_choices[i].prefix, prefix) == 0)
+        {
+            choice = &node->strategy_choices[i];
+            break;
+        }
+    }
+    for (int i = 0; choice == NULL && i < MAX_STRATEGY_CHOICES; i++)
+    {
+        if (!node->strategy_choices[i].is_valid)
+        {
+            choice = &node->strategy_choices[i];
+            strncpy(choice->prefix, prefix, MAX_OBJECT_NAME_LEN);
+            choice->prefix[MAX_OBJECT_NAME_LEN] = '\0';
+            choice->is_valid = 1;
+            histogram_reset(&node->prefix_latency[i]);
+        }
+    }
+    if (!choice)
+    {
+        return -1;
+    }
+
+    choice->strategy = strategy;
+    choice->best_face_sd = -1;
+    choice->probe_counter = 0;
+    return 0;
+}
+
+int find_strategy_choice(NDNNode *node, const char *object_name)
+{
+    int best = 0;
+    size_t best_len = 0;
+    for (int i = 0; i < MAX_STRATEGY_CHOICES; i++)
+    {
+        if (!node->strategy_choices[i].is_valid)
+        {
+            continue;
+        }
+        size_t len = strlen(node->strategy_choices[i].prefix);
+        if (len > best_len && strncmp(object_name, node->strategy_choices[i].prefix, len) == 0)
+        {
+            best = i;
+            best_len = len;
+        }
+    }
+    return best;
+}
+
+void assign_forwarding_strategy(NDNNode *node, PendingInterestEntry *entry)
+{
+    entry->strategy_choice = find_strategy_choice(node, entry->object_name);
+    entry->created_us = ndn_now_us();
+    node->strategy_stats[node->strategy_choices[entry->strategy_choice].strategy].interests++;
+}
+
+// --- Encaminhamento ---
+
+int forward_interest(NDNNode *node, PendingInterestEntry *entry)
+{
+    // Candidatos: vizinhos que ainda não aparecem na entrada (nem como RESPOSTA, nem já tentados)
+    Neighbor *candidates[MAX_NEIGHBORS];
+    int num_candidates = 0;
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        Neighbor *neighbor = &node->neighbors[i];
+        if (!neighbor->is_valid || neighbor->socket_sd == -1)
+        {
+            continue;
+        }
+        int already_used = 0;
+        for (int j = 0; j < entry->num_active_interfaces; j++)
+        {
+            if (entry->interfaces[j].is_valid && entry->interfaces[j].sd == neighbor->socket_sd)
+            {
+                already_used = 1;
+                break;
+            }
+        }
+        if (!already_used)
+        {
+            candidates[num_candidates++] = neighbor;
+        }
+    }
+    if (num_candidates == 0)
+    {
+        return 0;
+    }
+
+    StrategyChoice *choice = &node->strategy_choices[entry->strategy_choice];
+    Neighbor *chosen[MAX_NEIGHBORS];
+    int num_chosen = strategies[choice->strategy].select_faces(node, choice, candidates, num_candidates, chosen);
+
+    int sent = 0;
+    for (int i = 0; i < num_chosen && entry->num_active_interfaces < MAX_INTEREST_INTERFACES; i++)
+    {
+        int sd = chosen[i]->socket_sd;
+        chosen[i]->fwd_interests++;
+        InterestInterface *interface = &entry->interfaces[entry->num_active_interfaces];
+        interface->sd = sd;
+        interface->state = INTERFACE_STATE_WAITING;
+        interface->is_valid = 1;
+        entry->num_active_interfaces++;
+        sent++;
+        send_interest_message(node, sd, entry->interest_id, entry->object_name, entry->hop_limit, entry->trace_id);
+    }
+    return sent;
+}
+
+void strategy_interest_satisfied(NDNNode *node, PendingInterestEntry *entry, int face_sd)
+{
+    StrategyChoice *choice = &node->strategy_choices[entry->strategy_choice];
+    long long latency_us = ndn_now_us() - entry->created_us;
+
+    StrategyStats *stats = &node->strategy_stats[choice->strategy];
+    stats->satisfied++;
+    stats->latency_sum_us += latency_us;
+
+    choice->best_face_sd = face_sd;
+
+    Neighbor *neighbor = find_neighbor_by_sd(node, face_sd);
+    if (neighbor)
+    {
+        neighbor->fwd_satisfied++;
+        neighbor->fwd_latency_us = (neighbor->fwd_latency_us == 0) ? latency_us : (7 * neighbor->fwd_latency_us + latency_us) / 8;
+        histogram_record(&neighbor->face_latency, latency_us);
+    }
+}
+
+void strategy_interest_nacked(NDNNode *node, int face_sd)
+{
+    Neighbor *neighbor = find_neighbor_by_sd(node, face_sd);
+    if (neighbor)
+    {
+        neighbor->fwd_nacked++;
+    }
+}
+
+void strategy_interest_unsatisfied(NDNNode *node, PendingInterestEntry *entry)
+{
+    node->strategy_stats[node->strategy_choices[entry->strategy_choice].strategy].unsatisfied++;
+}
+
+void strategy_face_removed(NDNNode *node, int face_sd)
+{
+    // O descritor pode ser reutilizado por outro vizinho: as escolhas esquecem a interface aprendida
+    for (int i = 0; i < MAX_STRATEGY_CHOICES; i++)
+    {
+        if (node->strategy_choices[i].is_valid && node->strategy_choices[i].best_face_sd == face_sd)
+        {
+            node->strategy_choices[i].best_face_sd = -1;
+        }
+    }
+}
+
+void show_forwarding_strategies(NDNNode *node)
+{
+    printf("Estratégias de encaminhamento por prefixo:\n");
+    for (int i = 0; i < MAX_STRATEGY_CHOICES; i++)
+    {
+        StrategyChoice *choice = &node->strategy_choices[i];
+        if (choice->is_valid)
+        {
+            printf("  %-20s -> %s", choice->prefix[0] ? choice->prefix : "*", strategies[choice->strategy].name);
+            if (choice->best_face_sd != -1)
+            {
+                printf(" (última interface satisfeita: SD %d)", choice->best_face_sd);
+            }
+            printf("\n");
+        }
+    }
+
+    printf("Estatísticas por estratégia:\n");
+    for (int i = 0; i < NUM_STRATEGIES; i++)
+    {
+        StrategyStats *stats = &node->strategy_stats[i];
+        printf("  %-10s: %ld interesses, %ld satisfeitos, %ld não satisfeitos, latência média %.2f ms\n",
+               strategies[i].name, stats->interests, stats->satisfied, stats->unsatisfied,
+               stats->satisfied ? stats->latency_sum_us / 1000.0 / stats->satisfied : 0.0);
+    }
+
+    printf("Interfaces:\n");
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        Neighbor *neighbor = &node->neighbors[i];
+        if (neighbor->is_valid)
+        {
+            printf("  SD %d (%s:%d): %ld interesses, %ld objetos, %ld noobjects, latência %.2f ms, custo %lld\n",
+                   neighbor->socket_sd, neighbor->ip, neighbor->tcp_port, neighbor->fwd_interests,
+                   neighbor->fwd_satisfied, neighbor->fwd_nacked, neighbor->fwd_latency_us / 1000.0, face_cost(neighbor));
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef FORWARDING_STRATEGY_H
+#define FORWARDING_STRATEGY_H
+
+#include "ndn_node.h"
+
+// Interface de uma estratégia de encaminhamento: dos vizinhos candidatos (os que ainda não
+// constam da entrada da PIT), escolhe por quais o interesse sai. Devolve quantos escolheu.
+typedef struct
+{
+    const char *name;
+    int (*select_faces)(NDNNode *node, StrategyChoice *choice, Neighbor **candidates, int num_candidates, Neighbor **chosen);
+} ForwardingStrategy;
+
+// Inicialização (todos os prefixos usam inundação por omissão)
+void init_forwarding_strategies(NDNNode *node);
+
+// Escolha da estratégia por prefixo do nome ("*" designa o prefixo vazio, por omissão)
+int strategy_from_name(const char *name); // -1 se o nome não for conhecido
+int set_strategy_choice(NDNNode *node, const char *prefix, int strategy);
+int find_strategy_choice(NDNNode *node, const char *object_name); // Prefixo mais longo que coincide
+
+// Associa uma entrada nova da PIT à estratégia do seu prefixo (chamada quando a entrada é criada)
+void assign_forwarding_strategy(NDNNode *node, PendingInterestEntry *entry);
+
+// Envia o interesse da entrada pelas interfaces escolhidas pela estratégia do seu prefixo,
+// colocando-as em ESPERA. Devolve o número de interfaces por onde foi enviado.
+int forward_interest(NDNNode *node, PendingInterestEntry *entry);
+
+// Registo de resultados (para as estatísticas e para as estratégias que aprendem)
+void strategy_interest_satisfied(NDNNode *node, PendingInterestEntry *entry, int face_sd);
+void strategy_interest_nacked(NDNNode *node, int face_sd);
+void strategy_interest_unsatisfied(NDNNode *node, PendingInterestEntry *entry);
+void strategy_face_removed(NDNNode *node, int face_sd); // Vizinho removido: esquece a interface aprendida
+
+void show_forwarding_strategies(NDNNode *node);
+
+#endif // FORWARDING_STRATEGY_H
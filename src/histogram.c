@@ -0,0 +1,161 @@
+#include "histogram.h"
+#include <stdio.h>
+#include <string.h>
+
+void histogram_reset(LatencyHistogram *histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+// Classe de um valor: o grupo é a posição do bit mais significativo, a subclasse os
+// HISTOGRAM_SUB_BUCKET_BITS bits seguintes
+int histogram_bucket_index(long long value_us)
+{
+    if (value_us < HISTOGRAM_SUB_BUCKETS)
+    {
+        return value_us < 0 ? 0 : (int)value_us;
+    }
+    int exponent = 63 - __builtin_clzll((unsigned long long)value_us);
+    int shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+    int sub = (int)(value_us >> shift) - HISTOGRAM_SUB_BUCKETS;
+    int index = (shift + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+    return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+long long histogram_bucket_lower(int index)
+{
+    int group = index / HISTOGRAM_SUB_BUCKETS;
+    if (group == 0)
+    {
+        return index;
+    }
+    return (long long)(HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS) << (group - 1);
+}
+
+long long histogram_bucket_upper(int index)
+{
+    int group = index / HISTOGRAM_SUB_BUCKETS;
+    return histogram_bucket_lower(index) + (group == 0 ? 1 : 1LL << (group - 1));
+}
+
+void histogram_record(LatencyHistogram *histogram, long long value_us)
+{
+    if (value_us < 0)
+    {
+        value_us = 0;
+    }
+    histogram->counts[histogram_bucket_index(value_us)]++;
+    histogram->total++;
+    histogram->sum_us += (unsigned long long)value_us;
+    if (value_us > histogram->max_us)
+    {
+        histogram->max_us = value_us;
+    }
+}
+
+void histogram_merge(LatencyHistogram *dst, const LatencyHistogram *src)
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum_us += src->sum_us;
+    if (src->max_us > dst->max_us)
+    {
+        dst->max_us = src->max_us;
+    }
+}
+
+long long histogram_percentile(const LatencyHistogram *histogram, double q)
+{
+    if (histogram->total == 0)
+    {
+        return 0;
+    }
+    // Posição da amostra pedida (arredondada para cima, no mínimo a primeira)
+    unsigned long long rank = (unsigned long long)(q * (double)histogram->total);
+    if ((double)rank < q * (double)histogram->total)
+    {
+        rank++;
+    }
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+    unsigned long long seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += histogram->counts[i];
+        if (seen >= rank)
+        {
+            long long upper = histogram_bucket_upper(i) - 1;
+            // O máximo só é exato quando é conhecido (histogramas lidos de outros nós não o têm)
+            return (histogram->max_us > 0 && upper > histogram->max_us) ? histogram->max_us : upper;
+        }
+    }
+    return histogram->max_us;
+}
+
+static const struct
+{
+    const char *label;
+    double q;
+} histogram_quantiles[] = {{"0.5", 0.5}, {"0.9", 0.9}, {"0.99", 0.99}, {"0.999", 0.999}};
+
+#define HISTOGRAM_QUANTILE_COUNT (int)(sizeof(histogram_quantiles) / sizeof(histogram_quantiles[0]))
+
+size_t histogram_render(const LatencyHistogram *histogram, const char *name, const char *labels, char *buffer, size_t size)
+{
+    size_t len = 0;
+    const char *sep = labels[0] ? "," : "";
+#define EMIT(...)                                                          \
+    do                                                                     \
+    {                                                                      \
+        if (len < size)                                                    \
+        {                                                                  \
+            int written = snprintf(buffer + len, size - len, __VA_ARGS__); \
+            len += (written > 0) ? (size_t)written : 0;                    \
+        }                                                                  \
+    } while (0)
+
+    if (labels[0])
+    {
+        EMIT("%s_count{%s} %llu\n", name, labels, histogram->total);
+        EMIT("%s_sum{%s} %llu\n", name, labels, histogram->sum_us);
+        EMIT("%s_max{%s} %lld\n", name, labels, histogram->max_us);
+    }
+    else
+    {
+        EMIT("%s_count %llu\n", name, histogram->total);
+        EMIT("%s_sum %llu\n", name, histogram->sum_us);
+        EMIT("%s_max %lld\n", name, histogram->max_us);
+    }
+    for (int i = 0; i < HISTOGRAM_QUANTILE_COUNT; i++)
+    {
+        EMIT("%s{%s%squantile=\"%s\"} %lld\n", name, labels, sep, histogram_quantiles[i].label,
+             histogram_percentile(histogram, histogram_quantiles[i].q));
+    }
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        if (histogram->counts[i] > 0)
+        {
+            EMIT("%s_bucket{%s%slo=\"%lld\"} %llu\n", name, labels, sep, histogram_bucket_lower(i), histogram->counts[i]);
+        }
+    }
+#undef EMIT
+    return len < size ? len : (size > 0 ? size - 1 : 0);
+}
+
+void histogram_print_summary(const LatencyHistogram *histogram)
+{
+    if (histogram->total == 0)
+    {
+        printf("sem amostras");
+        return;
+    }
+    printf("p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, p999 %.1f ms, máx %.1f ms (%llu amostra(s))",
+           histogram_percentile(histogram, 0.5) / 1000.0, histogram_percentile(histogram, 0.9) / 1000.0,
+           histogram_percentile(histogram, 0.99) / 1000.0, histogram_percentile(histogram, 0.999) / 1000.0,
+           histogram->max_us / 1000.0, histogram->total);
+}
@@ -0,0 +1,41 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+
+// Histograma de latências em microssegundos com classes logarítmicas (ao estilo HDR): cada potência
+// de 2 é dividida em HISTOGRAM_SUB_BUCKETS classes iguais, o que dá um erro relativo máximo de 1/8.
+// As classes são as mesmas em todos os nós, por isso os histogramas juntam-se somando as contagens.
+#define HISTOGRAM_SUB_BUCKET_BITS 3
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_MAX_EXPONENT 36 // Valores até 2^37 µs (cerca de 38 horas); acima ficam na última classe
+// Valores abaixo de HISTOGRAM_SUB_BUCKETS têm uma classe cada; depois um grupo por potência de 2
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BUCKET_BITS + 2) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct
+{
+    unsigned long long counts[HISTOGRAM_BUCKETS];
+    unsigned long long total;
+    unsigned long long sum_us;
+    long long max_us;
+} LatencyHistogram;
+
+void histogram_reset(LatencyHistogram *histogram);
+void histogram_record(LatencyHistogram *histogram, long long value_us);
+void histogram_merge(LatencyHistogram *dst, const LatencyHistogram *src);
+
+int histogram_bucket_index(long long value_us);
+long long histogram_bucket_lower(int index);
+long long histogram_bucket_upper(int index); // Primeiro valor da classe seguinte
+
+// Valor abaixo do qual está a fração q (0 a 1) das amostras (limite superior da classe), ou 0 se vazio
+long long histogram_percentile(const LatencyHistogram *histogram, double q);
+
+// Texto para o ponto de recolha: <nome>_count, <nome>_sum, <nome>_max, os percentis e as classes não vazias
+// (<nome>_bucket{...,lo="<limite inferior>"}). labels é a lista de etiquetas sem chavetas ("" se nenhuma).
+size_t histogram_render(const LatencyHistogram *histogram, const char *name, const char *labels, char *buffer, size_t size);
+
+// "p50 1.2 ms, p90 ..., p99 ..., p999 ..., máx ... (N amostras)"
+void histogram_print_summary(const LatencyHistogram *histogram);
+
+#endif // HISTOGRAM_H
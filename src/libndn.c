@@ -0,0 +1,391 @@
+#include "libndn.h"
+#include "ndn_node.h"
+#include "registration_protocol.h"
+#include "topology_protocol.h"
+#include "ndn_protocol.h"
+#include "forwarding_strategy.h"
+#include "logger.h"
+#include "metrics.h"
+#include "capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/select.h>
+
+NDNNode *ndn_create(const char *ip, int tcp_port, const char *reg_ip, int reg_udp_port)
+{
+    NDNNode *node = malloc(sizeof(NDNNode));
+    if (!node)
+    {
+        perror("Erro ao reservar memória para o nó");
+        return NULL;
+    }
+    if (ndn_node_init(node, ip, tcp_port, reg_ip, reg_udp_port) == -1)
+    {
+        free(node);
+        return NULL;
+    }
+    return node;
+}
+
+void ndn_destroy(NDNNode *node)
+{
+    if (node)
+    {
+        ndn_node_cleanup(node);
+        free(node);
+    }
+}
+
+int ndn_step(NDNNode *node, int timeout_ms)
+{
+    fd_set read_fds;
+    fd_set write_fds;
+    FD_ZERO(&read_fds);
+    FD_ZERO(&write_fds);
+    int max_fd = ndn_node_fill_fds(node, &read_fds, &write_fds, -1);
+
+    // Espera o menor entre timeout_ms e o tempo até ao próximo temporizador
+    long long wait_ms = timeout_ms;
+    long long deadline_ms = ndn_node_next_deadline_ms(node);
+    if (deadline_ms != -1)
+    {
+        long long until_deadline = deadline_ms - ndn_now_ms();
+        until_deadline = until_deadline < 0 ? 0 : until_deadline;
+        wait_ms = (wait_ms < 0 || until_deadline < wait_ms) ? until_deadline : wait_ms;
+    }
+    struct timeval timeout;
+    timeout.tv_sec = wait_ms / 1000;
+    timeout.tv_usec = (wait_ms % 1000) * 1000;
+
+    if (select(max_fd + 1, &read_fds, &write_fds, NULL, wait_ms < 0 ? NULL : &timeout) < 0)
+    {
+        if (errno != EINTR)
+        {
+            return -1;
+        }
+        FD_ZERO(&read_fds); // Interrompido: só os temporizadores
+        FD_ZERO(&write_fds);
+    }
+    ndn_node_handle_events(node, &read_fds, &write_fds);
+    return 0;
+}
+
+int ndn_join(NDNNode *node, int net_id)
+{
+    if (net_id < 0 || net_id > 999)
+    {
+        printf("Erro: ID de rede inválido. Deve ser entre 000 e 999.\n");
+        return -1;
+    }
+    if (node->current_net_id != -1 && node->current_net_id != net_id)
+    {
+        printf("Erro: Nó já está na rede %03d. Saia antes de entrar em outra.\n", node->current_net_id);
+        return -1;
+    }
+    if (node->current_net_id == net_id)
+    {
+        printf("Nó já está na rede %03d.\n", net_id);
+        return 0;
+    }
+    printf("Comando: join (rede: %03d)\n", net_id);
+    node->current_net_id = net_id;
+    join_network(node, net_id);
+    return 0;
+}
+
+int ndn_direct_join(NDNNode *node, const char *ip, int tcp_port)
+{
+    if (strcmp(ip, "0.0.0.0") == 0 && tcp_port == 0)
+    {
+        printf("Comando: direct join (criando nova rede com este nó).\n");
+        if (node->current_net_id != -1)
+        {
+            printf("Nó já está na rede %03d. Não é possível criar nova rede com 0.0.0.0.\n", node->current_net_id);
+            return -1;
+        }
+        node->current_net_id = 0; // Por omissão, o primeiro nó cria a rede 000
+        printf("Nó se registrando como primeiro na rede %03d.\n", node->current_net_id);
+        send_reg_message(node, node->current_net_id);
+        return 0;
+    }
+
+    printf("Comando: direct join (conectando a %s:%d).\n", ip, tcp_port);
+    return connect_to_node(node, ip, tcp_port); // O resultado da conexão é mostrado num passo seguinte
+}
+
+int ndn_leave(NDNNode *node)
+{
+    if (node->current_net_id == -1)
+    {
+        printf("Nó não está atualmente em nenhuma rede para sair.\n");
+        return -1;
+    }
+    printf("Comando: leave (rede: %03d)\n", node->current_net_id);
+
+    node->is_leaving = 1;                       // Marcar que o nó está a sair
+    node->internal_neighbors_to_disconnect = 0; // Resetar contador
+
+    // Enviar mensagens LEAVE para todos os vizinhos internos
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        if (node->neighbors[i].is_valid &&
+            (node->neighbors[i].type == NEIGHBOR_TYPE_INTERNAL || node->neighbors[i].type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL))
+        {
+            send_leave_message(node->neighbors[i].socket_sd, node);
+            node->internal_neighbors_to_disconnect++; // Contar quantos vizinhos internos precisam desconectar
+        }
+    }
+
+    send_unreg_message(node, node->current_net_id);
+    unsubscribe_members(node);
+    cancel_pending_connects(node);
+    node->current_net_id = -1;
+
+    if (node->internal_neighbors_to_disconnect == 0)
+    {
+        printf("Nó não tem vizinhos internos. Saída imediata da rede.\n");
+    }
+    else
+    {
+        printf("Nó iniciando processo de saída. Aguardando desconexão de %d vizinhos internos.\n", node->internal_neighbors_to_disconnect);
+    }
+    return 0;
+}
+
+int ndn_create_object(NDNNode *node, const char *name)
+{
+    return create_local_object(node, name);
+}
+
+int ndn_delete_object(NDNNode *node, const char *name)
+{
+    return delete_local_object(node, name);
+}
+
+void ndn_retrieve(NDNNode *node, const char *name, int flags, RetrieveCallback callback, void *ctx)
+{
+    begin_retrieve(node, name, flags, callback, ctx);
+}
+
+int ndn_current_network(NDNNode *node)
+{
+    return node->current_net_id;
+}
+
+int ndn_list_members(NDNNode *node, int net_id, int use_tcp)
+{
+    if (net_id < 0 || net_id > 999)
+    {
+        printf("Erro: ID de rede inválido. Deve ser entre 000 e 999.\n");
+        return -1;
+    }
+    if (use_tcp)
+    {
+        query_network_members_tcp(node, net_id);
+    }
+    else
+    {
+        request_network_members(node, net_id);
+    }
+    return 0;
+}
+
+int ndn_set_heartbeat_interval(NDNNode *node, int interval_ms)
+{
+    if (interval_ms < 0)
+    {
+        return -1;
+    }
+    node->heartbeat_interval_ms = interval_ms;
+    node->heartbeat_next_ms = 0; // Aplicar já no próximo ciclo
+    return 0;
+}
+
+int ndn_get_heartbeat_interval(NDNNode *node)
+{
+    return node->heartbeat_interval_ms;
+}
+
+int ndn_set_shortcut_target(NDNNode *node, int target)
+{
+    if (target < 0 || target > NDN_MAX_SHORTCUTS)
+    {
+        return -1;
+    }
+    node->shortcut_target = target;
+    node->shortcut_next_ms = 0; // Primeiro passeio já no próximo ciclo
+    if (target == 0)
+    {
+        close_shortcuts(node);
+    }
+    return 0;
+}
+
+int ndn_get_shortcut_target(NDNNode *node)
+{
+    return node->shortcut_target;
+}
+
+int ndn_set_strategy(NDNNode *node, const char *prefix, const char *strategy_name)
+{
+    int strategy = strategy_from_name(strategy_name);
+    if (strategy == -1)
+    {
+        return -1;
+    }
+    return set_strategy_choice(node, prefix, strategy) == 0 ? 0 : -2;
+}
+
+int ndn_capture_start(NDNNode *node, const char *path)
+{
+    return start_capture(node, path);
+}
+
+void ndn_capture_stop(NDNNode *node)
+{
+    stop_capture(node);
+}
+
+void ndn_show_topology(NDNNode *node)
+{
+    printf("  Nó atual: %s:%d\n", node->ip, node->tcp_port);
+    printf("  Rede atual: %s\n", (node->current_net_id != -1) ? "Registrado na rede " : "Não registrado em rede");
+    if (node->current_net_id != -1)
+    {
+        printf("  ID da Rede: %03d\n", node->current_net_id);
+    }
+    if (node->depth >= 0)
+    {
+        printf("  Profundidade na árvore: %d\n", node->depth);
+    }
+    else
+    {
+        printf("  Profundidade na árvore: desconhecida\n");
+    }
+    Neighbor *external = get_external_neighbor(node);
+    printf("  Vizinho Externo: %s:%d", external ? external->ip : "Nenhum", external ? external->tcp_port : 0);
+    if (external && external->srtt_us > 0)
+    {
+        printf(" (RTT: %.2f ms)", external->srtt_us / 1000.0);
+    }
+    printf("\n");
+    printf("  Vizinhos Internos:\n");
+    int internal_count = 0;
+    for (int i = 0; i < MAX_NEIGHBORS; ++i)
+    {
+        if (node->neighbors[i].is_valid &&
+            (node->neighbors[i].type == NEIGHBOR_TYPE_INTERNAL || node->neighbors[i].type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL))
+        {
+            printf("    - %s:%d (SD: %d", node->neighbors[i].ip, node->neighbors[i].tcp_port, node->neighbors[i].socket_sd);
+            if (node->neighbors[i].srtt_us > 0)
+            {
+                printf(", RTT: %.2f ms", node->neighbors[i].srtt_us / 1000.0);
+            }
+            printf(")\n");
+            internal_count++;
+        }
+    }
+    if (internal_count == 0)
+    {
+        printf("    (Nenhum)\n");
+    }
+    if (node->shortcut_target > 0 || count_shortcuts(node) > 0)
+    {
+        printf("  Atalhos (%d de %d pretendidos):\n", count_shortcuts(node), node->shortcut_target);
+        for (int i = 0; i < MAX_NEIGHBORS; ++i)
+        {
+            if (node->neighbors[i].is_valid && node->neighbors[i].type == NEIGHBOR_TYPE_SHORTCUT)
+            {
+                printf("    - %s:%d (SD: %d)\n", node->neighbors[i].ip, node->neighbors[i].tcp_port, node->neighbors[i].socket_sd);
+            }
+        }
+    }
+    if (node->heartbeat_interval_ms > 0)
+    {
+        printf("  Heartbeats: a cada %d ms (falha após %d intervalos sem resposta)\n",
+               node->heartbeat_interval_ms, HEARTBEAT_MISS_LIMIT);
+    }
+    else
+    {
+        printf("  Heartbeats: desativados\n");
+    }
+}
+
+void ndn_show_names(NDNNode *node)
+{
+    show_local_objects(node);
+}
+
+void ndn_show_interest_table(NDNNode *node)
+{
+    show_interest_table(node);
+    show_retrieves(node);
+}
+
+void ndn_show_ring(NDNNode *node)
+{
+    show_ring_stats(node);
+}
+
+void ndn_show_strategy(NDNNode *node)
+{
+    show_forwarding_strategies(node);
+}
+
+void ndn_show_members(NDNNode *node)
+{
+    show_member_cache(node);
+}
+
+void ndn_show_stats(NDNNode *node)
+{
+    show_metrics(node);
+}
+
+void ndn_show_latency(NDNNode *node)
+{
+    show_latency(node);
+}
+
+void ndn_show_capture(NDNNode *node)
+{
+    show_capture(node);
+}
+
+void ndn_log_init(void)
+{
+    logger_init();
+}
+
+void ndn_log_shutdown(void)
+{
+    logger_shutdown();
+}
+
+void ndn_log_flush(void)
+{
+    logger_flush();
+}
+
+int ndn_log_set_level(const char *level_name)
+{
+    int level = logger_parse_level(level_name);
+    if (level == -1)
+    {
+        return -1;
+    }
+    logger_set_level(level);
+    printf("Nível de registo: %s\n", level_name);
+    if (level > LOG_COMPILE_LEVEL)
+    {
+        printf("  Aviso: as mensagens acima de '%s' foram retiradas na compilação.\n", logger_level_name(LOG_COMPILE_LEVEL));
+    }
+    return 0;
+}
+
+void ndn_log_show_status(void)
+{
+    logger_show_status();
+}
@@ -0,0 +1,103 @@
+#ifndef LIBNDN_H
+#define LIBNDN_H
+
+#include <sys/select.h>
+
+// Interface pública da biblioteca do nó (libndn.a / libndn.so), usada pelo executável ndn e por
+// programas que queiram um nó NDN no seu próprio loop de eventos.
+//
+// Um nó não tem threads: avança com ndn_step, ou com ndn_node_fill_fds, um select do programa e
+// ndn_node_handle_events. As operações só pedem o trabalho; o resultado chega pelos passos seguintes
+// (as conexões a outros nós, também a de ndn_direct_join, e as consultas TCP ao servidor de registo
+// são concluídas pelo loop). Podem ainda bloquear:
+//   - o envio de mensagens aos vizinhos, feito em sockets bloqueantes (só espera se o vizinho não
+//     estiver a ler e o buffer do socket encher);
+//   - ndn_destroy, que espera até UNREG_WAIT_MS (2 s) pela confirmação da saída do registo.
+// Os nós de um processo são independentes entre si. O nó escreve as suas mensagens no stdout, como
+// o executável ndn; ndn_log_init é opcional.
+//
+// Só as funções declaradas aqui são exportadas pela biblioteca (NDN_EXPORT, com -fvisibility=hidden);
+// o resto do código do nó é interno.
+
+#define NDN_EXPORT __attribute__((visibility("default")))
+
+typedef struct NDNNode NDNNode;
+
+// Resultado final de uma pesquisa do utilizador local
+typedef enum
+{
+    RETRIEVE_RESULT_FOUND,
+    RETRIEVE_RESULT_NOT_FOUND,
+    RETRIEVE_RESULT_TIMEOUT
+} RetrieveResult;
+
+// Chamada uma vez por pesquisa: dentro de um passo do nó ou, se a resposta é imediata (objeto
+// local ou na cache, nó fora de uma rede), antes de ndn_retrieve terminar
+typedef void (*RetrieveCallback)(NDNNode *node, const char *object_name, RetrieveResult result,
+                                 long long latency_us, void *ctx);
+
+// Opções de ndn_retrieve (combináveis)
+#define NDN_RETRIEVE_RING 0x1   // Alcance crescente (1, 2, 4, ... saltos)
+#define NDN_RETRIEVE_TRACED 0x2 // Rastreada em todos os nós do caminho (T=<id>)
+
+// Nó com o socket TCP de escuta em tcp_port e o servidor de registo em reg_ip:reg_udp_port.
+// Devolve NULL se os sockets não puderem ser abertos.
+NDN_EXPORT NDNNode *ndn_create(const char *ip, int tcp_port, const char *reg_ip, int reg_udp_port);
+NDN_EXPORT void ndn_destroy(NDNNode *node); // Sai da rede sem LEAVE (como o 'exit'), fecha os sockets e liberta o nó
+
+// Passos do nó num loop de eventos
+NDN_EXPORT int ndn_node_fill_fds(NDNNode *node, fd_set *read_fds, fd_set *write_fds, int max_fd); // Novo descritor máximo
+NDN_EXPORT long long ndn_node_next_deadline_ms(NDNNode *node); // Próximo temporizador (relógio de ndn_now_ms), ou -1
+NDN_EXPORT void ndn_node_handle_events(NDNNode *node, fd_set *read_fds, fd_set *write_fds); // Sockets prontos e temporizadores
+NDN_EXPORT int ndn_node_finished(NDNNode *node); // 1 depois de um 'leave' concluído
+// Um passo completo: espera até timeout_ms (-1: sem limite) ou pelo próximo temporizador.
+// Devolve -1 se o select falhou (errno), 0 caso contrário.
+NDN_EXPORT int ndn_step(NDNNode *node, int timeout_ms);
+
+NDN_EXPORT long long ndn_now_ms();
+
+// Operações do utilizador local (os comandos do executável ndn). Devolvem 0 se o pedido foi aceite
+// e -1 se foi recusado (o motivo é mostrado no stdout).
+NDN_EXPORT int ndn_join(NDNNode *node, int net_id);
+NDN_EXPORT int ndn_direct_join(NDNNode *node, const char *ip, int tcp_port); // 0.0.0.0 0: cria a rede 000
+NDN_EXPORT int ndn_leave(NDNNode *node);
+NDN_EXPORT int ndn_create_object(NDNNode *node, const char *name);
+NDN_EXPORT int ndn_delete_object(NDNNode *node, const char *name);
+NDN_EXPORT void ndn_retrieve(NDNNode *node, const char *name, int flags, RetrieveCallback callback, void *ctx);
+NDN_EXPORT int ndn_current_network(NDNNode *node); // -1 fora de uma rede
+NDN_EXPORT int ndn_list_members(NDNNode *node, int net_id, int use_tcp); // Lista completa no stdout quando chegar
+
+// Configuração do nó
+#define NDN_MAX_SHORTCUTS 3 // Máximo de atalhos pedidos por ndn_set_shortcut_target
+NDN_EXPORT int ndn_set_heartbeat_interval(NDNNode *node, int interval_ms); // 0 desativa; -1 se negativo
+NDN_EXPORT int ndn_get_heartbeat_interval(NDNNode *node);
+NDN_EXPORT int ndn_set_shortcut_target(NDNNode *node, int target); // 0 fecha os atalhos; -1 fora de 0..NDN_MAX_SHORTCUTS
+NDN_EXPORT int ndn_get_shortcut_target(NDNNode *node);
+// Estratégia de encaminhamento para um prefixo ("*": todos). -1 se o nome da estratégia não é conhecido,
+// -2 se a tabela de estratégias está cheia.
+NDN_EXPORT int ndn_set_strategy(NDNNode *node, const char *prefix, const char *strategy_name);
+
+// Captura das mensagens dos vizinhos (ver tools/replay). path NULL: caminho por omissão.
+NDN_EXPORT int ndn_capture_start(NDNNode *node, const char *path); // -1 se o ficheiro não abriu
+NDN_EXPORT void ndn_capture_stop(NDNNode *node);
+
+// Estado do nó, escrito no stdout (os comandos 'show' do executável ndn)
+NDN_EXPORT void ndn_show_topology(NDNNode *node);
+NDN_EXPORT void ndn_show_names(NDNNode *node);
+NDN_EXPORT void ndn_show_interest_table(NDNNode *node); // Com as pesquisas locais em curso
+NDN_EXPORT void ndn_show_ring(NDNNode *node);
+NDN_EXPORT void ndn_show_strategy(NDNNode *node);
+NDN_EXPORT void ndn_show_members(NDNNode *node);
+NDN_EXPORT void ndn_show_stats(NDNNode *node);
+NDN_EXPORT void ndn_show_latency(NDNNode *node);
+NDN_EXPORT void ndn_show_capture(NDNNode *node);
+
+// Mensagens de diagnóstico, partilhadas por todos os nós do processo. Sem ndn_log_init são escritas
+// diretamente por quem as regista.
+NDN_EXPORT void ndn_log_init(void);     // Thread de escrita
+NDN_EXPORT void ndn_log_shutdown(void); // Escreve as mensagens pendentes e para a thread
+NDN_EXPORT void ndn_log_flush(void);    // Espera até as mensagens pendentes serem escritas
+NDN_EXPORT int ndn_log_set_level(const char *level_name); // error|warn|info|debug; -1 se não for conhecido
+NDN_EXPORT void ndn_log_show_status(void);
+
+#endif // LIBNDN_H
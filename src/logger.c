@@ -0,0 +1,503 @@
+#include "logger.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Anel com vários produtores (as threads que registam mensagens) e um único consumidor (a thread de
+// escrita). As posições avançam sem limite; a posição no anel é o resto da divisão por LOG_RING_SLOTS.
+// Cada registo tem um número de sequência: igual à posição quando está livre para essa posição,
+// posição + 1 depois de escrito. Um produtor reserva a posição com um compare-and-swap em ring_head.
+// Com o anel cheio a mensagem é descartada e contada.
+//
+// O registo guarda o formato (um literal) e os argumentos em binário: inteiros e reais pelo seu
+// valor, cadeias copiadas para data (o texto original pode não existir quando o registo é escrito).
+// Quem regista só percorre o formato para saber os tipos; a formatação é feita pela thread de escrita.
+
+typedef union
+{
+    long long i;
+    unsigned long long u;
+    double d;
+} LogArg;
+
+typedef struct
+{
+    atomic_ulong sequence;
+    const char *format; // NULL: data tem a mensagem já formatada (mais de LOG_MAX_ARGS argumentos)
+    unsigned char level;
+    unsigned char num_args;
+    LogArg args[LOG_MAX_ARGS]; // Cadeias: posição em data, ou -1 para a cadeia vazia
+    char data[LOG_DATA_LEN];
+} LogRecord;
+
+// Uma especificação de conversão do formato: "%[flags][largura][.precisão][tamanho]conversão"
+typedef struct
+{
+    char flags[8];
+    int width;     // -1: nenhuma; -2: '*' (vem dos argumentos)
+    int precision; // -1: nenhuma; -2: '*'
+    char length[3];
+    char conversion;
+} LogSpec;
+
+static LogRecord ring[LOG_RING_SLOTS];
+static atomic_ulong ring_head; // Próxima posição a reservar (os produtores disputam-na)
+static atomic_ulong ring_tail; // Próxima posição a ler (só o consumidor a altera)
+static atomic_ulong records_dropped;
+static atomic_long records_suppressed;
+
+static pthread_t writer_thread;
+static atomic_int writer_running;
+
+atomic_int log_runtime_level = LOG_DEFAULT_LEVEL;
+
+static const char *level_names[] = {"error", "warn", "info", "debug"};
+
+static long long logger_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static FILE *level_stream(int level)
+{
+    return level <= LOG_LEVEL_WARN ? stderr : stdout;
+}
+
+// Lê a especificação de conversão em p (depois do '%'); devolve quantos carateres ocupa
+static int parse_spec(const char *p, LogSpec *spec)
+{
+    const char *start = p;
+    int num_flags = 0;
+    while (*p && strchr("-+ #0", *p) && num_flags < (int)sizeof(spec->flags) - 1)
+    {
+        spec->flags[num_flags++] = *p++;
+    }
+    spec->flags[num_flags] = '\0';
+
+    spec->width = -1;
+    if (*p == '*')
+    {
+        spec->width = -2;
+        p++;
+    }
+    else if (*p >= '0' && *p <= '9')
+    {
+        spec->width = 0;
+        while (*p >= '0' && *p <= '9')
+        {
+            spec->width = spec->width * 10 + (*p++ - '0');
+        }
+    }
+
+    spec->precision = -1;
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            spec->precision = -2;
+            p++;
+        }
+        else
+        {
+            spec->precision = 0;
+            while (*p >= '0' && *p <= '9')
+            {
+                spec->precision = spec->precision * 10 + (*p++ - '0');
+            }
+        }
+    }
+
+    int length_len = 0;
+    while (*p && strchr("hlLzjt", *p) && length_len < 2)
+    {
+        spec->length[length_len++] = *p++;
+    }
+    spec->length[length_len] = '\0';
+    spec->conversion = *p ? *p++ : '\0';
+    return (int)(p - start);
+}
+
+// Escreve um argumento segundo a sua especificação (largura e precisão já resolvidas)
+static void write_spec(FILE *stream, const LogSpec *spec, int width, int precision, const LogArg *arg, const char *data)
+{
+    char format[32];
+    int len = snprintf(format, sizeof(format), "%%%s", spec->flags);
+    if (width >= 0)
+    {
+        len += snprintf(format + len, sizeof(format) - len, "%d", width);
+    }
+    if (precision >= 0)
+    {
+        len += snprintf(format + len, sizeof(format) - len, ".%d", precision);
+    }
+    switch (spec->conversion)
+    {
+    case 'd':
+    case 'i':
+        snprintf(format + len, sizeof(format) - len, "ll%c", spec->conversion);
+        fprintf(stream, format, arg->i);
+        break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        snprintf(format + len, sizeof(format) - len, "ll%c", spec->conversion);
+        fprintf(stream, format, arg->u);
+        break;
+    case 'c':
+        snprintf(format + len, sizeof(format) - len, "c");
+        fprintf(stream, format, (int)arg->i);
+        break;
+    case 'p':
+        snprintf(format + len, sizeof(format) - len, "p");
+        fprintf(stream, format, (void *)(uintptr_t)arg->u);
+        break;
+    case 's':
+        snprintf(format + len, sizeof(format) - len, "s");
+        fprintf(stream, format, arg->i < 0 ? "" : data + arg->i);
+        break;
+    default: // Reais
+        snprintf(format + len, sizeof(format) - len, "%c", spec->conversion);
+        fprintf(stream, format, arg->d);
+        break;
+    }
+}
+
+// Formata um registo no terminal
+static void write_record(const LogRecord *record)
+{
+    FILE *stream = level_stream(record->level);
+    if (!record->format)
+    {
+        fputs(record->data, stream);
+        return;
+    }
+    int next_arg = 0;
+    for (const char *p = record->format; *p;)
+    {
+        const char *percent = strchr(p, '%');
+        if (!percent)
+        {
+            fputs(p, stream);
+            break;
+        }
+        fwrite(p, 1, percent - p, stream);
+        if (percent[1] == '%')
+        {
+            fputc('%', stream);
+            p = percent + 2;
+            continue;
+        }
+        LogSpec spec;
+        p = percent + 1 + parse_spec(percent + 1, &spec);
+        int width = spec.width == -2 ? (int)record->args[next_arg++].i : spec.width;
+        int precision = spec.precision == -2 ? (int)record->args[next_arg++].i : spec.precision;
+        write_spec(stream, &spec, width, precision, &record->args[next_arg++], record->data);
+    }
+}
+
+// Escreve os registos pendentes; devolve quantos foram escritos
+static int drain_ring(void)
+{
+    unsigned long tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    int written = 0;
+    while (1)
+    {
+        LogRecord *record = &ring[tail % LOG_RING_SLOTS];
+        if (atomic_load_explicit(&record->sequence, memory_order_acquire) != tail + 1)
+        {
+            break; // Posição ainda não reservada ou ainda a ser escrita
+        }
+        write_record(record);
+        atomic_store_explicit(&record->sequence, tail + LOG_RING_SLOTS, memory_order_release); // Livre para a próxima volta
+        tail++;
+        written++;
+    }
+    atomic_store_explicit(&ring_tail, tail, memory_order_release);
+
+    unsigned long dropped = atomic_exchange_explicit(&records_dropped, 0, memory_order_relaxed);
+    if (dropped > 0)
+    {
+        fprintf(stderr, "[registo] %lu mensagem(ns) perdida(s) com o anel cheio.\n", dropped);
+    }
+    if (written > 0 || dropped > 0)
+    {
+        fflush(stdout);
+        fflush(stderr);
+    }
+    return written;
+}
+
+static void *writer_main(void *arg)
+{
+    (void)arg;
+    while (atomic_load_explicit(&writer_running, memory_order_acquire))
+    {
+        if (drain_ring() == 0)
+        {
+            usleep(LOG_DRAIN_INTERVAL_US);
+        }
+    }
+    drain_ring(); // O que foi registado antes da paragem
+    return NULL;
+}
+
+void logger_init(void)
+{
+    atomic_store(&ring_head, 0);
+    atomic_store(&ring_tail, 0);
+    for (unsigned long i = 0; i < LOG_RING_SLOTS; i++)
+    {
+        atomic_store(&ring[i].sequence, i);
+    }
+    atomic_store(&records_dropped, 0);
+    atomic_store(&writer_running, 1);
+    if (pthread_create(&writer_thread, NULL, writer_main, NULL) != 0)
+    {
+        // Sem thread de escrita as mensagens são escritas diretamente
+        atomic_store(&writer_running, 0);
+        fprintf(stderr, "Aviso: não foi possível criar a thread de registo. Mensagens escritas diretamente.\n");
+    }
+}
+
+void logger_shutdown(void)
+{
+    if (!atomic_load(&writer_running))
+    {
+        return;
+    }
+    atomic_store_explicit(&writer_running, 0, memory_order_release);
+    pthread_join(writer_thread, NULL);
+}
+
+// Espera até a thread de escrita esvaziar o anel (antes da saída de um comando do utilizador, para
+// que as mensagens anteriores apareçam primeiro)
+void logger_flush(void)
+{
+    while (atomic_load(&writer_running) &&
+           atomic_load_explicit(&ring_tail, memory_order_acquire) != atomic_load_explicit(&ring_head, memory_order_relaxed))
+    {
+        usleep(100);
+    }
+}
+
+void logger_set_level(int level)
+{
+    atomic_store_explicit(&log_runtime_level, level, memory_order_relaxed);
+}
+
+int logger_parse_level(const char *name)
+{
+    for (int i = 0; i <= LOG_LEVEL_DEBUG; i++)
+    {
+        if (strcmp(name, level_names[i]) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *logger_level_name(int level)
+{
+    return (level >= 0 && level <= LOG_LEVEL_DEBUG) ? level_names[level] : "?";
+}
+
+void logger_show_status(void)
+{
+    printf("Nível de registo: %s (compilado até %s)\n", logger_level_name(atomic_load(&log_runtime_level)),
+           logger_level_name(LOG_COMPILE_LEVEL));
+    printf("  Mensagens suprimidas pelo limite de %d/s por ponto de registo: %ld\n", LOG_RATE_PER_SECOND,
+           atomic_load(&records_suppressed));
+    printf("  Escrita em segundo plano: %s\n", atomic_load(&writer_running) ? "ativa" : "inativa");
+}
+
+// Copia os argumentos de uma mensagem para o registo. Devolve 0 se a mensagem tem argumentos a mais
+// ou conversões não suportadas (o registo é então formatado aqui).
+static int capture_args(LogRecord *record, const char *format, va_list args)
+{
+    int num_args = 0;
+    size_t data_len = 0;
+    for (const char *p = strchr(format, '%'); p; p = strchr(p, '%'))
+    {
+        if (p[1] == '%')
+        {
+            p += 2;
+            continue;
+        }
+        LogSpec spec;
+        p += 1 + parse_spec(p + 1, &spec);
+        int precision = -1;
+        if (spec.width == -2)
+        {
+            if (num_args == LOG_MAX_ARGS)
+                return 0;
+            record->args[num_args++].i = va_arg(args, int);
+        }
+        if (spec.precision == -2)
+        {
+            if (num_args == LOG_MAX_ARGS)
+                return 0;
+            precision = va_arg(args, int);
+            record->args[num_args++].i = precision;
+        }
+        else
+        {
+            precision = spec.precision;
+        }
+        if (num_args == LOG_MAX_ARGS)
+            return 0;
+
+        LogArg *arg = &record->args[num_args++];
+        int is_long = (spec.length[0] == 'l');
+        int is_long_long = (spec.length[0] == 'l' && spec.length[1] == 'l');
+        int is_size = (spec.length[0] == 'z' || spec.length[0] == 'j' || spec.length[0] == 't');
+        switch (spec.conversion)
+        {
+        case 'd':
+        case 'i':
+            arg->i = is_long_long ? va_arg(args, long long) : is_long ? va_arg(args, long) : is_size ? (long long)va_arg(args, ptrdiff_t) : va_arg(args, int);
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            arg->u = is_long_long ? va_arg(args, unsigned long long) : is_long ? va_arg(args, unsigned long) : is_size ? (unsigned long long)va_arg(args, size_t) : va_arg(args, unsigned int);
+            break;
+        case 'c':
+            arg->i = va_arg(args, int);
+            break;
+        case 'p':
+            arg->u = (uintptr_t)va_arg(args, void *);
+            break;
+        case 's':
+        {
+            const char *text = va_arg(args, const char *);
+            size_t len = text ? strnlen(text, precision >= 0 ? (size_t)precision : LOG_DATA_LEN) : 0;
+            if (data_len >= LOG_DATA_LEN || !text)
+            {
+                arg->i = -1; // Sem espaço: a cadeia aparece vazia
+                break;
+            }
+            if (len > LOG_DATA_LEN - 1 - data_len)
+            {
+                len = LOG_DATA_LEN - 1 - data_len; // Truncada
+            }
+            memcpy(record->data + data_len, text, len);
+            record->data[data_len + len] = '\0';
+            arg->i = (long long)data_len;
+            data_len += len + 1;
+            break;
+        }
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            arg->d = (spec.length[0] == 'L') ? (double)va_arg(args, long double) : va_arg(args, double);
+            break;
+        default:
+            return 0; // %n e conversões desconhecidas
+        }
+    }
+    return 1;
+}
+
+static void push_record(int level, const char *format, va_list args)
+{
+    if (!atomic_load_explicit(&writer_running, memory_order_relaxed))
+    {
+        vfprintf(level_stream(level), format, args);
+        return;
+    }
+
+    // Reserva uma posição: livre quando o seu número de sequência é igual à posição
+    unsigned long head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    LogRecord *record;
+    while (1)
+    {
+        record = &ring[head % LOG_RING_SLOTS];
+        long diff = (long)(atomic_load_explicit(&record->sequence, memory_order_acquire) - head);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring_head, &head, head + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            atomic_fetch_add_explicit(&records_dropped, 1, memory_order_relaxed); // Anel cheio
+            return;
+        }
+        else
+        {
+            head = atomic_load_explicit(&ring_head, memory_order_relaxed); // Outro produtor reservou-a
+        }
+    }
+
+    record->level = level;
+    record->format = format;
+    va_list copy;
+    va_copy(copy, args);
+    if (!capture_args(record, format, copy))
+    {
+        // Caso raro: formatada aqui, truncada a LOG_DATA_LEN mas com o fim de linha
+        record->format = NULL;
+        int len = vsnprintf(record->data, LOG_DATA_LEN, format, args);
+        if (len >= LOG_DATA_LEN)
+        {
+            record->data[LOG_DATA_LEN - 2] = '\n';
+        }
+    }
+    va_end(copy);
+    atomic_store_explicit(&record->sequence, head + 1, memory_order_release);
+}
+
+static void push_text(int level, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    push_record(level, format, args);
+    va_end(args);
+}
+
+void log_write(int level, LogRateLimit *limit, const char *format, ...)
+{
+    // A janela de cada ponto de registo é partilhada pelas threads; só uma delas a reinicia
+    long long now_ms = logger_now_ms();
+    long long window_start_ms = atomic_load_explicit(&limit->window_start_ms, memory_order_relaxed);
+    if (now_ms - window_start_ms >= 1000 &&
+        atomic_compare_exchange_strong_explicit(&limit->window_start_ms, &window_start_ms, now_ms, memory_order_relaxed,
+                                                memory_order_relaxed))
+    {
+        int suppressed = atomic_exchange_explicit(&limit->suppressed, 0, memory_order_relaxed);
+        atomic_store_explicit(&limit->count, 0, memory_order_relaxed);
+        if (suppressed > 0)
+        {
+            push_text(level, "  (%d mensagem(ns) semelhante(s) suprimida(s))\n", suppressed);
+        }
+    }
+    if (atomic_fetch_add_explicit(&limit->count, 1, memory_order_relaxed) >= LOG_RATE_PER_SECOND)
+    {
+        atomic_fetch_add_explicit(&limit->suppressed, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&records_suppressed, 1, memory_order_relaxed);
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    push_record(level, format, args);
+    va_end(args);
+}
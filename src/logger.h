@@ -0,0 +1,65 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+// Registo das mensagens de diagnóstico fora do caminho de encaminhamento. Quem regista copia para um
+// anel só o formato (um literal) e os argumentos, em binário; a formatação e a escrita no terminal são
+// feitas por uma thread de fundo, de modo que nem a formatação nem um terminal lento atrasam o loop.
+// Qualquer thread pode registar (o anel aceita vários produtores). As mensagens acima do nível de
+// compilação não geram código; as acima do nível em tempo de execução custam apenas uma comparação.
+
+#include <stdatomic.h>
+
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG // make LOG_COMPILE_LEVEL=2 retira as mensagens de depuração
+#endif
+
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO
+#define LOG_RING_SLOTS 2048     // Registos no anel (potência de 2)
+#define LOG_MAX_ARGS 6          // Argumentos por mensagem (com mais, a mensagem é formatada por quem regista)
+#define LOG_DATA_LEN 80         // Bytes das cadeias (%s) de uma mensagem (as maiores são truncadas)
+#define LOG_DRAIN_INTERVAL_US 2000
+#define LOG_RATE_PER_SECOND 100 // Mensagens por segundo de cada ponto de registo; as restantes são suprimidas
+
+// Limite de mensagens de um ponto de registo (uma instância estática por chamada das macros)
+typedef struct
+{
+    atomic_llong window_start_ms;
+    atomic_int count;
+    atomic_int suppressed;
+} LogRateLimit;
+
+extern atomic_int log_runtime_level;
+
+void logger_init(void);
+void logger_shutdown(void);
+void logger_flush(void);
+void logger_set_level(int level);
+int logger_parse_level(const char *name); // -1 se o nome não é um nível
+const char *logger_level_name(int level);
+void logger_show_status(void);
+
+// format tem de ser um literal: é lido pela thread de escrita depois de log_write terminar
+void log_write(int level, LogRateLimit *limit, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+#define LOG_AT(level, ...)                                                             \
+    do                                                                                 \
+    {                                                                                  \
+        if ((level) <= LOG_COMPILE_LEVEL &&                                            \
+            (level) <= atomic_load_explicit(&log_runtime_level, memory_order_relaxed)) \
+        {                                                                              \
+            static LogRateLimit log_rate_limit;                                        \
+            log_write((level), &log_rate_limit, __VA_ARGS__);                          \
+        }                                                                              \
+    } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#endif // LOGGER_H
@@ -1,12 +1,85 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "ndn_node.h"
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include "libndn.h"
+#include "ui_handler.h"
 
 // Valores por omissão para o servidor de nós
 #define DEFAULT_REG_IP "193.136.138.142"
 #define DEFAULT_REG_UDP_PORT 59000
 
+// Loop do executável: os comandos do utilizador (stdin) e os sockets do nó no mesmo select
+static void run_cli(NDNNode *node)
+{
+    fd_set read_fds;
+    fd_set write_fds;
+    int max_fd;
+
+    while (1)
+    {
+        FD_ZERO(&read_fds);
+        FD_ZERO(&write_fds);
+        FD_SET(STDIN_FILENO, &read_fds);
+        max_fd = ndn_node_fill_fds(node, &read_fds, &write_fds, STDIN_FILENO);
+
+        // O select acorda a tempo do próximo temporizador (ou bloqueia se não houver nenhum)
+        struct timeval timeout;
+        struct timeval *timeout_ptr = NULL;
+        long long deadline_ms = ndn_node_next_deadline_ms(node);
+        if (deadline_ms != -1)
+        {
+            long long wait_ms = deadline_ms - ndn_now_ms();
+            if (wait_ms < 0)
+            {
+                wait_ms = 0;
+            }
+            timeout.tv_sec = wait_ms / 1000;
+            timeout.tv_usec = (wait_ms % 1000) * 1000;
+            timeout_ptr = &timeout;
+        }
+
+        int activity = select(max_fd + 1, &read_fds, &write_fds, NULL, timeout_ptr);
+
+        if (activity < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("select error");
+            break;
+        }
+
+        // Lidar com comandos do utilizador (STDIN)
+        if (FD_ISSET(STDIN_FILENO, &read_fds))
+        {
+            char command_line[256];
+            if (fgets(command_line, sizeof(command_line), stdin) != NULL)
+            {
+                command_line[strcspn(command_line, "\n")] = 0;
+                ndn_log_flush(); // As mensagens pendentes aparecem antes da resposta ao comando
+                handle_user_command(node, command_line); // Chamará 'leave' ou 'exit'
+                // Se 'exit' for digitado, o loop principal é quebrado aqui.
+                if (strcmp(command_line, "exit") == 0 || strcmp(command_line, "x") == 0)
+                {
+                    printf("Encerrando a aplicação (comando 'exit').\n");
+                    break;
+                }
+            }
+        }
+
+        ndn_node_handle_events(node, &read_fds, &write_fds);
+
+        // Se o nó está a sair e todos os vizinhos internos desconectaram, sair do loop
+        if (ndn_node_finished(node))
+        {
+            break;
+        }
+    }
+}
+
 int main(int argc, char *argv[])
 {
     if (argc < 3 || argc > 5)
@@ -37,13 +110,21 @@ int main(int argc, char *argv[])
     printf("Nó NDN iniciado com IP: %s, Porto TCP: %d\n", node_ip, node_tcp_port);
     printf("Servidor de Nós: IP: %s, Porto UDP: %d\n", reg_ip, reg_udp_port);
 
-    ndn_node_init(node_ip, node_tcp_port, reg_ip, reg_udp_port);
+    ndn_log_init();
+    // Semente única por processo: identificadores de procura diferentes em cada tentativa
+    srand((unsigned int)time(NULL) ^ (unsigned int)getpid());
+
+    NDNNode *node = ndn_create(node_ip, node_tcp_port, reg_ip, reg_udp_port);
+    if (!node)
+    {
+        ndn_log_shutdown();
+        return EXIT_FAILURE;
+    }
 
-    start_ndn_node_loop(); // Este loop bloqueia até o comando 'exit' ou erro
+    run_cli(node); // Este loop bloqueia até o comando 'exit', o fim de um 'leave' ou erro
+    ndn_destroy(node);
 
-    // A limpeza é chamada dentro do start_ndn_node_loop() antes de sair
-    // ou pode ser chamada aqui se o loop sair por outro motivo.
-    // ndn_node_cleanup();
+    ndn_log_shutdown(); // Escreve as mensagens ainda no anel
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
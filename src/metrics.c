@@ -0,0 +1,351 @@
+#include "metrics.h"
+#include "topology_protocol.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Nome no formato de recolha e descrição mostrada pelo "show stats", por MetricId
+static const struct
+{
+    const char *name;
+    const char *description;
+} metric_info[METRIC_COUNT] = {
+    {"messages_in", "Mensagens recebidas"},
+    {"messages_out", "Mensagens enviadas"},
+    {"bytes_in", "Bytes recebidos"},
+    {"bytes_out", "Bytes enviados"},
+    {"interests_in", "INTEREST recebidos"},
+    {"interests_out", "INTEREST enviados"},
+    {"objects_in", "OBJECT recebidos"},
+    {"objects_out", "OBJECT enviados"},
+    {"noobjects_in", "NOOBJECT recebidos"},
+    {"noobjects_out", "NOOBJECT enviados"},
+    {"cancels_in", "CANCEL recebidos"},
+    {"cancels_out", "CANCEL enviados"},
+    {"control_in", "Mensagens de topologia recebidas"},
+    {"control_out", "Mensagens de topologia enviadas"},
+    {"send_errors", "Erros de envio"},
+    {"local_hits", "Interesses satisfeitos por objetos locais"},
+    {"cache_hits", "Interesses satisfeitos pela cache"},
+    {"cache_misses", "Interesses sem o objeto no nó"},
+    {"cache_inserts", "Objetos guardados na cache"},
+    {"cache_evictions", "Objetos retirados da cache (LRU)"},
+    {"pit_inserts", "Entradas criadas na PIT"},
+    {"pit_aggregated", "Interesses repetidos pela interface de resposta"},
+    {"pit_loops", "Interesses recebidos em ciclo"},
+    {"pit_full", "Interesses recusados com a PIT cheia"},
+    {"pit_satisfied", "Entradas da PIT satisfeitas"},
+    {"pit_unsatisfied", "Entradas da PIT terminadas com NOOBJECT"},
+    {"pit_cancelled", "Entradas da PIT canceladas"},
+    {"scope_exhausted", "Interesses com o alcance esgotado"},
+    {"unsolicited", "OBJECT/NOOBJECT sem interesse pendente"},
+    {"retrieves_found", "Pesquisas locais concluídas com o objeto"},
+    {"retrieves_not_found", "Pesquisas locais concluídas sem o objeto"},
+    {"retrieves_timeout", "Pesquisas locais sem resposta"},
+};
+
+// Contador de entrada do tipo da mensagem (o de saída é o seguinte)
+static int message_kind_metric(const char *message)
+{
+    if (strncmp(message, "INTEREST ", 9) == 0)
+        return METRIC_INTERESTS_IN;
+    if (strncmp(message, "OBJECT ", 7) == 0)
+        return METRIC_OBJECTS_IN;
+    if (strncmp(message, "NOOBJECT ", 9) == 0)
+        return METRIC_NOOBJECTS_IN;
+    if (strncmp(message, "CANCEL ", 7) == 0)
+        return METRIC_CANCELS_IN;
+    return METRIC_CONTROL_IN;
+}
+
+void metrics_count_received(NDNNode *node, Neighbor *face, const char *message)
+{
+    int kind = message_kind_metric(message);
+    node->metrics[METRIC_MESSAGES_IN]++;
+    node->metrics[kind]++;
+    if (face)
+    {
+        face->face_metrics[METRIC_MESSAGES_IN]++;
+        face->face_metrics[kind]++;
+    }
+}
+
+void metrics_count_sent(NDNNode *node, int sd, const char *message, size_t len)
+{
+    int kind = message_kind_metric(message) + 1;
+    node->metrics[METRIC_MESSAGES_OUT]++;
+    node->metrics[METRIC_BYTES_OUT] += len;
+    node->metrics[kind]++;
+    Neighbor *face = find_neighbor_by_sd(node, sd);
+    if (face)
+    {
+        face->face_metrics[METRIC_MESSAGES_OUT]++;
+        face->face_metrics[METRIC_BYTES_OUT] += len;
+        face->face_metrics[kind]++;
+    }
+}
+
+void metrics_count_bytes_in(NDNNode *node, Neighbor *face, size_t len)
+{
+    node->metrics[METRIC_BYTES_IN] += len;
+    if (face)
+    {
+        face->face_metrics[METRIC_BYTES_IN] += len;
+    }
+}
+
+void init_metrics(NDNNode *node)
+{
+    memset(node->metrics, 0, sizeof(node->metrics));
+    node->metrics_sd = -1;
+
+    const char *path = getenv("NDN_METRICS_SOCKET");
+    if (path && path[0])
+    {
+        snprintf(node->metrics_path, sizeof(node->metrics_path), "%s", path);
+    }
+    else
+    {
+        snprintf(node->metrics_path, sizeof(node->metrics_path), METRICS_SOCKET_FORMAT, node->tcp_port);
+    }
+}
+
+void open_metrics_socket(NDNNode *node)
+{
+    int sd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sd == -1)
+    {
+        perror("Erro ao criar socket de métricas");
+        return;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, node->metrics_path, sizeof(addr.sun_path) - 1);
+    unlink(node->metrics_path); // Restos de uma execução anterior com o mesmo porto
+    if (bind(sd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(sd, 4) == -1)
+    {
+        fprintf(stderr, "Aviso: métricas indisponíveis em %s: %s\n", node->metrics_path, strerror(errno));
+        close(sd);
+        return;
+    }
+    fcntl(sd, F_SETFL, fcntl(sd, F_GETFL, 0) | O_NONBLOCK);
+    node->metrics_sd = sd;
+    printf("Métricas disponíveis em %s.\n", node->metrics_path);
+}
+
+void close_metrics(NDNNode *node)
+{
+    if (node->metrics_sd != -1)
+    {
+        close(node->metrics_sd);
+        unlink(node->metrics_path);
+        node->metrics_sd = -1;
+    }
+}
+
+int metrics_fill_read_fds(NDNNode *node, fd_set *read_fds, int max_fd)
+{
+    if (node->metrics_sd == -1)
+    {
+        return max_fd;
+    }
+    FD_SET(node->metrics_sd, read_fds);
+    return node->metrics_sd > max_fd ? node->metrics_sd : max_fd;
+}
+
+// Cada ligação recebe o estado atual das métricas e é fechada
+void metrics_handle_readable(NDNNode *node, fd_set *read_fds)
+{
+    if (node->metrics_sd == -1 || !FD_ISSET(node->metrics_sd, read_fds))
+    {
+        return;
+    }
+    int client_sd = accept(node->metrics_sd, NULL, NULL);
+    if (client_sd == -1)
+    {
+        return;
+    }
+    char buffer[METRICS_RENDER_BUFFER];
+    size_t len = render_metrics(node, buffer, sizeof(buffer));
+    // O recetor é local e a resposta cabe no buffer do socket: a escrita não bloqueia o loop
+    fcntl(client_sd, F_SETFL, fcntl(client_sd, F_GETFL, 0) | O_NONBLOCK);
+    if (write(client_sd, buffer, len) == -1)
+    {
+        LOG_WARN("Erro ao enviar métricas: %s\n", strerror(errno));
+    }
+    close(client_sd);
+}
+
+static const char *face_type_name(NeighborType type)
+{
+    switch (type)
+    {
+    case NEIGHBOR_TYPE_EXTERNAL:
+        return "external";
+    case NEIGHBOR_TYPE_INTERNAL:
+        return "internal";
+    case NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL:
+        return "external_internal";
+    case NEIGHBOR_TYPE_SHORTCUT:
+        return "shortcut";
+    default:
+        return "pending";
+    }
+}
+
+static int count_active_retrieves(NDNNode *node)
+{
+    int retrieves = 0;
+    for (int i = 0; i < MAX_RETRIEVES; i++)
+    {
+        retrieves += node->retrieves[i].is_valid;
+    }
+    return retrieves;
+}
+
+// Formato de texto simples: "ndn_<nome>[{etiquetas}] <valor>", um valor por linha
+size_t render_metrics(NDNNode *node, char *buffer, size_t size)
+{
+    size_t len = 0;
+#define EMIT(...)                                                          \
+    do                                                                     \
+    {                                                                      \
+        if (len < size)                                                    \
+        {                                                                  \
+            int written = snprintf(buffer + len, size - len, __VA_ARGS__); \
+            len += (written > 0) ? (size_t)written : 0;                    \
+        }                                                                  \
+    } while (0)
+
+    EMIT("# nó %s:%d\n", node->ip, node->tcp_port);
+    for (int i = 0; i < METRIC_COUNT; i++)
+    {
+        EMIT("ndn_%s_total %llu\n", metric_info[i].name, node->metrics[i]);
+    }
+    EMIT("ndn_pit_entries %d\n", node->num_pending_interests);
+    EMIT("ndn_cache_objects %d\n", node->num_cached_objects);
+    EMIT("ndn_local_objects %d\n", node->num_local_objects);
+    EMIT("ndn_neighbors %d\n", node->num_active_neighbors);
+    EMIT("ndn_retrieves_in_flight %d\n", count_active_retrieves(node));
+    EMIT("ndn_depth %d\n", node->depth);
+    EMIT("ndn_network %d\n", node->current_net_id);
+
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        Neighbor *face = &node->neighbors[i];
+        if (!face->is_valid)
+        {
+            continue;
+        }
+        for (int m = 0; m < FACE_METRIC_COUNT; m++)
+        {
+            EMIT("ndn_face_%s_total{face=\"%s:%d\",sd=\"%d\",type=\"%s\"} %llu\n", metric_info[m].name, face->ip,
+                 face->tcp_port, face->socket_sd, face_type_name(face->type), face->face_metrics[m]);
+        }
+    }
+#undef EMIT
+
+    // Histogramas de latência (em µs): as classes "lo" são iguais em todos os nós, pelo que as
+    // recolhas de vários nós se juntam somando as linhas _bucket com as mesmas etiquetas
+    char labels[MAX_OBJECT_NAME_LEN + 64];
+    if (len < size)
+    {
+        len += histogram_render(&node->retrieve_latency, "ndn_retrieve_latency_us", "", buffer + len, size - len);
+    }
+    for (int i = 0; i < MAX_STRATEGY_CHOICES && len < size; i++)
+    {
+        StrategyChoice *choice = &node->strategy_choices[i];
+        if (choice->is_valid && node->prefix_latency[i].total > 0)
+        {
+            snprintf(labels, sizeof(labels), "prefix=\"%s\"", choice->prefix[0] ? choice->prefix : "*");
+            len += histogram_render(&node->prefix_latency[i], "ndn_prefix_latency_us", labels, buffer + len, size - len);
+        }
+    }
+    for (int i = 0; i < MAX_NEIGHBORS && len < size; i++)
+    {
+        Neighbor *face = &node->neighbors[i];
+        if (face->is_valid && face->face_latency.total > 0)
+        {
+            snprintf(labels, sizeof(labels), "face=\"%s:%d\",sd=\"%d\"", face->ip, face->tcp_port, face->socket_sd);
+            len += histogram_render(&face->face_latency, "ndn_face_latency_us", labels, buffer + len, size - len);
+        }
+    }
+    return len < size ? len : size - 1;
+}
+
+void show_metrics(NDNNode *node)
+{
+    printf("Estatísticas do nó %s:%d:\n", node->ip, node->tcp_port);
+    for (int i = 0; i < METRIC_COUNT; i++)
+    {
+        printf("  %-48s %llu\n", metric_info[i].description, node->metrics[i]);
+    }
+    printf("  PIT: %d/%d entradas, cache: %d/%d objetos, %d pesquisa(s) em curso\n", node->num_pending_interests,
+           MAX_PENDING_INTERESTS, node->num_cached_objects, MAX_CACHE_OBJECTS, count_active_retrieves(node));
+
+    printf("Interfaces:\n");
+    int shown = 0;
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        Neighbor *face = &node->neighbors[i];
+        if (!face->is_valid)
+        {
+            continue;
+        }
+        unsigned long long *m = face->face_metrics;
+        printf("  SD %d (%s:%d, %s): mensagens %llu/%llu, bytes %llu/%llu, INTEREST %llu/%llu, OBJECT %llu/%llu, "
+               "NOOBJECT %llu/%llu (recebidos/enviados)\n",
+               face->socket_sd, face->ip, face->tcp_port, face_type_name(face->type), m[METRIC_MESSAGES_IN],
+               m[METRIC_MESSAGES_OUT], m[METRIC_BYTES_IN], m[METRIC_BYTES_OUT], m[METRIC_INTERESTS_IN],
+               m[METRIC_INTERESTS_OUT], m[METRIC_OBJECTS_IN], m[METRIC_OBJECTS_OUT], m[METRIC_NOOBJECTS_IN],
+               m[METRIC_NOOBJECTS_OUT]);
+        shown++;
+    }
+    if (shown == 0)
+    {
+        printf("  (Nenhuma)\n");
+    }
+}
+
+void show_latency(NDNNode *node)
+{
+    printf("Latência das pesquisas deste nó (até OBJECT ou NOOBJECT):\n  Total: ");
+    histogram_print_summary(&node->retrieve_latency);
+    printf("\n");
+    for (int i = 0; i < MAX_STRATEGY_CHOICES; i++)
+    {
+        StrategyChoice *choice = &node->strategy_choices[i];
+        if (choice->is_valid && node->prefix_latency[i].total > 0)
+        {
+            printf("  Prefixo '%s': ", choice->prefix[0] ? choice->prefix : "*");
+            histogram_print_summary(&node->prefix_latency[i]);
+            printf("\n");
+        }
+    }
+
+    printf("Latência por interface (INTEREST encaminhado até ao OBJECT):\n");
+    int shown = 0;
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        Neighbor *face = &node->neighbors[i];
+        if (!face->is_valid)
+        {
+            continue;
+        }
+        printf("  SD %d (%s:%d): ", face->socket_sd, face->ip, face->tcp_port);
+        histogram_print_summary(&face->face_latency);
+        printf("\n");
+        shown++;
+    }
+    if (shown == 0)
+    {
+        printf("  (Nenhuma)\n");
+    }
+}
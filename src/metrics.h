@@ -0,0 +1,30 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "ndn_node.h"
+
+// Socket UNIX onde a monitorização recolhe as métricas em texto (uma ligação, uma resposta).
+// A variável de ambiente NDN_METRICS_SOCKET substitui o caminho por omissão.
+#define METRICS_SOCKET_FORMAT "/tmp/ndn-%d.metrics" // Porto TCP do nó
+#define METRICS_RENDER_BUFFER 65536
+
+#define METRIC_INC(node, id) ((node)->metrics[(id)]++)
+
+void init_metrics(NDNNode *node);        // Contadores e caminho do socket
+void open_metrics_socket(NDNNode *node); // Ponto de recolha (só nos nós com sockets próprios)
+void close_metrics(NDNNode *node);
+
+// Contagem das mensagens trocadas com os vizinhos
+void metrics_count_received(NDNNode *node, Neighbor *face, const char *message);
+void metrics_count_sent(NDNNode *node, int sd, const char *message, size_t len);
+void metrics_count_bytes_in(NDNNode *node, Neighbor *face, size_t len);
+
+// Ponto de recolha (chamadas pelo loop principal)
+int metrics_fill_read_fds(NDNNode *node, fd_set *read_fds, int max_fd);
+void metrics_handle_readable(NDNNode *node, fd_set *read_fds);
+
+size_t render_metrics(NDNNode *node, char *buffer, size_t size);
+void show_metrics(NDNNode *node);
+void show_latency(NDNNode *node); // Percentis dos histogramas de latência
+
+#endif // METRICS_H
@@ -1,8 +1,12 @@
 #include "ndn_node.h"
-#include "ui_handler.h"
 #include "registration_protocol.h"
 #include "topology_protocol.h"
 #include "ndn_protocol.h"
+#include "forwarding_strategy.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,267 +15,380 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <time.h>
 
-static NDNNode current_node;
+long long ndn_now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
 
-NDNNode *get_current_ndn_node()
+long long ndn_now_ms()
 {
-    return &current_node;
+    return ndn_now_us() / 1000;
 }
 
-void ndn_node_init(const char *ip, int tcp_port, const char *reg_ip, int reg_udp_port)
+// Instante (ms) do próximo temporizador de qualquer módulo, ou -1 se não houver nenhum
+static long long next_timer_deadline_ms(NDNNode *node)
 {
-    strncpy(current_node.ip, ip, sizeof(current_node.ip) - 1);
-    current_node.ip[sizeof(current_node.ip) - 1] = '\0';
-    current_node.tcp_port = tcp_port;
-    strncpy(current_node.reg_ip, reg_ip, sizeof(current_node.reg_ip) - 1);
-    current_node.reg_ip[sizeof(current_node.reg_ip) - 1] = '\0';
-    current_node.reg_udp_port = reg_udp_port;
-    current_node.current_net_id = -1; // Inicializa sem rede
+    long long deadline = retrieve_next_deadline_ms(node);
+    long long candidates[] = {join_next_deadline_ms(node), connect_next_deadline_ms(node), heartbeat_next_deadline_ms(node),
+                              shortcut_next_deadline_ms(node), lease_next_deadline_ms(node),
+                              reg_request_next_deadline_ms(node), reg_tcp_query_next_deadline_ms(node)};
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++)
+    {
+        if (candidates[i] != -1 && (deadline == -1 || candidates[i] < deadline))
+        {
+            deadline = candidates[i];
+        }
+    }
+    return deadline;
+}
+
+// Executa os temporizadores que já expiraram
+static void run_expired_timers(NDNNode *node)
+{
+    check_retrieve_timeouts(node);
+    check_join_timeouts(node);
+    check_connect_timeouts(node);
+    check_heartbeats(node);
+    check_shortcuts(node);
+    check_lease_refresh(node);
+    check_reg_retransmissions(node);
+    check_reg_tcp_query_timeouts(node);
+}
+
+void ndn_node_init_state(NDNNode *node, const char *ip, int tcp_port)
+{
+    strncpy(node->ip, ip, sizeof(node->ip) - 1);
+    node->ip[sizeof(node->ip) - 1] = '\0';
+    node->tcp_port = tcp_port;
+    node->reg_ip[0] = '\0';
+    node->reg_udp_port = 0;
+    node->current_net_id = -1; // Inicializa sem rede
+
+    // Sem sockets até ndn_node_init (um nó simulado usa apenas o transporte)
+    node->tcp_listen_sd = -1;
+    node->udp_reg_sd = -1;
+    node->transport = NULL;
+    node->on_retrieve_done = NULL;
+    node->retrieve_ctx = NULL;
 
     // Inicializar vizinhos
-    current_node.num_active_neighbors = 0;
+    node->num_active_neighbors = 0;
     for (int i = 0; i < MAX_NEIGHBORS; i++)
     {
-        current_node.neighbors[i].is_valid = 0;
-        current_node.neighbors[i].socket_sd = -1;
-        current_node.neighbors[i].type = NEIGHBOR_TYPE_NONE;
-        current_node.neighbors[i].recv_buffer_pos = 0;
-        memset(current_node.neighbors[i].recv_buffer, 0, sizeof(current_node.neighbors[i].recv_buffer));
+        node->neighbors[i].is_valid = 0;
+        node->neighbors[i].socket_sd = -1;
+        node->neighbors[i].type = NEIGHBOR_TYPE_NONE;
+        node->neighbors[i].recv_buffer_pos = 0;
+        memset(node->neighbors[i].recv_buffer, 0, sizeof(node->neighbors[i].recv_buffer));
     }
 
-    current_node.is_leaving = 0;                       // Inicializa como não estando a sair
-    current_node.internal_neighbors_to_disconnect = 0; // Nenhum para desconectar inicialmente
+    // Um nó isolado é a raiz da sua própria árvore
+    node->depth = 0;
+    strcpy(node->depth_ext_ip, node->ip);
+    node->depth_ext_port = node->tcp_port;
+    node->reported_degree = -1;
+    node->reported_depth = -1;
+    node->lease_ttl_s = 0;
+    node->lease_refresh_ms = -1;
+    node->member_cache_net = -1;
+    node->member_cache_seq = 0;
+    node->member_cache_complete = 0;
+    node->num_cached_members = 0;
+
+    for (int i = 0; i < MAX_REG_REQUESTS; i++)
+    {
+        node->reg_requests[i].in_use = 0;
+    }
+    node->reg_next_tag = 0;
+    for (int i = 0; i < MAX_REG_TCP_QUERIES; i++)
+    {
+        node->reg_tcp_queries[i].in_use = 0;
+    }
+    for (int i = 0; i < NODESLIST_CACHE_SIZE; i++)
+    {
+        node->nodes_cache[i].net_id = -1;
+    }
+
+    node->members_query_net = -1;
+    node->members_received = 0;
+
+    for (int i = 0; i < MAX_PENDING_CONNECTS; i++)
+    {
+        node->pending_connects[i].is_valid = 0;
+    }
+    node->repair_in_progress = 0;
+    node->repair_confirm_sd = -1;
+    node->repair_confirm_deadline_ms = -1;
+
+    node->shortcut_target = 0;
+    node->shortcut_next_ms = 0;
+
+    node->heartbeat_interval_ms = HEARTBEAT_DEFAULT_INTERVAL_MS;
+    node->heartbeat_next_ms = 0;
+
+    node->is_leaving = 0;                       // Inicializa como não estando a sair
+    node->internal_neighbors_to_disconnect = 0; // Nenhum para desconectar inicialmente
 
     // Inicializar estruturas NDN
-    init_local_objects(&current_node);     // Chamar a função de inicialização
-    init_cache(&current_node);             // Chamar a função de inicialização
-    init_pending_interests(&current_node); // Chamar a função de inicialização
+    init_local_objects(node);     // Chamar a função de inicialização
+    init_cache(node);             // Chamar a função de inicialização
+    init_pending_interests(node); // Chamar a função de inicialização
+    init_retrieves(node);
+    init_forwarding_strategies(node);
+    init_join(node);
     // num_local_objects, num_cached_objects, num_pending_interests são inicializados dentro das respectivas init_* funções
 
+    init_metrics(node);
+    init_trace(node);
+    init_capture(node);
+}
+
+int ndn_node_init(NDNNode *node, const char *ip, int tcp_port, const char *reg_ip, int reg_udp_port)
+{
+    ndn_node_init_state(node, ip, tcp_port);
+    strncpy(node->reg_ip, reg_ip, sizeof(node->reg_ip) - 1);
+    node->reg_ip[sizeof(node->reg_ip) - 1] = '\0';
+    node->reg_udp_port = reg_udp_port;
+
     // 1. Inicializar Socket TCP de Escuta (Servidor TCP)
-    current_node.tcp_listen_sd = socket(AF_INET, SOCK_STREAM, 0);
-    if (current_node.tcp_listen_sd == -1)
+    node->tcp_listen_sd = socket(AF_INET, SOCK_STREAM, 0);
+    if (node->tcp_listen_sd == -1)
     {
         perror("Erro ao criar socket TCP de escuta");
-        exit(EXIT_FAILURE);
+        return -1;
     }
     printf("Socket TCP de escuta criado.\n");
 
     struct sockaddr_in server_addr;
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(current_node.tcp_port);
+    server_addr.sin_port = htons(node->tcp_port);
     server_addr.sin_addr.s_addr = htonl(INADDR_ANY); // Escutar em todas as interfaces
 
     int optval = 1;
-    if (setsockopt(current_node.tcp_listen_sd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) == -1)
+    if (setsockopt(node->tcp_listen_sd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) == -1)
     {
         perror("Erro em setsockopt SO_REUSEADDR para TCP");
-        close(current_node.tcp_listen_sd);
-        exit(EXIT_FAILURE);
+        close(node->tcp_listen_sd);
+        node->tcp_listen_sd = -1;
+        return -1;
     }
 
-    if (bind(current_node.tcp_listen_sd, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1)
+    if (bind(node->tcp_listen_sd, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1)
     {
         perror("Erro ao fazer bind do socket TCP");
-        close(current_node.tcp_listen_sd);
-        exit(EXIT_FAILURE);
+        close(node->tcp_listen_sd);
+        node->tcp_listen_sd = -1;
+        return -1;
     }
-    printf("Bind do socket TCP efetuado na porta %d.\n", current_node.tcp_port);
+    printf("Bind do socket TCP efetuado na porta %d.\n", node->tcp_port);
 
-    if (listen(current_node.tcp_listen_sd, 5) == -1)
+    if (listen(node->tcp_listen_sd, 5) == -1)
     {
         perror("Erro ao iniciar listen no socket TCP");
-        close(current_node.tcp_listen_sd);
-        exit(EXIT_FAILURE);
+        close(node->tcp_listen_sd);
+        node->tcp_listen_sd = -1;
+        return -1;
     }
     printf("Socket TCP a escutar por conexões.\n");
 
     // 2. Inicializar Socket UDP (Cliente UDP para o servidor de registo)
-    current_node.udp_reg_sd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (current_node.udp_reg_sd == -1)
+    node->udp_reg_sd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (node->udp_reg_sd == -1)
     {
         perror("Erro ao criar socket UDP");
-        close(current_node.tcp_listen_sd);
-        exit(EXIT_FAILURE);
+        close(node->tcp_listen_sd);
+        node->tcp_listen_sd = -1;
+        return -1;
     }
     printf("Socket UDP criado.\n");
 
     // Configurar o endereço do servidor de registo
-    memset(&current_node.reg_server_addr, 0, sizeof(current_node.reg_server_addr));
-    current_node.reg_server_addr.sin_family = AF_INET;
-    current_node.reg_server_addr.sin_port = htons(current_node.reg_udp_port);
-    if (inet_pton(AF_INET, current_node.reg_ip, &current_node.reg_server_addr.sin_addr) <= 0)
+    memset(&node->reg_server_addr, 0, sizeof(node->reg_server_addr));
+    node->reg_server_addr.sin_family = AF_INET;
+    node->reg_server_addr.sin_port = htons(node->reg_udp_port);
+    if (inet_pton(AF_INET, node->reg_ip, &node->reg_server_addr.sin_addr) <= 0)
     {
         perror("Erro em inet_pton para o IP do servidor de registo");
-        close(current_node.tcp_listen_sd);
-        close(current_node.udp_reg_sd);
-        exit(EXIT_FAILURE);
+        close(node->tcp_listen_sd);
+        close(node->udp_reg_sd);
+        node->tcp_listen_sd = -1;
+        node->udp_reg_sd = -1;
+        return -1;
     }
     printf("Endereço do servidor de registo configurado.\n");
 
+    open_metrics_socket(node);
+
     printf("Nó NDN inicializado.\n");
+    return 0;
 }
 
-void start_ndn_node_loop()
+// Junta os sockets do nó aos conjuntos do select; devolve o novo descritor máximo
+int ndn_node_fill_fds(NDNNode *node, fd_set *read_fds, fd_set *write_fds, int max_fd)
 {
-    fd_set read_fds;
-    int max_fd;
-    NDNNode *node = get_current_ndn_node();
-    char temp_read_buffer[MAX_TCP_MSG_LEN]; // Buffer temporário para ler do socket
-
-
-    while (1)
+    if (node->tcp_listen_sd != -1)
     {
-        FD_ZERO(&read_fds);
-        FD_SET(STDIN_FILENO, &read_fds);
-        FD_SET(node->tcp_listen_sd, &read_fds);
-        FD_SET(node->udp_reg_sd, &read_fds);
-
-        max_fd = STDIN_FILENO;
+        FD_SET(node->tcp_listen_sd, read_fds);
         if (node->tcp_listen_sd > max_fd)
         {
             max_fd = node->tcp_listen_sd;
         }
+    }
+    if (node->udp_reg_sd != -1)
+    {
+        FD_SET(node->udp_reg_sd, read_fds);
         if (node->udp_reg_sd > max_fd)
         {
             max_fd = node->udp_reg_sd;
         }
+    }
 
-        // Adicionar sockets de vizinhos ativos ao conjunto de monitoramento
-        for (int i = 0; i < MAX_NEIGHBORS; i++)
+    // Adicionar sockets de vizinhos ativos ao conjunto de monitoramento
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd != -1)
         {
-            if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd != -1)
+            FD_SET(node->neighbors[i].socket_sd, read_fds);
+            if (node->neighbors[i].socket_sd > max_fd)
             {
-                FD_SET(node->neighbors[i].socket_sd, &read_fds);
-                if (node->neighbors[i].socket_sd > max_fd)
-                {
-                    max_fd = node->neighbors[i].socket_sd;
-                }
+                max_fd = node->neighbors[i].socket_sd;
             }
         }
+    }
 
-        int activity = select(max_fd + 1, &read_fds, NULL, NULL, NULL);
+    // Conexões de entrada na rede e restantes conexões de saída em curso (connect() não bloqueante)
+    max_fd = join_fill_write_fds(node, write_fds, max_fd);
+    max_fd = connect_fill_write_fds(node, write_fds, max_fd);
+    max_fd = reg_tcp_query_fill_fds(node, read_fds, write_fds, max_fd); // Consultas TCP ao servidor de registo
+    return metrics_fill_read_fds(node, read_fds, max_fd);
+}
 
-        if (activity < 0)
+long long ndn_node_next_deadline_ms(NDNNode *node)
+{
+    return next_timer_deadline_ms(node);
+}
+
+int ndn_node_finished(NDNNode *node)
+{
+    // O nó saiu com 'leave' e todos os vizinhos internos já desconectaram
+    return node->is_leaving && node->internal_neighbors_to_disconnect <= 0;
+}
+
+void ndn_node_handle_events(NDNNode *node, fd_set *read_fds, fd_set *write_fds)
+{
+    char temp_read_buffer[MAX_TCP_MSG_LEN]; // Buffer temporário para ler do socket
+
+    // 1. Lidar com novas conexões TCP
+    if (node->tcp_listen_sd != -1 && FD_ISSET(node->tcp_listen_sd, read_fds))
+    {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int new_socket_sd = accept(node->tcp_listen_sd, (struct sockaddr *)&client_addr, &client_len);
+        if (new_socket_sd == -1)
         {
-            if (errno == EINTR)
-                continue;
-            perror("select error");
-            break;
+            perror("Erro ao aceitar conexão TCP");
         }
-
-        // 1. Lidar com comandos do utilizador (STDIN)
-        if (FD_ISSET(STDIN_FILENO, &read_fds))
+        else
         {
-            char command_line[256];
-            if (fgets(command_line, sizeof(command_line), stdin) != NULL)
-            {
-                command_line[strcspn(command_line, "\n")] = 0;
-                handle_user_command(command_line); // Chamará 'leave' ou 'exit'
-                // Se 'exit' for digitado, o loop principal é quebrado aqui.
-                if (strcmp(command_line, "exit") == 0 || strcmp(command_line, "x") == 0)
-                {
-                    printf("Encerrando a aplicação (comando 'exit').\n");
-                    break;
-                }
-            }
+            char client_ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &(client_addr.sin_addr), client_ip, INET_ADDRSTRLEN);
+            process_incoming_connection(node, new_socket_sd, client_ip, ntohs(client_addr.sin_port));
         }
+    }
 
-        // 2. Lidar com novas conexões TCP
-        if (FD_ISSET(node->tcp_listen_sd, &read_fds))
+    // 2. Lidar com dados UDP do servidor de registo
+    if (node->udp_reg_sd != -1 && FD_ISSET(node->udp_reg_sd, read_fds))
+    {
+        char buffer[MAX_UDP_MSG_LEN];
+        struct sockaddr_in sender_addr;
+        socklen_t sender_len = sizeof(sender_addr);
+        ssize_t bytes_received = recvfrom(node->udp_reg_sd, buffer, sizeof(buffer) - 1, 0,
+                                          (struct sockaddr *)&sender_addr, &sender_len);
+        if (bytes_received == -1)
         {
-            struct sockaddr_in client_addr;
-            socklen_t client_len = sizeof(client_addr);
-            int new_socket_sd = accept(node->tcp_listen_sd, (struct sockaddr *)&client_addr, &client_len);
-            if (new_socket_sd == -1)
-            {
-                perror("Erro ao aceitar conexão TCP");
-            }
-            else
-            {
-                char client_ip[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, &(client_addr.sin_addr), client_ip, INET_ADDRSTRLEN);
-                process_incoming_connection(node, new_socket_sd, client_ip, ntohs(client_addr.sin_port));
-            }
+            perror("Erro ao receber dados UDP");
         }
-
-        // 3. Lidar com dados UDP do servidor de registo
-        if (FD_ISSET(node->udp_reg_sd, &read_fds))
+        else
         {
-            char buffer[MAX_UDP_MSG_LEN];
-            struct sockaddr_in sender_addr;
-            socklen_t sender_len = sizeof(sender_addr);
-            ssize_t bytes_received = recvfrom(node->udp_reg_sd, buffer, sizeof(buffer) - 1, 0,
-                                              (struct sockaddr *)&sender_addr, &sender_len);
-            if (bytes_received == -1)
-            {
-                perror("Erro ao receber dados UDP");
-            }
-            else
-            {
-                buffer[bytes_received] = '\0';
-                process_udp_registration_message(node, buffer);
-            }
+            buffer[bytes_received] = '\0';
+            process_udp_registration_message(node, buffer);
         }
+    }
+
+    // 3. Lidar com conexões de saída que terminaram e com pedidos de métricas
+    join_handle_writable(node, write_fds);
+    connect_handle_writable(node, write_fds);
+    reg_tcp_query_handle_events(node, read_fds, write_fds);
+    metrics_handle_readable(node, read_fds);
 
-        // 4. Lidar com dados recebidos de vizinhos TCP existentes (e fechos de conexão)
-        for (int i = 0; i < MAX_NEIGHBORS; i++)
+    // 4. Lidar com dados recebidos de vizinhos TCP existentes (e fechos de conexão)
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd != -1 &&
+            FD_ISSET(node->neighbors[i].socket_sd, read_fds))
         {
-            if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd != -1 &&
-                FD_ISSET(node->neighbors[i].socket_sd, &read_fds))
+
+            ssize_t bytes_received = read(node->neighbors[i].socket_sd, temp_read_buffer, sizeof(temp_read_buffer));
+            if (bytes_received <= 0)
             {
+                // Conexão fechada ou erro
+                if (bytes_received == 0)
+                {
+                    
+                }
+                else
+                {
+                    perror("Erro ao ler de vizinho TCP");
+                }
 
-                ssize_t bytes_received = read(node->neighbors[i].socket_sd, temp_read_buffer, sizeof(temp_read_buffer));
-                if (bytes_received <= 0)
+                // Se o nó está a sair e este vizinho é interno, decrementa o contador
+                if (node->is_leaving && (node->neighbors[i].type == NEIGHBOR_TYPE_INTERNAL || node->neighbors[i].type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL))
                 {
-                    // Conexão fechada ou erro
-                    if (bytes_received == 0)
-                    {
-                        
-                    }
-                    else
-                    {
-                        perror("Erro ao ler de vizinho TCP");
-                    }
-
-                    // Se o nó está a sair e este vizinho é interno, decrementa o contador
-                    if (node->is_leaving && (node->neighbors[i].type == NEIGHBOR_TYPE_INTERNAL || node->neighbors[i].type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL))
-                    {
-                        node->internal_neighbors_to_disconnect--;
-                    }
+                    node->internal_neighbors_to_disconnect--;
+                }
 
+                if (node->is_leaving)
+                {
                     remove_neighbor(node, node->neighbors[i].socket_sd); // Remover o vizinho
                 }
                 else
                 {
-                    handle_tcp_data_received(node, node->neighbors[i].socket_sd, temp_read_buffer, bytes_received);
+                    handle_neighbor_failure(node, node->neighbors[i].socket_sd); // Fechada sem LEAVE
                 }
             }
-        }
-
-        // Se o nó está a sair e todos os vizinhos internos desconectaram, sair do loop
-        if (node->is_leaving && node->internal_neighbors_to_disconnect <= 0)
-        {
-            break;
+            else
+            {
+                handle_tcp_data_received(node, node->neighbors[i].socket_sd, temp_read_buffer, bytes_received);
+            }
         }
     }
 
-    ndn_node_cleanup();
+    run_expired_timers(node);
+
+    // Propagar alterações de topologia: profundidade aos vizinhos, grau e profundidade ao servidor
+    update_node_depth(node);
+    report_node_state(node);
 }
 
-void ndn_node_cleanup()
+void ndn_node_cleanup(NDNNode *node)
 {
-    NDNNode *node = get_current_ndn_node();
-    // A lógica de UNREG ao sair está no ui_handler para 'leave' e 'exit'
+    // A lógica de UNREG ao sair com 'leave' está em ndn_leave (libndn.c)
     // Se o nó estava a sair por 'leave', já enviou UNREG.
     // Se o nó saiu por 'exit' e ainda está numa rede, deve desregistar.
     if (!node->is_leaving && node->current_net_id != -1)
     { // Só se desregista se não estiver já em processo de saída por 'leave'
         send_unreg_message(node, node->current_net_id);
-        usleep(100000); // 100 ms
+        unsubscribe_members(node);
     }
+    wait_for_unreg_confirmation(node, UNREG_WAIT_MS); // Também o UNREG de um 'leave' ainda sem resposta
+
+    cancel_pending_connects(node);
+    cancel_reg_tcp_queries(node);
 
     // Fechar todos os sockets de vizinhos TCP ativos (sem enviar LEAVE, já foi feito ou não é necessário)
     for (int i = 0; i < MAX_NEIGHBORS; i++)
@@ -292,5 +409,8 @@ void ndn_node_cleanup()
         close(node->udp_reg_sd);
         printf("Socket UDP de registo fechado.\n");
     }
+    close_metrics(node);
+    close_trace(node);
+    stop_capture(node);
     printf("Recursos do nó NDN limpos.\n");
 }
\ No newline at end of file
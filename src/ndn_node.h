@@ -1,11 +1,14 @@
 #ifndef NDN_NODE_H
 #define NDN_NODE_H
 
+#include <stdio.h>
 #include <sys/select.h>
 #include <netinet/in.h>
+#include "histogram.h"
+#include "libndn.h" // NDNNode, RetrieveResult, RetrieveCallback e a interface pública
 
 // Constantes para mensagens UDP e TCP
-#define MAX_UDP_MSG_LEN 512
+#define MAX_UDP_MSG_LEN 1500 // Cabe uma página de NODESLIST (1400 bytes)
 #define MAX_TCP_MSG_LEN 512 // Tamanho máximo de uma mensagem TCP completa
 #define MAX_IP_LEN 16
 #define MAX_PORT_LEN 6 // Ex: "65535\0"
@@ -17,11 +20,53 @@ typedef enum
     NEIGHBOR_TYPE_INTERNAL,
     NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL, // NOVO TIPO: Para o caso de dois nós
     NEIGHBOR_TYPE_PENDING_INCOMING,      // Para conexões aceitas, mas IP/Porta real ainda não conhecido
+    NEIGHBOR_TYPE_SHORTCUT,              // Ligação de longo alcance fora da árvore (usada só no encaminhamento)
     NEIGHBOR_TYPE_NONE                   // Para vizinhos não classificados ou slots vazios
 } NeighborType;
 
 #define MAX_TCP_RECV_BUFFER_SIZE (MAX_TCP_MSG_LEN * 2) // Buffer para receber mensagens fragmentadas
 
+// Contadores do nó (comando "show stats" e ponto de recolha das métricas). Os contadores até
+// METRIC_CONTROL_OUT existem também por interface (vizinho); os pares _IN/_OUT são consecutivos.
+typedef enum
+{
+    METRIC_MESSAGES_IN,
+    METRIC_MESSAGES_OUT,
+    METRIC_BYTES_IN,
+    METRIC_BYTES_OUT,
+    METRIC_INTERESTS_IN,
+    METRIC_INTERESTS_OUT,
+    METRIC_OBJECTS_IN,
+    METRIC_OBJECTS_OUT,
+    METRIC_NOOBJECTS_IN,
+    METRIC_NOOBJECTS_OUT,
+    METRIC_CANCELS_IN,
+    METRIC_CANCELS_OUT,
+    METRIC_CONTROL_IN,  // Mensagens de topologia (ENTRY, LEAVE, PING, ...)
+    METRIC_CONTROL_OUT,
+    METRIC_SEND_ERRORS,
+    METRIC_LOCAL_HITS,      // Interesses respondidos com um objeto local
+    METRIC_CACHE_HITS,      // ... com um objeto da cache
+    METRIC_CACHE_MISSES,    // ... que o nó não tinha
+    METRIC_CACHE_INSERTS,
+    METRIC_CACHE_EVICTIONS,
+    METRIC_PIT_INSERTS,
+    METRIC_PIT_AGGREGATED,  // Interesse repetido pela interface de resposta
+    METRIC_PIT_LOOPS,       // Cópia do interesse chegada por outra interface (ciclo)
+    METRIC_PIT_FULL,
+    METRIC_PIT_SATISFIED,
+    METRIC_PIT_UNSATISFIED,
+    METRIC_PIT_CANCELLED,
+    METRIC_SCOPE_EXHAUSTED,
+    METRIC_UNSOLICITED,     // OBJECT/NOOBJECT sem entrada na PIT
+    METRIC_RETRIEVES_FOUND, // Pesquisas do utilizador local terminadas, por RetrieveResult (pela mesma ordem)
+    METRIC_RETRIEVES_NOT_FOUND,
+    METRIC_RETRIEVES_TIMEOUT,
+    METRIC_COUNT
+} MetricId;
+
+#define FACE_METRIC_COUNT (METRIC_CONTROL_OUT + 1)
+
 // Estrutura para representar um vizinho
 typedef struct
 {
@@ -34,15 +79,47 @@ typedef struct
     // Buffer de receção para este socket específico
     char recv_buffer[MAX_TCP_RECV_BUFFER_SIZE];
     int recv_buffer_pos; // Posição atual de escrita no buffer
+
+    // Resultados dos interesses encaminhados por este vizinho (usados pelas estratégias)
+    long fwd_interests;       // Interesses enviados
+    long fwd_satisfied;       // OBJECTs recebidos em resposta
+    long fwd_nacked;          // NOOBJECTs recebidos em resposta
+    long long fwd_latency_us; // Latência suavizada interesse -> objeto (0 se sem amostras)
+
+    // Heartbeats
+    long long last_heard_ms;       // Última vez que se recebeu algo deste vizinho
+    int heartbeat_capable;         // 1 depois de receber um PING/PONG (só então é vigiado)
+    long long srtt_us;             // RTT suavizado medido por PING/PONG (0 se sem amostras)
+    char recovery_ip[MAX_IP_LEN];  // Vizinho externo anunciado pelo vizinho (usado se ele falhar)
+    int recovery_tcp_port;
+
+    // Profundidade anunciada pelo vizinho (mensagem DEPTH)
+    int depth;          // -1 se desconhecida
+    int external_is_me; // 1 se o vizinho externo do vizinho é este nó (par âncora)
+
+    unsigned long long face_metrics[FACE_METRIC_COUNT]; // Contadores desta interface (MetricId)
+    LatencyHistogram face_latency;                      // INTEREST enviado por esta interface até ao OBJECT
 } Neighbor;
 
+#define HEARTBEAT_DEFAULT_INTERVAL_MS 1000
+#define HEARTBEAT_MISS_LIMIT 3 // Intervalos sem notícias até o vizinho ser dado como falhado
+#define MAX_OVERLAY_DEPTH 255 // Acima disto a profundidade é dada como desconhecida (evita contagens até ao infinito)
+
+// Atalhos: ligações extra a nós escolhidos por passeios aleatórios pela árvore
+#define SHORTCUT_MAX_LINKS NDN_MAX_SHORTCUTS // Máximo de atalhos por nó (pedidos ou aceites)
+#define SHORTCUT_WALK_TTL 8           // Comprimento de cada passeio aleatório
+#define SHORTCUT_WALK_INTERVAL_MS 2000 // Intervalo entre passeios enquanto faltam atalhos
+
 #define MAX_NEIGHBORS 10        // Número máximo de vizinhos que um nó pode ter
 #define MAX_OBJECT_NAME_LEN 100 // Máximo de 100 caracteres para o nome do objeto
 
 // --- Novas estruturas para a NDN ---
+// Os tamanhos das tabelas podem ser escolhidos na compilação (p. ex. -DMAX_PENDING_INTERESTS=500, make bench)
 
 // Para objetos criados localmente pelo utilizador
+#ifndef MAX_LOCAL_OBJECTS
 #define MAX_LOCAL_OBJECTS 20 // Exemplo: um limite para objetos que o nó possui
+#endif
 typedef struct
 {
     char name[MAX_OBJECT_NAME_LEN + 1]; // Nome do objeto, +1 para '\0'
@@ -50,7 +127,9 @@ typedef struct
 } LocalObject;
 
 // Para a cache de objetos
+#ifndef MAX_CACHE_OBJECTS
 #define MAX_CACHE_OBJECTS 5 // A cache terá um tamanho máximo de 5 objetos
+#endif
 typedef struct
 {
     char name[MAX_OBJECT_NAME_LEN + 1]; // Nome do objeto
@@ -59,7 +138,9 @@ typedef struct
 } CachedObject;
 
 // Para a Tabela de Interesses Pendentes (PIT - Pending Interest Table)
+#ifndef MAX_PENDING_INTERESTS
 #define MAX_PENDING_INTERESTS 50   // Limite para interesses pendentes
+#endif
 #define MAX_INTEREST_INTERFACES 10 // Limite de interfaces por interesse (pode ser MAX_NEIGHBORS + 1 (stdin))
 
 // Estados de uma interface para um interesse
@@ -78,17 +159,213 @@ typedef struct
     int is_valid; // 1 se este slot está em uso
 } InterestInterface;
 
+#define HOP_LIMIT_NONE -1 // Interesse sem limite de saltos (inunda toda a árvore)
+
 typedef struct
 {
     unsigned char interest_id;                 // Identificador de procura (0-255)
     char object_name[MAX_OBJECT_NAME_LEN + 1]; // Nome do objeto procurado
     InterestInterface interfaces[MAX_INTEREST_INTERFACES];
     int num_active_interfaces; // Contagem de interfaces para este interesse
+    int hop_limit;             // Limite de saltos com que o interesse é reencaminhado (HOP_LIMIT_NONE se ilimitado)
+    int scope_exhausted;       // 1 se algum ramo respondeu NOOBJECT por ter esgotado o alcance
+    int strategy_choice;       // Índice em strategy_choices da estratégia usada
+    long long created_us;      // Instante de criação da entrada (para a latência)
+    unsigned long long trace_id; // Identificador de rastreio (0 se o interesse não é rastreado)
     int is_valid;              // 1 se esta entrada está em uso
 } PendingInterestEntry;
 
-// Estrutura principal do nó
+// Estratégias de encaminhamento de interesses, escolhidas por prefixo do nome
+typedef enum
+{
+    STRATEGY_FLOOD,         // Todas as outras interfaces (comportamento original)
+    STRATEGY_BEST_ROUTE,    // Só a interface de menor custo (latência / taxa de sucesso)
+    STRATEGY_K_RANDOM,      // STRATEGY_RANDOM_FANOUT interfaces ao acaso
+    STRATEGY_PROBE_EXPLOIT, // A última interface que satisfez o prefixo, inundando periodicamente
+    NUM_STRATEGIES
+} StrategyId;
+
+#define MAX_STRATEGY_CHOICES 16
+#define STRATEGY_RANDOM_FANOUT 2
+#define STRATEGY_PROBE_PERIOD 8 // Sonda e explora: 1 em cada 8 interesses é inundado
+#define STRATEGY_UNKNOWN_LATENCY_US 10000 // Latência assumida para interfaces sem objetos recebidos
+
+typedef struct
+{
+    char prefix[MAX_OBJECT_NAME_LEN + 1]; // "" coincide com todos os nomes
+    StrategyId strategy;
+    int best_face_sd;  // Última interface que trouxe um objeto com este prefixo (-1 se nenhuma)
+    int probe_counter; // Interesses encaminhados (para a periodicidade das sondas)
+    int is_valid;
+} StrategyChoice;
+
+typedef struct
+{
+    long interests;   // Entradas da PIT criadas com esta estratégia
+    long satisfied;   // ... satisfeitas por um OBJECT
+    long unsatisfied; // ... terminadas com NOOBJECT
+    long long latency_sum_us;
+} StrategyStats;
+
+// Para as pesquisas iniciadas pelo utilizador local
+#ifndef MAX_RETRIEVES
+#define MAX_RETRIEVES 20
+#endif
+#define RING_MAX_SCOPE 64     // Maior alcance finito da pesquisa em anel; a seguir a pesquisa é ilimitada
+#define RING_STATS_BUCKETS 8  // Alcances 1, 2, 4, ..., 64 e ilimitado
+
+// Retransmissão das pesquisas (estimador SRTT/RTTVAR ao estilo do TCP)
+#define RETRIEVE_MAX_ATTEMPTS 4 // Tentativas por alcance antes de desistir
+#define RTO_INITIAL_MS 1000     // RTO antes da primeira amostra de RTT
+#define RTO_MIN_MS 200
+#define RTO_MAX_MS 10000
+
 typedef struct
+{
+    char object_name[MAX_OBJECT_NAME_LEN + 1];
+    unsigned char interest_id; // Identificador da tentativa em curso (novo em cada retransmissão)
+    int ring;                  // 1 se o alcance cresce em anel (1, 2, 4, ...)
+    int scope;                 // Limite de saltos da tentativa em curso (HOP_LIMIT_NONE se ilimitado)
+    int attempts;              // Tentativas enviadas com o alcance atual
+    long long rto_ms;          // Tempo de espera da tentativa em curso (duplica a cada retransmissão)
+    long long start_us;        // Instante do pedido do utilizador
+    long long attempt_sent_us; // Instante de envio da tentativa em curso
+    long long deadline_ms;     // Instante em que a tentativa em curso expira
+    unsigned long long trace_id; // Identificador de rastreio de todas as tentativas (0 se não rastreada)
+    RetrieveCallback callback; // Conclusão pedida em ndn_retrieve (NULL: a do nó, on_retrieve_done)
+    void *callback_ctx;
+    int is_valid;              // 1 se esta pesquisa está em curso
+} RetrieveRequest;
+
+// Para a entrada na rede: candidatos devolvidos pelo servidor (NODESLIST), ligados em paralelo
+#define MAX_NODES_PER_NET 100
+#define JOIN_PARALLEL_CANDIDATES 3 // Conexões abertas em simultâneo por lote
+#define JOIN_CONNECT_TIMEOUT_MS 2000
+#define LEASE_REFRESHES_PER_TTL 3 // Renovações do registo por período de validade (tolera perdas de UDP)
+#define MEMBER_REPAIR_ATTEMPTS 3  // Membros da cache tentados quando a reparação da topologia falha
+
+typedef enum
+{
+    JOIN_CANDIDATE_UNTRIED,    // Ainda não tentado (ou tentado, mas fechado por outro ter respondido antes)
+    JOIN_CANDIDATE_CONNECTING, // connect() não bloqueante em curso
+    JOIN_CANDIDATE_REACHABLE,  // Respondeu; rtt_us é o tempo de estabelecimento da conexão
+    JOIN_CANDIDATE_FAILED      // Recusou, expirou ou deu erro
+} JoinCandidateState;
+
+typedef struct
+{
+    char ip[MAX_IP_LEN];
+    int tcp_port;
+    int sd; // Socket da conexão em curso (-1 se nenhuma)
+    JoinCandidateState state;
+    long long started_us; // Instante do connect()
+    long long rtt_us;     // Tempo até a conexão ficar estabelecida
+} JoinCandidate;
+
+// Conexões de saída não bloqueantes fora da entrada na rede, concluídas pelo loop de eventos
+#define MAX_PENDING_CONNECTS 4
+
+typedef enum
+{
+    PENDING_CONNECT_SHORTCUT,      // Atalho até à origem de um passeio aleatório
+    PENDING_CONNECT_DIRECT,        // Entrada direta pedida pelo utilizador (direct join)
+    PENDING_CONNECT_REPAIR,        // Novo externo indicado pelo vizinho que saiu (LEAVE ou PING)
+    PENDING_CONNECT_REPAIR_MEMBER  // Novo externo da cache de membros (confirmado pelo seu DEPTH)
+} PendingConnectPurpose;
+
+typedef struct
+{
+    char ip[MAX_IP_LEN];
+    int tcp_port;
+    int sd; // Socket com connect() em curso
+    PendingConnectPurpose purpose;
+    long long deadline_ms; // Expiração do connect()
+    int is_valid;
+} PendingConnect;
+
+// Membro da rede na cache mantida pela subscrição ao servidor de registo
+typedef struct
+{
+    char ip[MAX_IP_LEN];
+    int tcp_port;
+} MemberEntry;
+
+// Pedidos ao servidor de registo à espera de resposta (retransmitidos com recuo exponencial)
+#define MAX_REG_REQUESTS 8
+#define REG_RTO_INITIAL_MS 500
+#define REG_RTO_MAX_MS 4000
+#define REG_MAX_ATTEMPTS 5
+#define NODESLIST_CACHE_SIZE 4            // Redes com a última NODESLIST guardada
+#define NODESLIST_CACHE_MAX_AGE_MS 60000  // Idade máxima de uma lista usada para voltar a entrar
+#define UNREG_WAIT_MS 2000                // Espera máxima pelo OKUNREG ao terminar
+
+typedef enum
+{
+    REG_REQUEST_REG,
+    REG_REQUEST_UNREG,
+    REG_REQUEST_UPDATE,
+    REG_REQUEST_NODES,      // Lista de entrada na rede
+    REG_REQUEST_NODES_PAGE, // Página da listagem completa
+    REG_REQUEST_SUBSCRIBE
+} RegRequestType;
+
+typedef struct
+{
+    int in_use;
+    RegRequestType type;
+    int net_id;
+    unsigned int tag;         // Número de sequência local do pedido (ecoado pelo servidor na resposta)
+    char message[64];         // Mensagem enviada (reenviada tal como está)
+    int attempts;
+    int rto_ms;               // Espera atual pela resposta (duplica a cada retransmissão)
+    long long next_retry_ms;
+} RegRequest;
+
+// Consultas pelo canal TCP do servidor de registo (listas que não cabem num datagrama), conduzidas
+// pelo loop de eventos: connect() e leitura não bloqueantes, com prazo para a consulta inteira
+#define MAX_REG_TCP_QUERIES 2
+#define REG_TCP_QUERY_TIMEOUT_MS 3000
+
+typedef enum
+{
+    REG_TCP_QUERY_MEMBER_CACHE, // Sincronização da cache de membros
+    REG_TCP_QUERY_PRINT         // Listagem pedida pelo utilizador (comando nodes <net> tcp)
+} RegTcpQueryPurpose;
+
+typedef struct
+{
+    int in_use;
+    RegTcpQueryPurpose purpose;
+    int net_id;
+    int sd;
+    int connected;   // 0 enquanto o connect() está em curso
+    char *response;  // Resposta recebida até agora (termina com o fecho da conexão)
+    size_t len;
+    size_t capacity;
+    long long deadline_ms;
+} RegTcpQuery;
+
+// Última NODESLIST recebida de uma rede
+typedef struct
+{
+    int net_id; // -1 se a posição está livre
+    long long received_ms;
+    char message[MAX_UDP_MSG_LEN];
+} CachedNodesList;
+
+// Ligações de um nó sem sockets de rede próprios (vários nós no mesmo processo, tools/ndn_sim).
+// Com um transporte definido, as conexões a outros nós e as mensagens ao servidor de registo passam
+// por estas funções; as respostas do servidor são entregues com process_udp_registration_message.
+typedef struct
+{
+    int (*connect_node)(struct NDNNode *node, const char *ip, int tcp_port, void *ctx); // Socket ligado, ou -1
+    void (*send_to_reg_server)(struct NDNNode *node, const char *message, void *ctx);
+    void *ctx;
+} NodeTransport;
+
+
+// Estrutura principal do nó (opaca para os programas que só usam libndn.h)
+struct NDNNode
 {
     char ip[MAX_IP_LEN]; // Endereço IP próprio do nó
     int tcp_port;        // Porto TCP de escuta próprio do nó
@@ -96,8 +373,12 @@ typedef struct
     int reg_udp_port;
     struct sockaddr_in reg_server_addr; // Endereço do servidor de registo
 
-    int tcp_listen_sd; // Socket descriptor para o TCP de escuta
-    int udp_reg_sd;    // Socket descriptor para o UDP do servidor de registo
+    int tcp_listen_sd; // Socket descriptor para o TCP de escuta (-1 num nó simulado)
+    int udp_reg_sd;    // Socket descriptor para o UDP do servidor de registo (-1 num nó simulado)
+    const NodeTransport *transport; // NULL: sockets TCP/UDP reais
+
+    RetrieveCallback on_retrieve_done; // Chamada no fim de cada pesquisa do utilizador local (pode ser NULL)
+    void *retrieve_ctx;
 
     // Informações de rede
     int current_net_id; // -1 se não estiver em nenhuma rede, ou o ID da rede
@@ -106,6 +387,81 @@ typedef struct
     Neighbor neighbors[MAX_NEIGHBORS];
     int num_active_neighbors; // Quantidade de vizinhos atualmente conectados
 
+    // Entrada na rede em curso (candidatos por ordem de preferência: lista de recurso)
+    JoinCandidate join_candidates[MAX_NODES_PER_NET];
+    int join_num_candidates;
+    int join_net_id;           // Rede a que o nó se está a juntar
+    int join_in_progress;      // 1 enquanto há conexões de entrada por resolver
+    int join_two_node;         // 1 se a rede tinha apenas um nó (vizinho EXTERNAL_AND_INTERNAL)
+    long long join_deadline_ms; // Expiração do lote de conexões em curso
+    int join_from_cache;        // 1 se os candidatos vêm de uma NODESLIST em cache
+    long long join_list_ms;     // Instante de receção da lista em uso
+
+    // Pedidos ao servidor de registo sem resposta e últimas listas de nós recebidas
+    RegRequest reg_requests[MAX_REG_REQUESTS];
+    unsigned int reg_next_tag;
+    CachedNodesList nodes_cache[NODESLIST_CACHE_SIZE];
+
+    RegTcpQuery reg_tcp_queries[MAX_REG_TCP_QUERIES];
+
+    // Listagem paginada dos membros de uma rede (comando nodes)
+    int members_query_net;   // Rede a ser listada (-1 se nenhuma listagem em curso)
+    int members_received;    // Membros já recebidos
+
+    // Profundidade na árvore (saltos até ao par âncora) e último estado anunciado aos vizinhos
+    int depth; // -1 se desconhecida
+    char depth_ext_ip[MAX_IP_LEN];
+    int depth_ext_port;
+
+    // Grau e profundidade comunicados ao servidor de registo (-1 se o nó não está registado)
+    int reported_degree;
+    int reported_depth;
+
+    // Validade do registo anunciada pelo servidor no OKREG (0 = sem validade, nada a renovar)
+    int lease_ttl_s;
+    long long lease_refresh_ms; // Próxima renovação do registo (-1 se nenhuma)
+
+    // Cache de membros da rede (JOINED/LEFT por ordem de seq)
+    int member_cache_net;                // Rede subscrita (-1 se nenhuma)
+    unsigned long long member_cache_seq; // Última alteração aplicada (0 = por sincronizar)
+    int member_cache_complete;           // 0 se a lista não coube na cache
+    MemberEntry member_cache[MAX_NODES_PER_NET];
+    int num_cached_members;
+
+    PendingConnect pending_connects[MAX_PENDING_CONNECTS];
+
+    // Reparação da topologia em curso (procura de um novo vizinho externo)
+    int repair_in_progress;
+    int repair_max_depth;                // Profundidade do nó antes da perda (-1 se desconhecida)
+    char repair_lost_ip[MAX_IP_LEN];     // Vizinho perdido e nó de reparação que falhou:
+    int repair_lost_port;                // excluídos dos membros tentados
+    char repair_failed_ip[MAX_IP_LEN];
+    int repair_failed_port;
+    int repair_member_start;             // Primeiro membro da cache tentado (ao acaso)
+    int repair_member_next;              // Membros da cache já percorridos
+    int repair_attempts;                 // Conexões a membros já abertas
+    int repair_confirm_sd;               // Membro ligado à espera do seu DEPTH (-1 se nenhum)
+    long long repair_confirm_deadline_ms;
+
+    int shortcut_target;         // Atalhos que o nó procura manter (0 = modo desativado)
+    long long shortcut_next_ms;  // Próximo passeio aleatório
+
+    int heartbeat_interval_ms;  // Intervalo entre PINGs (0 = heartbeats desativados)
+    long long heartbeat_next_ms; // Próximo ciclo de heartbeats
+
+    unsigned long long metrics[METRIC_COUNT]; // Contadores do nó (MetricId)
+    int metrics_sd;                           // Socket UNIX de recolha das métricas (-1 se nenhum)
+    char metrics_path[108];
+
+    int trace_fd;      // Ficheiro de rastreio (-1 até ao primeiro evento)
+    int trace_failed;  // 1 se o ficheiro não pôde ser aberto (não se tenta de novo)
+    char trace_path[108];
+
+    FILE *capture_file;         // Captura das mensagens trocadas com os vizinhos (NULL se inativa)
+    long long capture_start_us; // Instante do início da captura (os registos guardam o desvio)
+    unsigned long capture_messages;
+    char capture_path[108];
+
     int is_leaving;                       // Flag: 1 se o nó está em processo de saída
     int internal_neighbors_to_disconnect; // Contador de vizinhos internos para fechar conexões
 
@@ -119,14 +475,32 @@ typedef struct
     PendingInterestEntry pending_interests[MAX_PENDING_INTERESTS];
     int num_pending_interests;
 
-} NDNNode;
+    StrategyChoice strategy_choices[MAX_STRATEGY_CHOICES];
+    StrategyStats strategy_stats[NUM_STRATEGIES];
+
+    // Latência das pesquisas deste nó (retrieve até OBJECT ou NOOBJECT final), no total e por
+    // prefixo (o índice é o da escolha de estratégia que coincide com o nome)
+    LatencyHistogram retrieve_latency;
+    LatencyHistogram prefix_latency[MAX_STRATEGY_CHOICES];
+
+    RetrieveRequest retrieves[MAX_RETRIEVES];
+    int ring_satisfied[RING_STATS_BUCKETS]; // Pesquisas em anel satisfeitas por alcance
+    int ring_failed;                        // Pesquisas em anel sem objeto
+    int ring_expansions;                    // Vezes que uma pesquisa em anel alargou o alcance
+
+    long long srtt_us;   // RTT suavizado das pesquisas (0 se ainda sem amostras)
+    long long rttvar_us; // Variação do RTT
+    long long rto_ms;    // Tempo de retransmissão atual
+
+};
 
-// Obter a instância do nó (para que outras funções possam acessá-la)
-NDNNode *get_current_ndn_node();
+// Relógio monotónico usado pelos temporizadores do nó (ndn_now_ms está em libndn.h)
+long long ndn_now_us();
 
-// Funções de inicialização e gestão do nó
-void ndn_node_init(const char *ip, int tcp_port, const char *reg_ip, int reg_udp_port);
-void start_ndn_node_loop(); // Loop principal de multiplexagem síncrona
-void ndn_node_cleanup();    // Função para fechar sockets e libertar recursos
+// Funções de inicialização e gestão do nó. Cada nó é uma instância independente: um processo pode
+// ter vários, avançando-os com ndn_node_fill_fds, um select comum e ndn_node_handle_events (libndn.h).
+void ndn_node_init_state(NDNNode *node, const char *ip, int tcp_port); // Estado inicial, sem sockets
+int ndn_node_init(NDNNode *node, const char *ip, int tcp_port, const char *reg_ip, int reg_udp_port); // -1 se os sockets falham
+void ndn_node_cleanup(NDNNode *node); // Função para fechar sockets e libertar recursos
 
 #endif // NDN_NODE_H
\ No newline at end of file
@@ -1,10 +1,14 @@
 #include "ndn_protocol.h"
 #include "topology_protocol.h" // Para enviar mensagens a vizinhos
+#include "forwarding_strategy.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>   // Para time() em srand() e last_access_time
-#include <unistd.h> // Para write() em sockets, STDIN_FILENO
+#include <time.h>   // Para time() em last_access_time
+#include <unistd.h> // Para STDIN_FILENO
 
 // Helper function: Inicializa a tabela de interesses pendentes
 void init_pending_interests(NDNNode *node)
@@ -45,19 +49,19 @@ void init_cache(NDNNode *node)
 }
 
 // Funções de gestão de objetos locais
-void create_local_object(NDNNode *node, const char *name)
+int create_local_object(NDNNode *node, const char *name)
 {
     if (strlen(name) > MAX_OBJECT_NAME_LEN)
     {
         printf("Erro: Nome do objeto '%s' excede o tamanho máximo de %d caracteres.\n", name, MAX_OBJECT_NAME_LEN);
-        return;
+        return -1;
     }
     for (int i = 0; i < MAX_LOCAL_OBJECTS; i++)
     {
         if (node->local_objects[i].is_valid && strcmp(node->local_objects[i].name, name) == 0)
         {
             printf("Objeto '%s' já existe localmente.\n", name);
-            return;
+            return -1;
         }
     }
     for (int i = 0; i < MAX_LOCAL_OBJECTS; i++)
@@ -69,13 +73,14 @@ void create_local_object(NDNNode *node, const char *name)
             node->local_objects[i].is_valid = 1;
             node->num_local_objects++;
             printf("Objeto '%s' criado localmente.\n", name);
-            return;
+            return 0;
         }
     }
     printf("Erro: Limite de objetos locais atingido (%d).\n", MAX_LOCAL_OBJECTS);
+    return -1;
 }
 
-void delete_local_object(NDNNode *node, const char *name)
+int delete_local_object(NDNNode *node, const char *name)
 {
     for (int i = 0; i < MAX_LOCAL_OBJECTS; i++)
     {
@@ -84,10 +89,11 @@ void delete_local_object(NDNNode *node, const char *name)
             node->local_objects[i].is_valid = 0;
             node->num_local_objects--;
             printf("Objeto '%s' removido localmente.\n", name);
-            return;
+            return 0;
         }
     }
     printf("Objeto '%s' não encontrado localmente.\n", name);
+    return -1;
 }
 
 int has_local_object(NDNNode *node, const char *name)
@@ -111,7 +117,7 @@ void add_object_to_cache(NDNNode *node, const char *name)
         if (node->object_cache[i].is_valid && strcmp(node->object_cache[i].name, name) == 0)
         {
             node->object_cache[i].last_access_time = time(NULL); // Atualiza timestamp para LRU
-            printf("Objeto '%s' já estava na cache. Timestamp atualizado.\n", name);
+            LOG_DEBUG("Objeto '%s' já estava na cache. Timestamp atualizado.\n", name);
             return;
         }
     }
@@ -126,12 +132,13 @@ void add_object_to_cache(NDNNode *node, const char *name)
             node->object_cache[i].is_valid = 1;
             node->object_cache[i].last_access_time = time(NULL);
             node->num_cached_objects++; // SÓ INCREMENTA QUANDO ADICIONA NOVO
+            METRIC_INC(node, METRIC_CACHE_INSERTS);
             return;
         }
     }
 
     // Cache cheia, aplica política LRU: remove o menos recentemente usado
-    printf("Cache cheia. Aplicando política LRU para '%s'.\n", name);
+    LOG_DEBUG("Cache cheia. Aplicando política LRU para '%s'.\n", name);
     long oldest_time = time(NULL) + 1; // Inicializa com um valor maior para garantir que o primeiro é sempre "oldest"
     int oldest_idx = -1;
 
@@ -146,7 +153,9 @@ void add_object_to_cache(NDNNode *node, const char *name)
 
     if (oldest_idx != -1)
     {
-        printf("Removendo '%s' da cache (LRU).\n", node->object_cache[oldest_idx].name);
+        LOG_DEBUG("Removendo '%s' da cache (LRU).\n", node->object_cache[oldest_idx].name);
+        METRIC_INC(node, METRIC_CACHE_INSERTS);
+        METRIC_INC(node, METRIC_CACHE_EVICTIONS);
         strncpy(node->object_cache[oldest_idx].name, name, MAX_OBJECT_NAME_LEN);
         node->object_cache[oldest_idx].name[MAX_OBJECT_NAME_LEN] = '\0';
         node->object_cache[oldest_idx].last_access_time = time(NULL);
@@ -154,7 +163,7 @@ void add_object_to_cache(NDNNode *node, const char *name)
     }
     else
     {
-        fprintf(stderr, "Erro lógico: Cache cheia, mas não encontrei LRU válido para remover (todos os timestamps eram 0?).\n");
+        LOG_ERROR("Erro lógico: Cache cheia, mas não encontrei LRU válido para remover (todos os timestamps eram 0?).\n");
     }
 }
 
@@ -171,42 +180,107 @@ int has_cached_object(NDNNode *node, const char *name)
     return 0;
 }
 
+// Procura na PIT a entrada correspondente ao par (identificador, nome)
+PendingInterestEntry *find_pending_interest(NDNNode *node, unsigned char id, const char *name)
+{
+    for (int i = 0; i < MAX_PENDING_INTERESTS; i++)
+    {
+        if (node->pending_interests[i].is_valid && node->pending_interests[i].interest_id == id &&
+            strcmp(node->pending_interests[i].object_name, name) == 0)
+        {
+            return &node->pending_interests[i];
+        }
+    }
+    return NULL;
+}
+
+// Apaga uma entrada da PIT e envia CANCEL por todas as suas interfaces em ESPERA (exceto except_sd),
+// para que os ramos que ainda procuram o objeto libertem o seu estado. A entrada é apagada antes dos
+// envios: um envio que falhe remove o vizinho, o que volta a percorrer a PIT.
+static void drop_pending_interest(NDNNode *node, PendingInterestEntry *entry, int except_sd)
+{
+    unsigned char id = entry->interest_id;
+    char name[MAX_OBJECT_NAME_LEN + 1];
+    strcpy(name, entry->object_name);
+    int waiting_sds[MAX_INTEREST_INTERFACES];
+    int num_waiting = 0;
+    for (int i = 0; i < MAX_INTEREST_INTERFACES; i++)
+    {
+        if (entry->interfaces[i].is_valid && entry->interfaces[i].state == INTERFACE_STATE_WAITING &&
+            entry->interfaces[i].sd != except_sd)
+        {
+            waiting_sds[num_waiting++] = entry->interfaces[i].sd;
+            entry->interfaces[i].state = INTERFACE_STATE_CLOSED;
+        }
+    }
+    entry->is_valid = 0;
+    node->num_pending_interests--;
+
+    for (int i = 0; i < num_waiting; i++)
+    {
+        send_cancel_message(node, waiting_sds[i], id, name);
+    }
+}
+
 // Funções de envio de mensagens NDN
-void send_interest_message(int target_sd, unsigned char id, const char *name)
+void send_interest_message(NDNNode *node, int target_sd, unsigned char id, const char *name, int hop_limit,
+                           unsigned long long trace_id)
 {
     char message[MAX_TCP_MSG_LEN];
-    snprintf(message, sizeof(message), "INTEREST %u %s\n", id, name); // %u para unsigned char
-    printf("Enviando INTEREST (ID: %u) para SD %d: '%s'", id, target_sd, message);
-    if (write(target_sd, message, strlen(message)) == -1)
+    char trace_option[TRACE_OPTION_LEN];
+    format_trace_option(trace_option, trace_id);
+    if (hop_limit == HOP_LIMIT_NONE)
+    {
+        snprintf(message, sizeof(message), "INTEREST %u %s%s\n", id, name, trace_option); // %u para unsigned char
+    }
+    else
+    {
+        snprintf(message, sizeof(message), "INTEREST %u %s %d%s\n", id, name, hop_limit, trace_option);
+    }
+    LOG_DEBUG("Enviando INTEREST (ID: %u) para SD %d: '%.*s'\n", id, target_sd, (int)strlen(message) - 1, message);
+    TRACE_EVENT(node, trace_id, TRACE_FORWARDED, target_sd, id, name);
+    if (send_neighbor_message(node, target_sd, message) == -1)
+    {
+        remove_neighbor(node, target_sd);
+    }
+}
+
+void send_object_message(NDNNode *node, int target_sd, unsigned char id, const char *name, unsigned long long trace_id)
+{
+    char message[MAX_TCP_MSG_LEN];
+    char trace_option[TRACE_OPTION_LEN];
+    format_trace_option(trace_option, trace_id);
+    snprintf(message, sizeof(message), "OBJECT %u %s%s\n", id, name, trace_option);
+    LOG_DEBUG("Enviando OBJECT (ID: %u) para SD %d: '%.*s'\n", id, target_sd, (int)strlen(message) - 1, message);
+    TRACE_EVENT(node, trace_id, TRACE_OBJECT_SENT, target_sd, id, name);
+    if (send_neighbor_message(node, target_sd, message) == -1)
     {
-        perror("Erro ao enviar mensagem INTEREST");
-        NDNNode *node = get_current_ndn_node(); // Acessar o nó global
         remove_neighbor(node, target_sd);
     }
 }
 
-void send_object_message(int target_sd, unsigned char id, const char *name)
+void send_noobject_message(NDNNode *node, int target_sd, unsigned char id, const char *name, int scope_exhausted,
+                           unsigned long long trace_id)
 {
     char message[MAX_TCP_MSG_LEN];
-    snprintf(message, sizeof(message), "OBJECT %u %s\n", id, name);
-    printf("Enviando OBJECT (ID: %u) para SD %d: '%s'", id, target_sd, message);
-    if (write(target_sd, message, strlen(message)) == -1)
+    char trace_option[TRACE_OPTION_LEN];
+    format_trace_option(trace_option, trace_id);
+    snprintf(message, sizeof(message), "NOOBJECT %u %s%s%s\n", id, name, scope_exhausted ? " SCOPE" : "", trace_option);
+    LOG_DEBUG("Enviando NOOBJECT (ID: %u) para SD %d: '%.*s'\n", id, target_sd, (int)strlen(message) - 1, message);
+    TRACE_EVENT(node, trace_id, TRACE_NOOBJECT_SENT, target_sd, id, name);
+    if (send_neighbor_message(node, target_sd, message) == -1)
     {
-        perror("Erro ao enviar mensagem OBJECT");
-        NDNNode *node = get_current_ndn_node();
         remove_neighbor(node, target_sd);
     }
 }
 
-void send_noobject_message(int target_sd, unsigned char id, const char *name)
+void send_cancel_message(NDNNode *node, int target_sd, unsigned char id, const char *name)
 {
     char message[MAX_TCP_MSG_LEN];
-    snprintf(message, sizeof(message), "NOOBJECT %u %s\n", id, name);
-    printf("Enviando NOOBJECT (ID: %u) para SD %d: '%s'", id, target_sd, message);
-    if (write(target_sd, message, strlen(message)) == -1)
+    snprintf(message, sizeof(message), "CANCEL %u %s\n", id, name);
+    LOG_DEBUG("Enviando CANCEL (ID: %u) para SD %d: '%.*s'\n", id, target_sd, (int)strlen(message) - 1, message);
+    if (send_neighbor_message(node, target_sd, message) == -1)
     {
-        perror("Erro ao enviar mensagem NOOBJECT");
-        NDNNode *node = get_current_ndn_node();
         remove_neighbor(node, target_sd);
     }
 }
@@ -289,37 +363,122 @@ void show_interest_table(NDNNode *node)
     }
 }
 
+void show_retrieves(NDNNode *node)
+{
+    printf("Pesquisas do utilizador em curso (SRTT: %.1f ms, RTTVAR: %.1f ms, RTO: %lld ms):\n",
+           node->srtt_us / 1000.0, node->rttvar_us / 1000.0, node->rto_ms);
+    long long now_ms = ndn_now_ms();
+    int count = 0;
+    for (int i = 0; i < MAX_RETRIEVES; i++)
+    {
+        RetrieveRequest *req = &node->retrieves[i];
+        if (req->is_valid)
+        {
+            printf("  %s (ID: %u, tentativa %d, expira em %lld ms)\n",
+                   req->object_name, req->interest_id, req->attempts, req->deadline_ms - now_ms);
+            count++;
+        }
+    }
+    if (count == 0)
+    {
+        printf("  (Nenhuma)\n");
+    }
+}
+
 // --- Lógica principal de obtenção de objetos ---
 
-// Início de uma pesquisa (chamada do UI)
-void initiate_retrieve(NDNNode *node, const char *object_name)
+// Helper function: Inicializa a tabela de pesquisas do utilizador e as estatísticas do anel
+void init_retrieves(NDNNode *node)
 {
-    if (node->current_net_id == -1)
+    for (int i = 0; i < MAX_RETRIEVES; i++)
     {
-        printf("Erro: Nó não está em nenhuma rede. Use 'join' ou 'direct join' primeiro.\n");
-        return;
+        node->retrieves[i].is_valid = 0;
     }
+    for (int i = 0; i < RING_STATS_BUCKETS; i++)
+    {
+        node->ring_satisfied[i] = 0;
+    }
+    node->ring_failed = 0;
+    node->ring_expansions = 0;
 
-    // 1. Verificar se o nó já tem o objeto localmente
-    if (has_local_object(node, object_name))
+    node->srtt_us = 0;
+    node->rttvar_us = 0;
+    node->rto_ms = RTO_INITIAL_MS;
+}
+
+// Atualiza o estimador de RTT com uma nova amostra (RFC 6298) e recalcula o RTO
+static void update_rto(NDNNode *node, long long sample_us)
+{
+    if (node->srtt_us == 0)
     {
-        printf("Objeto '%s' encontrado localmente. Não é necessária pesquisa.\n", object_name);
-        return;
+        node->srtt_us = sample_us;
+        node->rttvar_us = sample_us / 2;
+    }
+    else
+    {
+        long long delta = node->srtt_us - sample_us;
+        if (delta < 0)
+        {
+            delta = -delta;
+        }
+        node->rttvar_us = (3 * node->rttvar_us + delta) / 4;
+        node->srtt_us = (7 * node->srtt_us + sample_us) / 8;
     }
 
-    // 2. Verificar se o objeto está na cache
-    if (has_cached_object(node, object_name))
+    long long rto_ms = (node->srtt_us + 4 * node->rttvar_us) / 1000;
+    if (rto_ms < RTO_MIN_MS)
     {
-        printf("Objeto '%s' encontrado na cache. Não é necessária pesquisa.\n", object_name);
-        return;
+        rto_ms = RTO_MIN_MS;
     }
+    if (rto_ms > RTO_MAX_MS)
+    {
+        rto_ms = RTO_MAX_MS;
+    }
+    node->rto_ms = rto_ms;
+}
 
-    // Se não tiver o objeto, iniciar a pesquisa
+// Remove da PIT a entrada de uma tentativa abandonada, cancelando os ramos que ainda a procuram
+static void abandon_retrieve_attempt(NDNNode *node, RetrieveRequest *req)
+{
+    PendingInterestEntry *entry = find_pending_interest(node, req->interest_id, req->object_name);
+    if (entry)
+    {
+        drop_pending_interest(node, entry, -1);
+    }
+}
 
-    // 3. Escolher um identificador de procura aleatoriamente entre 0 e 255
-    srand(time(NULL)); // Inicializa o gerador de números aleatórios
-    unsigned char interest_id;
-    int id_found = 0;
+// Procura a pesquisa do utilizador cuja tentativa em curso usa o par (identificador, nome)
+static RetrieveRequest *find_retrieve(NDNNode *node, unsigned char id, const char *name)
+{
+    for (int i = 0; i < MAX_RETRIEVES; i++)
+    {
+        if (node->retrieves[i].is_valid && node->retrieves[i].interest_id == id &&
+            strcmp(node->retrieves[i].object_name, name) == 0)
+        {
+            return &node->retrieves[i];
+        }
+    }
+    return NULL;
+}
+
+// Posição nas estatísticas do anel para um alcance: 1 -> 0, 2 -> 1, 4 -> 2, ..., ilimitado -> última
+static int ring_stats_bucket(int scope)
+{
+    if (scope == HOP_LIMIT_NONE)
+    {
+        return RING_STATS_BUCKETS - 1;
+    }
+    int bucket = 0;
+    while ((1 << bucket) < scope && bucket < RING_STATS_BUCKETS - 2)
+    {
+        bucket++;
+    }
+    return bucket;
+}
+
+// Escolhe aleatoriamente um identificador de procura (0-255) que não esteja em uso na PIT
+static int choose_interest_id(NDNNode *node, unsigned char *interest_id)
+{
     for (int attempts = 0; attempts < 256; attempts++)
     { // Tenta encontrar um ID único
         unsigned char potential_id = (unsigned char)(rand() % 256);
@@ -334,18 +493,26 @@ void initiate_retrieve(NDNNode *node, const char *object_name)
         }
         if (is_unique)
         {
-            interest_id = potential_id;
-            id_found = 1;
-            break;
+            *interest_id = potential_id;
+            return 1;
         }
     }
+    return 0;
+}
 
-    if (!id_found)
+// Envia uma tentativa da pesquisa: cria a entrada na PIT com o utilizador como interface de RESPOSTA
+// e envia o interesse, com o alcance da tentativa, por cada um dos vizinhos.
+// Devolve 1 se ficou pelo menos uma interface em ESPERA, 0 caso contrário.
+static int send_retrieve_attempt(NDNNode *node, RetrieveRequest *req)
+{
+    // 1. Escolher um identificador de procura aleatoriamente entre 0 e 255
+    unsigned char interest_id;
+    if (!choose_interest_id(node, &interest_id))
     {
-        return;
+        return 0;
     }
 
-    // 4. Criar a entrada correspondente na tabela de interesses pendentes (PIT)
+    // 2. Criar a entrada correspondente na tabela de interesses pendentes (PIT)
     int pit_idx = -1;
     for (int i = 0; i < MAX_PENDING_INTERESTS; i++)
     {
@@ -357,63 +524,408 @@ void initiate_retrieve(NDNNode *node, const char *object_name)
     }
     if (pit_idx == -1)
     {
-        printf("Erro: Tabela de Interesses Pendentes cheia. Não é possível iniciar nova pesquisa para '%s'.\n", object_name);
-        return;
+        printf("Erro: Tabela de Interesses Pendentes cheia. Não é possível iniciar nova pesquisa para '%s'.\n", req->object_name);
+        return 0;
     }
 
     PendingInterestEntry *new_interest = &node->pending_interests[pit_idx];
     new_interest->is_valid = 1;
     new_interest->interest_id = interest_id;
-    strncpy(new_interest->object_name, object_name, MAX_OBJECT_NAME_LEN);
+    strncpy(new_interest->object_name, req->object_name, MAX_OBJECT_NAME_LEN);
     new_interest->object_name[MAX_OBJECT_NAME_LEN] = '\0';
     new_interest->num_active_interfaces = 0;
+    new_interest->hop_limit = req->scope;
+    new_interest->scope_exhausted = 0;
+    new_interest->trace_id = req->trace_id;
+    for (int j = 0; j < MAX_INTEREST_INTERFACES; j++)
+    {
+        new_interest->interfaces[j].is_valid = 0;
+    }
 
     // A interface que gerou o interesse (o utilizador local) é a interface de RESPOSTA
-    if (new_interest->num_active_interfaces < MAX_INTEREST_INTERFACES)
+    new_interest->interfaces[0].sd = STDIN_FILENO; // Representa o utilizador
+    new_interest->interfaces[0].state = INTERFACE_STATE_RESPONSE;
+    new_interest->interfaces[0].is_valid = 1;
+    new_interest->num_active_interfaces = 1;
+    TRACE_EVENT(node, req->trace_id, TRACE_ISSUED, STDIN_FILENO, interest_id, req->object_name);
+
+    // 3. Enviar a mensagem de interesse pelas interfaces escolhidas pela estratégia do prefixo
+    // Colocando estas interfaces no estado de ESPERA
+    assign_forwarding_strategy(node, new_interest);
+    if (forward_interest(node, new_interest) == 0)
     {
-        new_interest->interfaces[new_interest->num_active_interfaces].sd = STDIN_FILENO; // Representa o utilizador
-        new_interest->interfaces[new_interest->num_active_interfaces].state = INTERFACE_STATE_RESPONSE;
-        new_interest->interfaces[new_interest->num_active_interfaces].is_valid = 1;
-        new_interest->num_active_interfaces++;
+        // Sem vizinhos para onde enviar, a entrada não fica na PIT
+        new_interest->is_valid = 0;
+        return 0;
     }
-    else
+
+    node->num_pending_interests++;
+    req->interest_id = interest_id;
+    req->attempts++;
+    req->attempt_sent_us = ndn_now_us();
+    req->deadline_ms = req->attempt_sent_us / 1000 + req->rto_ms;
+    return 1;
+}
+
+// Início de uma pesquisa; ring indica se o alcance cresce em anel (1, 2, 4, ...) ou se é ilimitado,
+// traced se as mensagens levam um identificador de rastreio
+// Avisa quem pediu a pesquisa (simulador, biblioteca) do seu resultado final
+static void notify_retrieve_done(NDNNode *node, const char *object_name, RetrieveResult result, long long latency_us,
+                                 RetrieveCallback callback, void *ctx)
+{
+    METRIC_INC(node, METRIC_RETRIEVES_FOUND + result);
+    if (callback)
+    {
+        callback(node, object_name, result, latency_us, ctx);
+    }
+    else if (node->on_retrieve_done)
+    {
+        node->on_retrieve_done(node, object_name, result, latency_us, node->retrieve_ctx);
+    }
+}
+
+// Fim de uma pesquisa do utilizador local: liberta a entrada e avisa quem a pediu
+static void finish_retrieve(NDNNode *node, RetrieveRequest *req, RetrieveResult result, long long now_us)
+{
+    req->is_valid = 0;
+    notify_retrieve_done(node, req->object_name, result, now_us - req->start_us, req->callback, req->callback_ctx);
+}
+
+// Início de uma pesquisa do utilizador local (flags: NDN_RETRIEVE_RING, NDN_RETRIEVE_TRACED)
+void begin_retrieve(NDNNode *node, const char *object_name, int flags, RetrieveCallback callback, void *ctx)
+{
+    int ring = (flags & NDN_RETRIEVE_RING) != 0;
+    int traced = (flags & NDN_RETRIEVE_TRACED) != 0;
+
+    if (node->current_net_id == -1)
     {
-        node->pending_interests[pit_idx].is_valid = 0; // Invalidar a entrada se não pode ser usada
+        printf("Erro: Nó não está em nenhuma rede. Use 'join' ou 'direct join' primeiro.\n");
+        notify_retrieve_done(node, object_name, RETRIEVE_RESULT_NOT_FOUND, 0, callback, ctx);
         return;
     }
 
-    // 5. Enviar uma mensagem de interesse por CADA uma das suas interfaces (vizinhos)
-    // Colocando estas interfaces no estado de ESPERA
-    int sent_to_any_neighbor = 0;
-    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    // 1. Verificar se o nó já tem o objeto localmente
+    if (has_local_object(node, object_name))
+    {
+        printf("Objeto '%s' encontrado localmente. Não é necessária pesquisa.\n", object_name);
+        notify_retrieve_done(node, object_name, RETRIEVE_RESULT_FOUND, 0, callback, ctx);
+        return;
+    }
+
+    // 2. Verificar se o objeto está na cache
+    if (has_cached_object(node, object_name))
     {
-        if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd != -1)
+        printf("Objeto '%s' encontrado na cache. Não é necessária pesquisa.\n", object_name);
+        notify_retrieve_done(node, object_name, RETRIEVE_RESULT_FOUND, 0, callback, ctx);
+        return;
+    }
+
+    // Se não tiver o objeto, iniciar a pesquisa
+    RetrieveRequest *req = NULL;
+    for (int i = 0; i < MAX_RETRIEVES; i++)
+    {
+        if (!node->retrieves[i].is_valid)
         {
-            if (new_interest->num_active_interfaces < MAX_INTEREST_INTERFACES)
+            req = &node->retrieves[i];
+            break;
+        }
+    }
+    if (!req)
+    {
+        printf("Erro: Limite de pesquisas em curso atingido (%d).\n", MAX_RETRIEVES);
+        notify_retrieve_done(node, object_name, RETRIEVE_RESULT_NOT_FOUND, 0, callback, ctx);
+        return;
+    }
+
+    strncpy(req->object_name, object_name, MAX_OBJECT_NAME_LEN);
+    req->object_name[MAX_OBJECT_NAME_LEN] = '\0';
+    req->ring = ring;
+    req->scope = ring ? 1 : HOP_LIMIT_NONE;
+    req->attempts = 0;
+    req->rto_ms = node->rto_ms;
+    req->start_us = ndn_now_us();
+    req->trace_id = traced ? new_trace_id(node) : 0;
+    req->callback = callback;
+    req->callback_ctx = ctx;
+    req->is_valid = 1;
+    if (traced)
+    {
+        printf("Pesquisa de '%s' rastreada com T=%llx. Eventos deste nó em %s.\n", object_name, req->trace_id,
+               node->trace_path);
+    }
+
+    if (!send_retrieve_attempt(node, req))
+    {
+        finish_retrieve(node, req, RETRIEVE_RESULT_NOT_FOUND, ndn_now_us()); // Sem interfaces para onde enviar
+    }
+}
+
+// Regista a duração de uma pesquisa terminada (OBJECT ou NOOBJECT final) no total e no prefixo do nome
+static void record_retrieve_latency(NDNNode *node, RetrieveRequest *req, long long now_us)
+{
+    long long latency_us = now_us - req->start_us;
+    histogram_record(&node->retrieve_latency, latency_us);
+    histogram_record(&node->prefix_latency[find_strategy_choice(node, req->object_name)], latency_us);
+}
+
+// O objeto chegou a uma entrada da PIT cuja interface de RESPOSTA é o utilizador local
+static void complete_retrieve_found(NDNNode *node, unsigned char interest_id, const char *object_name)
+{
+    printf("  Objeto '%s' (ID %u) entregue ao utilizador local.\n", object_name, interest_id);
+
+    RetrieveRequest *req = find_retrieve(node, interest_id, object_name);
+    if (!req)
+    {
+        return;
+    }
+
+    // Cada tentativa tem identificador próprio, logo a amostra de RTT nunca é ambígua
+    long long now_us = ndn_now_us();
+    update_rto(node, now_us - req->attempt_sent_us);
+    TRACE_EVENT(node, req->trace_id, TRACE_DELIVERED, STDIN_FILENO, interest_id, object_name);
+    printf("  Pesquisa de '%s' concluída: OBJECT em %.1f ms (%d tentativa(s)).\n",
+           object_name, (now_us - req->start_us) / 1000.0, req->attempts);
+    record_retrieve_latency(node, req, now_us);
+
+    if (req->ring)
+    {
+        node->ring_satisfied[ring_stats_bucket(req->scope)]++;
+    }
+    finish_retrieve(node, req, RETRIEVE_RESULT_FOUND, now_us);
+}
+
+// Todas as interfaces em ESPERA responderam NOOBJECT a uma pesquisa do utilizador local.
+// Numa pesquisa em anel em que algum ramo esgotou o alcance, tenta de novo com o dobro do alcance.
+static void complete_retrieve_not_found(NDNNode *node, unsigned char interest_id, const char *object_name, int scope_exhausted)
+{
+    RetrieveRequest *req = find_retrieve(node, interest_id, object_name);
+    long long now_us = ndn_now_us();
+    if (req)
+    {
+        update_rto(node, now_us - req->attempt_sent_us);
+        TRACE_EVENT(node, req->trace_id, TRACE_NOT_FOUND, STDIN_FILENO, interest_id, object_name);
+    }
+
+    if (req && req->ring && scope_exhausted && req->scope != HOP_LIMIT_NONE)
+    {
+        int previous_scope = req->scope;
+        req->scope = (req->scope >= RING_MAX_SCOPE) ? HOP_LIMIT_NONE : req->scope * 2;
+        req->attempts = 0;
+        req->rto_ms = node->rto_ms;
+        node->ring_expansions++;
+        printf("  Objeto '%s' não encontrado até %d saltos. Alargando o alcance da pesquisa.\n", object_name, previous_scope);
+        if (send_retrieve_attempt(node, req))
+        {
+            return;
+        }
+    }
+
+    printf("  Objeto '%s' (ID %u) NÃO ENCONTRADO para o utilizador local.\n", object_name, interest_id);
+    if (req)
+    {
+        printf("  Pesquisa de '%s' concluída: NOOBJECT em %.1f ms (%d tentativa(s)).\n",
+               object_name, (now_us - req->start_us) / 1000.0, req->attempts);
+        record_retrieve_latency(node, req, now_us);
+        if (req->ring)
+        {
+            node->ring_failed++;
+        }
+        finish_retrieve(node, req, RETRIEVE_RESULT_NOT_FOUND, now_us);
+    }
+}
+
+// Responde a uma entrada da PIT por todas as interfaces no estado de RESPOSTA, o utilizador local
+// (STDIN) incluído: OBJECT se found, NOOBJECT caso contrário. Os ramos ainda em ESPERA são cancelados,
+// exceto except_sd (por onde chegou a resposta), e a entrada é apagada antes das respostas.
+static void answer_pending_interest(NDNNode *node, PendingInterestEntry *entry, int found, int except_sd,
+                                    unsigned long long trace_id)
+{
+    unsigned char id = entry->interest_id;
+    char name[MAX_OBJECT_NAME_LEN + 1];
+    strcpy(name, entry->object_name);
+    int scope_exhausted = entry->scope_exhausted;
+    int response_sds[MAX_INTEREST_INTERFACES];
+    int num_responses = 0;
+    for (int i = 0; i < MAX_INTEREST_INTERFACES; i++)
+    {
+        if (entry->interfaces[i].is_valid && entry->interfaces[i].state == INTERFACE_STATE_RESPONSE)
+        {
+            response_sds[num_responses++] = entry->interfaces[i].sd;
+        }
+    }
+    drop_pending_interest(node, entry, except_sd);
+
+    for (int i = 0; i < num_responses; i++)
+    {
+        if (response_sds[i] == STDIN_FILENO && found)
+        {
+            complete_retrieve_found(node, id, name);
+        }
+        else if (response_sds[i] == STDIN_FILENO)
+        {
+            complete_retrieve_not_found(node, id, name, scope_exhausted);
+        }
+        else if (found)
+        {
+            send_object_message(node, response_sds[i], id, name, trace_id);
+        }
+        else
+        {
+            send_noobject_message(node, response_sds[i], id, name, scope_exhausted, trace_id);
+        }
+    }
+}
+
+void pit_face_removed(NDNNode *node, int sd)
+{
+    for (int e = 0; e < MAX_PENDING_INTERESTS; e++)
+    {
+        PendingInterestEntry *entry = &node->pending_interests[e];
+        if (!entry->is_valid)
+        {
+            continue;
+        }
+        int affected = 0;
+        int has_response_interface = 0;
+        int has_waiting_interface = 0;
+        for (int i = 0; i < MAX_INTEREST_INTERFACES; i++)
+        {
+            InterestInterface *interface = &entry->interfaces[i];
+            if (!interface->is_valid)
             {
-                send_interest_message(node->neighbors[i].socket_sd, interest_id, object_name);
-                new_interest->interfaces[new_interest->num_active_interfaces].sd = node->neighbors[i].socket_sd;
-                new_interest->interfaces[new_interest->num_active_interfaces].state = INTERFACE_STATE_WAITING;
-                new_interest->interfaces[new_interest->num_active_interfaces].is_valid = 1;
-                new_interest->num_active_interfaces++;
-                sent_to_any_neighbor = 1;
+                continue;
             }
-            else
+            if (interface->sd == sd)
             {
-                break;
+                // Fica FECHADO e sem o descritor, que pode ser reutilizado por uma nova conexão
+                interface->state = INTERFACE_STATE_CLOSED;
+                interface->sd = -1;
+                affected = 1;
             }
+            else if (interface->state == INTERFACE_STATE_RESPONSE)
+            {
+                has_response_interface = 1;
+            }
+            else if (interface->state == INTERFACE_STATE_WAITING)
+            {
+                has_waiting_interface = 1;
+            }
+        }
+        if (!affected)
+        {
+            continue;
+        }
+
+        if (!has_response_interface)
+        {
+            // Ninguém espera já pela resposta: como um CANCEL do último pedido
+            drop_pending_interest(node, entry, -1);
+            METRIC_INC(node, METRIC_PIT_CANCELLED);
+            LOG_DEBUG("  Entrada da PIT para ID %u apagada: o pedido veio do vizinho removido (SD %d).\n", entry->interest_id, sd);
+            continue;
         }
+        // Perdeu-se o último ramo em ESPERA: como um NOOBJECT desse ramo
+        if (has_waiting_interface || forward_interest(node, entry) > 0 || !entry->is_valid)
+        {
+            continue;
+        }
+        METRIC_INC(node, METRIC_PIT_UNSATISFIED);
+        strategy_interest_unsatisfied(node, entry);
+        answer_pending_interest(node, entry, 0, -1, entry->trace_id);
     }
+}
 
-    // If no neighbors to send to, and only STDIN is in the PIT, then send NOOBJECT back immediately.
-    if (!sent_to_any_neighbor)
+// Instante em que expira a tentativa mais próxima, ou -1 se não houver pesquisas em curso
+long long retrieve_next_deadline_ms(NDNNode *node)
+{
+    long long deadline = -1;
+    for (int i = 0; i < MAX_RETRIEVES; i++)
     {
-        new_interest->is_valid = 0; // Remove from PIT if no interfaces are waiting
-        node->num_pending_interests--;
+        if (node->retrieves[i].is_valid && (deadline == -1 || node->retrieves[i].deadline_ms < deadline))
+        {
+            deadline = node->retrieves[i].deadline_ms;
+        }
     }
-    else
+    return deadline;
+}
+
+// Retransmite, com novo identificador e o dobro do tempo de espera, as tentativas sem resposta
+void check_retrieve_timeouts(NDNNode *node)
+{
+    long long now_ms = ndn_now_ms();
+    for (int i = 0; i < MAX_RETRIEVES; i++)
     {
-        node->num_pending_interests++;
+        RetrieveRequest *req = &node->retrieves[i];
+        if (!req->is_valid || req->deadline_ms > now_ms)
+        {
+            continue;
+        }
+
+        TRACE_EVENT(node, req->trace_id, TRACE_TIMEOUT, STDIN_FILENO, req->interest_id, req->object_name);
+        abandon_retrieve_attempt(node, req);
+
+        if (req->attempts < RETRIEVE_MAX_ATTEMPTS)
+        {
+            req->rto_ms *= 2;
+            if (req->rto_ms > RTO_MAX_MS)
+            {
+                req->rto_ms = RTO_MAX_MS;
+            }
+            printf("  Sem resposta para '%s'. Retransmitindo (tentativa %d, espera %lld ms).\n",
+                   req->object_name, req->attempts + 1, req->rto_ms);
+            if (send_retrieve_attempt(node, req))
+            {
+                continue;
+            }
+        }
+
+        printf("  Pesquisa de '%s' concluída: SEM RESPOSTA após %.1f ms (%d tentativa(s)).\n",
+               req->object_name, (ndn_now_us() - req->start_us) / 1000.0, req->attempts);
+        if (req->ring)
+        {
+            node->ring_failed++;
+        }
+        finish_retrieve(node, req, RETRIEVE_RESULT_TIMEOUT, ndn_now_us());
+    }
+}
+
+void show_ring_stats(NDNNode *node)
+{
+    printf("Pesquisas em anel satisfeitas por alcance:\n");
+    for (int i = 0; i < RING_STATS_BUCKETS - 1; i++)
+    {
+        printf("  %3d salto(s): %d\n", 1 << i, node->ring_satisfied[i]);
+    }
+    printf("  ilimitado   : %d\n", node->ring_satisfied[RING_STATS_BUCKETS - 1]);
+    printf("  Não encontradas: %d\n", node->ring_failed);
+    printf("  Alargamentos de alcance: %d\n", node->ring_expansions);
+}
+
+// Lê os campos opcionais que seguem o nome numa mensagem NDN:
+// um número é o limite de saltos de um INTEREST; "SCOPE" indica, num NOOBJECT,
+// que algum ramo parou por ter esgotado o alcance (e não por ter percorrido toda a árvore);
+// "T=<hex>" é o identificador de rastreio da pesquisa
+static void parse_ndn_options(const char *rest, int *hop_limit, int *scope_exhausted, unsigned long long *trace_id)
+{
+    char token[32];
+    int consumed;
+    while (sscanf(rest, "%31s%n", token, &consumed) == 1)
+    {
+        char *end;
+        long value = strtol(token, &end, 10);
+        if (*end == '\0' && value > 0)
+        {
+            *hop_limit = (int)value;
+        }
+        else if (strcmp(token, "SCOPE") == 0)
+        {
+            *scope_exhausted = 1;
+        }
+        else if (strncmp(token, "T=", 2) == 0)
+        {
+            *trace_id = strtoull(token + 2, NULL, 16);
+        }
+        rest += consumed;
     }
 }
 
@@ -424,82 +936,121 @@ void process_ndn_message(NDNNode *node, int client_sd, const char *message)
     unsigned int id_uint; // Usar unsigned int para sscanf, depois converter para unsigned char
     char object_name[MAX_OBJECT_NAME_LEN + 1];
 
-    if (sscanf(message, "%s %u %s", cmd, &id_uint, object_name) != 3)
+    int consumed = 0;
+
+    if (sscanf(message, "%s %u %s%n", cmd, &id_uint, object_name, &consumed) != 3)
     {
         return;
     }
     unsigned char interest_id = (unsigned char)id_uint;
 
+    int hop_limit = HOP_LIMIT_NONE; // Limite de saltos do INTEREST recebido (ausente = ilimitado)
+    int scope_exhausted = 0;        // Marca "SCOPE" de um NOOBJECT recebido
+    unsigned long long trace_id = 0; // Identificador de rastreio (0 se a mensagem não é rastreada)
+    parse_ndn_options(message + consumed, &hop_limit, &scope_exhausted, &trace_id);
+
     if (strcmp(cmd, "INTEREST") == 0)
     {
-        printf("Recebida INTEREST (ID: %u, Nome: %s) de SD %d.\n", interest_id, object_name, client_sd);
+        LOG_DEBUG("Recebida INTEREST (ID: %u, Nome: %s) de SD %d.\n", interest_id, object_name, client_sd);
+        TRACE_EVENT(node, trace_id, TRACE_INTEREST_RECEIVED, client_sd, interest_id, object_name);
 
         // 1. Verificar se o nó tem o objeto
         if (has_local_object(node, object_name))
         {
-            printf("  Objeto '%s' encontrado localmente. Respondendo com OBJECT.\n", object_name);
-            send_object_message(client_sd, interest_id, object_name);
+            LOG_DEBUG("  Objeto '%s' encontrado localmente. Respondendo com OBJECT.\n", object_name);
+            METRIC_INC(node, METRIC_LOCAL_HITS);
+            TRACE_EVENT(node, trace_id, TRACE_LOCAL_HIT, client_sd, interest_id, object_name);
+            send_object_message(node, client_sd, interest_id, object_name, trace_id);
             return;
         }
 
         // 2. Verificar se o objeto está na cache
         if (has_cached_object(node, object_name))
         {
-            printf("  Objeto '%s' encontrado na cache. Respondendo com OBJECT.\n", object_name);
-            send_object_message(client_sd, interest_id, object_name);
+            LOG_DEBUG("  Objeto '%s' encontrado na cache. Respondendo com OBJECT.\n", object_name);
+            METRIC_INC(node, METRIC_CACHE_HITS);
+            TRACE_EVENT(node, trace_id, TRACE_CACHE_HIT, client_sd, interest_id, object_name);
+            send_object_message(node, client_sd, interest_id, object_name, trace_id);
             return;
         }
 
         // 3. Se o nó não tiver o objeto localmente ou na cache
+        METRIC_INC(node, METRIC_CACHE_MISSES);
         // Procurar na Tabela de Interesses Pendentes (PIT) se já existe este interesse
-        PendingInterestEntry *existing_interest = NULL;
-        for (int i = 0; i < MAX_PENDING_INTERESTS; i++)
-        {
-            if (node->pending_interests[i].is_valid && node->pending_interests[i].interest_id == interest_id &&
-                strcmp(node->pending_interests[i].object_name, object_name) == 0)
-            {
-                existing_interest = &node->pending_interests[i];
-                break;
-            }
-        }
+        PendingInterestEntry *existing_interest = find_pending_interest(node, interest_id, object_name);
 
         if (existing_interest)
         {
-            // Se o interesse já existe na PIT, adicionar a interface de onde veio
-            // para que a resposta seja enviada de volta por ela.
-            printf("  Interesse ID %u para '%s' já existe na PIT. Adicionando SD %d como interface de RESPOSTA.\n",
-                   interest_id, object_name, client_sd);
-            // Verifica se a interface já existe para não duplicar, apenas atualiza o estado
-            int interface_found = 0;
+            TRACE_EVENT(node, trace_id, TRACE_PIT_HIT, client_sd, interest_id, object_name);
+            InterestInterface *arriving_interface = NULL;
             for (int i = 0; i < existing_interest->num_active_interfaces; ++i)
             {
                 if (existing_interest->interfaces[i].is_valid && existing_interest->interfaces[i].sd == client_sd)
                 {
-                    existing_interest->interfaces[i].state = INTERFACE_STATE_RESPONSE;
-                    interface_found = 1;
+                    arriving_interface = &existing_interest->interfaces[i];
                     break;
                 }
             }
-            if (!interface_found)
+
+            // Só há ciclo se o interesse volta por uma interface para onde foi reencaminhado, ou chega por
+            // um atalho (a árvore sozinha não tem ciclos). Responde-se NOOBJECT para que o remetente não
+            // fique à espera. Nos outros casos é outra origem com o mesmo ID: agrega-se, como antes.
+            Neighbor *arriving_neighbor = find_neighbor_by_sd(node, client_sd);
+            if ((arriving_interface && arriving_interface->state == INTERFACE_STATE_WAITING) ||
+                (arriving_neighbor && arriving_neighbor->type == NEIGHBOR_TYPE_SHORTCUT))
             {
-                // Adiciona nova interface de resposta
-                if (existing_interest->num_active_interfaces < MAX_INTEREST_INTERFACES)
-                {
-                    existing_interest->interfaces[existing_interest->num_active_interfaces].sd = client_sd;
-                    existing_interest->interfaces[existing_interest->num_active_interfaces].state = INTERFACE_STATE_RESPONSE;
-                    existing_interest->interfaces[existing_interest->num_active_interfaces].is_valid = 1;
-                    existing_interest->num_active_interfaces++;
-                }
-                else
-                {
-                    fprintf(stderr, "Aviso: Limite de interfaces para interesse %u atingido. Não adicionou SD %d.\n", interest_id, client_sd);
-                }
+                LOG_DEBUG("  Interesse ID %u para '%s' já existe na PIT (ciclo). Respondendo com NOOBJECT a SD %d.\n",
+                          interest_id, object_name, client_sd);
+                METRIC_INC(node, METRIC_PIT_LOOPS);
+                send_noobject_message(node, client_sd, interest_id, object_name, 0, trace_id);
+                return;
+            }
+
+            // Se o interesse já existe na PIT, adicionar a interface de onde veio
+            // para que a resposta seja enviada de volta por ela.
+            LOG_DEBUG("  Interesse ID %u para '%s' já existe na PIT. Adicionando SD %d como interface de RESPOSTA.\n",
+                      interest_id, object_name, client_sd);
+            if (arriving_interface)
+            {
+                arriving_interface->state = INTERFACE_STATE_RESPONSE;
             }
+            else if (existing_interest->num_active_interfaces < MAX_INTEREST_INTERFACES)
+            {
+                existing_interest->interfaces[existing_interest->num_active_interfaces].sd = client_sd;
+                existing_interest->interfaces[existing_interest->num_active_interfaces].state = INTERFACE_STATE_RESPONSE;
+                existing_interest->interfaces[existing_interest->num_active_interfaces].is_valid = 1;
+                existing_interest->num_active_interfaces++;
+            }
+            else
+            {
+                LOG_WARN("Aviso: Limite de interfaces para interesse %u atingido. Não adicionou SD %d.\n", interest_id, client_sd);
+            }
+            METRIC_INC(node, METRIC_PIT_AGGREGATED);
         }
         else
         {
+            // Se o interesse chegou com o último salto do seu alcance, não é reencaminhado.
+            // Um nó folha responde sem a marca SCOPE, porque não há mais nada para além dele.
+            if (hop_limit != HOP_LIMIT_NONE && hop_limit <= 1)
+            {
+                int has_other_neighbor = 0;
+                for (int i = 0; i < MAX_NEIGHBORS; i++)
+                {
+                    if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd != -1 &&
+                        node->neighbors[i].socket_sd != client_sd)
+                    {
+                        has_other_neighbor = 1;
+                        break;
+                    }
+                }
+                LOG_DEBUG("  Alcance do interesse ID %u para '%s' esgotado. Respondendo com NOOBJECT.\n", interest_id, object_name);
+                METRIC_INC(node, METRIC_SCOPE_EXHAUSTED);
+                send_noobject_message(node, client_sd, interest_id, object_name, has_other_neighbor, trace_id);
+                return;
+            }
+
             // Se o interesse não existe na PIT, criar uma nova entrada
-            printf("  Interesse ID %u para '%s' não existe na PIT. Criando nova entrada e reencaminhando.\n", interest_id, object_name);
+            LOG_DEBUG("  Interesse ID %u para '%s' não existe na PIT. Criando nova entrada e reencaminhando.\n", interest_id, object_name);
             int pit_idx = -1;
             for (int i = 0; i < MAX_PENDING_INTERESTS; i++)
             {
@@ -512,7 +1063,8 @@ void process_ndn_message(NDNNode *node, int client_sd, const char *message)
             if (pit_idx == -1)
             {
                 // Neste caso, o interesse não pode ser reencaminhado. Poderíamos enviar NOOBJECT de volta.
-                send_noobject_message(client_sd, interest_id, object_name);
+                METRIC_INC(node, METRIC_PIT_FULL);
+                send_noobject_message(node, client_sd, interest_id, object_name, 0, trace_id);
                 return;
             }
 
@@ -522,6 +1074,9 @@ void process_ndn_message(NDNNode *node, int client_sd, const char *message)
             strncpy(new_interest->object_name, object_name, MAX_OBJECT_NAME_LEN);
             new_interest->object_name[MAX_OBJECT_NAME_LEN] = '\0';
             new_interest->num_active_interfaces = 0;
+            new_interest->hop_limit = (hop_limit == HOP_LIMIT_NONE) ? HOP_LIMIT_NONE : hop_limit - 1;
+            new_interest->scope_exhausted = 0;
+            new_interest->trace_id = trace_id;
 
             // A interface de onde veio a mensagem é a interface de RESPOSTA
             if (new_interest->num_active_interfaces < MAX_INTEREST_INTERFACES)
@@ -533,58 +1088,24 @@ void process_ndn_message(NDNNode *node, int client_sd, const char *message)
             }
             else
             {
-                send_noobject_message(client_sd, interest_id, object_name); // Se não pode adicionar interface de resposta
+                send_noobject_message(node, client_sd, interest_id, object_name, 0, trace_id); // Se não pode adicionar interface de resposta
                 node->pending_interests[pit_idx].is_valid = 0;              // Invalidar a entrada se não pode ser usada
                 return;
             }
             node->num_pending_interests++;
-            existing_interest = new_interest; // Definir para reencaminhar
-
-            // Reencaminhar a mensagem de interesse por todas as outras interfaces (exceto a de entrada)
-            // Colocando-as no estado de ESPERA
-            if (node->num_active_neighbors == 0)
-            { // Se não tem vizinhos para reencaminhar
-                send_noobject_message(client_sd, interest_id, object_name);
-                // Remover a entrada da PIT se não há espera
-                node->pending_interests[pit_idx].is_valid = 0;
-                node->num_pending_interests--;
-                return;
-            }
+            METRIC_INC(node, METRIC_PIT_INSERTS);
+
+            // Reencaminhar a mensagem de interesse pelas interfaces escolhidas pela estratégia
+            // (nunca pela de entrada), colocando-as no estado de ESPERA
+            assign_forwarding_strategy(node, new_interest);
 
-            for (int i = 0; i < MAX_NEIGHBORS; i++)
-            {
-                if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd != -1 &&
-                    node->neighbors[i].socket_sd != client_sd)
-                { // Não reencaminhar pela mesma interface
-                    if (existing_interest->num_active_interfaces < MAX_INTEREST_INTERFACES)
-                    {
-                        send_interest_message(node->neighbors[i].socket_sd, interest_id, object_name);
-                        existing_interest->interfaces[existing_interest->num_active_interfaces].sd = node->neighbors[i].socket_sd;
-                        existing_interest->interfaces[existing_interest->num_active_interfaces].state = INTERFACE_STATE_WAITING;
-                        existing_interest->interfaces[existing_interest->num_active_interfaces].is_valid = 1;
-                        existing_interest->num_active_interfaces++;
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
-            }
             // A especificação diz: "Cada entrada na tabela de interesses terá pelo menos uma interface no estado de espera."
             // Se nenhuma interface foi colocada em ESPERA (ex: apenas 1 vizinho e foi a interface de entrada), deve enviar NOOBJECT.
-            int has_waiting_interface = 0;
-            for (int i = 0; i < existing_interest->num_active_interfaces; ++i)
-            {
-                if (existing_interest->interfaces[i].is_valid && existing_interest->interfaces[i].state == INTERFACE_STATE_WAITING)
-                {
-                    has_waiting_interface = 1;
-                    break;
-                }
-            }
-            if (!has_waiting_interface)
+            if (forward_interest(node, new_interest) == 0)
             {
-                send_noobject_message(client_sd, interest_id, object_name);
-                existing_interest->is_valid = 0;
+                send_noobject_message(node, client_sd, interest_id, object_name, 0, trace_id);
+                strategy_interest_unsatisfied(node, new_interest);
+                new_interest->is_valid = 0;
                 node->num_pending_interests--;
             }
         }
@@ -593,63 +1114,38 @@ void process_ndn_message(NDNNode *node, int client_sd, const char *message)
     {
 
         // Se o identificador da procura consta da tabela de interesses pendentes
-        PendingInterestEntry *pending_interest = NULL;
-        for (int i = 0; i < MAX_PENDING_INTERESTS; i++)
-        {
-            if (node->pending_interests[i].is_valid && node->pending_interests[i].interest_id == interest_id &&
-                strcmp(node->pending_interests[i].object_name, object_name) == 0)
-            {
-                pending_interest = &node->pending_interests[i];
-                break;
-            }
-        }
+        PendingInterestEntry *pending_interest = find_pending_interest(node, interest_id, object_name);
 
         if (pending_interest)
         {
+            trace_id = pending_interest->trace_id ? pending_interest->trace_id : trace_id;
+            TRACE_EVENT(node, trace_id, TRACE_OBJECT_RECEIVED, client_sd, interest_id, object_name);
+            METRIC_INC(node, METRIC_PIT_SATISFIED);
+            strategy_interest_satisfied(node, pending_interest, client_sd);
+
             // O objeto é guardado em cache
             add_object_to_cache(node, object_name);
 
-            // A mensagem é reencaminhada pela interface no estado de RESPOSTA
-            for (int i = 0; i < MAX_INTEREST_INTERFACES; i++)
-            {
-                if (pending_interest->interfaces[i].is_valid && pending_interest->interfaces[i].state == INTERFACE_STATE_RESPONSE)
-                {
-                    int response_sd = pending_interest->interfaces[i].sd;
-                    // Se a interface de resposta for STDIN, significa que o usuário local iniciou a pesquisa.
-                    if (response_sd == STDIN_FILENO)
-                    {
-                        printf("  Objeto '%s' (ID %u) entregue ao utilizador local.\n", object_name, interest_id);
-                    }
-                    else
-                    {
-                        send_object_message(response_sd, interest_id, object_name);
-                    }
-                    break; // Supondo apenas uma interface de RESPOSTA por interesse.
-                }
-            }
-            // A entrada correspondente à procura é apagada da tabela de interesses pendentes
-            pending_interest->is_valid = 0;
-            node->num_pending_interests--;
+            // A mensagem é reencaminhada por todas as interfaces no estado de RESPOSTA (o utilizador local,
+            // se iniciou a pesquisa, e os vizinhos cujos interesses foram agregados nesta entrada); os
+            // restantes ramos em ESPERA deixam de ser necessários e a entrada é apagada
+            answer_pending_interest(node, pending_interest, 1, client_sd, trace_id);
+        }
+        else
+        {
+            METRIC_INC(node, METRIC_UNSOLICITED);
         }
-
     }
     else if (strcmp(cmd, "NOOBJECT") == 0)
     {
 
         // Se o identificador da procura consta da tabela de interesses pendentes
-        PendingInterestEntry *pending_interest = NULL;
-        for (int i = 0; i < MAX_PENDING_INTERESTS; i++)
-        {
-            if (node->pending_interests[i].is_valid && node->pending_interests[i].interest_id == interest_id &&
-                strcmp(node->pending_interests[i].object_name, object_name) == 0)
-            {
-                pending_interest = &node->pending_interests[i];
-                break;
-            }
-        }
+        PendingInterestEntry *pending_interest = find_pending_interest(node, interest_id, object_name);
 
         if (pending_interest)
         {
+            trace_id = pending_interest->trace_id ? pending_interest->trace_id : trace_id;
+            TRACE_EVENT(node, trace_id, TRACE_NOOBJECT_RECEIVED, client_sd, interest_id, object_name);
             // O estado da interface por onde a mensagem é recebida passa a FECHADO
             int interface_found = 0;
             for (int i = 0; i < MAX_INTEREST_INTERFACES; i++)
@@ -661,10 +1157,18 @@ void process_ndn_message(NDNNode *node, int client_sd, const char *message)
                     break;
                 }
             }
+            if (scope_exhausted)
+            {
+                pending_interest->scope_exhausted = 1;
+            }
+            if (interface_found)
+            {
+                strategy_interest_nacked(node, client_sd);
+            }
             if (!interface_found)
             {
-                fprintf(stderr, "Aviso: NOOBJECT recebido, mas interface SD %d não encontrada na PIT para ID %u, nome %s.\n",
-                        client_sd, interest_id, object_name);
+                LOG_WARN("Aviso: NOOBJECT recebido, mas interface SD %d não encontrada na PIT para ID %u, nome %s.\n",
+                         client_sd, interest_id, object_name);
                 // Pode ser um NOOBJECT de uma interface que não estava em ESPERA, ou já foi tratada.
             }
 
@@ -679,38 +1183,68 @@ void process_ndn_message(NDNNode *node, int client_sd, const char *message)
                 }
             }
 
+            // Estratégias que não usaram todas as interfaces tentam as que restam antes de desistir
+            if (!has_waiting_interface && forward_interest(node, pending_interest) > 0)
+            {
+                has_waiting_interface = 1;
+            }
+
             if (!has_waiting_interface)
             {
-                // Então é enviada uma mensagem de não-objeto pela interface no estado de RESPOSTA
-                for (int i = 0; i < MAX_INTEREST_INTERFACES; i++)
-                {
-                    if (pending_interest->interfaces[i].is_valid && pending_interest->interfaces[i].state == INTERFACE_STATE_RESPONSE)
-                    {
-                        int response_sd = pending_interest->interfaces[i].sd;
-                        if (response_sd == STDIN_FILENO)
-                        {
-                            printf("  Objeto '%s' (ID %u) NÃO ENCONTRADO para o utilizador local.\n", object_name, interest_id);
-                        }
-                        else
-                        {
-                            send_noobject_message(response_sd, interest_id, object_name);
-                        }
-                        break; // Supondo apenas uma interface de RESPOSTA
-                    }
-                }
-                // Apaga a entrada da PIT
-                pending_interest->is_valid = 0;
-                node->num_pending_interests--;
-                printf("  Entrada da PIT para ID %u, nome %s apagada.\n", interest_id, object_name);
+                METRIC_INC(node, METRIC_PIT_UNSATISFIED);
+                strategy_interest_unsatisfied(node, pending_interest);
+
+                // Então é enviada uma mensagem de não-objeto por todas as interfaces no estado de RESPOSTA
+                // e a entrada é apagada da PIT
+                answer_pending_interest(node, pending_interest, 0, -1, trace_id);
+                LOG_DEBUG("  Entrada da PIT para ID %u, nome %s apagada.\n", interest_id, object_name);
             }
         }
         else
         {
-            printf("  NOOBJECT (ID: %u, Nome: %s) recebido, mas não há interesse pendente correspondente. Descartado.\n", interest_id, object_name);
+            METRIC_INC(node, METRIC_UNSOLICITED);
+            LOG_DEBUG("  NOOBJECT (ID: %u, Nome: %s) recebido, mas não há interesse pendente correspondente. Descartado.\n", interest_id, object_name);
+        }
+    }
+    else if (strcmp(cmd, "CANCEL") == 0)
+    {
+        // O vizinho que fez o pedido já não precisa da resposta (o objeto chegou-lhe por outro ramo)
+        PendingInterestEntry *pending_interest = find_pending_interest(node, interest_id, object_name);
+        if (!pending_interest)
+        {
+            // Já respondido ou nunca visto: nada a libertar
+            return;
+        }
+
+        LOG_DEBUG("Recebido CANCEL (ID: %u, Nome: %s) de SD %d.\n", interest_id, object_name, client_sd);
+
+        int has_response_interface = 0;
+        for (int i = 0; i < MAX_INTEREST_INTERFACES; i++)
+        {
+            if (!pending_interest->interfaces[i].is_valid || pending_interest->interfaces[i].state != INTERFACE_STATE_RESPONSE)
+            {
+                continue;
+            }
+            if (pending_interest->interfaces[i].sd == client_sd)
+            {
+                pending_interest->interfaces[i].state = INTERFACE_STATE_CLOSED;
+            }
+            else
+            {
+                has_response_interface = 1;
+            }
+        }
+
+        // Se ainda houver outra interface à espera da resposta, a procura continua
+        if (!has_response_interface)
+        {
+            drop_pending_interest(node, pending_interest, client_sd);
+            METRIC_INC(node, METRIC_PIT_CANCELLED);
+            LOG_DEBUG("  Entrada da PIT para ID %u, nome %s cancelada.\n", interest_id, object_name);
         }
     }
     else
     {
-        fprintf(stderr, "Tipo de mensagem NDN desconhecido: %s\n", cmd);
+        LOG_WARN("Tipo de mensagem NDN desconhecido: %s\n", cmd);
     }
 }
\ No newline at end of file
@@ -7,27 +7,45 @@
 void init_pending_interests(NDNNode *node);
 void init_local_objects(NDNNode *node);
 void init_cache(NDNNode *node);
+void init_retrieves(NDNNode *node);
 
 // Funções para gerir objetos locais
-void create_local_object(NDNNode *node, const char *name);
-void delete_local_object(NDNNode *node, const char *name);
+int create_local_object(NDNNode *node, const char *name); // 0 se criado, -1 se recusado
+int delete_local_object(NDNNode *node, const char *name); // 0 se removido, -1 se não existe
 int has_local_object(NDNNode *node, const char *name); // Verifica se o nó possui o objeto
 
 // Funções para gerir cache
 void add_object_to_cache(NDNNode *node, const char *name);
 int has_cached_object(NDNNode *node, const char *name); // Verifica se o objeto está na cache
 
+// Procura uma entrada na PIT pelo par (identificador, nome); NULL se não existir
+PendingInterestEntry *find_pending_interest(NDNNode *node, unsigned char id, const char *name);
+
+// Chamada por remove_neighbor: as interfaces do vizinho passam a FECHADO. Uma entrada sem interfaces de
+// RESPOSTA é apagada; uma sem ramos em ESPERA tenta as interfaces que restam ou responde NOOBJECT.
+void pit_face_removed(NDNNode *node, int sd);
+
 // Funções para iniciar e processar a busca de objetos
-void initiate_retrieve(NDNNode *node, const char *object_name);              // Chamada pelo UI (comando retrieve)
+// Chamada por ndn_retrieve (flags: NDN_RETRIEVE_RING, NDN_RETRIEVE_TRACED; callback NULL: on_retrieve_done do nó)
+void begin_retrieve(NDNNode *node, const char *object_name, int flags, RetrieveCallback callback, void *ctx);
+
+// Temporizadores de retransmissão das pesquisas (chamadas pelo loop principal)
+long long retrieve_next_deadline_ms(NDNNode *node);
+void check_retrieve_timeouts(NDNNode *node);
 void process_ndn_message(NDNNode *node, int client_sd, const char *message); // Chamada pelo topology_protocol
 
-// Funções de envio de mensagens NDN
-void send_interest_message(int target_sd, unsigned char id, const char *name);
-void send_object_message(int target_sd, unsigned char id, const char *name);
-void send_noobject_message(int target_sd, unsigned char id, const char *name);
+// Funções de envio de mensagens NDN (trace_id: 0 se a pesquisa não é rastreada)
+void send_interest_message(NDNNode *node, int target_sd, unsigned char id, const char *name, int hop_limit,
+                           unsigned long long trace_id); // hop_limit: HOP_LIMIT_NONE se ilimitado
+void send_object_message(NDNNode *node, int target_sd, unsigned char id, const char *name, unsigned long long trace_id);
+void send_noobject_message(NDNNode *node, int target_sd, unsigned char id, const char *name, int scope_exhausted,
+                           unsigned long long trace_id);
+void send_cancel_message(NDNNode *node, int target_sd, unsigned char id, const char *name);
 
 // Funções de depuração e visualização para NDN
 void show_local_objects(NDNNode *node);
 void show_interest_table(NDNNode *node);
+void show_ring_stats(NDNNode *node);
+void show_retrieves(NDNNode *node);
 
 #endif // NDN_PROTOCOL_H
\ No newline at end of file
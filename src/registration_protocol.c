@@ -1,151 +1,1398 @@
 #include "registration_protocol.h"
-#include "topology_protocol.h" // Necessário para connect_to_node
+#include "topology_protocol.h" // Necessário para adopt_outgoing_connection
+#include "logger.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
 #include <unistd.h>
-#include <time.h> // Para srand, rand
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
 
-// Para a lógica de escolher um nó aleatoriamente
-static int nodes_count = 0;
-static char nodes_ip_list[MAX_NODES_PER_NET][MAX_IP_LEN]; // MAX_NODES_PER_NET deve ser definido ou usar um tamanho fixo
-static int nodes_port_list[MAX_NODES_PER_NET];            // MAX_NODES_PER_NET deve ser definido ou usar um tamanho fixo
+// --- Pedidos ao servidor de registo ---
+// Os pedidos seguem por UDP e podem perder-se. Cada pedido fica numa tabela até chegar a resposta e é
+// retransmitido com recuo exponencial pelos temporizadores do loop principal. O protocolo não tem
+// identificadores de pedido: a resposta corresponde ao pedido pendente do mesmo tipo (e da mesma rede,
+// quando a resposta a indica). O tag é um número de sequência local usado nas mensagens de diagnóstico.
 
-void send_reg_message(NDNNode *node, int net_id)
-{
-    char message[MAX_UDP_MSG_LEN];
-    snprintf(message, sizeof(message), "REG %03d %s %d", net_id, node->ip, node->tcp_port);
+static const char *reg_request_names[] = {"REG", "UNREG", "UPDATE", "NODES", "NODES (página)", "SUBSCRIBE"};
 
+static void send_to_reg_server(NDNNode *node, const char *message)
+{
+    if (node->transport)
+    {
+        node->transport->send_to_reg_server(node, message, node->transport->ctx);
+        return;
+    }
     ssize_t bytes_sent = sendto(node->udp_reg_sd, message, strlen(message), 0,
                                 (struct sockaddr *)&node->reg_server_addr, sizeof(node->reg_server_addr));
     if (bytes_sent == -1)
     {
-        perror("Erro ao enviar mensagem REG UDP");
+        fprintf(stderr, "Erro ao enviar mensagem UDP '%s': %s\n", message, strerror(errno));
+    }
+}
+
+// Envia um pedido e guarda-o até à resposta. Um pedido novo do mesmo tipo e rede substitui o anterior.
+// O pedido leva a etiqueta " #<tag>", que o servidor ecoa na resposta: uma resposta atrasada a um
+// pedido substituído não é confundida com a do pedido atual.
+static void send_reg_request(NDNNode *node, RegRequestType type, int net_id, const char *message)
+{
+    RegRequest *slot = NULL;
+    for (int i = 0; i < MAX_REG_REQUESTS; i++)
+    {
+        RegRequest *request = &node->reg_requests[i];
+        if (request->in_use && request->type == type && request->net_id == net_id)
+        {
+            slot = request;
+            break;
+        }
+        if (!slot && !request->in_use)
+        {
+            slot = request;
+        }
+    }
+    if (!slot)
+    {
+        // Tabela cheia: o pedido mais antigo deixa de ser retransmitido
+        slot = &node->reg_requests[0];
+        for (int i = 1; i < MAX_REG_REQUESTS; i++)
+        {
+            if (node->reg_requests[i].tag < slot->tag)
+            {
+                slot = &node->reg_requests[i];
+            }
+        }
+    }
+
+    slot->in_use = 1;
+    slot->type = type;
+    slot->net_id = net_id;
+    slot->tag = ++node->reg_next_tag;
+    snprintf(slot->message, sizeof(slot->message), "%s #%u", message, slot->tag);
+    slot->attempts = 1;
+    slot->rto_ms = REG_RTO_INITIAL_MS;
+    slot->next_retry_ms = ndn_now_ms() + slot->rto_ms;
+    send_to_reg_server(node, slot->message);
+}
+
+static RegRequest *find_reg_request(NDNNode *node, RegRequestType type, int net_id)
+{
+    for (int i = 0; i < MAX_REG_REQUESTS; i++)
+    {
+        RegRequest *request = &node->reg_requests[i];
+        if (request->in_use && request->type == type && (net_id == -1 || request->net_id == net_id))
+        {
+            return request;
+        }
+    }
+    return NULL;
+}
+
+// Marca o pedido como respondido (net_id -1: resposta sem rede). Devolve 0 se não havia pedido pendente,
+// ou seja, se a resposta é duplicada (de uma retransmissão) ou não foi pedida.
+static int complete_reg_request(NDNNode *node, RegRequestType type, int net_id)
+{
+    RegRequest *request = find_reg_request(node, type, net_id);
+    if (!request)
+    {
+        return 0;
+    }
+    request->in_use = 0;
+    return 1;
+}
+
+// Marca como respondido o pedido com a etiqueta ecoada pelo servidor (tag 0: resposta sem etiqueta,
+// de um servidor antigo, associada pelo tipo e pela rede). Devolve 0 se a resposta não é a do pedido
+// pendente.
+static int complete_reg_reply(NDNNode *node, RegRequestType type, int net_id, unsigned int tag)
+{
+    if (tag == 0)
+    {
+        return complete_reg_request(node, type, net_id);
+    }
+    for (int i = 0; i < MAX_REG_REQUESTS; i++)
+    {
+        RegRequest *request = &node->reg_requests[i];
+        if (request->in_use && request->type == type && request->tag == tag)
+        {
+            request->in_use = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Retira a etiqueta " #<tag>" do fim da primeira linha de uma resposta; devolve-a, ou 0 se não há
+static unsigned int strip_reply_tag(char *message)
+{
+    size_t line_len = strcspn(message, "\n");
+    char *hash = memchr(message, '#', line_len);
+    if (!hash || hash == message || hash[-1] != ' ')
+    {
+        return 0;
+    }
+    char *end;
+    unsigned long tag = strtoul(hash + 1, &end, 10);
+    if (end == hash + 1 || end != message + line_len || tag > UINT_MAX)
+    {
+        return 0;
+    }
+    memmove(hash - 1, end, strlen(end) + 1);
+    return (unsigned int)tag;
+}
+
+long long reg_request_next_deadline_ms(NDNNode *node)
+{
+    long long deadline = -1;
+    for (int i = 0; i < MAX_REG_REQUESTS; i++)
+    {
+        RegRequest *request = &node->reg_requests[i];
+        if (request->in_use && (deadline == -1 || request->next_retry_ms < deadline))
+        {
+            deadline = request->next_retry_ms;
+        }
+    }
+    return deadline;
+}
+
+static void give_up_reg_request(NDNNode *node, RegRequest *request);
+
+void check_reg_retransmissions(NDNNode *node)
+{
+    long long now_ms = ndn_now_ms();
+    for (int i = 0; i < MAX_REG_REQUESTS; i++)
+    {
+        RegRequest *request = &node->reg_requests[i];
+        if (!request->in_use || request->next_retry_ms > now_ms)
+        {
+            continue;
+        }
+        if (request->attempts >= REG_MAX_ATTEMPTS)
+        {
+            request->in_use = 0;
+            give_up_reg_request(node, request);
+            continue;
+        }
+        request->attempts++;
+        request->rto_ms = (request->rto_ms * 2 > REG_RTO_MAX_MS) ? REG_RTO_MAX_MS : request->rto_ms * 2;
+        request->next_retry_ms = now_ms + request->rto_ms;
+        printf("Sem resposta do servidor de registo ao pedido #%u (%s). Retransmissão %d de %d.\n",
+               request->tag, reg_request_names[request->type], request->attempts - 1, REG_MAX_ATTEMPTS - 1);
+        send_to_reg_server(node, request->message);
+    }
+}
+
+// Ao terminar: espera pela confirmação do UNREG (retransmitindo-o) durante no máximo timeout_ms
+void wait_for_unreg_confirmation(NDNNode *node, int timeout_ms)
+{
+    if (node->udp_reg_sd == -1)
+    {
+        return; // Nó simulado: as respostas do servidor chegam pelo simulador
+    }
+    long long deadline_ms = ndn_now_ms() + timeout_ms;
+    while (find_reg_request(node, REG_REQUEST_UNREG, -1))
+    {
+        long long now_ms = ndn_now_ms();
+        if (now_ms >= deadline_ms)
+        {
+            printf("Servidor de registo não confirmou a saída da rede.\n");
+            return;
+        }
+        long long wait_ms = reg_request_next_deadline_ms(node);
+        wait_ms = (wait_ms == -1 || wait_ms > deadline_ms) ? deadline_ms - now_ms : wait_ms - now_ms;
+        if (wait_ms < 0)
+        {
+            wait_ms = 0;
+        }
+
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(node->udp_reg_sd, &read_fds);
+        struct timeval timeout = {wait_ms / 1000, (wait_ms % 1000) * 1000};
+        if (select(node->udp_reg_sd + 1, &read_fds, NULL, NULL, &timeout) > 0)
+        {
+            char buffer[MAX_UDP_MSG_LEN];
+            ssize_t bytes_received = recvfrom(node->udp_reg_sd, buffer, sizeof(buffer) - 1, 0, NULL, NULL);
+            if (bytes_received > 0)
+            {
+                buffer[bytes_received] = '\0';
+                if (strncmp(buffer, "OKUNREG", 7) == 0) // O nó está a terminar: o resto já não interessa
+                {
+                    process_udp_registration_message(node, buffer);
+                }
+            }
+        }
+        check_reg_retransmissions(node);
+    }
+}
+
+// --- Última lista de nós (NODESLIST) recebida por rede ---
+// Ao voltar a entrar numa rede, uma lista recente permite começar logo as conexões enquanto o pedido
+// NODES segue para o servidor.
+
+static CachedNodesList *find_cached_nodes_list(NDNNode *node, int net_id)
+{
+    for (int i = 0; i < NODESLIST_CACHE_SIZE; i++)
+    {
+        if (node->nodes_cache[i].net_id == net_id)
+        {
+            return &node->nodes_cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void store_nodes_list(NDNNode *node, int net_id, const char *message)
+{
+    CachedNodesList *entry = find_cached_nodes_list(node, net_id);
+    if (!entry)
+    {
+        // Posição livre ou, se não houver, a lista mais antiga
+        entry = &node->nodes_cache[0];
+        for (int i = 1; i < NODESLIST_CACHE_SIZE && entry->net_id != -1; i++)
+        {
+            if (node->nodes_cache[i].net_id == -1 || node->nodes_cache[i].received_ms < entry->received_ms)
+            {
+                entry = &node->nodes_cache[i];
+            }
+        }
     }
+    entry->net_id = net_id;
+    entry->received_ms = ndn_now_ms();
+    strncpy(entry->message, message, sizeof(entry->message) - 1);
+    entry->message[sizeof(entry->message) - 1] = '\0';
+}
+
+// O REG e o UPDATE levam o grau e a profundidade do nó, que o servidor usa para recomendar
+// pontos de entrada (os servidores antigos ignoram os campos extra)
+void send_reg_message(NDNNode *node, int net_id)
+{
+    char message[MAX_UDP_MSG_LEN];
+    int degree = count_tree_neighbors(node);
+    snprintf(message, sizeof(message), "REG %03d %s %d %d %d", net_id, node->ip, node->tcp_port, degree, node->depth);
+    node->reported_degree = degree;
+    node->reported_depth = node->depth;
+    send_reg_request(node, REG_REQUEST_REG, net_id, message);
 }
 
 void send_unreg_message(NDNNode *node, int net_id)
 {
     char message[MAX_UDP_MSG_LEN];
     snprintf(message, sizeof(message), "UNREG %03d %s %d", net_id, node->ip, node->tcp_port);
+    node->reported_degree = -1;
+    node->reported_depth = -1;
+    node->lease_ttl_s = 0;
+    node->lease_refresh_ms = -1;
+    // Os pedidos ainda sem resposta deixam de fazer sentido fora da rede
+    complete_reg_request(node, REG_REQUEST_REG, -1);
+    complete_reg_request(node, REG_REQUEST_UPDATE, -1);
+    complete_reg_request(node, REG_REQUEST_NODES, -1);
+    send_reg_request(node, REG_REQUEST_UNREG, net_id, message);
+}
 
-    ssize_t bytes_sent = sendto(node->udp_reg_sd, message, strlen(message), 0,
-                                (struct sockaddr *)&node->reg_server_addr, sizeof(node->reg_server_addr));
-    if (bytes_sent == -1)
+void send_nodes_request_message(NDNNode *node, int net_id)
+{
+    char message[MAX_UDP_MSG_LEN];
+    snprintf(message, sizeof(message), "NODES %03d", net_id);
+    send_reg_request(node, REG_REQUEST_NODES, net_id, message);
+}
+
+void send_update_message(NDNNode *node, int net_id)
+{
+    char message[MAX_UDP_MSG_LEN];
+    int degree = count_tree_neighbors(node);
+    snprintf(message, sizeof(message), "UPDATE %03d %s %d %d %d", net_id, node->ip, node->tcp_port, degree, node->depth);
+    node->reported_degree = degree;
+    node->reported_depth = node->depth;
+    if (node->lease_ttl_s == 0)
     {
-        perror("Erro ao enviar mensagem UNREG UDP");
+        send_to_reg_server(node, message); // Servidor sem validade no OKREG: pode não responder ao UPDATE
+        return;
     }
+    send_reg_request(node, REG_REQUEST_UPDATE, net_id, message);
 }
 
-void send_nodes_request_message(NDNNode *node, int net_id)
+void report_node_state(NDNNode *node)
+{
+    // Só depois do REG (e não durante a saída, em que o nó já pediu UNREG)
+    if (node->reported_degree == -1 || node->current_net_id == -1 || node->is_leaving)
+    {
+        return;
+    }
+    if (node->reported_degree != count_tree_neighbors(node) || node->reported_depth != node->depth)
+    {
+        send_update_message(node, node->current_net_id);
+    }
+}
+
+// O servidor esquece os registos que não são renovados dentro da validade anunciada no OKREG.
+// O nó repete o REG várias vezes por período (o REG repetido só renova o registo, e volta a criá-lo
+// se o servidor o tiver perdido, por exemplo depois de reiniciar).
+static void schedule_lease_refresh(NDNNode *node)
+{
+    node->lease_refresh_ms = ndn_now_ms() + (long long)node->lease_ttl_s * 1000 / LEASE_REFRESHES_PER_TTL;
+}
+
+long long lease_next_deadline_ms(NDNNode *node)
+{
+    return node->lease_refresh_ms;
+}
+
+void check_lease_refresh(NDNNode *node)
+{
+    if (node->lease_refresh_ms == -1 || node->lease_refresh_ms > ndn_now_ms())
+    {
+        return;
+    }
+    if (node->reported_degree == -1 || node->current_net_id == -1 || node->is_leaving)
+    {
+        node->lease_refresh_ms = -1;
+        return;
+    }
+    send_reg_message(node, node->current_net_id);
+    if (node->member_cache_net != -1)
+    {
+        send_subscribe_message(node, node->member_cache_net); // A subscrição expira como o registo
+    }
+    schedule_lease_refresh(node); // Sem resposta, a próxima renovação é a nova tentativa
+}
+
+// --- Listagem completa dos membros de uma rede ---
+// O NODES simples devolve só os pontos de entrada recomendados. A lista completa pede-se por páginas
+// ("NODES <net> <cursor>", respondido com "NODESLIST <net> <cursor seguinte|-1> <total>"; o cursor,
+// opaco para o cliente, é a chave ip:porto do último nó recebido) ou, para redes grandes, de uma vez
+// pelo canal TCP do servidor de registo.
+
+static void send_nodes_page_request(NDNNode *node, int net_id, long long cursor)
 {
     char message[MAX_UDP_MSG_LEN];
-    snprintf(message, sizeof(message), "NODES %03d", net_id);
+    snprintf(message, sizeof(message), "NODES %03d %lld", net_id, cursor);
+    send_reg_request(node, REG_REQUEST_NODES_PAGE, net_id, message);
+}
 
-    ssize_t bytes_sent = sendto(node->udp_reg_sd, message, strlen(message), 0,
-                                (struct sockaddr *)&node->reg_server_addr, sizeof(node->reg_server_addr));
-    if (bytes_sent == -1)
+void request_network_members(NDNNode *node, int net_id)
+{
+    node->members_query_net = net_id;
+    node->members_received = 0;
+    printf("Membros da rede %03d:\n", net_id);
+    send_nodes_page_request(node, net_id, 0);
+}
+
+// Mostra as linhas "ip porto grau profundidade" de uma lista de membros; devolve quantas mostrou
+static int print_member_lines(const char *lines)
+{
+    int count = 0;
+    char ip_str[MAX_IP_LEN];
+    int port_num, degree, depth;
+    while (lines && sscanf(lines, "%15s %d %d %d", ip_str, &port_num, &degree, &depth) == 4)
     {
-        perror("Erro ao enviar mensagem NODES UDP");
+        printf("  %s:%d (grau %d, profundidade %d)\n", ip_str, port_num, degree, depth);
+        count++;
+        lines = strchr(lines, '\n');
+        if (lines)
+            lines++;
     }
+    return count;
 }
 
-void process_udp_registration_message(NDNNode *node, const char *message)
+// Página de NODESLIST recebida: mostra-a e pede a seguinte
+static void handle_nodes_page(NDNNode *node, int net_id, long long next_cursor, int total, const char *message)
 {
+    if (net_id != node->members_query_net)
+    {
+        return; // Resposta atrasada de uma listagem anterior
+    }
+    const char *lines = strchr(message, '\n');
+    node->members_received += print_member_lines(lines ? lines + 1 : NULL);
 
-    char cmd[20];
-    int net_id;
+    if (next_cursor != -1)
+    {
+        send_nodes_page_request(node, net_id, next_cursor);
+        return;
+    }
+    printf("  Total: %d membro(s)", node->members_received);
+    if (node->members_received != total)
+    {
+        printf(" (a rede mudou durante a listagem; o servidor indica %d)", total);
+    }
+    printf("\n");
+    node->members_query_net = -1;
+}
 
-    if (sscanf(message, "%s %d", cmd, &net_id) >= 1)
+// --- Consultas pelo canal TCP do servidor ---
+// Uma lista que não cabe num datagrama é pedida pelo canal TCP do servidor ("NODES <net>\n", com a
+// resposta a terminar no fecho da conexão). A consulta não bloqueia o nó: o connect() e a leitura
+// avançam no loop de eventos e a consulta é abandonada ao fim de REG_TCP_QUERY_TIMEOUT_MS.
+
+static void apply_member_cache_response(NDNNode *node, int net_id, const char *response);
+
+// Mostra a lista de membros de uma resposta TCP completa
+static void print_members_response(int net_id, const char *response)
+{
+    int total = 0;
+    if (sscanf(response, "NODESLIST %*d %*d %d", &total) != 1)
     {
-        if (strcmp(cmd, "OKREG") == 0)
+        printf("Resposta TCP mal formatada do servidor de registo.\n");
+        return;
+    }
+    printf("Membros da rede %03d (TCP):\n", net_id);
+    int count = print_member_lines(strchr(response, '\n') ? strchr(response, '\n') + 1 : NULL);
+    printf("  Total: %d de %d membro(s)\n", count, total);
+}
+
+// Começa uma consulta TCP (uma por finalidade e rede). Devolve 0 se ficou em curso, -1 se não pôde ser iniciada.
+static int start_reg_tcp_query(NDNNode *node, RegTcpQueryPurpose purpose, int net_id)
+{
+    if (node->transport)
+    {
+        printf("Consulta por TCP indisponível num nó simulado.\n");
+        return -1;
+    }
+    RegTcpQuery *query = NULL;
+    for (int i = 0; i < MAX_REG_TCP_QUERIES; i++)
+    {
+        if (node->reg_tcp_queries[i].in_use && node->reg_tcp_queries[i].purpose == purpose &&
+            node->reg_tcp_queries[i].net_id == net_id)
         {
-            printf("Servidor de registo confirmou o registo para rede %03d.\n", node->current_net_id);
+            return 0; // A mesma consulta já está em curso
         }
-        else if (strcmp(cmd, "OKUNREG") == 0)
+        if (!node->reg_tcp_queries[i].in_use && !query)
         {
-            printf("Servidor de registo confirmou a remoção do registo para rede %03d.\n", net_id);
+            query = &node->reg_tcp_queries[i];
         }
-        else if (strcmp(cmd, "NODESLIST") == 0)
+    }
+    if (!query)
+    {
+        printf("Demasiadas consultas TCP em curso. Tente mais tarde.\n");
+        return -1;
+    }
+
+    int sd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sd == -1)
+    {
+        perror("Erro ao criar socket TCP de consulta");
+        return -1;
+    }
+    fcntl(sd, F_SETFL, fcntl(sd, F_GETFL, 0) | O_NONBLOCK);
+    if (connect(sd, (struct sockaddr *)&node->reg_server_addr, sizeof(node->reg_server_addr)) == -1 && errno != EINPROGRESS)
+    {
+        perror("Erro ao conectar ao canal TCP do servidor de registo");
+        close(sd);
+        return -1;
+    }
+
+    query->in_use = 1;
+    query->purpose = purpose;
+    query->net_id = net_id;
+    query->sd = sd;
+    query->connected = 0; // O pedido é enviado quando o socket ficar pronto para escrita
+    query->response = NULL;
+    query->len = 0;
+    query->capacity = 0;
+    query->deadline_ms = ndn_now_ms() + REG_TCP_QUERY_TIMEOUT_MS;
+    return 0;
+}
+
+// Termina uma consulta; se a resposta chegou completa (ok), entrega-a à sua finalidade
+static void finish_reg_tcp_query(NDNNode *node, RegTcpQuery *query, int ok)
+{
+    RegTcpQueryPurpose purpose = query->purpose;
+    int net_id = query->net_id;
+    char *response = query->response;
+    close(query->sd);
+    query->response = NULL;
+    query->in_use = 0;
+
+    if (!ok || !response)
+    {
+        if (purpose == REG_TCP_QUERY_PRINT)
         {
-            printf("Lista de Nós recebida. Rede ID: %03d\n", net_id);
-            // Resetar a lista de nós temporária
-            nodes_count = 0;
+            printf("Falha na consulta TCP dos membros da rede %03d.\n", net_id);
+        }
+        else
+        {
+            LOG_INFO("Falha na consulta TCP dos membros da rede %03d (cache de membros).\n", net_id);
+        }
+    }
+    else if (purpose == REG_TCP_QUERY_PRINT)
+    {
+        print_members_response(net_id, response);
+    }
+    else
+    {
+        apply_member_cache_response(node, net_id, response);
+    }
+    free(response);
+}
 
-            char *line_start = strchr(message, '\n');
-            if (line_start)
+// Lê o que chegou de uma consulta. Devolve 1 se a consulta terminou (fecho da conexão ou erro).
+static int read_reg_tcp_query(NDNNode *node, RegTcpQuery *query)
+{
+    while (1)
+    {
+        if (query->capacity - query->len < 2)
+        {
+            size_t capacity = query->capacity ? query->capacity * 2 : MAX_UDP_MSG_LEN;
+            char *grown = realloc(query->response, capacity);
+            if (!grown)
             {
-                line_start++; // Pular o '\n'
-                char ip_str[MAX_IP_LEN];
-                int port_num;
-                while (nodes_count < MAX_NODES_PER_NET && sscanf(line_start, "%s %d", ip_str, &port_num) == 2)
-                {
-                    // Ignorar o próprio nó na lista
-                    if (!(strcmp(ip_str, node->ip) == 0 && port_num == node->tcp_port))
-                    {
-                        strncpy(nodes_ip_list[nodes_count], ip_str, MAX_IP_LEN - 1);
-                        nodes_ip_list[nodes_count][MAX_IP_LEN - 1] = '\0';
-                        nodes_port_list[nodes_count] = port_num;
-                        nodes_count++;
-                    }
-                    line_start = strchr(line_start, '\n');
-                    if (line_start)
-                        line_start++;
-                    else
-                        break;
-                }
+                finish_reg_tcp_query(node, query, 0);
+                return 1;
             }
+            query->response = grown;
+            query->capacity = capacity;
+        }
+        ssize_t n = read(query->sd, query->response + query->len, query->capacity - query->len - 1);
+        if (n > 0)
+        {
+            query->len += n;
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        {
+            return 0; // Por agora não há mais nada
+        }
+        query->response[query->len] = '\0';
+        finish_reg_tcp_query(node, query, n == 0);
+        return 1;
+    }
+}
 
-            if (nodes_count == 0)
+int reg_tcp_query_fill_fds(NDNNode *node, fd_set *read_fds, fd_set *write_fds, int max_fd)
+{
+    for (int i = 0; i < MAX_REG_TCP_QUERIES; i++)
+    {
+        RegTcpQuery *query = &node->reg_tcp_queries[i];
+        if (query->in_use)
+        {
+            FD_SET(query->sd, query->connected ? read_fds : write_fds);
+            if (query->sd > max_fd)
             {
-                send_reg_message(node, net_id);
+                max_fd = query->sd;
             }
-            else // nodes_count > 0
+        }
+    }
+    return max_fd;
+}
+
+void reg_tcp_query_handle_events(NDNNode *node, fd_set *read_fds, fd_set *write_fds)
+{
+    for (int i = 0; i < MAX_REG_TCP_QUERIES; i++)
+    {
+        RegTcpQuery *query = &node->reg_tcp_queries[i];
+        if (!query->in_use)
+        {
+            continue;
+        }
+        if (!query->connected && FD_ISSET(query->sd, write_fds))
+        {
+            // Conexão estabelecida (ou recusada): envia o pedido, que cabe sempre no buffer do socket
+            int so_error = 0;
+            socklen_t len = sizeof(so_error);
+            char request[32];
+            int request_len = snprintf(request, sizeof(request), "NODES %03d\n", query->net_id);
+            if (getsockopt(query->sd, SOL_SOCKET, SO_ERROR, &so_error, &len) == -1 || so_error != 0 ||
+                write(query->sd, request, request_len) != request_len)
             {
+                LOG_WARN("Erro na consulta TCP ao servidor de registo: %s\n", strerror(so_error ? so_error : errno));
+                finish_reg_tcp_query(node, query, 0);
+                continue;
+            }
+            query->connected = 1;
+        }
+        else if (query->connected && FD_ISSET(query->sd, read_fds))
+        {
+            read_reg_tcp_query(node, query);
+        }
+    }
+}
 
-                srand(time(NULL)); // Inicializar o gerador de números aleatórios
-                int random_idx = rand() % nodes_count;
+long long reg_tcp_query_next_deadline_ms(NDNNode *node)
+{
+    long long deadline = -1;
+    for (int i = 0; i < MAX_REG_TCP_QUERIES; i++)
+    {
+        if (node->reg_tcp_queries[i].in_use && (deadline == -1 || node->reg_tcp_queries[i].deadline_ms < deadline))
+        {
+            deadline = node->reg_tcp_queries[i].deadline_ms;
+        }
+    }
+    return deadline;
+}
 
-                char *target_ip = nodes_ip_list[random_idx];
-                int target_port = nodes_port_list[random_idx];
+void check_reg_tcp_query_timeouts(NDNNode *node)
+{
+    long long now_ms = ndn_now_ms();
+    for (int i = 0; i < MAX_REG_TCP_QUERIES; i++)
+    {
+        RegTcpQuery *query = &node->reg_tcp_queries[i];
+        if (query->in_use && query->deadline_ms <= now_ms)
+        {
+            LOG_WARN("Consulta TCP da rede %03d sem resposta completa do servidor em %d ms.\n", query->net_id,
+                     REG_TCP_QUERY_TIMEOUT_MS);
+            finish_reg_tcp_query(node, query, 0);
+        }
+    }
+}
 
+void cancel_reg_tcp_queries(NDNNode *node)
+{
+    for (int i = 0; i < MAX_REG_TCP_QUERIES; i++)
+    {
+        RegTcpQuery *query = &node->reg_tcp_queries[i];
+        if (query->in_use)
+        {
+            close(query->sd);
+            free(query->response);
+            query->response = NULL;
+            query->in_use = 0;
+        }
+    }
+}
 
-                // Determina se este é o cenário de 2 nós (apenas um outro nó na lista)
-                // O is_two_node_network_scenario é usado aqui para decidir o tipo de vizinho.
-                int is_two_node_network_scenario = (nodes_count == 1);
+void query_network_members_tcp(NDNNode *node, int net_id)
+{
+    if (start_reg_tcp_query(node, REG_TCP_QUERY_PRINT, net_id) == 0)
+    {
+        printf("Consulta TCP dos membros da rede %03d enviada.\n", net_id);
+    }
+}
 
-                int connected_sd = connect_to_node(node, target_ip, target_port);
-                if (connected_sd != -1)
-                {
-                    printf("  Conectado ao nó %s:%d. Registrando-se na rede %03d.\n", target_ip, target_port, net_id);
-
-                    // Se este é o cenário de 2 nós, classifique o vizinho recém-conectado como EXTERNAL_AND_INTERNAL
-                    if (is_two_node_network_scenario)
-                    {
-                        Neighbor *just_connected_neighbor = find_neighbor_by_sd(node, connected_sd);
-                        if (just_connected_neighbor)
-                        {
-                            just_connected_neighbor->type = NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL;
-                           
-                        }
-                    }
-                    send_reg_message(node, net_id);
-                }
-                else
+// --- Cache de membros da rede ---
+// Depois do registo, o nó subscreve as alterações de membros da sua rede. O servidor responde com a
+// lista ("MEMBERS <net> <seq> <total>" e as linhas) e envia depois cada entrada e saída
+// ("JOINED|LEFT <net> <seq> <ip> <porto>"). As alterações aplicam-se por ordem de seq; uma falha na
+// sequência leva a nova sincronização. A cache permite reparar a topologia sem pedir NODES.
+
+void send_subscribe_message(NDNNode *node, int net_id)
+{
+    char message[MAX_UDP_MSG_LEN];
+    snprintf(message, sizeof(message), "SUBSCRIBE %03d", net_id);
+    send_reg_request(node, REG_REQUEST_SUBSCRIBE, net_id, message);
+}
+
+void subscribe_members(NDNNode *node, int net_id)
+{
+    node->member_cache_net = net_id;
+    node->member_cache_seq = 0; // Por sincronizar até chegar o MEMBERS
+    node->num_cached_members = 0;
+    send_subscribe_message(node, net_id);
+}
+
+void unsubscribe_members(NDNNode *node)
+{
+    if (node->member_cache_net == -1)
+    {
+        return;
+    }
+    char message[MAX_UDP_MSG_LEN];
+    snprintf(message, sizeof(message), "UNSUBSCRIBE %03d", node->member_cache_net);
+    send_to_reg_server(node, message); // Sem confirmação: a subscrição expira de qualquer forma
+    complete_reg_request(node, REG_REQUEST_SUBSCRIBE, -1);
+    node->member_cache_net = -1;
+    node->member_cache_seq = 0;
+    node->num_cached_members = 0;
+}
+
+static int find_cached_member(NDNNode *node, const char *ip, int tcp_port)
+{
+    for (int i = 0; i < node->num_cached_members; i++)
+    {
+        if (strcmp(node->member_cache[i].ip, ip) == 0 && node->member_cache[i].tcp_port == tcp_port)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void add_cached_member(NDNNode *node, const char *ip, int tcp_port)
+{
+    if (find_cached_member(node, ip, tcp_port) != -1)
+    {
+        return;
+    }
+    if (node->num_cached_members == MAX_NODES_PER_NET)
+    {
+        node->member_cache_complete = 0;
+        return;
+    }
+    MemberEntry *member = &node->member_cache[node->num_cached_members++];
+    strncpy(member->ip, ip, MAX_IP_LEN - 1);
+    member->ip[MAX_IP_LEN - 1] = '\0';
+    member->tcp_port = tcp_port;
+}
+
+static void remove_cached_member(NDNNode *node, const char *ip, int tcp_port)
+{
+    int i = find_cached_member(node, ip, tcp_port);
+    if (i != -1)
+    {
+        node->member_cache[i] = node->member_cache[--node->num_cached_members];
+    }
+}
+
+// Substitui a cache pelas linhas "ip porto ..." de uma lista completa com o seq indicado
+static void load_member_cache(NDNNode *node, unsigned long long seq, int total, const char *lines)
+{
+    node->num_cached_members = 0;
+    node->member_cache_complete = 1;
+    char ip[MAX_IP_LEN];
+    int tcp_port;
+    while (lines && *lines && sscanf(lines, "%15s %d", ip, &tcp_port) == 2)
+    {
+        add_cached_member(node, ip, tcp_port);
+        lines = strchr(lines, '\n');
+        if (lines)
+            lines++;
+    }
+    if (node->num_cached_members < total)
+    {
+        node->member_cache_complete = 0;
+    }
+    node->member_cache_seq = seq;
+}
+
+// Lista completa e o seq correspondente pelo canal TCP (redes que não cabem num datagrama). A cache é
+// substituída se a lista for mais recente ou se a cache com o mesmo seq ficou incompleta.
+static void apply_member_cache_response(NDNNode *node, int net_id, const char *response)
+{
+    int total;
+    unsigned long long seq;
+    if (net_id == node->member_cache_net && sscanf(response, "NODESLIST %*d %*d %d %llu", &total, &seq) == 2 &&
+        (seq > node->member_cache_seq || (seq == node->member_cache_seq && !node->member_cache_complete)))
+    {
+        load_member_cache(node, seq, total, strchr(response, '\n') ? strchr(response, '\n') + 1 : NULL);
+    }
+}
+
+static void handle_members_list(NDNNode *node, int net_id, const char *message)
+{
+    unsigned long long seq;
+    int total;
+    if (net_id != node->member_cache_net || sscanf(message, "MEMBERS %*d %llu %d", &seq, &total) != 2)
+    {
+        return;
+    }
+    if (seq < node->member_cache_seq || (seq == node->member_cache_seq && node->member_cache_complete))
+    {
+        return; // Resposta atrasada ou cache já atualizada (renovação da subscrição)
+    }
+    const char *lines = strchr(message, '\n');
+    load_member_cache(node, seq, total, lines ? lines + 1 : NULL);
+    if (!node->member_cache_complete && total <= MAX_NODES_PER_NET)
+    {
+        start_reg_tcp_query(node, REG_TCP_QUERY_MEMBER_CACHE, net_id); // A lista não coube no datagrama
+    }
+}
+
+static void handle_member_delta(NDNNode *node, int joined, int net_id, const char *message)
+{
+    unsigned long long seq;
+    char ip[MAX_IP_LEN];
+    int tcp_port;
+    if (net_id != node->member_cache_net || node->member_cache_seq == 0 ||
+        sscanf(message, "%*s %*d %llu %15s %d", &seq, ip, &tcp_port) != 3 || seq <= node->member_cache_seq)
+    {
+        return; // Outra rede, cache por sincronizar ou alteração já incluída
+    }
+    if (seq != node->member_cache_seq + 1)
+    {
+        // Perdeu-se pelo menos uma alteração: pedir de novo a lista
+        LOG_INFO("Alterações de membros da rede %03d em falta (seq %llu, esperado %llu). A sincronizar.\n",
+                 net_id, seq, node->member_cache_seq + 1);
+        send_subscribe_message(node, net_id);
+        return;
+    }
+    if (joined)
+    {
+        add_cached_member(node, ip, tcp_port);
+    }
+    else
+    {
+        remove_cached_member(node, ip, tcp_port);
+    }
+    node->member_cache_seq = seq;
+}
+
+void show_member_cache(NDNNode *node)
+{
+    if (node->member_cache_net == -1)
+    {
+        printf("  Sem subscrição de membros (o nó não está registado numa rede).\n");
+        return;
+    }
+    if (node->member_cache_seq == 0)
+    {
+        printf("  Membros da rede %03d: a sincronizar.\n", node->member_cache_net);
+        return;
+    }
+    printf("  Membros da rede %03d (seq %llu%s):\n", node->member_cache_net, node->member_cache_seq,
+           node->member_cache_complete ? "" : ", incompleta");
+    for (int i = 0; i < node->num_cached_members; i++)
+    {
+        printf("    %s:%d%s\n", node->member_cache[i].ip, node->member_cache[i].tcp_port,
+               (strcmp(node->member_cache[i].ip, node->ip) == 0 && node->member_cache[i].tcp_port == node->tcp_port) ? " (este nó)" : "");
+    }
+    printf("  Total: %d membro(s)\n", node->num_cached_members);
+}
+
+// --- Entrada na rede com conexões paralelas ---
+// Em vez de uma conexão bloqueante a um único nó aleatório, são abertas até
+// JOIN_PARALLEL_CANDIDATES conexões não bloqueantes; o primeiro candidato a responder
+// (menor RTT) fica como vizinho externo e os restantes são fechados. Se todo o lote
+// falhar ou expirar, passa-se ao lote seguinte da lista de candidatos.
+
+void init_join(NDNNode *node)
+{
+    node->join_num_candidates = 0;
+    node->join_net_id = -1;
+    node->join_in_progress = 0;
+    node->join_two_node = 0;
+    node->join_deadline_ms = -1;
+    node->join_from_cache = 0;
+    node->join_list_ms = -1;
+}
+
+// Fecha as conexões ainda em curso; os candidatos voltam a "não tentado" (não se provou que falharam)
+static void close_connecting_candidates(NDNNode *node)
+{
+    for (int i = 0; i < node->join_num_candidates; i++)
+    {
+        JoinCandidate *candidate = &node->join_candidates[i];
+        if (candidate->state == JOIN_CANDIDATE_CONNECTING)
+        {
+            close(candidate->sd);
+            candidate->sd = -1;
+            candidate->state = JOIN_CANDIDATE_UNTRIED;
+        }
+    }
+}
+
+// Ordem de preferência da lista de recurso: alcançáveis por RTT crescente, depois não tentados, por fim os que falharam
+static int join_candidate_rank(const JoinCandidate *candidate)
+{
+    switch (candidate->state)
+    {
+    case JOIN_CANDIDATE_REACHABLE:
+        return 0;
+    case JOIN_CANDIDATE_UNTRIED:
+    case JOIN_CANDIDATE_CONNECTING:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+static void rank_join_candidates(NDNNode *node)
+{
+    for (int i = 1; i < node->join_num_candidates; i++)
+    {
+        JoinCandidate key = node->join_candidates[i];
+        int j = i - 1;
+        while (j >= 0 && (join_candidate_rank(&node->join_candidates[j]) > join_candidate_rank(&key) ||
+                          (join_candidate_rank(&node->join_candidates[j]) == 0 && join_candidate_rank(&key) == 0 &&
+                           node->join_candidates[j].rtt_us > key.rtt_us)))
+        {
+            node->join_candidates[j + 1] = node->join_candidates[j];
+            j--;
+        }
+        node->join_candidates[j + 1] = key;
+    }
+}
+
+static int start_join_from_list(NDNNode *node, int net_id, const char *message, int from_cache);
+
+static void fail_join(NDNNode *node)
+{
+    close_connecting_candidates(node);
+    node->join_in_progress = 0;
+    node->join_deadline_ms = -1;
+    if (node->join_from_cache)
+    {
+        // A lista em cache podia estar desatualizada: esperar pela do servidor, ou usá-la se já chegou
+        node->join_from_cache = 0;
+        if (find_reg_request(node, REG_REQUEST_NODES, node->join_net_id))
+        {
+            printf("  Nenhum nó da lista em cache respondeu. A aguardar a lista do servidor de registo.\n");
+            return;
+        }
+        CachedNodesList *cached = find_cached_nodes_list(node, node->join_net_id);
+        if (cached && cached->received_ms != node->join_list_ms &&
+            start_join_from_list(node, node->join_net_id, cached->message, 0))
+        {
+            return;
+        }
+    }
+    fprintf(stderr, "  Falha ao conectar a qualquer nó da rede %03d. Entrada na rede cancelada.\n", node->join_net_id);
+    node->current_net_id = -1;
+}
+
+static void start_join_batch(NDNNode *node);
+
+// Verifica se a entrada na rede ainda é desejada; se o utilizador saiu entretanto, abandona-a
+static int join_still_wanted(NDNNode *node)
+{
+    if (node->current_net_id == node->join_net_id)
+    {
+        return 1;
+    }
+    close_connecting_candidates(node);
+    node->join_in_progress = 0;
+    node->join_deadline_ms = -1;
+    return 0;
+}
+
+// O candidato respondeu primeiro: fica como vizinho externo e o nó regista-se na rede
+static void finish_join(NDNNode *node, JoinCandidate *winner)
+{
+    int sd = winner->sd;
+    winner->sd = -1;
+    winner->rtt_us = ndn_now_us() - winner->started_us;
+    winner->state = JOIN_CANDIDATE_REACHABLE;
+
+    close_connecting_candidates(node);
+    node->join_deadline_ms = -1;
+
+    // O resto do protocolo usa sockets bloqueantes
+    int flags = fcntl(sd, F_GETFL, 0);
+    fcntl(sd, F_SETFL, flags & ~O_NONBLOCK);
+
+    char target_ip[MAX_IP_LEN];
+    strcpy(target_ip, winner->ip);
+    int target_port = winner->tcp_port;
+    double rtt_ms = winner->rtt_us / 1000.0;
+    rank_join_candidates(node);
+
+    int connected_sd = adopt_outgoing_connection(node, target_ip, target_port, sd);
+    if (connected_sd == -1)
+    {
+        // Não foi possível adotar a conexão: tentar o próximo da lista
+        for (int i = 0; i < node->join_num_candidates; i++)
+        {
+            if (strcmp(node->join_candidates[i].ip, target_ip) == 0 && node->join_candidates[i].tcp_port == target_port)
+            {
+                node->join_candidates[i].state = JOIN_CANDIDATE_FAILED;
+            }
+        }
+        start_join_batch(node);
+        return;
+    }
+
+    node->join_in_progress = 0;
+    complete_reg_request(node, REG_REQUEST_NODES, node->join_net_id); // A lista do servidor já não é precisa
+    printf("  Conectado ao nó %s:%d (%.1f ms). Registrando-se na rede %03d.\n", target_ip, target_port, rtt_ms, node->join_net_id);
+
+    // Se este é o cenário de 2 nós, classifique o vizinho recém-conectado como EXTERNAL_AND_INTERNAL
+    if (node->join_two_node)
+    {
+        Neighbor *just_connected_neighbor = find_neighbor_by_sd(node, connected_sd);
+        if (just_connected_neighbor)
+        {
+            just_connected_neighbor->type = NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL;
+        }
+    }
+    send_reg_message(node, node->join_net_id);
+}
+
+// Abre conexões não bloqueantes para os próximos candidatos ainda não tentados
+static void start_join_batch(NDNNode *node)
+{
+    int opened = 0;
+    for (int i = 0; i < node->join_num_candidates && opened < JOIN_PARALLEL_CANDIDATES; i++)
+    {
+        JoinCandidate *candidate = &node->join_candidates[i];
+        if (candidate->state != JOIN_CANDIDATE_UNTRIED)
+        {
+            continue;
+        }
+
+        // Já é vizinho (p. ex. depois de um direct join): não é preciso nova conexão
+        if (find_neighbor_by_addr(node, candidate->ip, candidate->tcp_port))
+        {
+            close_connecting_candidates(node);
+            node->join_in_progress = 0;
+            node->join_deadline_ms = -1;
+            complete_reg_request(node, REG_REQUEST_NODES, node->join_net_id);
+            printf("  Já conectado ao nó %s:%d. Registrando-se na rede %03d.\n", candidate->ip, candidate->tcp_port, node->join_net_id);
+            send_reg_message(node, node->join_net_id);
+            return;
+        }
+
+        if (node->transport)
+        {
+            // Nó simulado: a conexão é estabelecida de imediato pelo transporte
+            candidate->started_us = ndn_now_us();
+            candidate->sd = node->transport->connect_node(node, candidate->ip, candidate->tcp_port, node->transport->ctx);
+            if (candidate->sd != -1)
+            {
+                finish_join(node, candidate);
+                return;
+            }
+            candidate->state = JOIN_CANDIDATE_FAILED;
+            continue;
+        }
+
+        struct sockaddr_in target_addr;
+        memset(&target_addr, 0, sizeof(target_addr));
+        target_addr.sin_family = AF_INET;
+        target_addr.sin_port = htons(candidate->tcp_port);
+        if (inet_pton(AF_INET, candidate->ip, &target_addr.sin_addr) <= 0)
+        {
+            candidate->state = JOIN_CANDIDATE_FAILED;
+            continue;
+        }
+
+        int sd = socket(AF_INET, SOCK_STREAM, 0);
+        if (sd == -1)
+        {
+            perror("Erro ao criar socket cliente TCP");
+            break;
+        }
+        fcntl(sd, F_SETFL, fcntl(sd, F_GETFL, 0) | O_NONBLOCK);
+
+        candidate->sd = sd;
+        candidate->started_us = ndn_now_us();
+        if (connect(sd, (struct sockaddr *)&target_addr, sizeof(target_addr)) == 0)
+        {
+            // Conexão imediata (comum em loopback): é o vencedor
+            finish_join(node, candidate);
+            return;
+        }
+        if (errno != EINPROGRESS)
+        {
+            fprintf(stderr, "  Falha ao conectar ao nó %s:%d: %s\n", candidate->ip, candidate->tcp_port, strerror(errno));
+            close(sd);
+            candidate->sd = -1;
+            candidate->state = JOIN_CANDIDATE_FAILED;
+            continue;
+        }
+        candidate->state = JOIN_CANDIDATE_CONNECTING;
+        opened++;
+    }
+
+    if (opened == 0)
+    {
+        fail_join(node);
+        return;
+    }
+    node->join_deadline_ms = ndn_now_ms() + JOIN_CONNECT_TIMEOUT_MS;
+}
+
+// Adiciona ao conjunto de escrita do select os sockets com connect() em curso
+int join_fill_write_fds(NDNNode *node, fd_set *write_fds, int max_fd)
+{
+    if (!node->join_in_progress)
+    {
+        return max_fd;
+    }
+    for (int i = 0; i < node->join_num_candidates; i++)
+    {
+        if (node->join_candidates[i].state == JOIN_CANDIDATE_CONNECTING)
+        {
+            FD_SET(node->join_candidates[i].sd, write_fds);
+            if (node->join_candidates[i].sd > max_fd)
+            {
+                max_fd = node->join_candidates[i].sd;
+            }
+        }
+    }
+    return max_fd;
+}
+
+// Um socket em connect() ficou pronto para escrita: a conexão terminou (com sucesso ou erro)
+void join_handle_writable(NDNNode *node, fd_set *write_fds)
+{
+    if (!node->join_in_progress || !join_still_wanted(node))
+    {
+        return;
+    }
+
+    for (int i = 0; i < node->join_num_candidates; i++)
+    {
+        JoinCandidate *candidate = &node->join_candidates[i];
+        if (candidate->state != JOIN_CANDIDATE_CONNECTING || !FD_ISSET(candidate->sd, write_fds))
+        {
+            continue;
+        }
+
+        int so_error = 0;
+        socklen_t len = sizeof(so_error);
+        if (getsockopt(candidate->sd, SOL_SOCKET, SO_ERROR, &so_error, &len) == -1 || so_error != 0)
+        {
+            fprintf(stderr, "  Falha ao conectar ao nó %s:%d: %s\n", candidate->ip, candidate->tcp_port, strerror(so_error));
+            close(candidate->sd);
+            candidate->sd = -1;
+            candidate->state = JOIN_CANDIDATE_FAILED;
+            continue;
+        }
+
+        finish_join(node, candidate);
+        return;
+    }
+
+    // Se todo o lote falhou, passar já ao seguinte em vez de esperar pela expiração
+    for (int i = 0; i < node->join_num_candidates; i++)
+    {
+        if (node->join_candidates[i].state == JOIN_CANDIDATE_CONNECTING)
+        {
+            return;
+        }
+    }
+    start_join_batch(node);
+}
+
+long long join_next_deadline_ms(NDNNode *node)
+{
+    return node->join_in_progress ? node->join_deadline_ms : -1;
+}
+
+// Os candidatos que não responderam dentro do prazo são dados como falhados
+void check_join_timeouts(NDNNode *node)
+{
+    if (!node->join_in_progress || node->join_deadline_ms > ndn_now_ms() || !join_still_wanted(node))
+    {
+        return;
+    }
+    for (int i = 0; i < node->join_num_candidates; i++)
+    {
+        JoinCandidate *candidate = &node->join_candidates[i];
+        if (candidate->state == JOIN_CANDIDATE_CONNECTING)
+        {
+            fprintf(stderr, "  Nó %s:%d não respondeu em %d ms.\n", candidate->ip, candidate->tcp_port, JOIN_CONNECT_TIMEOUT_MS);
+            close(candidate->sd);
+            candidate->sd = -1;
+            candidate->state = JOIN_CANDIDATE_FAILED;
+        }
+    }
+    start_join_batch(node);
+}
+
+// Começa a entrada na rede com os nós de uma NODESLIST (do servidor ou da cache). Devolve 0 se a lista
+// da cache não tem candidatos.
+static int start_join_from_list(NDNNode *node, int net_id, const char *message, int from_cache)
+{
+    CachedNodesList *cached = find_cached_nodes_list(node, net_id);
+    long long list_ms = cached ? cached->received_ms : -1;
+
+    // A lista de candidatos é reconstruída a cada NODESLIST. Se todas as linhas trazem
+    // grau e profundidade, a lista vem ordenada pelo servidor e essa ordem é mantida.
+    node->join_num_candidates = 0;
+    int ranked = 1;
+
+    char *line_start = strchr(message, '\n');
+    if (line_start)
+    {
+        line_start++; // Pular o '\n'
+        char ip_str[MAX_IP_LEN];
+        int port_num, degree, depth;
+        int fields;
+        while (node->join_num_candidates < MAX_NODES_PER_NET &&
+               (fields = sscanf(line_start, "%15s %d %d %d", ip_str, &port_num, &degree, &depth)) >= 2)
+        {
+            if (fields < 4)
+            {
+                ranked = 0;
+            }
+            // Ignorar o próprio nó na lista
+            if (!(strcmp(ip_str, node->ip) == 0 && port_num == node->tcp_port))
+            {
+                JoinCandidate *candidate = &node->join_candidates[node->join_num_candidates];
+                strncpy(candidate->ip, ip_str, MAX_IP_LEN - 1);
+                candidate->ip[MAX_IP_LEN - 1] = '\0';
+                candidate->tcp_port = port_num;
+                candidate->sd = -1;
+                candidate->state = JOIN_CANDIDATE_UNTRIED;
+                candidate->rtt_us = 0;
+                node->join_num_candidates++;
+            }
+            line_start = strchr(line_start, '\n');
+            if (line_start)
+                line_start++;
+            else
+                break;
+        }
+    }
+
+    if (node->join_num_candidates == 0)
+    {
+        if (from_cache)
+        {
+            return 0; // Uma lista antiga vazia não chega para criar a rede sozinho: esperar pela do servidor
+        }
+        send_reg_message(node, net_id);
+    }
+    else
+    {
+        // Lista sem recomendação: ordem aleatória. Os lotes de conexões paralelas seguem esta ordem.
+        for (int i = node->join_num_candidates - 1; !ranked && i > 0; i--)
+        {
+            int j = rand() % (i + 1);
+            JoinCandidate tmp = node->join_candidates[i];
+            node->join_candidates[i] = node->join_candidates[j];
+            node->join_candidates[j] = tmp;
+        }
+
+        // Determina se este é o cenário de 2 nós (apenas um outro nó na lista)
+        // O join_two_node é usado aqui para decidir o tipo de vizinho.
+        node->join_two_node = (node->join_num_candidates == 1);
+        node->join_net_id = net_id;
+        node->join_in_progress = 1;
+        node->join_from_cache = from_cache;
+        node->join_list_ms = list_ms;
+        start_join_batch(node);
+    }
+    return 1;
+}
+
+// Entra na rede: pede a NODESLIST ao servidor e, se houver uma lista recente desta rede, começa já as
+// conexões com ela. A resposta do servidor só é usada se a lista em cache não levar a nenhum nó.
+void join_network(NDNNode *node, int net_id)
+{
+    send_nodes_request_message(node, net_id);
+    CachedNodesList *cached = find_cached_nodes_list(node, net_id);
+    if (cached && ndn_now_ms() - cached->received_ms < NODESLIST_CACHE_MAX_AGE_MS && !node->join_in_progress)
+    {
+        printf("A usar a lista de nós da rede %03d recebida há %lld ms.\n", net_id, ndn_now_ms() - cached->received_ms);
+        start_join_from_list(node, net_id, cached->message, 1);
+    }
+}
+
+// O servidor não respondeu a nenhuma das tentativas
+static void give_up_reg_request(NDNNode *node, RegRequest *request)
+{
+    fprintf(stderr, "Servidor de registo não respondeu ao pedido #%u (%s) após %d tentativas.\n",
+            request->tag, reg_request_names[request->type], REG_MAX_ATTEMPTS);
+    switch (request->type)
+    {
+    case REG_REQUEST_NODES:
+        if (node->join_in_progress || node->current_net_id != request->net_id)
+        {
+            return; // Entrada em curso com a lista em cache, ou já abandonada
+        }
+        {
+            // Último recurso: uma lista antiga desta rede, mesmo fora da validade
+            CachedNodesList *cached = find_cached_nodes_list(node, request->net_id);
+            if (cached)
+            {
+                printf("  A tentar entrar na rede %03d com a última lista conhecida.\n", request->net_id);
+                if (start_join_from_list(node, request->net_id, cached->message, 1))
+                {
+                    return;
+                }
+            }
+        }
+        fprintf(stderr, "  Entrada na rede %03d cancelada.\n", request->net_id);
+        node->current_net_id = -1;
+        break;
+    case REG_REQUEST_NODES_PAGE:
+        if (node->members_query_net == request->net_id)
+        {
+            printf("  Listagem interrompida após %d membro(s).\n", node->members_received);
+            node->members_query_net = -1;
+        }
+        break;
+    default:
+        break; // REG e SUBSCRIBE repetem-se na renovação; o UPDATE volta a ser enviado na próxima alteração
+    }
+}
+
+void process_udp_registration_message(NDNNode *node, const char *received)
+{
+    char message[MAX_UDP_MSG_LEN];
+    snprintf(message, sizeof(message), "%s", received);
+    unsigned int tag = strip_reply_tag(message);
+
+    char cmd[20];
+    int net_id;
+
+    if (sscanf(message, "%s %d", cmd, &net_id) >= 1)
+    {
+        if (strcmp(cmd, "OKREG") == 0)
+        {
+            complete_reg_reply(node, REG_REQUEST_REG, -1, tag);
+            // "OKREG <validade>": o registo tem de ser renovado (servidores antigos enviam só "OKREG")
+            int ttl_s;
+            int first = (node->lease_ttl_s == 0);
+            if (sscanf(message, "OKREG %d", &ttl_s) == 1 && ttl_s > 0 && node->reported_degree != -1)
+            {
+                node->lease_ttl_s = ttl_s;
+                schedule_lease_refresh(node);
+            }
+            if (first)
+            {
+                printf("Servidor de registo confirmou o registo para rede %03d.\n", node->current_net_id);
+            }
+            if (node->member_cache_net != node->current_net_id && node->current_net_id != -1 && node->lease_ttl_s > 0)
+            {
+                subscribe_members(node, node->current_net_id); // Servidores sem validade também não têm subscrições
+            }
+        }
+        else if (strcmp(cmd, "OKUNREG") == 0)
+        {
+            if (complete_reg_reply(node, REG_REQUEST_UNREG, -1, tag))
+            {
+                printf("Servidor de registo confirmou a remoção do registo para rede %03d.\n", net_id);
+            }
+        }
+        else if (strcmp(cmd, "OKUPDATE") == 0)
+        {
+            complete_reg_reply(node, REG_REQUEST_UPDATE, -1, tag); // Atualização de grau/profundidade: nada a mostrar
+        }
+        else if (strcmp(cmd, "OKUNSUBSCRIBE") == 0)
+        {
+            // Fim da subscrição: nada a mostrar
+        }
+        else if (strcmp(cmd, "MEMBERS") == 0)
+        {
+            complete_reg_reply(node, REG_REQUEST_SUBSCRIBE, net_id, tag);
+            handle_members_list(node, net_id, message);
+        }
+        else if (strcmp(cmd, "JOINED") == 0 || strcmp(cmd, "LEFT") == 0)
+        {
+            handle_member_delta(node, strcmp(cmd, "JOINED") == 0, net_id, message);
+        }
+        else if (strcmp(cmd, "NODESLIST") == 0)
+        {
+            // Página da lista completa de membros (cabeçalho com cursor e total)
+            char header[64];
+            size_t header_len = strcspn(message, "\n");
+            if (header_len >= sizeof(header))
+                header_len = sizeof(header) - 1;
+            memcpy(header, message, header_len);
+            header[header_len] = '\0';
+            long long next_cursor;
+            int total;
+            if (sscanf(header, "%*s %*d %lld %d", &next_cursor, &total) == 2)
+            {
+                if (complete_reg_reply(node, REG_REQUEST_NODES_PAGE, net_id, tag))
                 {
-                    fprintf(stderr, "  Falha ao conectar ao nó %s:%d. Tentando outro ou falhando o join.\n", target_ip, target_port);
-                    node->current_net_id = -1;
+                    handle_nodes_page(node, net_id, next_cursor, total, message);
                 }
+                return;
+            }
+
+            store_nodes_list(node, net_id, message);
+            if (!complete_reg_reply(node, REG_REQUEST_NODES, net_id, tag))
+            {
+                return; // Resposta repetida (retransmissão), ou a entrada já foi feita com a lista em cache
+            }
+            printf("Lista de Nós recebida. Rede ID: %03d\n", net_id);
+            if (node->join_in_progress)
+            {
+                printf("  Entrada na rede já em curso. Lista ignorada.\n");
+                return;
             }
+            start_join_from_list(node, net_id, message, 0);
         }
         else
         {
-            printf("Mensagem UDP desconhecida ou mal formatada: %s\n", message);
+            LOG_WARN("Mensagem UDP desconhecida ou mal formatada: %s\n", message);
         }
     }
     else
     {
-        printf("Mensagem UDP incompleta ou mal formatada: %s\n", message);
+        LOG_WARN("Mensagem UDP incompleta ou mal formatada: %s\n", message);
     }
 }
\ No newline at end of file
@@ -3,14 +3,50 @@
 
 #include "ndn_node.h" // Para acessar a estrutura NDNNode
 
-#define MAX_NODES_PER_NET 100
-
 // Funções para enviar mensagens ao servidor de registo
 void send_reg_message(NDNNode *node, int net_id);
 void send_unreg_message(NDNNode *node, int net_id);
 void send_nodes_request_message(NDNNode *node, int net_id);
+void send_update_message(NDNNode *node, int net_id);
+void join_network(NDNNode *node, int net_id);
+
+// Retransmissão dos pedidos sem resposta (chamadas pelo loop principal) e espera pelo OKUNREG ao terminar
+long long reg_request_next_deadline_ms(NDNNode *node);
+void check_reg_retransmissions(NDNNode *node);
+void wait_for_unreg_confirmation(NDNNode *node, int timeout_ms);
+
+// Listagem completa dos membros de uma rede: por páginas UDP ou pelo canal TCP do servidor
+void request_network_members(NDNNode *node, int net_id);
+void query_network_members_tcp(NDNNode *node, int net_id); // A lista é mostrada quando a consulta terminar
+
+// Consultas pelo canal TCP do servidor em curso (chamadas pelo loop principal)
+int reg_tcp_query_fill_fds(NDNNode *node, fd_set *read_fds, fd_set *write_fds, int max_fd);
+void reg_tcp_query_handle_events(NDNNode *node, fd_set *read_fds, fd_set *write_fds);
+long long reg_tcp_query_next_deadline_ms(NDNNode *node);
+void check_reg_tcp_query_timeouts(NDNNode *node);
+void cancel_reg_tcp_queries(NDNNode *node);
+
+// Comunica ao servidor o grau e a profundidade do nó se mudaram (chamada pelo loop principal)
+void report_node_state(NDNNode *node);
+
+// Subscrição das alterações de membros da rede (cache local usada na reparação da topologia)
+void send_subscribe_message(NDNNode *node, int net_id);
+void subscribe_members(NDNNode *node, int net_id);
+void unsubscribe_members(NDNNode *node);
+void show_member_cache(NDNNode *node);
+
+// Renovação periódica do registo no servidor (chamadas pelo loop principal)
+long long lease_next_deadline_ms(NDNNode *node);
+void check_lease_refresh(NDNNode *node);
 
 // Função para processar mensagens recebidas do servidor de registo
 void process_udp_registration_message(NDNNode *node, const char *message);
 
+// Conexões paralelas de entrada na rede (chamadas pelo loop principal)
+void init_join(NDNNode *node);
+int join_fill_write_fds(NDNNode *node, fd_set *write_fds, int max_fd);
+void join_handle_writable(NDNNode *node, fd_set *write_fds);
+long long join_next_deadline_ms(NDNNode *node);
+void check_join_timeouts(NDNNode *node);
+
 #endif // REGISTRATION_PROTOCOL_H
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "topology_protocol.h"
 #include "registration_protocol.h"
 #include "ndn_protocol.h" // Necessário para process_ndn_message
+#include "forwarding_strategy.h"
+#include "logger.h"
+#include "metrics.h"
+#include "capture.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,6 +13,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 
 // Funções de gestão de vizinhos (interno ao módulo)
 
@@ -20,13 +25,13 @@
  * @param port Porto TCP do vizinho.
  * @param sd Socket descriptor da conexão com o vizinho.
  * @param type Tipo de vizinho (EXTERNAL, INTERNAL, PENDING_INCOMING, EXTERNAL_AND_INTERNAL).
- * @return Índice do vizinho na lista, ou -1 se o limite foi atingido.
+ * @return Índice do vizinho na lista, ou -1 se o limite foi atingido (o socket é fechado).
  */
 int add_neighbor(NDNNode *node, const char *ip, int port, int sd, NeighborType type)
 {
     if (node->num_active_neighbors >= MAX_NEIGHBORS)
     {
-        fprintf(stderr, "Erro: Máximo de vizinhos atingido para o nó %s:%d. Não pode adicionar %s:%d.\n", node->ip, node->tcp_port, ip, port);
+        LOG_ERROR("Erro: Máximo de vizinhos atingido para o nó %s:%d. Não pode adicionar %s:%d.\n", node->ip, node->tcp_port, ip, port);
         close(sd); // Fecha o socket se não puder adicionar
         return -1;
     }
@@ -45,229 +50,1243 @@ int add_neighbor(NDNNode *node, const char *ip, int port, int sd, NeighborType t
             node->neighbors[i].recv_buffer_pos = 0;                                            // Inicializar a posição do buffer
             memset(node->neighbors[i].recv_buffer, 0, sizeof(node->neighbors[i].recv_buffer)); // Limpar o buffer
 
+            node->neighbors[i].fwd_interests = 0;
+            node->neighbors[i].fwd_satisfied = 0;
+            node->neighbors[i].fwd_nacked = 0;
+            node->neighbors[i].fwd_latency_us = 0;
+
+            // Estado dos heartbeats: o vizinho só é vigiado depois de mostrar que fala PING/PONG
+            node->neighbors[i].last_heard_ms = ndn_now_ms();
+            node->neighbors[i].heartbeat_capable = 0;
+            node->neighbors[i].srtt_us = 0;
+            node->neighbors[i].recovery_ip[0] = '\0';
+            node->neighbors[i].recovery_tcp_port = 0;
+
+            node->neighbors[i].depth = -1;
+            node->neighbors[i].external_is_me = 0;
+            memset(node->neighbors[i].face_metrics, 0, sizeof(node->neighbors[i].face_metrics));
+            histogram_reset(&node->neighbors[i].face_latency);
+
             node->num_active_neighbors++;
             return i; // Retorna o índice do vizinho
         }
     }
-    return -1; // Não encontrou slot vazio (não deveria acontecer se a contagem estiver certa)
+    close(sd);
+    return -1; // Não encontrou slot vazio (não deveria acontecer se a contagem estiver certa)
+}
+
+/**
+ * @brief Remove um vizinho da lista do nó pelo seu socket descriptor.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param sd Socket descriptor do vizinho a remover.
+ */
+void remove_neighbor(NDNNode *node, int sd)
+{
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd == sd)
+        {
+            LOG_INFO("Removendo vizinho SD: %d (%s:%d).\n", sd, node->neighbors[i].ip, node->neighbors[i].tcp_port);
+            close(sd); // Fechar o socket do vizinho
+            strategy_face_removed(node, sd);
+            if (sd == node->repair_confirm_sd)
+            {
+                node->repair_confirm_sd = -1; // O prazo da confirmação leva a reparação ao membro seguinte
+            }
+            node->neighbors[i].is_valid = 0;
+            node->neighbors[i].socket_sd = -1;                                                 // Invalidar SD
+            node->neighbors[i].type = NEIGHBOR_TYPE_NONE;                                      // Resetar tipo
+            node->neighbors[i].recv_buffer_pos = 0;                                            // Limpar a posição do buffer
+            memset(node->neighbors[i].recv_buffer, 0, sizeof(node->neighbors[i].recv_buffer)); // Limpar o buffer
+
+            node->num_active_neighbors--;
+            LOG_INFO("Vizinho removido. Total: %d\n", node->num_active_neighbors);
+            pit_face_removed(node, sd); // Depois de o vizinho deixar de ser candidato ao reencaminhamento
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Encontra um vizinho na lista pelo seu socket descriptor.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param sd Socket descriptor do vizinho.
+ * @return Ponteiro para a estrutura Neighbor, ou NULL se não encontrado.
+ */
+Neighbor *find_neighbor_by_sd(NDNNode *node, int sd)
+{
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd == sd)
+        {
+            return &node->neighbors[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Encontra um vizinho na lista pelo seu endereço IP e porto TCP.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param ip IP do vizinho.
+ * @param port Porto TCP do vizinho.
+ * @return Ponteiro para a estrutura Neighbor, ou NULL se não encontrado.
+ */
+Neighbor *find_neighbor_by_addr(NDNNode *node, const char *ip, int port)
+{
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        if (node->neighbors[i].is_valid && strcmp(node->neighbors[i].ip, ip) == 0 && node->neighbors[i].tcp_port == port)
+        {
+            return &node->neighbors[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Obtém o vizinho externo do nó.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @return Ponteiro para a estrutura Neighbor do vizinho externo, ou NULL se não houver.
+ */
+Neighbor *get_external_neighbor(NDNNode *node)
+{
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        if (node->neighbors[i].is_valid && (node->neighbors[i].type == NEIGHBOR_TYPE_EXTERNAL || node->neighbors[i].type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL))
+        {
+            return &node->neighbors[i];
+        }
+    }
+    return NULL; // Nenhum vizinho externo encontrado
+}
+
+/**
+ * @brief Conta os vizinhos que fazem parte da árvore (todos exceto os atalhos).
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @return Número de vizinhos da árvore.
+ */
+int count_tree_neighbors(NDNNode *node)
+{
+    int count = 0;
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        if (node->neighbors[i].is_valid && node->neighbors[i].type != NEIGHBOR_TYPE_SHORTCUT)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Funções para conexão
+
+/**
+ * @brief Adota uma conexão TCP já estabelecida com um nó alvo como vizinho EXTERNAL e envia ENTRY.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param target_ip IP do nó alvo.
+ * @param target_tcp_port Porto TCP do nó alvo.
+ * @param client_sd Socket da conexão (bloqueante).
+ * @return O socket descriptor da conexão, ou -1 se não foi possível adicionar o vizinho (o socket é fechado).
+ */
+int adopt_outgoing_connection(NDNNode *node, const char *target_ip, int target_tcp_port, int client_sd)
+{
+    // Adicionar o nó como vizinho EXTERNAL. O tipo será ajustado pelo outro lado.
+    int neighbor_idx = add_neighbor(node, target_ip, target_tcp_port, client_sd, NEIGHBOR_TYPE_EXTERNAL);
+    if (neighbor_idx != -1)
+    {
+        send_entry_message(client_sd, node); // Envia ENTRY para o nó conectado
+        return client_sd;
+    }
+    return -1; // add_neighbor já fechou o socket
+}
+
+/**
+ * @brief Processa uma nova conexão TCP de entrada (chamada por accept no ndn_node.c).
+ * Adiciona o vizinho como PENDING_INCOMING.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param new_socket_sd O socket descriptor da nova conexão aceita.
+ * @param client_ip O IP de origem da conexão (temporário).
+ * @param client_port O porto de origem da conexão (temporário).
+ */
+void process_incoming_connection(NDNNode *node, int new_socket_sd, const char *client_ip, int client_port)
+{
+
+    // Verificar se já temos uma conexão ACEITA (PENDING_INCOMING) para este SD, ou se já é um vizinho.
+    Neighbor *existing_sd_neighbor = find_neighbor_by_sd(node, new_socket_sd);
+    if (existing_sd_neighbor && existing_sd_neighbor->is_valid)
+    {
+        LOG_WARN("Aviso: Nova conexão aceita (SD: %d) já existe como vizinho. Pode ser reabertura ou erro.\n", new_socket_sd);
+        close(new_socket_sd); // Fechar a duplicata
+        return;
+    }
+
+    // Adicionar o vizinho com o tipo PENDING_INCOMING. IP/Porta serão atualizados pela mensagem ENTRY.
+    add_neighbor(node, client_ip, client_port, new_socket_sd, NEIGHBOR_TYPE_PENDING_INCOMING);
+}
+
+// Conexões de saída não bloqueantes
+// Como na entrada na rede, o connect() não bloqueia o loop de eventos: o socket fica no conjunto de
+// escrita do select até a conexão terminar ou expirar (JOIN_CONNECT_TIMEOUT_MS). O resultado é
+// entregue à função da finalidade da conexão, com o socket (bloqueante) ou -1 se falhou.
+
+static void shortcut_connected(NDNNode *node, const char *origin_ip, int origin_port, int sd);
+static void direct_connected(NDNNode *node, const char *ip, int tcp_port, int sd);
+static void repair_connected(NDNNode *node, const char *ip, int tcp_port, int sd);
+static void repair_member_connected(NDNNode *node, const char *ip, int tcp_port, int sd);
+static int drop_repair_candidate(NDNNode *node, int sd);
+static void repair_next_member(NDNNode *node);
+
+/**
+ * @brief Entrega o resultado de uma conexão de saída à função da sua finalidade.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param pending Cópia da conexão (o slot já foi libertado).
+ * @param sd Socket da conexão estabelecida, ou -1 se falhou ou expirou.
+ */
+static void finish_pending_connect(NDNNode *node, const PendingConnect *pending, int sd)
+{
+    if (sd != -1 && !node->transport)
+    {
+        // O resto do protocolo usa sockets bloqueantes
+        fcntl(sd, F_SETFL, fcntl(sd, F_GETFL, 0) & ~O_NONBLOCK);
+    }
+    switch (pending->purpose)
+    {
+    case PENDING_CONNECT_SHORTCUT:
+        shortcut_connected(node, pending->ip, pending->tcp_port, sd);
+        break;
+    case PENDING_CONNECT_DIRECT:
+        direct_connected(node, pending->ip, pending->tcp_port, sd);
+        break;
+    case PENDING_CONNECT_REPAIR:
+        repair_connected(node, pending->ip, pending->tcp_port, sd);
+        break;
+    case PENDING_CONNECT_REPAIR_MEMBER:
+        repair_member_connected(node, pending->ip, pending->tcp_port, sd);
+        break;
+    }
+}
+
+/**
+ * @brief Indica se já há uma conexão de saída em curso para um nó.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param ip IP do nó.
+ * @param tcp_port Porto TCP do nó.
+ * @return 1 se houver, 0 caso contrário.
+ */
+static int has_pending_connect(NDNNode *node, const char *ip, int tcp_port)
+{
+    for (int i = 0; i < MAX_PENDING_CONNECTS; i++)
+    {
+        if (node->pending_connects[i].is_valid && strcmp(node->pending_connects[i].ip, ip) == 0 &&
+            node->pending_connects[i].tcp_port == tcp_port)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Começa uma conexão TCP não bloqueante a um nó. Se a conexão termina de imediato (nó
+ * simulado, loopback) ou não pode ser aberta, o resultado é entregue antes de a função terminar.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param target_ip IP do nó alvo.
+ * @param target_tcp_port Porto TCP do nó alvo.
+ * @param purpose Finalidade da conexão (define quem trata o resultado).
+ */
+static void start_pending_connect(NDNNode *node, const char *target_ip, int target_tcp_port, PendingConnectPurpose purpose)
+{
+    PendingConnect pending;
+    strncpy(pending.ip, target_ip, MAX_IP_LEN - 1);
+    pending.ip[MAX_IP_LEN - 1] = '\0';
+    pending.tcp_port = target_tcp_port;
+    pending.purpose = purpose;
+    pending.sd = -1;
+    pending.deadline_ms = -1;
+    pending.is_valid = 0;
+
+    if (node->transport)
+    {
+        // Nó simulado: a conexão é estabelecida de imediato pelo transporte
+        finish_pending_connect(node, &pending, node->transport->connect_node(node, target_ip, target_tcp_port, node->transport->ctx));
+        return;
+    }
+
+    PendingConnect *slot = NULL;
+    for (int i = 0; i < MAX_PENDING_CONNECTS && !slot; i++)
+    {
+        if (!node->pending_connects[i].is_valid)
+        {
+            slot = &node->pending_connects[i];
+        }
+    }
+
+    struct sockaddr_in target_addr;
+    memset(&target_addr, 0, sizeof(target_addr));
+    target_addr.sin_family = AF_INET;
+    target_addr.sin_port = htons(target_tcp_port);
+    if (!slot || inet_pton(AF_INET, target_ip, &target_addr.sin_addr) <= 0)
+    {
+        LOG_WARN("Não foi possível iniciar a conexão a %s:%d.\n", target_ip, target_tcp_port);
+        finish_pending_connect(node, &pending, -1);
+        return;
+    }
+
+    int sd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sd == -1)
+    {
+        perror("Erro ao criar socket cliente TCP");
+        finish_pending_connect(node, &pending, -1);
+        return;
+    }
+    fcntl(sd, F_SETFL, fcntl(sd, F_GETFL, 0) | O_NONBLOCK);
+
+    if (connect(sd, (struct sockaddr *)&target_addr, sizeof(target_addr)) == 0)
+    {
+        finish_pending_connect(node, &pending, sd); // Conexão imediata (comum em loopback)
+        return;
+    }
+    if (errno != EINPROGRESS)
+    {
+        LOG_WARN("Falha ao conectar a %s:%d: %s\n", target_ip, target_tcp_port, strerror(errno));
+        close(sd);
+        finish_pending_connect(node, &pending, -1);
+        return;
+    }
+
+    pending.sd = sd;
+    pending.deadline_ms = ndn_now_ms() + JOIN_CONNECT_TIMEOUT_MS;
+    pending.is_valid = 1;
+    *slot = pending;
+}
+
+/**
+ * @brief Começa a conexão de uma entrada direta (direct join) a um nó alvo. O resultado é mostrado
+ * quando a conexão terminar; o nó alvo é adicionado como vizinho EXTERNAL.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param target_ip IP do nó alvo.
+ * @param target_tcp_port Porto TCP do nó alvo.
+ * @return 0 se a conexão foi pedida (ou o nó já é vizinho), -1 se já há uma conexão em curso para ele.
+ */
+int connect_to_node(NDNNode *node, const char *target_ip, int target_tcp_port)
+{
+    Neighbor *existing_neighbor = find_neighbor_by_addr(node, target_ip, target_tcp_port);
+    if (existing_neighbor && existing_neighbor->is_valid)
+    {
+        printf("%s:%d já é vizinho deste nó.\n", target_ip, target_tcp_port);
+        return 0;
+    }
+    if (has_pending_connect(node, target_ip, target_tcp_port))
+    {
+        printf("Já há uma conexão em curso para %s:%d.\n", target_ip, target_tcp_port);
+        return -1;
+    }
+    start_pending_connect(node, target_ip, target_tcp_port, PENDING_CONNECT_DIRECT);
+    return 0;
+}
+
+/**
+ * @brief Conclui uma entrada direta: adota a conexão como vizinho EXTERNAL e mostra o resultado.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param ip IP do nó alvo.
+ * @param tcp_port Porto TCP do nó alvo.
+ * @param sd Socket da conexão, ou -1 se falhou.
+ */
+static void direct_connected(NDNNode *node, const char *ip, int tcp_port, int sd)
+{
+    if (sd == -1 || adopt_outgoing_connection(node, ip, tcp_port, sd) == -1)
+    {
+        printf("Falha na conexão direta com %s:%d.\n", ip, tcp_port);
+        return;
+    }
+    printf("Conexão direta bem sucedida. Lembre-se de usar 'join <net>' para se registrar nesta rede.\n");
+}
+
+/**
+ * @brief Adiciona ao conjunto de escrita do select os sockets com connect() em curso.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param write_fds Conjunto de escrita.
+ * @param max_fd Maior descritor já no conjunto.
+ * @return O novo maior descritor.
+ */
+int connect_fill_write_fds(NDNNode *node, fd_set *write_fds, int max_fd)
+{
+    for (int i = 0; i < MAX_PENDING_CONNECTS; i++)
+    {
+        if (node->pending_connects[i].is_valid)
+        {
+            FD_SET(node->pending_connects[i].sd, write_fds);
+            if (node->pending_connects[i].sd > max_fd)
+            {
+                max_fd = node->pending_connects[i].sd;
+            }
+        }
+    }
+    return max_fd;
+}
+
+/**
+ * @brief Trata os sockets com connect() em curso que ficaram prontos para escrita (conexão
+ * estabelecida ou recusada).
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param write_fds Conjunto de escrita devolvido pelo select.
+ */
+void connect_handle_writable(NDNNode *node, fd_set *write_fds)
+{
+    for (int i = 0; i < MAX_PENDING_CONNECTS; i++)
+    {
+        if (!node->pending_connects[i].is_valid || !FD_ISSET(node->pending_connects[i].sd, write_fds))
+        {
+            continue;
+        }
+        PendingConnect pending = node->pending_connects[i];
+        node->pending_connects[i].is_valid = 0; // O slot pode ser reutilizado por quem trata o resultado
+        FD_CLR(pending.sd, write_fds);
+
+        int so_error = 0;
+        socklen_t len = sizeof(so_error);
+        if (getsockopt(pending.sd, SOL_SOCKET, SO_ERROR, &so_error, &len) == -1 || so_error != 0)
+        {
+            LOG_WARN("Falha ao conectar a %s:%d: %s\n", pending.ip, pending.tcp_port, strerror(so_error));
+            close(pending.sd);
+            finish_pending_connect(node, &pending, -1);
+            continue;
+        }
+        finish_pending_connect(node, &pending, pending.sd);
+    }
+}
+
+/**
+ * @brief Expiração mais próxima das conexões em curso, ou -1 se não houver nenhuma.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ */
+long long connect_next_deadline_ms(NDNNode *node)
+{
+    long long deadline = node->repair_confirm_deadline_ms;
+    for (int i = 0; i < MAX_PENDING_CONNECTS; i++)
+    {
+        if (node->pending_connects[i].is_valid && (deadline == -1 || node->pending_connects[i].deadline_ms < deadline))
+        {
+            deadline = node->pending_connects[i].deadline_ms;
+        }
+    }
+    return deadline;
+}
+
+/**
+ * @brief Dá como falhadas as conexões que não terminaram dentro do prazo.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ */
+void check_connect_timeouts(NDNNode *node)
+{
+    long long now_ms = ndn_now_ms();
+    for (int i = 0; i < MAX_PENDING_CONNECTS; i++)
+    {
+        if (node->pending_connects[i].is_valid && node->pending_connects[i].deadline_ms <= now_ms)
+        {
+            PendingConnect pending = node->pending_connects[i];
+            node->pending_connects[i].is_valid = 0;
+            LOG_WARN("Nó %s:%d não respondeu em %d ms.\n", pending.ip, pending.tcp_port, JOIN_CONNECT_TIMEOUT_MS);
+            close(pending.sd);
+            finish_pending_connect(node, &pending, -1);
+        }
+    }
+
+    // O membro da cache ligado para reparação não anunciou a sua profundidade a tempo (ou a conexão
+    // já foi fechada por outro motivo): passa-se ao membro seguinte
+    if (node->repair_confirm_deadline_ms != -1 && node->repair_confirm_deadline_ms <= now_ms)
+    {
+        node->repair_confirm_deadline_ms = -1;
+        if (node->repair_confirm_sd != -1)
+        {
+            LOG_INFO("  Membro (SD %d) sem DEPTH em %d ms: recusado como vizinho externo.\n", node->repair_confirm_sd,
+                     JOIN_CONNECT_TIMEOUT_MS);
+            drop_repair_candidate(node, node->repair_confirm_sd);
+        }
+        else if (node->repair_in_progress)
+        {
+            repair_next_member(node);
+        }
+    }
+}
+
+/**
+ * @brief Fecha as conexões em curso sem entregar o resultado e abandona a reparação em curso.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ */
+void cancel_pending_connects(NDNNode *node)
+{
+    node->repair_in_progress = 0;
+    node->repair_confirm_sd = -1;
+    node->repair_confirm_deadline_ms = -1;
+    for (int i = 0; i < MAX_PENDING_CONNECTS; i++)
+    {
+        if (node->pending_connects[i].is_valid)
+        {
+            close(node->pending_connects[i].sd);
+            node->pending_connects[i].is_valid = 0;
+        }
+    }
+}
+
+// Funções de envio de mensagens de topologia
+
+/**
+ * @brief Envia uma mensagem completa a um vizinho e conta-a nas métricas do nó e da interface.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param target_sd Socket descriptor do vizinho alvo.
+ * @param message Mensagem terminada em '\n'.
+ * @return 0 se enviada, -1 em caso de erro (o chamador decide se remove o vizinho).
+ */
+int send_neighbor_message(NDNNode *node, int target_sd, const char *message)
+{
+    size_t len = strlen(message);
+    if (write(target_sd, message, len) == -1)
+    {
+        METRIC_INC(node, METRIC_SEND_ERRORS);
+        LOG_WARN("Erro ao enviar mensagem %.*s para SD %d: %s\n", (int)strcspn(message, " \n"), message, target_sd,
+                 strerror(errno));
+        return -1;
+    }
+    metrics_count_sent(node, target_sd, message, len);
+    CAPTURE_SENT(node, target_sd, message);
+    return 0;
+}
+
+/**
+ * @brief Envia uma mensagem ENTRY para um vizinho.
+ *
+ * @param target_sd Socket descriptor do vizinho alvo.
+ * @param node Ponteiro para a estrutura NDNNode (remetente).
+ */
+void send_entry_message(int target_sd, NDNNode *node)
+{
+    char message[MAX_TCP_MSG_LEN];
+    snprintf(message, sizeof(message), "ENTRY %s %d\n", node->ip, node->tcp_port);
+    if (send_neighbor_message(node, target_sd, message) == -1)
+    {
+        remove_neighbor(node, target_sd);
+    }
+}
+
+/**
+ * @brief Envia uma mensagem LEAVE para um vizinho.
+ *
+ * @param target_sd Socket descriptor do vizinho alvo.
+ * @param node Ponteiro para a estrutura NDNNode (remetente).
+ */
+void send_leave_message(int target_sd, NDNNode *node)
+{
+    char message[MAX_TCP_MSG_LEN];
+    Neighbor *external = get_external_neighbor(node);
+    if (external)
+    {
+        snprintf(message, sizeof(message), "LEAVE %s %d\n", external->ip, external->tcp_port);
+    }
+    else
+    {
+        snprintf(message, sizeof(message), "LEAVE %s %d\n", node->ip, node->tcp_port);
+    }
+
+    if (send_neighbor_message(node, target_sd, message) == -1)
+    {
+        remove_neighbor(node, target_sd);
+    }
+}
+
+// Reparação da topologia
+// O nó que perde o seu vizinho externo liga-se ao externo desse vizinho (indicado no LEAVE ou no
+// PING) e, se este não responder, a até MEMBER_REPAIR_ATTEMPTS membros da cache de membros, por
+// ordem aleatória. Todas as conexões são não bloqueantes. Enquanto repara, o nó anuncia profundidade
+// desconhecida, que desce pela sua subárvore; um membro só é aceite se anunciar uma profundidade
+// conhecida e não maior que a que o nó tinha, o que exclui os seus descendentes (que formariam um ciclo).
+
+/**
+ * @brief Termina a reparação em curso.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ */
+static void end_repair(NDNNode *node)
+{
+    node->repair_in_progress = 0;
+    node->repair_confirm_sd = -1;
+    node->repair_confirm_deadline_ms = -1;
+}
+
+/**
+ * @brief Começa a procura de um novo vizinho externo.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param old_depth Profundidade do nó antes da perda.
+ * @param lost_ip IP do vizinho que saiu ou falhou.
+ * @param lost_port Porto TCP do vizinho que saiu ou falhou.
+ * @param recovery_ip IP do externo do vizinho perdido, ou NULL se desconhecido.
+ * @param recovery_port Porto TCP do externo do vizinho perdido.
+ */
+static void begin_repair(NDNNode *node, int old_depth, const char *lost_ip, int lost_port, const char *recovery_ip, int recovery_port)
+{
+    node->repair_in_progress = 1;
+    node->repair_max_depth = old_depth;
+    node->repair_confirm_sd = -1;
+    node->repair_confirm_deadline_ms = -1;
+    strcpy(node->repair_lost_ip, lost_ip);
+    node->repair_lost_port = lost_port;
+    strcpy(node->repair_failed_ip, recovery_ip ? recovery_ip : lost_ip);
+    node->repair_failed_port = recovery_ip ? recovery_port : lost_port;
+    node->repair_member_start = (node->num_cached_members > 0) ? rand() % node->num_cached_members : 0;
+    node->repair_member_next = 0;
+    node->repair_attempts = 0;
+
+    if (recovery_ip)
+    {
+        start_pending_connect(node, recovery_ip, recovery_port, PENDING_CONNECT_REPAIR);
+    }
+    else
+    {
+        repair_next_member(node);
+    }
+}
+
+/**
+ * @brief Abre a conexão ao próximo membro da cache que pode ser o novo vizinho externo. Os vizinhos
+ * atuais, o vizinho perdido e o nó de reparação que falhou são excluídos.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ */
+static void repair_next_member(NDNNode *node)
+{
+    int num_members = node->num_cached_members;
+    while (node->repair_member_next < num_members && node->repair_attempts < MEMBER_REPAIR_ATTEMPTS)
+    {
+        MemberEntry member = node->member_cache[(node->repair_member_start + node->repair_member_next++) % num_members];
+        if ((strcmp(member.ip, node->ip) == 0 && member.tcp_port == node->tcp_port) ||
+            (strcmp(member.ip, node->repair_lost_ip) == 0 && member.tcp_port == node->repair_lost_port) ||
+            (strcmp(member.ip, node->repair_failed_ip) == 0 && member.tcp_port == node->repair_failed_port) ||
+            find_neighbor_by_addr(node, member.ip, member.tcp_port) || has_pending_connect(node, member.ip, member.tcp_port))
+        {
+            continue;
+        }
+        node->repair_attempts++;
+        start_pending_connect(node, member.ip, member.tcp_port, PENDING_CONNECT_REPAIR_MEMBER);
+        return;
+    }
+    LOG_INFO("  Nenhum membro da cache serviu de novo vizinho externo.\n");
+    end_repair(node);
+}
+
+/**
+ * @brief Conclui a conexão ao externo do vizinho perdido: passa a vizinho externo ou, se não
+ * respondeu, tenta a cache de membros.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param ip IP do nó de reparação.
+ * @param tcp_port Porto TCP do nó de reparação.
+ * @param sd Socket da conexão, ou -1 se falhou.
+ */
+static void repair_connected(NDNNode *node, const char *ip, int tcp_port, int sd)
+{
+    if (!node->repair_in_progress)
+    {
+        if (sd != -1)
+        {
+            close(sd);
+        }
+        return;
+    }
+    if (sd != -1 && adopt_outgoing_connection(node, ip, tcp_port, sd) != -1)
+    {
+        LOG_INFO("  Conectado com sucesso a %s:%d como novo vizinho externo.\n", ip, tcp_port);
+        end_repair(node);
+        return;
+    }
+    LOG_INFO("  Falha ao conectar a %s:%d para ser novo vizinho externo.\n", ip, tcp_port);
+    repair_next_member(node);
+}
+
+/**
+ * @brief Conclui a conexão a um membro da cache: envia ENTRY e espera pelo DEPTH do membro para
+ * confirmar que não está na subárvore deste nó.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param ip IP do membro.
+ * @param tcp_port Porto TCP do membro.
+ * @param sd Socket da conexão, ou -1 se falhou.
+ */
+static void repair_member_connected(NDNNode *node, const char *ip, int tcp_port, int sd)
+{
+    if (!node->repair_in_progress)
+    {
+        if (sd != -1)
+        {
+            close(sd);
+        }
+        return;
+    }
+    if (sd == -1 || adopt_outgoing_connection(node, ip, tcp_port, sd) == -1)
+    {
+        repair_next_member(node);
+        return;
+    }
+    node->repair_confirm_sd = sd;
+    node->repair_confirm_deadline_ms = ndn_now_ms() + JOIN_CONNECT_TIMEOUT_MS;
+}
+
+/**
+ * @brief Se o vizinho indicado é o membro à espera de confirmação (saiu, falhou ou não respondeu a
+ * tempo), remove-o e passa ao membro seguinte.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param sd Socket descriptor do vizinho.
+ * @return 1 se era o membro à espera de confirmação, 0 caso contrário.
+ */
+static int drop_repair_candidate(NDNNode *node, int sd)
+{
+    if (!node->repair_in_progress || node->repair_confirm_sd == -1 || node->repair_confirm_sd != sd)
+    {
+        return 0;
+    }
+    node->repair_confirm_sd = -1;
+    node->repair_confirm_deadline_ms = -1;
+    remove_neighbor(node, sd);
+    repair_next_member(node);
+    return 1;
+}
+
+/**
+ * @brief Aceita ou recusa o membro ligado à espera de confirmação, pela profundidade que anunciou.
+ * Um descendente deste nó anuncia profundidade desconhecida (a deste nó durante a reparação) ou,
+ * enquanto o anúncio não lhe chega, uma maior que a que este nó tinha.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param candidate O membro (vizinho externo ainda por confirmar).
+ */
+static void confirm_repair_member(NDNNode *node, Neighbor *candidate)
+{
+    int depth = candidate->depth;
+    if (depth >= 0 && (node->repair_max_depth < 0 || depth <= node->repair_max_depth))
+    {
+        LOG_INFO("  Conectado a %s:%d (cache de membros, profundidade %d) como novo vizinho externo.\n",
+                 candidate->ip, candidate->tcp_port, depth);
+        end_repair(node);
+        return;
+    }
+    LOG_INFO("  Membro %s:%d recusado (profundidade %d): pode estar na subárvore deste nó.\n",
+             candidate->ip, candidate->tcp_port, depth);
+    drop_repair_candidate(node, candidate->socket_sd);
+}
+
+/**
+ * @brief Trata a saída de um vizinho (mensagem LEAVE ou falha detetada) e repara a topologia.
+ * Se o vizinho era o externo deste nó, liga-se ao externo do vizinho (recovery_ip:recovery_port)
+ * ou, se esse externo era o próprio nó, promove um vizinho interno a externo.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param client_sd Socket descriptor do vizinho que saiu.
+ * @param ip_str IP do vizinho externo do nó que saiu.
+ * @param tcp_port Porto TCP do vizinho externo do nó que saiu.
+ */
+void handle_neighbor_leave(NDNNode *node, int client_sd, const char *ip_str, int tcp_port)
+{
+    Neighbor *removed_neighbor = find_neighbor_by_sd(node, client_sd);
+    if (!removed_neighbor || !removed_neighbor->is_valid)
+    {
+        LOG_ERROR("Erro: LEAVE recebido de SD %d, mas vizinho não encontrado ou inválido.\n", client_sd);
+        return;
+    }
+    if (drop_repair_candidate(node, client_sd))
+    {
+        return;
+    }
+    int old_depth = node->depth;
+
+    // Determinar se o vizinho que saiu era o vizinho externo deste nó
+    int was_external = (removed_neighbor->type == NEIGHBOR_TYPE_EXTERNAL || removed_neighbor->type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL);
+    char lost_ip[MAX_IP_LEN];
+    strcpy(lost_ip, removed_neighbor->ip);
+    int lost_port = removed_neighbor->tcp_port;
+
+    remove_neighbor(node, client_sd); // Sempre remove o vizinho que enviou LEAVE
+
+    if (was_external)
+    {
+
+        // Analisa o identificador contido na mensagem LEAVE (vizinho externo do REMETENTE do LEAVE)
+        if (strcmp(ip_str, node->ip) != 0 || tcp_port != node->tcp_port)
+        {
+            // Se não for o próprio nó local, tentar conectar a ele como novo vizinho externo.
+            Neighbor *potential_new_external = find_neighbor_by_addr(node, ip_str, tcp_port);
+            if (potential_new_external)
+            {
+                // Se já está conectado, promove a externo ou EXTERNAL_AND_INTERNAL se apropriado
+                if (potential_new_external->type == NEIGHBOR_TYPE_INTERNAL || potential_new_external->type == NEIGHBOR_TYPE_PENDING_INCOMING)
+                {
+                    // Se a rede agora tem apenas um vizinho (o que será promovido)
+                    if (count_tree_neighbors(node) == 1)
+                    { // Só sobrou um vizinho da árvore (o que será promovido)
+                        potential_new_external->type = NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL;
+                    }
+                    else
+                    {
+                        potential_new_external->type = NEIGHBOR_TYPE_EXTERNAL;
+                    }
+                }
+                // Se já era EXTERNAL_AND_INTERNAL ou EXTERNAL, mantém.
+            }
+            else
+            {
+                // Se não estava conectado, inicia uma nova conexão TCP; quando terminar, o nó é
+                // adicionado como EXTERNAL e recebe ENTRY (repair_connected)
+                begin_repair(node, old_depth, lost_ip, lost_port, ip_str, tcp_port);
+            }
+        }
+        else // O vizinho externo do nó que saiu era o próprio nó local.
+        {
+            // Este nó se tornou a "raiz" de uma sub-árvore que foi desconectada.
+            // Promover um vizinho interno existente a externo.
+            Neighbor *promoted_neighbor = NULL;
+            for (int i = 0; i < MAX_NEIGHBORS; i++)
+            {
+                if (node->neighbors[i].is_valid && (node->neighbors[i].type == NEIGHBOR_TYPE_INTERNAL || node->neighbors[i].type == NEIGHBOR_TYPE_PENDING_INCOMING))
+                { // Procura um interno ou pendente para promover
+                    promoted_neighbor = &node->neighbors[i];
+                    break;
+                }
+            }
+            if (promoted_neighbor)
+            {
+                // Se este é o único vizinho restante (rede de 2 nós agora)
+                if (count_tree_neighbors(node) == 1)
+                {
+                    promoted_neighbor->type = NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL;
+                }
+                else
+                {
+                    promoted_neighbor->type = NEIGHBOR_TYPE_EXTERNAL;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Trata a falha de um vizinho (heartbeats sem resposta ou conexão fechada sem LEAVE) como um
+ * LEAVE com o externo do vizinho, se este for conhecido. Se não for e o vizinho era o externo deste
+ * nó, procura um novo externo na cache de membros.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param sd Socket descriptor do vizinho em falha.
+ */
+void handle_neighbor_failure(NDNNode *node, int sd)
+{
+    Neighbor *neighbor = find_neighbor_by_sd(node, sd);
+    if (!neighbor || drop_repair_candidate(node, sd))
+    {
+        return;
+    }
+    if (neighbor->recovery_ip[0] != '\0')
+    {
+        char recovery_ip[MAX_IP_LEN];
+        strcpy(recovery_ip, neighbor->recovery_ip);
+        handle_neighbor_leave(node, sd, recovery_ip, neighbor->recovery_tcp_port);
+        return;
+    }
+
+    int was_external = (neighbor->type == NEIGHBOR_TYPE_EXTERNAL || neighbor->type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL);
+    char lost_ip[MAX_IP_LEN];
+    strcpy(lost_ip, neighbor->ip);
+    int lost_port = neighbor->tcp_port;
+    int old_depth = node->depth;
+    remove_neighbor(node, sd);
+    if (was_external && !get_external_neighbor(node))
+    {
+        begin_repair(node, old_depth, lost_ip, lost_port, NULL, 0);
+    }
+}
+
+// Heartbeats (PING/PONG) e deteção de falhas
+
+/**
+ * @brief Envia um PING a um vizinho. Leva o instante de envio (devolvido no PONG para medir o RTT)
+ * e o vizinho externo deste nó, que o recetor usa para reparar a topologia se este nó falhar.
+ *
+ * @param target_sd Socket descriptor do vizinho alvo.
+ * @param node Ponteiro para a estrutura NDNNode (remetente).
+ */
+void send_ping_message(int target_sd, NDNNode *node)
+{
+    char message[MAX_TCP_MSG_LEN];
+    Neighbor *external = get_external_neighbor(node);
+    snprintf(message, sizeof(message), "PING %lld %s %d\n", ndn_now_us(),
+             external ? external->ip : node->ip, external ? external->tcp_port : node->tcp_port);
+    if (send_neighbor_message(node, target_sd, message) == -1)
+    {
+        remove_neighbor(node, target_sd);
+    }
 }
 
 /**
- * @brief Remove um vizinho da lista do nó pelo seu socket descriptor.
+ * @brief Responde a um PING, devolvendo o instante de envio recebido.
  *
- * @param node Ponteiro para a estrutura NDNNode.
- * @param sd Socket descriptor do vizinho a remover.
+ * @param target_sd Socket descriptor do vizinho alvo.
+ * @param node Ponteiro para a estrutura NDNNode (remetente).
+ * @param ping_time_us Instante de envio contido no PING.
  */
-void remove_neighbor(NDNNode *node, int sd)
+void send_pong_message(int target_sd, NDNNode *node, long long ping_time_us)
 {
-    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    char message[MAX_TCP_MSG_LEN];
+    snprintf(message, sizeof(message), "PONG %lld\n", ping_time_us);
+    if (send_neighbor_message(node, target_sd, message) == -1)
     {
-        if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd == sd)
-        {
-            printf("Removendo vizinho SD: %d (%s:%d).\n", sd, node->neighbors[i].ip, node->neighbors[i].tcp_port);
-            close(sd); // Fechar o socket do vizinho
-            node->neighbors[i].is_valid = 0;
-            node->neighbors[i].socket_sd = -1;                                                 // Invalidar SD
-            node->neighbors[i].type = NEIGHBOR_TYPE_NONE;                                      // Resetar tipo
-            node->neighbors[i].recv_buffer_pos = 0;                                            // Limpar a posição do buffer
-            memset(node->neighbors[i].recv_buffer, 0, sizeof(node->neighbors[i].recv_buffer)); // Limpar o buffer
+        remove_neighbor(node, target_sd);
+    }
+}
 
-            node->num_active_neighbors--;
-            printf("Vizinho removido. Total: %d\n", node->num_active_neighbors);
-            return;
-        }
+/**
+ * @brief Instante do próximo ciclo de heartbeats, ou -1 se estiverem desativados.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ */
+long long heartbeat_next_deadline_ms(NDNNode *node)
+{
+    if (node->heartbeat_interval_ms <= 0 || node->num_active_neighbors == 0)
+    {
+        return -1;
     }
+    return node->heartbeat_next_ms;
 }
 
 /**
- * @brief Encontra um vizinho na lista pelo seu socket descriptor.
+ * @brief Ciclo de heartbeats: dá como falhados os vizinhos silenciosos há mais de
+ * HEARTBEAT_MISS_LIMIT intervalos (reparando a topologia como se tivessem enviado LEAVE)
+ * e envia um PING a todos os restantes.
  *
  * @param node Ponteiro para a estrutura NDNNode.
- * @param sd Socket descriptor do vizinho.
- * @return Ponteiro para a estrutura Neighbor, ou NULL se não encontrado.
  */
-Neighbor *find_neighbor_by_sd(NDNNode *node, int sd)
+void check_heartbeats(NDNNode *node)
 {
+    long long now_ms = ndn_now_ms();
+    if (node->heartbeat_interval_ms <= 0 || node->heartbeat_next_ms > now_ms)
+    {
+        return;
+    }
+    node->heartbeat_next_ms = now_ms + node->heartbeat_interval_ms;
+
+    long long silence_limit_ms = (long long)node->heartbeat_interval_ms * HEARTBEAT_MISS_LIMIT;
     for (int i = 0; i < MAX_NEIGHBORS; i++)
     {
-        if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd == sd)
+        Neighbor *neighbor = &node->neighbors[i];
+        if (!neighbor->is_valid || !neighbor->heartbeat_capable || now_ms - neighbor->last_heard_ms <= silence_limit_ms)
         {
-            return &node->neighbors[i];
+            continue;
+        }
+
+        LOG_WARN("Vizinho %s:%d (SD: %d) sem resposta há %lld ms. Considerado em falha.\n",
+                 neighbor->ip, neighbor->tcp_port, neighbor->socket_sd, now_ms - neighbor->last_heard_ms);
+        if (node->is_leaving && (neighbor->type == NEIGHBOR_TYPE_INTERNAL || neighbor->type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL))
+        {
+            node->internal_neighbors_to_disconnect--;
+        }
+
+        handle_neighbor_failure(node, neighbor->socket_sd);
+    }
+
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    {
+        if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd != -1)
+        {
+            send_ping_message(node->neighbors[i].socket_sd, node);
         }
     }
-    return NULL;
 }
 
+// Profundidade na árvore
+
 /**
- * @brief Encontra um vizinho na lista pelo seu endereço IP e porto TCP.
+ * @brief Envia a um vizinho a profundidade deste nó (-1 se desconhecida) e o seu vizinho externo,
+ * que permite ao recetor reconhecer o par âncora (dois nós que são o externo um do outro).
+ *
+ * @param target_sd Socket descriptor do vizinho alvo.
+ * @param node Ponteiro para a estrutura NDNNode (remetente).
+ */
+void send_depth_message(int target_sd, NDNNode *node)
+{
+    char message[MAX_TCP_MSG_LEN];
+    snprintf(message, sizeof(message), "DEPTH %d %s %d\n", node->depth, node->depth_ext_ip, node->depth_ext_port);
+    if (send_neighbor_message(node, target_sd, message) == -1)
+    {
+        remove_neighbor(node, target_sd);
+    }
+}
+
+/**
+ * @brief Profundidade deste nó: 0 sem vizinho externo ou no par âncora, caso contrário
+ * a profundidade anunciada pelo vizinho externo mais um.
  *
  * @param node Ponteiro para a estrutura NDNNode.
- * @param ip IP do vizinho.
- * @param port Porto TCP do vizinho.
- * @return Ponteiro para a estrutura Neighbor, ou NULL se não encontrado.
+ * @return A profundidade, ou -1 se ainda desconhecida (também durante uma reparação).
  */
-Neighbor *find_neighbor_by_addr(NDNNode *node, const char *ip, int port)
+static int compute_node_depth(NDNNode *node)
 {
-    for (int i = 0; i < MAX_NEIGHBORS; i++)
+    if (node->repair_in_progress)
     {
-        if (node->neighbors[i].is_valid && strcmp(node->neighbors[i].ip, ip) == 0 && node->neighbors[i].tcp_port == port)
-        {
-            return &node->neighbors[i];
-        }
+        return -1; // Sem externo confirmado: desconhecida até a reparação terminar
     }
-    return NULL;
+    Neighbor *external = get_external_neighbor(node);
+    if (!external || external->type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL || external->external_is_me)
+    {
+        return 0;
+    }
+    if (external->depth < 0 || external->depth >= MAX_OVERLAY_DEPTH)
+    {
+        return -1;
+    }
+    return external->depth + 1;
 }
 
 /**
- * @brief Obtém o vizinho externo do nó.
+ * @brief Recalcula a profundidade e, se ela ou o vizinho externo mudaram, anuncia-a a todos os vizinhos.
+ * Cada nó só usa o anúncio do seu externo, pelo que a propagação desce a árvore e termina.
  *
  * @param node Ponteiro para a estrutura NDNNode.
- * @return Ponteiro para a estrutura Neighbor do vizinho externo, ou NULL se não houver.
  */
-Neighbor *get_external_neighbor(NDNNode *node)
+void update_node_depth(NDNNode *node)
 {
+    int depth = compute_node_depth(node);
+    Neighbor *external = get_external_neighbor(node);
+    const char *ext_ip = external ? external->ip : node->ip;
+    int ext_port = external ? external->tcp_port : node->tcp_port;
+
+    if (depth == node->depth && strcmp(ext_ip, node->depth_ext_ip) == 0 && ext_port == node->depth_ext_port)
+    {
+        return;
+    }
+    node->depth = depth;
+    strcpy(node->depth_ext_ip, ext_ip);
+    node->depth_ext_port = ext_port;
+
     for (int i = 0; i < MAX_NEIGHBORS; i++)
     {
-        if (node->neighbors[i].is_valid && (node->neighbors[i].type == NEIGHBOR_TYPE_EXTERNAL || node->neighbors[i].type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL))
+        if (node->neighbors[i].is_valid && node->neighbors[i].socket_sd != -1 &&
+            node->neighbors[i].type != NEIGHBOR_TYPE_PENDING_INCOMING)
         {
-            return &node->neighbors[i];
+            send_depth_message(node->neighbors[i].socket_sd, node);
         }
     }
-    return NULL; // Nenhum vizinho externo encontrado
 }
 
-// Funções para conexão
+// Atalhos por passeio aleatório
+// Um nó que quer atalhos envia WALK <ttl> <ip> <porto> a um vizinho ao acaso; cada nó decrementa o ttl
+// e passa o passeio a outro vizinho ao acaso. O nó onde o ttl chega a zero liga-se à origem e envia
+// SHORTCUT <ip> <porto>. Os atalhos são usados pelo encaminhamento mas ignorados pela reparação da árvore.
 
 /**
- * @brief Tenta conectar-se a um nó alvo via TCP e adiciona-o como vizinho EXTERNAL.
+ * @brief Envia (ou reencaminha) um passeio aleatório.
  *
- * @param node Ponteiro para a estrutura NDNNode.
- * @param target_ip IP do nó alvo.
- * @param target_tcp_port Porto TCP do nó alvo.
- * @return O socket descriptor da conexão estabelecida, ou -1 em caso de erro.
+ * @param target_sd Socket descriptor do vizinho alvo.
+ * @param node Ponteiro para a estrutura NDNNode (remetente).
+ * @param ttl Saltos que faltam ao passeio.
+ * @param origin_ip IP do nó que pediu o atalho.
+ * @param origin_port Porto TCP do nó que pediu o atalho.
  */
-int connect_to_node(NDNNode *node, const char *target_ip, int target_tcp_port)
+void send_walk_message(int target_sd, NDNNode *node, int ttl, const char *origin_ip, int origin_port)
 {
-    // Primeiro, verifica se já é vizinho (pode ser interno ou pendente)
-    Neighbor *existing_neighbor = find_neighbor_by_addr(node, target_ip, target_tcp_port);
-    if (existing_neighbor && existing_neighbor->is_valid)
+    char message[MAX_TCP_MSG_LEN];
+    snprintf(message, sizeof(message), "WALK %d %s %d\n", ttl, origin_ip, origin_port);
+    if (send_neighbor_message(node, target_sd, message) == -1)
     {
-        return existing_neighbor->socket_sd;
+        remove_neighbor(node, target_sd);
     }
+}
 
-    int client_sd = socket(AF_INET, SOCK_STREAM, 0);
-    if (client_sd == -1)
+/**
+ * @brief Identifica um atalho acabado de abrir perante o nó que o pediu.
+ *
+ * @param target_sd Socket descriptor do atalho.
+ * @param node Ponteiro para a estrutura NDNNode (remetente).
+ */
+void send_shortcut_message(int target_sd, NDNNode *node)
+{
+    char message[MAX_TCP_MSG_LEN];
+    snprintf(message, sizeof(message), "SHORTCUT %s %d\n", node->ip, node->tcp_port);
+    if (send_neighbor_message(node, target_sd, message) == -1)
     {
-        perror("Erro ao criar socket cliente TCP");
-        return -1;
+        remove_neighbor(node, target_sd);
     }
+}
 
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(target_tcp_port);
-    if (inet_pton(AF_INET, target_ip, &server_addr.sin_addr) <= 0)
+int count_shortcuts(NDNNode *node)
+{
+    int count = 0;
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
     {
-        perror("Erro em inet_pton para IP alvo");
-        close(client_sd);
-        return -1;
+        if (node->neighbors[i].is_valid && node->neighbors[i].type == NEIGHBOR_TYPE_SHORTCUT)
+        {
+            count++;
+        }
     }
+    return count;
+}
 
-    if (connect(client_sd, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1)
+/**
+ * @brief Fecha todos os atalhos (quando o modo é desativado).
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ */
+void close_shortcuts(NDNNode *node)
+{
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
     {
-        if (errno == ECONNREFUSED)
-        {
-            fprintf(stderr, "Conexão recusada por %s:%d. Nó pode não estar ativo ou porta errada.\n", target_ip, target_tcp_port);
-        }
-        else
+        if (node->neighbors[i].is_valid && node->neighbors[i].type == NEIGHBOR_TYPE_SHORTCUT)
         {
-            perror("Erro ao conectar ao nó alvo");
+            remove_neighbor(node, node->neighbors[i].socket_sd);
         }
-        close(client_sd);
-        return -1;
     }
+}
 
-    // Adicionar o nó como vizinho EXTERNAL. O tipo será ajustado pelo outro lado.
-    int neighbor_idx = add_neighbor(node, target_ip, target_tcp_port, client_sd, NEIGHBOR_TYPE_EXTERNAL);
-    if (neighbor_idx != -1)
+/**
+ * @brief Escolhe ao acaso o próximo salto de um passeio, evitando voltar para trás se possível.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param from_sd Vizinho de onde veio o passeio (-1 na origem).
+ * @return Socket descriptor do vizinho escolhido, ou -1 se não há nenhum.
+ */
+static int pick_walk_neighbor(NDNNode *node, int from_sd)
+{
+    int candidates[MAX_NEIGHBORS];
+    int num_candidates = 0;
+    for (int i = 0; i < MAX_NEIGHBORS; i++)
     {
-        send_entry_message(client_sd, node); // Envia ENTRY para o nó conectado
-        return client_sd;
+        Neighbor *neighbor = &node->neighbors[i];
+        if (neighbor->is_valid && neighbor->socket_sd != -1 && neighbor->socket_sd != from_sd &&
+            neighbor->type != NEIGHBOR_TYPE_PENDING_INCOMING)
+        {
+            candidates[num_candidates++] = neighbor->socket_sd;
+        }
     }
-    else
+    if (num_candidates == 0)
     {
-        close(client_sd);
-        return -1;
+        return from_sd;
     }
+    return candidates[rand() % num_candidates];
 }
 
 /**
- * @brief Processa uma nova conexão TCP de entrada (chamada por accept no ndn_node.c).
- * Adiciona o vizinho como PENDING_INCOMING.
+ * @brief Trata um passeio recebido: reencaminha-o ou, no fim, abre o atalho até à origem.
  *
  * @param node Ponteiro para a estrutura NDNNode.
- * @param new_socket_sd O socket descriptor da nova conexão aceita.
- * @param client_ip O IP de origem da conexão (temporário).
- * @param client_port O porto de origem da conexão (temporário).
+ * @param client_sd Vizinho de onde veio o passeio.
+ * @param ttl Saltos que faltavam ao passeio.
+ * @param origin_ip IP do nó que pediu o atalho.
+ * @param origin_port Porto TCP do nó que pediu o atalho.
  */
-void process_incoming_connection(NDNNode *node, int new_socket_sd, const char *client_ip, int client_port)
+static void handle_walk(NDNNode *node, int client_sd, int ttl, const char *origin_ip, int origin_port)
 {
+    if (ttl > 1)
+    {
+        int next_sd = pick_walk_neighbor(node, client_sd);
+        if (next_sd != -1)
+        {
+            send_walk_message(next_sd, node, ttl - 1, origin_ip, origin_port);
+        }
+        return;
+    }
 
-    // Verificar se já temos uma conexão ACEITA (PENDING_INCOMING) para este SD, ou se já é um vizinho.
-    Neighbor *existing_sd_neighbor = find_neighbor_by_sd(node, new_socket_sd);
-    if (existing_sd_neighbor && existing_sd_neighbor->is_valid)
+    // Fim do passeio: o atalho só vale a pena se a origem não for já um vizinho
+    if ((strcmp(origin_ip, node->ip) == 0 && origin_port == node->tcp_port) ||
+        find_neighbor_by_addr(node, origin_ip, origin_port) || count_shortcuts(node) >= SHORTCUT_MAX_LINKS ||
+        node->num_active_neighbors >= MAX_NEIGHBORS || node->is_leaving)
     {
-        fprintf(stderr, "Aviso: Nova conexão aceita (SD: %d) já existe como vizinho. Pode ser reabertura ou erro.\n", new_socket_sd);
-        close(new_socket_sd); // Fechar a duplicata
         return;
     }
 
-    // Adicionar o vizinho com o tipo PENDING_INCOMING. IP/Porta serão atualizados pela mensagem ENTRY.
-    add_neighbor(node, client_ip, client_port, new_socket_sd, NEIGHBOR_TYPE_PENDING_INCOMING);
+    if (has_pending_connect(node, origin_ip, origin_port))
+    {
+        return;
+    }
+    start_pending_connect(node, origin_ip, origin_port, PENDING_CONNECT_SHORTCUT);
 }
 
-// Funções de envio de mensagens de topologia
-
 /**
- * @brief Envia uma mensagem ENTRY para um vizinho.
+ * @brief Conclui a abertura de um atalho: a conexão à origem do passeio terminou.
  *
- * @param target_sd Socket descriptor do vizinho alvo.
- * @param node Ponteiro para a estrutura NDNNode (remetente).
+ * @param node Ponteiro para a estrutura NDNNode.
+ * @param origin_ip IP do nó que pediu o atalho.
+ * @param origin_port Porto TCP do nó que pediu o atalho.
+ * @param sd Socket da conexão, ou -1 se falhou.
  */
-void send_entry_message(int target_sd, NDNNode *node)
+static void shortcut_connected(NDNNode *node, const char *origin_ip, int origin_port, int sd)
 {
-    char message[MAX_TCP_MSG_LEN];
-    snprintf(message, sizeof(message), "ENTRY %s %d\n", node->ip, node->tcp_port);
-    if (write(target_sd, message, strlen(message)) == -1)
+    if (sd == -1)
     {
-        perror("Erro ao enviar mensagem ENTRY");
-        remove_neighbor(node, target_sd);
+        return;
+    }
+    // Entretanto a origem pode ter passado a vizinho, ou o nó pode ter atingido o limite de atalhos
+    if (find_neighbor_by_addr(node, origin_ip, origin_port) || count_shortcuts(node) >= SHORTCUT_MAX_LINKS ||
+        node->is_leaving)
+    {
+        close(sd);
+        return;
     }
+    if (add_neighbor(node, origin_ip, origin_port, sd, NEIGHBOR_TYPE_SHORTCUT) == -1)
+    {
+        return; // add_neighbor já fechou o socket
+    }
+    send_shortcut_message(sd, node);
+    LOG_INFO("Atalho aberto para %s:%d (SD: %d).\n", origin_ip, origin_port, sd);
 }
 
 /**
- * @brief Envia uma mensagem LEAVE para um vizinho.
+ * @brief Instante do próximo passeio aleatório, ou -1 se o nó não precisa de mais atalhos.
  *
- * @param target_sd Socket descriptor do vizinho alvo.
- * @param node Ponteiro para a estrutura NDNNode (remetente).
+ * @param node Ponteiro para a estrutura NDNNode.
  */
-void send_leave_message(int target_sd, NDNNode *node)
+long long shortcut_next_deadline_ms(NDNNode *node)
 {
-    char message[MAX_TCP_MSG_LEN];
-    Neighbor *external = get_external_neighbor(node);
-    if (external)
+    if (node->shortcut_target <= 0 || node->is_leaving || count_tree_neighbors(node) == 0 ||
+        count_shortcuts(node) >= node->shortcut_target)
     {
-        snprintf(message, sizeof(message), "LEAVE %s %d\n", external->ip, external->tcp_port);
+        return -1;
     }
-    else
+    return node->shortcut_next_ms;
+}
+
+/**
+ * @brief Enquanto faltarem atalhos, lança um passeio aleatório a cada SHORTCUT_WALK_INTERVAL_MS.
+ *
+ * @param node Ponteiro para a estrutura NDNNode.
+ */
+void check_shortcuts(NDNNode *node)
+{
+    long long now_ms = ndn_now_ms();
+    if (shortcut_next_deadline_ms(node) == -1 || node->shortcut_next_ms > now_ms)
     {
-        snprintf(message, sizeof(message), "LEAVE %s %d\n", node->ip, node->tcp_port);
+        return;
     }
+    node->shortcut_next_ms = now_ms + SHORTCUT_WALK_INTERVAL_MS;
 
-    if (write(target_sd, message, strlen(message)) == -1)
+    int first_sd = pick_walk_neighbor(node, -1);
+    if (first_sd != -1)
     {
-        perror("Erro ao enviar mensagem LEAVE");
-        remove_neighbor(node, target_sd);
+        send_walk_message(first_sd, node, SHORTCUT_WALK_TTL, node->ip, node->tcp_port);
     }
 }
 
@@ -287,16 +1306,19 @@ void handle_tcp_data_received(NDNNode *node, int client_sd, char *data, ssize_t
     Neighbor *neighbor = find_neighbor_by_sd(node, client_sd);
     if (!neighbor)
     {
-        fprintf(stderr, "Erro: Dados recebidos de SD %d, mas vizinho não encontrado.\n", client_sd);
+        LOG_ERROR("Erro: Dados recebidos de SD %d, mas vizinho não encontrado.\n", client_sd);
         return;
     }
 
     if (neighbor->recv_buffer_pos + len >= MAX_TCP_RECV_BUFFER_SIZE)
     {
-        fprintf(stderr, "Erro: Buffer de receção de vizinho SD %d cheio. Descartando dados.\n", client_sd);
+        LOG_WARN("Erro: Buffer de receção de vizinho SD %d cheio. Descartando dados.\n", client_sd);
         neighbor->recv_buffer_pos = 0; // Resetar para evitar estouro contínuo
         return;
     }
+    neighbor->last_heard_ms = ndn_now_ms(); // Qualquer dado recebido prova que o vizinho está vivo
+    metrics_count_bytes_in(node, neighbor, len);
+
     memcpy(neighbor->recv_buffer + neighbor->recv_buffer_pos, data, len);
     neighbor->recv_buffer_pos += len;
     neighbor->recv_buffer[neighbor->recv_buffer_pos] = '\0';
@@ -310,6 +1332,8 @@ void handle_tcp_data_received(NDNNode *node, int client_sd, char *data, ssize_t
 
         if (strlen(msg_start) > 0)
         {
+            metrics_count_received(node, neighbor, msg_start);
+            CAPTURE_RECEIVED(node, neighbor, msg_start);
             process_complete_tcp_message(node, client_sd, msg_start);
         }
 
@@ -362,9 +1386,9 @@ void process_complete_tcp_message(NDNNode *node, int client_sd, const char *mess
                         }
 
                         // Lógica de classificação:
-                        // Se o nó (o que aceita) não tinha vizinho externo E só tem um vizinho ativo (o que acabou de se conectar)
+                        // Se o nó (o que aceita) não tinha vizinho externo E só tem um vizinho na árvore (o que acabou de se conectar; os atalhos não contam)
                         // então é o cenário de dois nós.
-                        if (get_external_neighbor(node) == NULL && node->num_active_neighbors == 1)
+                        if (get_external_neighbor(node) == NULL && count_tree_neighbors(node) == 1)
                         {
                             neighbor_conn->type = NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL;
                         }
@@ -373,6 +1397,7 @@ void process_complete_tcp_message(NDNNode *node, int client_sd, const char *mess
                             // Em todos os outros casos, é um vizinho interno "normal"
                             neighbor_conn->type = NEIGHBOR_TYPE_INTERNAL;
                         }
+                        send_depth_message(client_sd, node); // O novo vizinho calcula a sua profundidade a partir desta
                     }
                     else
                     {
@@ -380,114 +1405,125 @@ void process_complete_tcp_message(NDNNode *node, int client_sd, const char *mess
                         // ou se a conexão foi estabelecida de uma forma que o SD não foi ainda registado.
                         // Adiciona como vizinho interno
                         int idx = add_neighbor(node, ip_str, tcp_port, client_sd, NEIGHBOR_TYPE_INTERNAL);       // Adiciona como INTERNAL por padrão
-                        if (idx != -1 && get_external_neighbor(node) == NULL && node->num_active_neighbors == 1) // Se é o único vizinho e não tem externo
+                        if (idx != -1 && get_external_neighbor(node) == NULL && count_tree_neighbors(node) == 1) // Se é o único vizinho da árvore e não tem externo
                         {
                             node->neighbors[idx].type = NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL; // Promove a EXTERNAL_AND_INTERNAL
                         }
+                        if (idx != -1)
+                        {
+                            send_depth_message(client_sd, node);
+                        }
                     }
                 }
                 else if (strcmp(cmd, "LEAVE") == 0)
                 {
+                    handle_neighbor_leave(node, client_sd, ip_str, tcp_port);
+                }
+            }
+            else // Se o comando NÃO é ENTRY nem LEAVE (mas é uma mensagem TCP com um comando)
+            {
+                LOG_WARN("Tipo de mensagem TCP desconhecido de topologia: '%s' (de SD %d)\n", cmd, client_sd);
+            }
+        }
+        // Heartbeats: PING <instante> <ip externo> <porto externo> e PONG <instante>
+        else if (strcmp(cmd, "PING") == 0 || strcmp(cmd, "PONG") == 0)
+        {
+            Neighbor *neighbor = find_neighbor_by_sd(node, client_sd);
+            long long sent_us;
+            char ip_str[MAX_IP_LEN];
+            int tcp_port;
+            if (!neighbor || sscanf(message, "%*s %lld", &sent_us) != 1)
+            {
+                LOG_WARN("Mensagem %s mal formatada (de SD %d): '%s'\n", cmd, client_sd, message);
+                return;
+            }
+            neighbor->heartbeat_capable = 1;
 
-                    Neighbor *removed_neighbor = find_neighbor_by_sd(node, client_sd);
-                    if (!removed_neighbor || !removed_neighbor->is_valid)
-                    {
-                        fprintf(stderr, "Erro: LEAVE recebido de SD %d, mas vizinho não encontrado ou inválido.\n", client_sd);
-                        return;
-                    }
-
-                    // Determinar se o vizinho que saiu era o vizinho externo deste nó
-                    int was_external = (removed_neighbor->type == NEIGHBOR_TYPE_EXTERNAL || removed_neighbor->type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL);
-
-                    remove_neighbor(node, client_sd); // Sempre remove o vizinho que enviou LEAVE
+            if (strcmp(cmd, "PING") == 0)
+            {
+                if (sscanf(message, "%*s %*s %15s %d", ip_str, &tcp_port) == 2)
+                {
+                    strcpy(neighbor->recovery_ip, ip_str);
+                    neighbor->recovery_tcp_port = tcp_port;
+                }
+                send_pong_message(client_sd, node, sent_us);
+            }
+            else
+            {
+                long long sample_us = ndn_now_us() - sent_us;
+                neighbor->srtt_us = (neighbor->srtt_us == 0) ? sample_us : (7 * neighbor->srtt_us + sample_us) / 8;
+            }
+        }
+        // Atalhos: WALK <ttl> <ip origem> <porto origem> e SHORTCUT <ip> <porto>
+        else if (strcmp(cmd, "WALK") == 0 || strcmp(cmd, "SHORTCUT") == 0)
+        {
+            int ttl = 0;
+            char ip_str[MAX_IP_LEN];
+            int tcp_port;
+            int parsed = (strcmp(cmd, "WALK") == 0) ? (sscanf(message, "%*s %d %15s %d", &ttl, ip_str, &tcp_port) == 3)
+                                                    : (sscanf(message, "%*s %15s %d", ip_str, &tcp_port) == 2);
+            if (!parsed)
+            {
+                LOG_WARN("Mensagem %s mal formatada (de SD %d): '%s'\n", cmd, client_sd, message);
+                return;
+            }
 
-                    if (was_external)
-                    {
+            if (strcmp(cmd, "WALK") == 0)
+            {
+                handle_walk(node, client_sd, ttl, ip_str, tcp_port);
+                return;
+            }
 
-                        // Analisa o identificador contido na mensagem LEAVE (vizinho externo do REMETENTE do LEAVE)
-                        if (strcmp(ip_str, node->ip) != 0 || tcp_port != node->tcp_port)
-                        {
-                            // Se não for o próprio nó local, tentar conectar a ele como novo vizinho externo.
-                            Neighbor *potential_new_external = find_neighbor_by_addr(node, ip_str, tcp_port);
-                            if (potential_new_external)
-                            {
-                                // Se já está conectado, promove a externo ou EXTERNAL_AND_INTERNAL se apropriado
-                                if (potential_new_external->type == NEIGHBOR_TYPE_INTERNAL || potential_new_external->type == NEIGHBOR_TYPE_PENDING_INCOMING)
-                                {
-                                    // Se a rede agora tem apenas um vizinho (o que será promovido)
-                                    if (node->num_active_neighbors == 1)
-                                    { // Só sobrou um vizinho (o que será promovido)
-                                        potential_new_external->type = NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL;
-                                    }
-                                    else
-                                    {
-                                        potential_new_external->type = NEIGHBOR_TYPE_EXTERNAL;
-                                    }
-                                }
-                                // Se já era EXTERNAL_AND_INTERNAL ou EXTERNAL, mantém.
-                            }
-                            else
-                            {
-                                // Se não estava conectado, tenta iniciar uma nova conexão TCP e adiciona como EXTERNAL
-                                int new_sd = connect_to_node(node, ip_str, tcp_port); // connect_to_node já adiciona como EXTERNAL e envia ENTRY
-                                if (new_sd != -1)
-                                {
-                                    printf("  Conectado com sucesso a %s:%d como novo vizinho externo.\n", ip_str, tcp_port);
-                                }
-                                else
-                                {
-                                    printf("  Falha ao conectar a %s:%d para ser novo vizinho externo.\n", ip_str, tcp_port);
-                                }
-                            }
-                        }
-                        else // O vizinho externo do nó que saiu era o próprio nó local.
-                        {
-                            // Este nó se tornou a "raiz" de uma sub-árvore que foi desconectada.
-                            // Promover um vizinho interno existente a externo.
-                            Neighbor *promoted_neighbor = NULL;
-                            for (int i = 0; i < MAX_NEIGHBORS; i++)
-                            {
-                                if (node->neighbors[i].is_valid && (node->neighbors[i].type == NEIGHBOR_TYPE_INTERNAL || node->neighbors[i].type == NEIGHBOR_TYPE_PENDING_INCOMING))
-                                { // Procura um interno ou pendente para promover
-                                    promoted_neighbor = &node->neighbors[i];
-                                    break;
-                                }
-                            }
-                            if (promoted_neighbor)
-                            {
-                                // Se este é o único vizinho restante (rede de 2 nós agora)
-                                if (node->num_active_neighbors == 1)
-                                {
-                                    promoted_neighbor->type = NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL;
-                                }
-                                else
-                                {
-                                    promoted_neighbor->type = NEIGHBOR_TYPE_EXTERNAL;
-                                }
-                            }
-                        }
-                    }
-                }
+            // Conexão aceite de um nó no fim de um passeio: passa a atalho
+            Neighbor *neighbor = find_neighbor_by_sd(node, client_sd);
+            if (!neighbor || neighbor->type != NEIGHBOR_TYPE_PENDING_INCOMING)
+            {
+                return;
             }
-            else // Se o comando NÃO é ENTRY nem LEAVE (mas é uma mensagem TCP com um comando)
+            if (count_shortcuts(node) >= SHORTCUT_MAX_LINKS || find_neighbor_by_addr(node, ip_str, tcp_port))
+            {
+                remove_neighbor(node, client_sd);
+                return;
+            }
+            strcpy(neighbor->ip, ip_str);
+            neighbor->tcp_port = tcp_port;
+            neighbor->type = NEIGHBOR_TYPE_SHORTCUT;
+            LOG_INFO("Atalho aceite de %s:%d (SD: %d).\n", ip_str, tcp_port, client_sd);
+        }
+        // Profundidade do vizinho: DEPTH <profundidade> <ip externo> <porto externo>
+        else if (strcmp(cmd, "DEPTH") == 0)
+        {
+            Neighbor *neighbor = find_neighbor_by_sd(node, client_sd);
+            int depth;
+            char ip_str[MAX_IP_LEN];
+            int tcp_port;
+            if (!neighbor || sscanf(message, "%*s %d %15s %d", &depth, ip_str, &tcp_port) != 3)
+            {
+                LOG_WARN("Mensagem DEPTH mal formatada (de SD %d): '%s'\n", client_sd, message);
+                return;
+            }
+            neighbor->depth = depth;
+            neighbor->external_is_me = (strcmp(ip_str, node->ip) == 0 && tcp_port == node->tcp_port);
+            if (node->repair_in_progress && client_sd == node->repair_confirm_sd)
             {
-                fprintf(stderr, "Tipo de mensagem TCP desconhecido de topologia: '%s' (de SD %d)\n", cmd, client_sd);
+                confirm_repair_member(node, neighbor);
             }
         }
-        // Se o comando é uma mensagem NDN (INTEREST, OBJECT, NOOBJECT)
-        else if (strcmp(cmd, "INTEREST") == 0 || strcmp(cmd, "OBJECT") == 0 || strcmp(cmd, "NOOBJECT") == 0)
+        // Se o comando é uma mensagem NDN (INTEREST, OBJECT, NOOBJECT, CANCEL)
+        else if (strcmp(cmd, "INTEREST") == 0 || strcmp(cmd, "OBJECT") == 0 || strcmp(cmd, "NOOBJECT") == 0 ||
+                 strcmp(cmd, "CANCEL") == 0)
         {
             process_ndn_message(node, client_sd, message); // Encaminha para o módulo NDN
         }
         // Se o comando NÃO é de topologia nem NDN
         else
         {
-            fprintf(stderr, "Comando TCP '%s' desconhecido (de SD %d)\n", cmd, client_sd);
+            LOG_WARN("Comando TCP '%s' desconhecido (de SD %d)\n", cmd, client_sd);
         }
     }
     // Se não foi possível ler o comando (mensagem vazia ou mal formatada no início)
     else
     {
-        fprintf(stderr, "Mensagem TCP recebida vazia ou mal formatada para comando (de SD %d): '%s'\n", client_sd, message);
+        LOG_WARN("Mensagem TCP recebida vazia ou mal formatada para comando (de SD %d): '%s'\n", client_sd, message);
     }
 }
\ No newline at end of file
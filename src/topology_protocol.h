@@ -10,13 +10,48 @@ Neighbor *find_neighbor_by_sd(NDNNode *node, int sd);
 Neighbor *find_neighbor_by_addr(NDNNode *node, const char *ip, int port);
 Neighbor *get_external_neighbor(NDNNode *node);
 
+int count_tree_neighbors(NDNNode *node); // Vizinhos da árvore (exclui atalhos)
+
 // Funções para conexão
-int connect_to_node(NDNNode *node, const char *target_ip, int target_tcp_port);
+int connect_to_node(NDNNode *node, const char *target_ip, int target_tcp_port); // Não bloqueia (direct join)
+int adopt_outgoing_connection(NDNNode *node, const char *target_ip, int target_tcp_port, int client_sd);
 void process_incoming_connection(NDNNode *node, int new_socket_sd, const char *client_ip, int client_port);
 
+// Conexões de saída não bloqueantes (chamadas pelo loop principal)
+int connect_fill_write_fds(NDNNode *node, fd_set *write_fds, int max_fd);
+void connect_handle_writable(NDNNode *node, fd_set *write_fds);
+long long connect_next_deadline_ms(NDNNode *node);
+void check_connect_timeouts(NDNNode *node);
+void cancel_pending_connects(NDNNode *node); // Fecha as conexões em curso (saída da rede ou fim do nó)
+
+// Envio de uma mensagem a um vizinho (conta-a nas métricas)
+int send_neighbor_message(NDNNode *node, int target_sd, const char *message);
+
 // Funções para mensagens de topologia
 void send_entry_message(int target_sd, NDNNode *node);
 void send_leave_message(int target_sd, NDNNode *node);
+void send_ping_message(int target_sd, NDNNode *node);
+void send_pong_message(int target_sd, NDNNode *node, long long ping_time_us);
+void send_depth_message(int target_sd, NDNNode *node);
+void send_walk_message(int target_sd, NDNNode *node, int ttl, const char *origin_ip, int origin_port);
+void send_shortcut_message(int target_sd, NDNNode *node);
+
+// Recalcula a profundidade do nó e anuncia-a aos vizinhos se mudou (chamada pelo loop principal)
+void update_node_depth(NDNNode *node);
+
+// Reparação da topologia quando um vizinho sai (LEAVE) ou é dado como falhado
+void handle_neighbor_failure(NDNNode *node, int sd);
+void handle_neighbor_leave(NDNNode *node, int client_sd, const char *ip_str, int tcp_port);
+
+// Heartbeats e deteção de falhas (chamadas pelo loop principal)
+long long heartbeat_next_deadline_ms(NDNNode *node);
+void check_heartbeats(NDNNode *node);
+
+// Atalhos por passeio aleatório (chamadas pelo loop principal e pela interface)
+long long shortcut_next_deadline_ms(NDNNode *node);
+void check_shortcuts(NDNNode *node);
+int count_shortcuts(NDNNode *node);
+void close_shortcuts(NDNNode *node);
 
 // Função para processar dados brutos recebidos e extrair mensagens completas
 void handle_tcp_data_received(NDNNode *node, int client_sd, char *data, ssize_t len);
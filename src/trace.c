@@ -0,0 +1,156 @@
+#include "trace.h"
+#include "topology_protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
+
+void init_trace(NDNNode *node)
+{
+    node->trace_fd = -1;
+    node->trace_failed = 0;
+    const char *path = getenv("NDN_TRACE_FILE");
+    if (path && path[0])
+    {
+        snprintf(node->trace_path, sizeof(node->trace_path), "%s", path);
+    }
+    else
+    {
+        snprintf(node->trace_path, sizeof(node->trace_path), TRACE_FILE_FORMAT, node->tcp_port);
+    }
+}
+
+void close_trace(NDNNode *node)
+{
+    if (node->trace_fd != -1)
+    {
+        close(node->trace_fd);
+        node->trace_fd = -1;
+    }
+}
+
+// O ficheiro só é aberto no primeiro evento: os nós por onde não passa nenhuma pesquisa rastreada
+// não criam ficheiro. Os eventos de execuções anteriores são mantidos (cada um tem o seu identificador).
+static int open_trace_file(NDNNode *node)
+{
+    if (node->trace_fd != -1)
+    {
+        return 0;
+    }
+    if (node->trace_failed)
+    {
+        return -1;
+    }
+    int fd = open(node->trace_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1)
+    {
+        fprintf(stderr, "Aviso: rastreio indisponível em %s: %s\n", node->trace_path, strerror(errno));
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        node->trace_failed = 1;
+        return -1;
+    }
+    if (st.st_size == 0 && write(fd, TRACE_FILE_MAGIC, TRACE_MAGIC_LEN) != TRACE_MAGIC_LEN)
+    {
+        close(fd);
+        node->trace_failed = 1;
+        return -1;
+    }
+    node->trace_fd = fd;
+    return 0;
+}
+
+unsigned long long new_trace_id(NDNNode *node)
+{
+    unsigned long long id;
+    do
+    {
+        id = ((unsigned long long)rand() << 33) ^ ((unsigned long long)rand() << 11) ^ (unsigned long long)ndn_now_us() ^
+             ((unsigned long long)node->tcp_port << 48);
+    } while (id == 0);
+    return id;
+}
+
+void format_trace_option(char *option, unsigned long long trace_id)
+{
+    if (trace_id)
+    {
+        snprintf(option, TRACE_OPTION_LEN, " T=%llx", trace_id);
+    }
+    else
+    {
+        option[0] = '\0';
+    }
+}
+
+static unsigned char *put_le(unsigned char *p, unsigned long long value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        *p++ = (unsigned char)(value >> (8 * i));
+    }
+    return p;
+}
+
+static unsigned long ipv4_value(const char *ip)
+{
+    struct in_addr addr;
+    return inet_pton(AF_INET, ip, &addr) == 1 ? ntohl(addr.s_addr) : 0;
+}
+
+void trace_event(NDNNode *node, unsigned long long trace_id, TraceEvent event, int face_sd, unsigned char interest_id,
+                 const char *name)
+{
+    if (open_trace_file(node) == -1)
+    {
+        return;
+    }
+
+    // Instante de relógio de parede: os ficheiros de nós diferentes são comparados entre si
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    long long time_us = (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+    unsigned long peer_ip = 0;
+    int peer_port = 0;
+    Neighbor *face = (face_sd != STDIN_FILENO) ? find_neighbor_by_sd(node, face_sd) : NULL;
+    if (face)
+    {
+        peer_ip = ipv4_value(face->ip);
+        peer_port = face->tcp_port;
+    }
+
+    size_t name_len = strlen(name);
+    if (name_len > 255)
+    {
+        name_len = 255;
+    }
+
+    unsigned char record[TRACE_RECORD_HEADER_LEN + 255];
+    unsigned char *p = record;
+    p = put_le(p, trace_id, 8);
+    p = put_le(p, (unsigned long long)time_us, 8);
+    p = put_le(p, ipv4_value(node->ip), 4);
+    p = put_le(p, (unsigned long long)node->tcp_port, 2);
+    p = put_le(p, peer_ip, 4);
+    p = put_le(p, (unsigned long long)peer_port, 2);
+    *p++ = (unsigned char)event;
+    *p++ = interest_id;
+    *p++ = (unsigned char)name_len;
+    memcpy(p, name, name_len);
+    p += name_len;
+
+    // Uma escrita por registo com O_APPEND: o registo fica inteiro mesmo que o nó termine a seguir
+    if (write(node->trace_fd, record, p - record) == -1)
+    {
+        fprintf(stderr, "Aviso: erro ao escrever em %s: %s\n", node->trace_path, strerror(errno));
+    }
+}
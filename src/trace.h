@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "ndn_node.h"
+
+// Rastreio de pesquisas entre nós. Um INTEREST/OBJECT/NOOBJECT com o campo opcional "T=<hex>" é
+// rastreado: cada nó do caminho acrescenta os eventos da pesquisa ao seu ficheiro de rastreio, e
+// tools/trace_stitch junta os ficheiros de vários nós numa linha temporal por pesquisa.
+// A variável de ambiente NDN_TRACE_FILE substitui o caminho por omissão.
+#define TRACE_FILE_FORMAT "/tmp/ndn-%d.trace" // Porto TCP do nó
+#define TRACE_OPTION_LEN 24                   // " T=" + 16 dígitos hexadecimais
+
+// Formato do ficheiro (inteiros em little-endian): TRACE_FILE_MAGIC e depois registos com
+//   identificador de rastreio (8), instante em µs desde a época (8), IPv4 e porto do nó (4 + 2),
+//   IPv4 e porto da interface (4 + 2, zero para o utilizador local), evento (1),
+//   identificador de procura (1), comprimento do nome (1) e o nome (sem '\0').
+#define TRACE_FILE_MAGIC "NDNTRC01"
+#define TRACE_MAGIC_LEN 8
+#define TRACE_RECORD_HEADER_LEN 31
+
+typedef enum
+{
+    TRACE_ISSUED = 1,        // Tentativa de pesquisa enviada pelo utilizador local
+    TRACE_INTEREST_RECEIVED, // INTEREST recebido de uma interface
+    TRACE_PIT_HIT,           // INTEREST já presente na PIT (repetição ou ciclo)
+    TRACE_LOCAL_HIT,         // Objeto encontrado nos objetos locais
+    TRACE_CACHE_HIT,         // Objeto encontrado na cache
+    TRACE_FORWARDED,         // INTEREST enviado para uma interface
+    TRACE_OBJECT_RECEIVED,   // OBJECT recebido de uma interface
+    TRACE_NOOBJECT_RECEIVED, // NOOBJECT recebido de uma interface
+    TRACE_OBJECT_SENT,       // Resposta OBJECT enviada para uma interface
+    TRACE_NOOBJECT_SENT,     // Resposta NOOBJECT enviada para uma interface
+    TRACE_DELIVERED,         // Objeto entregue ao utilizador local
+    TRACE_NOT_FOUND,         // Pesquisa do utilizador local terminada com NOOBJECT
+    TRACE_TIMEOUT,           // Tentativa do utilizador local sem resposta
+    TRACE_EVENT_COUNT
+} TraceEvent;
+
+// Só chama trace_event para mensagens rastreadas: as restantes custam uma comparação
+#define TRACE_EVENT(node, trace_id, ...)                  \
+    do                                                    \
+    {                                                     \
+        if (trace_id)                                     \
+        {                                                 \
+            trace_event((node), (trace_id), __VA_ARGS__); \
+        }                                                 \
+    } while (0)
+
+void init_trace(NDNNode *node);
+void close_trace(NDNNode *node);
+
+unsigned long long new_trace_id(NDNNode *node);
+void format_trace_option(char *option, unsigned long long trace_id); // " T=<hex>", ou "" se não rastreado
+void trace_event(NDNNode *node, unsigned long long trace_id, TraceEvent event, int face_sd, unsigned char interest_id,
+                 const char *name);
+
+#endif // TRACE_H
@@ -1,13 +1,8 @@
 #include "ui_handler.h"
-#include "ndn_node.h"
-#include "registration_protocol.h"
-#include "topology_protocol.h"
-#include "ndn_protocol.h" // Incluir o novo cabeçalho para as funções NDN
+#include "libndn.h" // Só a interface pública da biblioteca: o executável não vê o estado do nó
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <arpa/inet.h>
-#include <unistd.h> // Para usleep
 
 // Implementação da função print_help()
 void print_help()
@@ -18,22 +13,33 @@ void print_help()
     printf("  create (c) <name>     - Criação de um objeto com nome\n");
     printf("  delete (dl) <name>    - Remoção do objeto com nome\n");
     printf("  retrieve (r) <name>   - Pesquisa do objeto com nome\n");
+    printf("  ring retrieve (rr) <name> - Pesquisa com alcance crescente (1, 2, 4, ... saltos)\n");
+    printf("  capture [start [ficheiro]|stop] - Captura das mensagens dos vizinhos (ver tools/replay)\n");
+    printf("  trace (tr) <name>     - Pesquisa rastreada em todos os nós do caminho (ver tools/trace_stitch)\n");
     printf("  show topology (st)    - Visualização dos vizinhos\n");
     printf("  show names (sn)       - Visualização dos nomes de objetos guardados\n");
     printf("  show interest table (si) - Visualização da tabela de interesses pendentes\n");
+    printf("  show ring (sr)        - Alcance a que as pesquisas em anel foram satisfeitas\n");
+    printf("  nodes (nl) <net> [tcp] - Lista completa dos membros de uma rede (por páginas ou por TCP)\n");
+    printf("  show strategy (sf)    - Estratégias de encaminhamento e estatísticas por interface\n");
+    printf("  show members (sm)     - Membros da rede conhecidos pela subscrição ao servidor\n");
+    printf("  show stats (ss)       - Contadores de mensagens, cache e PIT, no total e por interface\n");
+    printf("  show latency (sl)     - Percentis da latência das pesquisas (por prefixo) e das interfaces\n");
+    printf("  heartbeat (hb) <ms>   - Intervalo entre PINGs aos vizinhos (0 desativa)\n");
+    printf("  shortcuts (sc) <n>    - Manter até n atalhos por passeio aleatório (0 desativa)\n");
+    printf("  strategy (fs) <prefix|*> <flood|best-route|k-random|probe> - Estratégia para um prefixo\n");
+    printf("  log [error|warn|info|debug] - Nível das mensagens de diagnóstico (sem argumento: estado)\n");
     printf("  leave (l)             - Saída do nó da rede\n");
     printf("  exit (x)              - Fecho da aplicação\n");
     printf("  help                  - Mostra esta ajuda\n");
 }
 
-void handle_user_command(char *command_line)
+void handle_user_command(NDNNode *node, char *command_line)
 {
     char cmd[50];
     char arg1[101];
     int arg3;
 
-    NDNNode *node = get_current_ndn_node();
-
     if (sscanf(command_line, "%s", cmd) == 1)
     {
         if (strcmp(cmd, "help") == 0)
@@ -45,26 +51,7 @@ void handle_user_command(char *command_line)
             int num_scanned = sscanf(command_line, "%*s %s", arg1);
             if (num_scanned == 1)
             {
-                int net_id = atoi(arg1);
-                if (net_id < 0 || net_id > 999)
-                {
-                    printf("Erro: ID de rede inválido. Deve ser entre 000 e 999.\n");
-                    return;
-                }
-                if (node->current_net_id != -1 && node->current_net_id != net_id)
-                {
-                    printf("Erro: Nó já está na rede %03d. Saia antes de entrar em outra.\n", node->current_net_id);
-                }
-                else if (node->current_net_id == net_id)
-                {
-                    printf("Nó já está na rede %03d.\n", net_id);
-                }
-                else
-                {
-                    printf("Comando: join (rede: %03d)\n", net_id);
-                    node->current_net_id = net_id;
-                    send_nodes_request_message(node, net_id);
-                }
+                ndn_join(node, atoi(arg1));
             }
             else
             {
@@ -86,36 +73,7 @@ void handle_user_command(char *command_line)
 
             if ((num_scanned == 3 && strcmp(sub_cmd, "join") == 0) || strcmp(cmd, "dj") == 0)
             {
-                char *connect_ip = arg1;
-                int connect_tcp = arg3;
-
-                if (strcmp(connect_ip, "0.0.0.0") == 0 && connect_tcp == 0)
-                {
-                    printf("Comando: direct join (criando nova rede com este nó).\n");
-                    if (node->current_net_id == -1)
-                    {
-                        node->current_net_id = 0; // Por omissão, o primeiro nó cria a rede 000
-                        printf("Nó se registrando como primeiro na rede %03d.\n", node->current_net_id);
-                        send_reg_message(node, node->current_net_id);
-                    }
-                    else
-                    {
-                        printf("Nó já está na rede %03d. Não é possível criar nova rede com 0.0.0.0.\n", node->current_net_id);
-                    }
-                }
-                else
-                {
-                    printf("Comando: direct join (conectando a %s:%d).\n", connect_ip, connect_tcp);
-                    int connected_sd = connect_to_node(node, connect_ip, connect_tcp);
-                    if (connected_sd != -1)
-                    {
-                        printf("Conexão direta bem sucedida. Lembre-se de usar 'join <net>' para se registrar nesta rede.\n");
-                    }
-                    else
-                    {
-                        printf("Falha na conexão direta com %s:%d.\n", connect_ip, connect_tcp);
-                    }
-                }
+                ndn_direct_join(node, arg1, arg3);
             }
             else
             {
@@ -127,8 +85,7 @@ void handle_user_command(char *command_line)
             int num_scanned = sscanf(command_line, "%*s %s", arg1);
             if (num_scanned == 1)
             {
-                char *name = arg1;
-                create_local_object(node, name); // CHAMA FUNÇÃO NDN
+                ndn_create_object(node, arg1);
             }
             else
             {
@@ -140,8 +97,7 @@ void handle_user_command(char *command_line)
             int num_scanned = sscanf(command_line, "%*s %s", arg1);
             if (num_scanned == 1)
             {
-                char *name = arg1;
-                delete_local_object(node, name); // CHAMA FUNÇÃO NDN
+                ndn_delete_object(node, arg1);
             }
             else
             {
@@ -153,51 +109,87 @@ void handle_user_command(char *command_line)
             int num_scanned = sscanf(command_line, "%*s %s", arg1);
             if (num_scanned == 1)
             {
-                char *name = arg1;
-                initiate_retrieve(node, name); // CHAMA FUNÇÃO NDN
+                ndn_retrieve(node, arg1, 0, NULL, NULL); // Resultado no stdout (e nas métricas)
             }
             else
             {
                 printf("Uso: retrieve (r) <name>\n");
             }
         }
-        else if (strcmp(cmd, "show") == 0 || strcmp(cmd, "st") == 0 || strcmp(cmd, "sn") == 0 || strcmp(cmd, "si") == 0)
+        else if (strcmp(cmd, "capture") == 0)
+        {
+            char sub_cmd[50] = "";
+            int num_scanned = sscanf(command_line, "%*s %49s %s", sub_cmd, arg1);
+            if (num_scanned <= 0)
+            {
+                ndn_show_capture(node);
+            }
+            else if (strcmp(sub_cmd, "start") == 0)
+            {
+                ndn_capture_start(node, num_scanned == 2 ? arg1 : NULL);
+            }
+            else if (strcmp(sub_cmd, "stop") == 0)
+            {
+                ndn_capture_stop(node);
+            }
+            else
+            {
+                printf("Uso: capture [start [ficheiro]|stop]\n");
+            }
+        }
+        else if (strcmp(cmd, "trace") == 0 || strcmp(cmd, "tr") == 0)
+        {
+            int num_scanned = sscanf(command_line, "%*s %s", arg1);
+            if (num_scanned == 1)
+            {
+                ndn_retrieve(node, arg1, NDN_RETRIEVE_TRACED, NULL, NULL);
+            }
+            else
+            {
+                printf("Uso: trace (tr) <name>\n");
+            }
+        }
+        else if (strcmp(cmd, "ring") == 0 || strcmp(cmd, "rr") == 0)
         {
             char sub_cmd[50];
+            int num_scanned = 0;
+            if (strcmp(cmd, "ring") == 0)
+            {
+                num_scanned = sscanf(command_line, "%*s %s %s", sub_cmd, arg1);
+            }
+            if (strcmp(cmd, "rr") == 0)
+            {
+                num_scanned = sscanf(command_line, "%s %s", sub_cmd, arg1);
+            }
+
+            if (num_scanned == 2 && (strcmp(sub_cmd, "retrieve") == 0 || strcmp(cmd, "rr") == 0))
+            {
+                ndn_retrieve(node, arg1, NDN_RETRIEVE_RING, NULL, NULL);
+            }
+            else
+            {
+                printf("Uso: ring retrieve (rr) <name>\n");
+            }
+        }
+        else if (strcmp(cmd, "show") == 0 || strcmp(cmd, "st") == 0 || strcmp(cmd, "sn") == 0 || strcmp(cmd, "si") == 0 ||
+                 strcmp(cmd, "sr") == 0 || strcmp(cmd, "sf") == 0 || strcmp(cmd, "sm") == 0 || strcmp(cmd, "ss") == 0 ||
+                 strcmp(cmd, "sl") == 0)
+        {
+            char sub_cmd[50] = "";
             int num_scanned = sscanf(command_line, "%*s %s", sub_cmd);
-            if (num_scanned == 1 || strcmp(cmd, "st") == 0 || strcmp(cmd, "sn") == 0 || strcmp(cmd, "si") == 0)
+            if (num_scanned == 1 || strcmp(cmd, "st") == 0 || strcmp(cmd, "sn") == 0 || strcmp(cmd, "si") == 0 ||
+                strcmp(cmd, "sr") == 0 || strcmp(cmd, "sf") == 0 || strcmp(cmd, "sm") == 0 || strcmp(cmd, "ss") == 0 ||
+                strcmp(cmd, "sl") == 0)
             {
                 if (strcmp(sub_cmd, "topology") == 0 || strcmp(cmd, "st") == 0)
                 {
                     printf("Comando: show topology\n");
-                    printf("  Nó atual: %s:%d\n", node->ip, node->tcp_port);
-                    printf("  Rede atual: %s\n", (node->current_net_id != -1) ? "Registrado na rede " : "Não registrado em rede");
-                    if (node->current_net_id != -1)
-                    {
-                        printf("  ID da Rede: %03d\n", node->current_net_id);
-                    }
-                    Neighbor *external = get_external_neighbor(node);
-                    printf("  Vizinho Externo: %s:%d\n", external ? external->ip : "Nenhum", external ? external->tcp_port : 0);
-                    printf("  Vizinhos Internos:\n");
-                    int internal_count = 0;
-                    for (int i = 0; i < MAX_NEIGHBORS; ++i)
-                    {
-                        if (node->neighbors[i].is_valid &&
-                            (node->neighbors[i].type == NEIGHBOR_TYPE_INTERNAL || node->neighbors[i].type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL))
-                        {
-                            printf("    - %s:%d (SD: %d)\n", node->neighbors[i].ip, node->neighbors[i].tcp_port, node->neighbors[i].socket_sd);
-                            internal_count++;
-                        }
-                    }
-                    if (internal_count == 0)
-                    {
-                        printf("    (Nenhum)\n");
-                    }
+                    ndn_show_topology(node);
                 }
                 else if (strcmp(sub_cmd, "names") == 0 || strcmp(cmd, "sn") == 0)
                 {
                     printf("Comando: show names\n");
-                    show_local_objects(node); // CHAMA FUNÇÃO NDN
+                    ndn_show_names(node);
                 }
                 else if (strcmp(sub_cmd, "interest") == 0 || strcmp(cmd, "si") == 0)
                 {
@@ -206,13 +198,38 @@ void handle_user_command(char *command_line)
                     if (strcmp(next_arg, "table") == 0 || strcmp(cmd, "si") == 0)
                     {
                         printf("Comando: show interest table\n");
-                        show_interest_table(node); // CHAMA FUNÇÃO NDN
+                        ndn_show_interest_table(node);
                     }
                     else
                     {
                         printf("Comando desconhecido: %s\n", command_line);
                     }
                 }
+                else if (strcmp(sub_cmd, "ring") == 0 || strcmp(cmd, "sr") == 0)
+                {
+                    printf("Comando: show ring\n");
+                    ndn_show_ring(node);
+                }
+                else if (strcmp(sub_cmd, "strategy") == 0 || strcmp(cmd, "sf") == 0)
+                {
+                    printf("Comando: show strategy\n");
+                    ndn_show_strategy(node);
+                }
+                else if (strcmp(sub_cmd, "members") == 0 || strcmp(cmd, "sm") == 0)
+                {
+                    printf("Comando: show members\n");
+                    ndn_show_members(node);
+                }
+                else if (strcmp(sub_cmd, "stats") == 0 || strcmp(cmd, "ss") == 0)
+                {
+                    printf("Comando: show stats\n");
+                    ndn_show_stats(node);
+                }
+                else if (strcmp(sub_cmd, "latency") == 0 || strcmp(cmd, "sl") == 0)
+                {
+                    printf("Comando: show latency\n");
+                    ndn_show_latency(node);
+                }
                 else
                 {
                     printf("Comando desconhecido: %s\n", command_line);
@@ -220,45 +237,98 @@ void handle_user_command(char *command_line)
             }
             else
             {
-                printf("Uso: show <topology|names|interest table> (st|sn|si)\n");
+                printf("Uso: show <topology|names|interest table|ring|strategy|members|stats|latency> (st|sn|si|sr|sf|sm|ss|sl)\n");
             }
         }
-        else if (strcmp(cmd, "leave") == 0 || strcmp(cmd, "l") == 0)
+        else if (strcmp(cmd, "heartbeat") == 0 || strcmp(cmd, "hb") == 0)
         {
-            if (node->current_net_id != -1)
+            int interval_ms;
+            if (sscanf(command_line, "%*s %d", &interval_ms) == 1 && ndn_set_heartbeat_interval(node, interval_ms) == 0)
             {
-                printf("Comando: leave (rede: %03d)\n", node->current_net_id);
-
-                node->is_leaving = 1;                       // Marcar que o nó está a sair
-                node->internal_neighbors_to_disconnect = 0; // Resetar contador
-
-                // Enviar mensagens LEAVE para todos os vizinhos internos
-                for (int i = 0; i < MAX_NEIGHBORS; i++)
+                if (interval_ms > 0)
                 {
-                    if (node->neighbors[i].is_valid &&
-                        (node->neighbors[i].type == NEIGHBOR_TYPE_INTERNAL || node->neighbors[i].type == NEIGHBOR_TYPE_EXTERNAL_AND_INTERNAL))
-                    {
-                        send_leave_message(node->neighbors[i].socket_sd, node);
-                        node->internal_neighbors_to_disconnect++; // Contar quantos vizinhos internos precisam desconectar
-                    }
+                    printf("Heartbeats a cada %d ms.\n", interval_ms);
                 }
-
-                send_unreg_message(node, node->current_net_id);
-                node->current_net_id = -1;
-
-                if (node->internal_neighbors_to_disconnect == 0)
+                else
                 {
-                    printf("Nó não tem vizinhos internos. Saída imediata da rede.\n");
+                    printf("Heartbeats desativados.\n");
+                }
+            }
+            else
+            {
+                printf("Uso: heartbeat (hb) <ms>\n");
+            }
+        }
+        else if (strcmp(cmd, "nodes") == 0 || strcmp(cmd, "nl") == 0)
+        {
+            int net_id;
+            char channel[8] = "";
+            int num_scanned = sscanf(command_line, "%*s %d %7s", &net_id, channel);
+            if (num_scanned >= 1 && net_id >= 0 && net_id <= 999 && (num_scanned == 1 || strcmp(channel, "tcp") == 0))
+            {
+                ndn_list_members(node, net_id, num_scanned == 2);
+            }
+            else
+            {
+                printf("Uso: nodes (nl) <net> [tcp]\n");
+            }
+        }
+        else if (strcmp(cmd, "shortcuts") == 0 || strcmp(cmd, "sc") == 0)
+        {
+            int target;
+            if (sscanf(command_line, "%*s %d", &target) == 1 && ndn_set_shortcut_target(node, target) == 0)
+            {
+                if (target > 0)
+                {
+                    printf("Procurando manter %d atalho(s).\n", target);
                 }
                 else
                 {
-                    printf("Nó iniciando processo de saída. Aguardando desconexão de %d vizinhos internos.\n", node->internal_neighbors_to_disconnect);
+                    printf("Atalhos desativados.\n");
                 }
             }
             else
             {
-                printf("Nó não está atualmente em nenhuma rede para sair.\n");
+                printf("Uso: shortcuts (sc) <0-%d>\n", NDN_MAX_SHORTCUTS);
+            }
+        }
+        else if (strcmp(cmd, "strategy") == 0 || strcmp(cmd, "fs") == 0)
+        {
+            char prefix[101];
+            char strategy_name[20];
+            int result = -1;
+            if (sscanf(command_line, "%*s %100s %19s", prefix, strategy_name) == 2)
+            {
+                result = ndn_set_strategy(node, prefix, strategy_name);
+            }
+            if (result == -1)
+            {
+                printf("Uso: strategy (fs) <prefix|*> <flood|best-route|k-random|probe>\n");
             }
+            else if (result == 0)
+            {
+                printf("Estratégia '%s' para o prefixo '%s'.\n", strategy_name, prefix);
+            }
+            else
+            {
+                printf("Erro: Tabela de estratégias cheia.\n");
+            }
+        }
+        else if (strcmp(cmd, "log") == 0)
+        {
+            char level_name[10];
+            if (sscanf(command_line, "%*s %9s", level_name) != 1)
+            {
+                ndn_log_show_status();
+            }
+            else if (ndn_log_set_level(level_name) == -1)
+            {
+                printf("Uso: log [error|warn|info|debug]\n");
+            }
+        }
+        else if (strcmp(cmd, "leave") == 0 || strcmp(cmd, "l") == 0)
+        {
+            ndn_leave(node);
         }
         else if (strcmp(cmd, "exit") == 0 || strcmp(cmd, "x") == 0)
         {
@@ -1,7 +1,9 @@
 #ifndef UI_HANDLER_H
 #define UI_HANDLER_H
 
-void handle_user_command(char *command_line);
+#include "libndn.h"
+
+void handle_user_command(NDNNode *node, char *command_line);
 void print_help();
 
 #endif // UI_HANDLER_H
\ No newline at end of file
@@ -0,0 +1,298 @@
+// Microbenchmarks dos caminhos de dados do nó: PIT, cache, enquadramento das mensagens TCP e
+// formatação das mensagens NDN.
+//
+// Uso: bench [-i <repetições>] [-s <semente>] [-n]
+//   -i multiplica o número de operações de cada medida (omissão 1); -n omite o cabeçalho do CSV
+//
+// O tamanho das tabelas é o do código compilado (MAX_PENDING_INTERESTS, MAX_CACHE_OBJECTS): o
+// "make bench" compila este programa com os nós para cada valor de BENCH_SIZES e junta os CSV.
+// Saída: benchmark,table_size,operations,ns_per_op (uma linha por medida).
+//
+// As medidas usam um nó sem sockets de rede com dois vizinhos ligados a /dev/null: as mensagens
+// seguem o caminho real (processamento, métricas, escrita), sem o custo de uma rede.
+
+#include "../src/ndn_node.h"
+#include "../src/ndn_protocol.h"
+#include "../src/topology_protocol.h"
+#include "../src/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#define BENCH_BASE_OPS 200000 // Operações por medida com -i 1
+#define FRAME_MESSAGES 64     // Mensagens por bloco enquadrado
+#define MAX_FRAGMENT_LEN 64   // Fragmentos aleatórios de 1 a 64 bytes
+
+static NDNNode node;
+static int face_in;  // Vizinho de onde chegam os INTEREST
+static int face_out; // Vizinho para onde são encaminhados
+static FILE *report;
+static long scale = 1;
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void emit(const char *benchmark, int table_size, long operations, long long elapsed_ns)
+{
+    fprintf(report, "%s,%d,%ld,%.1f\n", benchmark, table_size, operations,
+            operations ? (double)elapsed_ns / operations : 0.0);
+}
+
+static int open_face(int port)
+{
+    int sd = open("/dev/null", O_WRONLY);
+    if (sd == -1 || add_neighbor(&node, "127.0.0.1", port, sd, NEIGHBOR_TYPE_INTERNAL) == -1)
+    {
+        perror("/dev/null");
+        exit(EXIT_FAILURE);
+    }
+    return sd;
+}
+
+// Enche a PIT com INTEREST vindos de face_in e esvazia-a com os NOOBJECT de face_out
+static void bench_pit(void)
+{
+    char message[MAX_TCP_MSG_LEN];
+    long rounds = (BENCH_BASE_OPS * scale + MAX_PENDING_INTERESTS - 1) / MAX_PENDING_INTERESTS;
+    long long insert_ns = 0, lookup_hit_ns = 0, lookup_miss_ns = 0, remove_ns = 0;
+    long inserts = 0, removes = 0, lookups = 0;
+    volatile long found = 0; // Impede que o compilador descarte as procuras
+
+    for (long round = 0; round < rounds; round++)
+    {
+        long long start = now_ns();
+        for (int i = 0; i < MAX_PENDING_INTERESTS; i++)
+        {
+            snprintf(message, sizeof(message), "INTEREST %d pit%d", i % 256, i);
+            process_ndn_message(&node, face_in, message);
+        }
+        insert_ns += now_ns() - start;
+        inserts += MAX_PENDING_INTERESTS;
+
+        // Procuras com a tabela cheia: nomes presentes e ausentes
+        char names[8][MAX_OBJECT_NAME_LEN + 1];
+        int ids[8];
+        for (int k = 0; k < 8; k++)
+        {
+            int i = rand() % MAX_PENDING_INTERESTS;
+            ids[k] = i % 256;
+            snprintf(names[k], sizeof(names[k]), "pit%d", i);
+        }
+        start = now_ns();
+        for (int i = 0; i < MAX_PENDING_INTERESTS; i++)
+        {
+            found += find_pending_interest(&node, (unsigned char)ids[i % 8], names[i % 8]) != NULL;
+        }
+        lookup_hit_ns += now_ns() - start;
+        start = now_ns();
+        for (int i = 0; i < MAX_PENDING_INTERESTS; i++)
+        {
+            found += find_pending_interest(&node, (unsigned char)ids[i % 8], "pit-absent") != NULL;
+        }
+        lookup_miss_ns += now_ns() - start;
+        lookups += MAX_PENDING_INTERESTS;
+
+        start = now_ns();
+        for (int i = 0; i < MAX_PENDING_INTERESTS; i++)
+        {
+            snprintf(message, sizeof(message), "NOOBJECT %d pit%d", i % 256, i);
+            process_ndn_message(&node, face_out, message);
+        }
+        remove_ns += now_ns() - start;
+        removes += MAX_PENDING_INTERESTS;
+    }
+    if (node.num_pending_interests != 0)
+    {
+        fprintf(stderr, "Aviso: %d entrada(s) ficaram na PIT.\n", node.num_pending_interests);
+    }
+    emit("pit_insert", MAX_PENDING_INTERESTS, inserts, insert_ns);
+    emit("pit_lookup_hit", MAX_PENDING_INTERESTS, lookups, lookup_hit_ns);
+    emit("pit_lookup_miss", MAX_PENDING_INTERESTS, lookups, lookup_miss_ns);
+    emit("pit_remove", MAX_PENDING_INTERESTS, removes, remove_ns);
+}
+
+static void bench_cache(void)
+{
+    long operations = BENCH_BASE_OPS * scale;
+    char (*names)[MAX_OBJECT_NAME_LEN + 1] = malloc(2 * MAX_CACHE_OBJECTS * sizeof(*names));
+    if (!names)
+    {
+        return;
+    }
+    for (int i = 0; i < 2 * MAX_CACHE_OBJECTS; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "cache%d", i);
+    }
+    volatile long found = 0;
+
+    // Inserções de nomes que alternam entre duas gerações: com a cache cheia, cada uma retira a mais antiga
+    long long start = now_ns();
+    for (long i = 0; i < operations; i++)
+    {
+        add_object_to_cache(&node, names[i % (2 * MAX_CACHE_OBJECTS)]);
+    }
+    emit("cache_insert_evict", MAX_CACHE_OBJECTS, operations, now_ns() - start);
+
+    // Procuras dos nomes que ficaram na cache (o LRU do nó tem resolução de um segundo: não se sabe quais)
+    int present = 0;
+    for (int i = 0; i < MAX_CACHE_OBJECTS; i++)
+    {
+        if (node.object_cache[i].is_valid)
+        {
+            snprintf(names[present++], sizeof(names[0]), "%s", node.object_cache[i].name);
+        }
+    }
+    start = now_ns();
+    for (long i = 0; i < operations; i++)
+    {
+        found += has_cached_object(&node, names[i % present]);
+    }
+    emit("cache_lookup_hit", MAX_CACHE_OBJECTS, operations, now_ns() - start);
+
+    start = now_ns();
+    for (long i = 0; i < operations; i++)
+    {
+        found += has_cached_object(&node, "cache-absent");
+    }
+    emit("cache_lookup_miss", MAX_CACHE_OBJECTS, operations, now_ns() - start);
+    if (found < operations)
+    {
+        fprintf(stderr, "Aviso: só %ld procura(s) encontraram o objeto na cache.\n", (long)found);
+    }
+    free(names);
+}
+
+// Blocos de mensagens entregues em fragmentos de tamanho aleatório, como chegam de um socket TCP
+static void bench_framing(void)
+{
+    char block[FRAME_MESSAGES * 32];
+    size_t block_len = 0;
+    for (int i = 0; i < FRAME_MESSAGES; i++)
+    {
+        block_len += snprintf(block + block_len, sizeof(block) - block_len, "NOOBJECT %d frame%d\n", i, i);
+    }
+    long blocks = BENCH_BASE_OPS * scale / FRAME_MESSAGES;
+
+    // Fronteiras dos fragmentos sorteadas antes da medida
+    size_t *cuts = malloc((block_len + 1) * sizeof(size_t));
+    if (!cuts)
+    {
+        return;
+    }
+    int num_cuts = 0;
+    for (size_t pos = 0; pos < block_len;)
+    {
+        size_t len = 1 + rand() % MAX_FRAGMENT_LEN;
+        pos = pos + len > block_len ? block_len : pos + len;
+        cuts[num_cuts++] = pos;
+    }
+
+    long long start = now_ns();
+    for (long b = 0; b < blocks; b++)
+    {
+        size_t pos = 0;
+        for (int c = 0; c < num_cuts; c++)
+        {
+            handle_tcp_data_received(&node, face_out, block + pos, cuts[c] - pos);
+            pos = cuts[c];
+        }
+    }
+    long long elapsed = now_ns() - start;
+    emit("framing_message", MAX_PENDING_INTERESTS, blocks * FRAME_MESSAGES, elapsed);
+    emit("framing_fragment", MAX_PENDING_INTERESTS, blocks * num_cuts, elapsed);
+    free(cuts);
+}
+
+static void bench_format(void)
+{
+    long operations = BENCH_BASE_OPS * scale;
+    long long start = now_ns();
+    for (long i = 0; i < operations; i++)
+    {
+        send_interest_message(&node, face_out, (unsigned char)i, "format/object", HOP_LIMIT_NONE, 0);
+    }
+    emit("format_interest", MAX_PENDING_INTERESTS, operations, now_ns() - start);
+
+    start = now_ns();
+    for (long i = 0; i < operations; i++)
+    {
+        send_object_message(&node, face_in, (unsigned char)i, "format/object", 0);
+    }
+    emit("format_object", MAX_PENDING_INTERESTS, operations, now_ns() - start);
+
+    start = now_ns();
+    for (long i = 0; i < operations; i++)
+    {
+        send_interest_message(&node, face_out, (unsigned char)i, "format/object", HOP_LIMIT_NONE, 0x1234abcdULL);
+    }
+    emit("format_interest_traced", MAX_PENDING_INTERESTS, operations, now_ns() - start);
+}
+
+int main(int argc, char *argv[])
+{
+    int header = 1;
+    unsigned int seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:s:n")) != -1)
+    {
+        switch (opt)
+        {
+        case 'i':
+            scale = atol(optarg);
+            break;
+        case 's':
+            seed = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            header = 0;
+            break;
+        default:
+            scale = 0;
+        }
+    }
+    if (scale < 1 || optind != argc)
+    {
+        fprintf(stderr, "Uso: %s [-i <repetições>] [-s <semente>] [-n]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // O CSV vai para a saída original; as mensagens do nó para /dev/null
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report || !freopen("/dev/null", "w", stdout))
+    {
+        perror("stdout");
+        return EXIT_FAILURE;
+    }
+    srand(seed);
+    logger_init();
+    logger_set_level(LOG_LEVEL_ERROR);
+
+    // O traçado é aberto no primeiro evento: sem ficheiro, os eventos rastreados não escrevem em disco
+    setenv("NDN_TRACE_FILE", "/dev/null", 1);
+    ndn_node_init_state(&node, "127.0.0.1", 1);
+    node.current_net_id = 1;
+    face_in = open_face(2);
+    face_out = open_face(3);
+
+    if (header)
+    {
+        fprintf(report, "benchmark,table_size,operations,ns_per_op\n");
+    }
+    bench_pit();
+    bench_cache();
+    bench_framing();
+    bench_format();
+    fclose(report);
+
+    node.current_net_id = -1; // Sem servidor de registo: nada a desregistar
+    ndn_node_cleanup(&node);
+    logger_shutdown();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+// Junta os histogramas de latência de vários nós numa vista única.
+//
+// Uso: hist_merge [-r] <fonte>...
+//   <fonte> é um socket de métricas de um nó (/tmp/ndn-<porto>.metrics), um ficheiro com uma recolha
+//   guardada, ou "-" para a entrada padrão.
+//   -r escreve o resultado no formato de recolha (pode voltar a ser junto com outras recolhas).
+//
+// As linhas <nome>_bucket{...,lo="<limite>"} com as mesmas etiquetas são somadas. As etiquetas que
+// identificam a interface (face, sd) são ignoradas, pelo que ndn_face_latency_us dá a latência de
+// todas as interfaces de todos os nós.
+
+#include "../src/histogram.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+
+#define MAX_GROUPS 128
+#define MAX_KEY_LEN 256
+#define MAX_LINE_LEN 1024
+
+typedef struct
+{
+    char name[MAX_KEY_LEN];   // Métrica (sem o sufixo _bucket/_max)
+    char labels[MAX_KEY_LEN]; // Etiquetas mantidas, sem chavetas
+    LatencyHistogram histogram;
+} MergeGroup;
+
+static MergeGroup groups[MAX_GROUPS];
+static int num_groups = 0;
+
+static MergeGroup *find_group(const char *name, const char *labels)
+{
+    for (int i = 0; i < num_groups; i++)
+    {
+        if (strcmp(groups[i].name, name) == 0 && strcmp(groups[i].labels, labels) == 0)
+        {
+            return &groups[i];
+        }
+    }
+    if (num_groups == MAX_GROUPS)
+    {
+        return NULL;
+    }
+    MergeGroup *group = &groups[num_groups++];
+    snprintf(group->name, sizeof(group->name), "%s", name);
+    snprintf(group->labels, sizeof(group->labels), "%s", labels);
+    histogram_reset(&group->histogram);
+    return group;
+}
+
+// Separa as etiquetas de "{a="x",lo="8"}": copia para kept as que não são lo/face/sd e devolve o valor de lo
+// (-1 se não existir)
+static long long split_labels(const char *start, const char *end, char *kept, size_t kept_size)
+{
+    long long lo = -1;
+    size_t kept_len = 0;
+    kept[0] = '\0';
+    const char *p = start;
+    while (p < end)
+    {
+        const char *label = p;
+        const char *eq = memchr(p, '=', end - p);
+        if (!eq || eq + 1 >= end || eq[1] != '"')
+        {
+            break;
+        }
+        const char *close = memchr(eq + 2, '"', end - (eq + 2));
+        if (!close)
+        {
+            break;
+        }
+        size_t key_len = eq - label;
+        if (key_len == 2 && strncmp(label, "lo", 2) == 0)
+        {
+            lo = atoll(eq + 2);
+        }
+        else if (!(key_len == 4 && strncmp(label, "face", 4) == 0) && !(key_len == 2 && strncmp(label, "sd", 2) == 0))
+        {
+            int written = snprintf(kept + kept_len, kept_size - kept_len, "%s%.*s", kept_len ? "," : "",
+                                   (int)(close + 1 - label), label);
+            if (written > 0 && kept_len + written < kept_size)
+            {
+                kept_len += written;
+            }
+        }
+        p = close + 1;
+        if (p < end && *p == ',')
+        {
+            p++;
+        }
+    }
+    return lo;
+}
+
+static int ends_with(const char *s, size_t len, const char *suffix)
+{
+    size_t suffix_len = strlen(suffix);
+    return len >= suffix_len && strncmp(s + len - suffix_len, suffix, suffix_len) == 0;
+}
+
+static void merge_line(const char *line)
+{
+    if (line[0] == '#' || line[0] == '\0')
+    {
+        return;
+    }
+    const char *brace = strchr(line, '{');
+    const char *space = strchr(line, ' ');
+    if (!space)
+    {
+        return;
+    }
+    const char *name_end = (brace && brace < space) ? brace : space;
+    size_t name_len = name_end - line;
+
+    int is_bucket = ends_with(line, name_len, "_bucket");
+    int is_max = ends_with(line, name_len, "_max");
+    if (!is_bucket && !is_max)
+    {
+        return;
+    }
+    char name[MAX_KEY_LEN];
+    size_t base_len = name_len - (is_bucket ? strlen("_bucket") : strlen("_max"));
+    if (base_len >= sizeof(name))
+    {
+        return;
+    }
+    memcpy(name, line, base_len);
+    name[base_len] = '\0';
+
+    char labels[MAX_KEY_LEN] = "";
+    long long lo = -1;
+    const char *value = space;
+    if (name_end == brace)
+    {
+        const char *close = strchr(brace, '}');
+        if (!close)
+        {
+            return;
+        }
+        lo = split_labels(brace + 1, close, labels, sizeof(labels));
+        value = close + 1;
+    }
+
+    MergeGroup *group = find_group(name, labels);
+    if (!group)
+    {
+        fprintf(stderr, "Demasiados histogramas; '%s' ignorado.\n", name);
+        return;
+    }
+    if (is_max)
+    {
+        long long max_us = atoll(value);
+        if (max_us > group->histogram.max_us)
+        {
+            group->histogram.max_us = max_us;
+        }
+        return;
+    }
+    if (lo < 0)
+    {
+        return;
+    }
+    unsigned long long count = strtoull(value, NULL, 10);
+    group->histogram.counts[histogram_bucket_index(lo)] += count;
+    group->histogram.total += count;
+    // A soma exata perde-se; conta-se cada amostra pelo ponto médio da sua classe
+    group->histogram.sum_us += count * (unsigned long long)((lo + histogram_bucket_upper(histogram_bucket_index(lo))) / 2);
+}
+
+static void merge_stream(FILE *stream)
+{
+    char line[MAX_LINE_LEN];
+    while (fgets(line, sizeof(line), stream))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        merge_line(line);
+    }
+}
+
+static int merge_source(const char *source)
+{
+    if (strcmp(source, "-") == 0)
+    {
+        merge_stream(stdin);
+        return 0;
+    }
+
+    struct stat st;
+    if (stat(source, &st) == -1)
+    {
+        perror(source);
+        return -1;
+    }
+    if (!S_ISSOCK(st.st_mode))
+    {
+        FILE *file = fopen(source, "r");
+        if (!file)
+        {
+            perror(source);
+            return -1;
+        }
+        merge_stream(file);
+        fclose(file);
+        return 0;
+    }
+
+    // Socket de métricas de um nó: uma ligação devolve a recolha completa e é fechada pelo nó
+    int sd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, source, sizeof(addr.sun_path) - 1);
+    if (sd == -1 || connect(sd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        perror(source);
+        if (sd != -1)
+        {
+            close(sd);
+        }
+        return -1;
+    }
+    FILE *stream = fdopen(sd, "r");
+    if (!stream)
+    {
+        close(sd);
+        return -1;
+    }
+    merge_stream(stream);
+    fclose(stream);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int raw = 0;
+    int first = 1;
+    if (argc > 1 && strcmp(argv[1], "-r") == 0)
+    {
+        raw = 1;
+        first = 2;
+    }
+    if (first >= argc)
+    {
+        fprintf(stderr, "Uso: %s [-r] <socket|ficheiro|->...\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = first; i < argc; i++)
+    {
+        failed |= (merge_source(argv[i]) == -1);
+    }
+
+    static char buffer[65536];
+    for (int i = 0; i < num_groups; i++)
+    {
+        MergeGroup *group = &groups[i];
+        if (raw)
+        {
+            histogram_render(&group->histogram, group->name, group->labels, buffer, sizeof(buffer));
+            fputs(buffer, stdout);
+        }
+        else
+        {
+            printf("%s%s%s%s: ", group->name, group->labels[0] ? "{" : "", group->labels, group->labels[0] ? "}" : "");
+            histogram_print_summary(&group->histogram);
+            printf("\n");
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,616 @@
+// Gerador de carga: pesquisas de nomes com popularidade Zipf enviadas a um ou mais nós.
+//
+// Uso: loadgen [-r <pedidos/s> | -c <em curso>] [-d <s>] [-n <nomes>] [-a <expoente>] [-p <prefixo>]
+//              [-f <interfaces por nó>] [-w <ms>] [-s <semente>] [-o <ficheiro>] <ip:porto>...
+//   -r ciclo aberto: chegadas de Poisson ao ritmo pedido, sem esperar pelas respostas
+//   -c ciclo fechado: mantém este número de pedidos em curso (omissão 8)
+//   -d duração da emissão (omissão 10 s); -w espera máxima por uma resposta (omissão 5000 ms)
+//   -n nomes <prefixo>0 .. <prefixo>n-1 (omissão 1000, prefixo "obj"); -a expoente da Zipf (omissão 1.0)
+//   -f ligações a cada nó (omissão 1): cada uma tem 256 identificadores de procura
+//   -o grava o histograma de latência no formato de recolha (para o hist_merge)
+//
+// Cada ligação é uma interface do nó, apresentada com ENTRY com o endereço local do socket, como um
+// vizinho sem objetos: não é preciso alterar os nós. Os INTEREST recebidos dos nós (reencaminhados
+// para esta interface) têm resposta NOOBJECT imediata. A taxa de acertos na cache é lida, antes e
+// depois, dos sockets de métricas dos nós (/tmp/ndn-<porto>.metrics), se existirem nesta máquina.
+
+#include "../src/histogram.h"
+#include "../src/metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_TARGETS 16
+#define MAX_LOAD_FACES 64
+#define NUM_IDS 256 // Identificadores de procura por interface
+#define FACE_BUFFER_LEN 8192
+#define LOAD_NAME_LEN 64
+#define TICK_MS 10 // Verificação das esperas expiradas
+
+typedef struct
+{
+    char ip[INET_ADDRSTRLEN];
+    int port;
+    unsigned long long before[3]; // local_hits, cache_hits, cache_misses no início
+    unsigned long long after[3];
+    int have_metrics;
+} LoadTarget;
+
+typedef struct
+{
+    int sd;
+    int target;
+    char recv_buffer[FACE_BUFFER_LEN];
+    size_t recv_len;
+    long long sent_us[NUM_IDS]; // 0: identificador livre
+    int name_index[NUM_IDS];
+    int next_id;
+    int in_flight;
+} LoadFace;
+
+static LoadTarget targets[MAX_TARGETS];
+static int num_targets = 0;
+static LoadFace faces[MAX_LOAD_FACES];
+static int num_faces = 0;
+static int next_face = 0;
+
+static char name_prefix[LOAD_NAME_LEN - 12] = "obj";
+static int num_names = 1000;
+static double *zipf_cdf;
+
+static unsigned long issued, answered, objects, noobjects, timeouts, dropped, interests_from_nodes;
+static int in_flight = 0;
+static LatencyHistogram latency;
+
+static const char *metric_names[3] = {"ndn_local_hits_total", "ndn_cache_hits_total", "ndn_cache_misses_total"};
+
+static long long now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static double uniform(void)
+{
+    return (rand() + 1.0) / ((double)RAND_MAX + 2.0); // Em ]0, 1[
+}
+
+// Distribuição acumulada da Zipf: o nome de ordem k tem peso 1 / (k + 1)^a
+static int build_zipf(double exponent)
+{
+    zipf_cdf = malloc(num_names * sizeof(double));
+    if (!zipf_cdf)
+    {
+        return -1;
+    }
+    double sum = 0;
+    for (int k = 0; k < num_names; k++)
+    {
+        sum += 1.0 / pow(k + 1, exponent);
+        zipf_cdf[k] = sum;
+    }
+    for (int k = 0; k < num_names; k++)
+    {
+        zipf_cdf[k] /= sum;
+    }
+    return 0;
+}
+
+static int sample_name(void)
+{
+    double u = uniform();
+    int lo = 0, hi = num_names - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (zipf_cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Lê os contadores de acertos de um nó pelo seu socket de métricas; -1 se não estiver disponível
+static int read_hit_counters(LoadTarget *target, unsigned long long *values)
+{
+    char path[108];
+    snprintf(path, sizeof(path), METRICS_SOCKET_FORMAT, target->port);
+    int sd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (sd == -1 || connect(sd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        if (sd != -1)
+        {
+            close(sd);
+        }
+        return -1;
+    }
+    FILE *stream = fdopen(sd, "r");
+    if (!stream)
+    {
+        close(sd);
+        return -1;
+    }
+    int found = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), stream))
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            size_t len = strlen(metric_names[i]);
+            if (strncmp(line, metric_names[i], len) == 0 && line[len] == ' ')
+            {
+                values[i] = strtoull(line + len + 1, NULL, 10);
+                found++;
+            }
+        }
+    }
+    fclose(stream);
+    return found == 3 ? 0 : -1;
+}
+
+static int connect_target(int index, int faces_per_target)
+{
+    LoadTarget *target = &targets[index];
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(target->port);
+    if (inet_pton(AF_INET, target->ip, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "Endereço inválido: %s\n", target->ip);
+        return -1;
+    }
+    for (int i = 0; i < faces_per_target; i++)
+    {
+        if (num_faces == MAX_LOAD_FACES)
+        {
+            fprintf(stderr, "Limite de %d interfaces atingido.\n", MAX_LOAD_FACES);
+            return -1;
+        }
+        LoadFace *face = &faces[num_faces];
+        memset(face, 0, sizeof(*face));
+        face->target = index;
+        face->sd = socket(AF_INET, SOCK_STREAM, 0);
+        if (face->sd == -1 || connect(face->sd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+        {
+            fprintf(stderr, "Erro ao ligar a %s:%d: %s\n", target->ip, target->port, strerror(errno));
+            return -1;
+        }
+        // A interface apresenta-se com o endereço local do socket
+        struct sockaddr_in local;
+        socklen_t local_len = sizeof(local);
+        getsockname(face->sd, (struct sockaddr *)&local, &local_len);
+        char local_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &local.sin_addr, local_ip, sizeof(local_ip));
+        char entry[64];
+        int len = snprintf(entry, sizeof(entry), "ENTRY %s %d\n", local_ip, ntohs(local.sin_port));
+        if (write(face->sd, entry, len) != len)
+        {
+            perror("Erro ao enviar ENTRY");
+            return -1;
+        }
+        num_faces++;
+    }
+    return 0;
+}
+
+static void format_name(int index, char *name, size_t size)
+{
+    snprintf(name, size, "%s%d", name_prefix, index);
+}
+
+// Envia um pedido pela próxima interface com um identificador livre; 0 se todas estão cheias
+static int issue_request(void)
+{
+    for (int tries = 0; tries < num_faces; tries++)
+    {
+        LoadFace *face = &faces[next_face];
+        next_face = (next_face + 1) % num_faces;
+        if (face->sd == -1 || face->in_flight == NUM_IDS)
+        {
+            continue;
+        }
+        int id = face->next_id;
+        while (face->sent_us[id] != 0)
+        {
+            id = (id + 1) % NUM_IDS;
+        }
+        face->next_id = (id + 1) % NUM_IDS;
+
+        int name_index = sample_name();
+        char name[LOAD_NAME_LEN];
+        format_name(name_index, name, sizeof(name));
+        char message[LOAD_NAME_LEN + 32];
+        int len = snprintf(message, sizeof(message), "INTEREST %d %s\n", id, name);
+        if (write(face->sd, message, len) != len)
+        {
+            fprintf(stderr, "Erro ao enviar para %s:%d: %s\n", targets[face->target].ip, targets[face->target].port,
+                    strerror(errno));
+            close(face->sd);
+            face->sd = -1;
+            continue;
+        }
+        face->sent_us[id] = now_us();
+        face->name_index[id] = name_index;
+        face->in_flight++;
+        in_flight++;
+        issued++;
+        return 1;
+    }
+    return 0;
+}
+
+static void release_id(LoadFace *face, int id)
+{
+    face->sent_us[id] = 0;
+    face->in_flight--;
+    in_flight--;
+}
+
+static void handle_line(LoadFace *face, const char *line)
+{
+    char cmd[16], name[LOAD_NAME_LEN];
+    int id;
+    if (sscanf(line, "%15s %d %63s", cmd, &id, name) != 3 || id < 0 || id >= NUM_IDS)
+    {
+        return; // Mensagens de topologia: ignoradas
+    }
+    if (strcmp(cmd, "INTEREST") == 0)
+    {
+        // Reencaminhado pelo nó para esta interface: um vizinho sem objetos responde NOOBJECT
+        char reply[LOAD_NAME_LEN + 32];
+        int len = snprintf(reply, sizeof(reply), "NOOBJECT %d %s\n", id, name);
+        if (write(face->sd, reply, len) != len)
+        {
+            perror("Erro ao responder NOOBJECT");
+        }
+        interests_from_nodes++;
+        return;
+    }
+    int is_object = strcmp(cmd, "OBJECT") == 0;
+    if (!is_object && strcmp(cmd, "NOOBJECT") != 0)
+    {
+        return;
+    }
+    char expected[LOAD_NAME_LEN];
+    format_name(face->name_index[id], expected, sizeof(expected));
+    if (face->sent_us[id] == 0 || strcmp(expected, name) != 0)
+    {
+        return; // Resposta a um pedido já dado como sem resposta
+    }
+    histogram_record(&latency, now_us() - face->sent_us[id]);
+    release_id(face, id);
+    answered++;
+    if (is_object)
+        objects++;
+    else
+        noobjects++;
+}
+
+static void read_face(LoadFace *face)
+{
+    ssize_t n = read(face->sd, face->recv_buffer + face->recv_len, sizeof(face->recv_buffer) - 1 - face->recv_len);
+    if (n <= 0)
+    {
+        fprintf(stderr, "O nó %s:%d fechou uma ligação.\n", targets[face->target].ip, targets[face->target].port);
+        close(face->sd);
+        face->sd = -1;
+        in_flight -= face->in_flight;
+        timeouts += face->in_flight;
+        face->in_flight = 0;
+        return;
+    }
+    face->recv_len += n;
+    face->recv_buffer[face->recv_len] = '\0';
+    char *start = face->recv_buffer;
+    char *end;
+    while ((end = strchr(start, '\n')) != NULL)
+    {
+        *end = '\0';
+        handle_line(face, start);
+        start = end + 1;
+    }
+    face->recv_len = strlen(start);
+    if (face->recv_len == sizeof(face->recv_buffer) - 1)
+    {
+        face->recv_len = 0; // Linha demasiado longa: descartada
+    }
+    memmove(face->recv_buffer, start, face->recv_len + 1);
+}
+
+static void expire_requests(long long timeout_us)
+{
+    long long now = now_us();
+    for (int i = 0; i < num_faces; i++)
+    {
+        for (int id = 0; faces[i].in_flight > 0 && id < NUM_IDS; id++)
+        {
+            if (faces[i].sent_us[id] != 0 && now - faces[i].sent_us[id] > timeout_us)
+            {
+                release_id(&faces[i], id);
+                timeouts++;
+            }
+        }
+    }
+}
+
+static int open_faces(void)
+{
+    for (int i = 0; i < num_faces; i++)
+    {
+        if (faces[i].sd != -1)
+            return 1;
+    }
+    return 0;
+}
+
+// Espera por respostas até ao instante indicado
+static void poll_faces(long long until_us)
+{
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    int max_fd = -1;
+    for (int i = 0; i < num_faces; i++)
+    {
+        if (faces[i].sd != -1)
+        {
+            FD_SET(faces[i].sd, &read_fds);
+            max_fd = faces[i].sd > max_fd ? faces[i].sd : max_fd;
+        }
+    }
+    long long wait_us = until_us - now_us();
+    if (wait_us < 0)
+        wait_us = 0;
+    struct timeval timeout = {wait_us / 1000000, wait_us % 1000000};
+    if (select(max_fd + 1, &read_fds, NULL, NULL, &timeout) <= 0)
+    {
+        return;
+    }
+    for (int i = 0; i < num_faces; i++)
+    {
+        if (faces[i].sd != -1 && FD_ISSET(faces[i].sd, &read_fds))
+        {
+            read_face(&faces[i]);
+        }
+    }
+}
+
+static int parse_target(const char *arg)
+{
+    if (num_targets == MAX_TARGETS)
+    {
+        fprintf(stderr, "No máximo %d nós.\n", MAX_TARGETS);
+        return -1;
+    }
+    LoadTarget *target = &targets[num_targets];
+    const char *colon = strrchr(arg, ':');
+    if (!colon || colon == arg || (size_t)(colon - arg) >= sizeof(target->ip) || atoi(colon + 1) <= 0)
+    {
+        fprintf(stderr, "Nó inválido (esperado ip:porto): %s\n", arg);
+        return -1;
+    }
+    memcpy(target->ip, arg, colon - arg);
+    target->ip[colon - arg] = '\0';
+    target->port = atoi(colon + 1);
+    num_targets++;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    double rate = 0, exponent = 1.0, duration_s = 10;
+    int concurrency = 8, faces_per_target = 1;
+    long long timeout_ms = 5000;
+    unsigned int seed = (unsigned int)time(NULL);
+    const char *output = NULL;
+    int usage_error = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:c:d:n:a:p:f:w:s:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'c':
+            concurrency = atoi(optarg);
+            break;
+        case 'd':
+            duration_s = atof(optarg);
+            break;
+        case 'n':
+            num_names = atoi(optarg);
+            break;
+        case 'a':
+            exponent = atof(optarg);
+            break;
+        case 'p':
+            snprintf(name_prefix, sizeof(name_prefix), "%s", optarg);
+            break;
+        case 'f':
+            faces_per_target = atoi(optarg);
+            break;
+        case 'w':
+            timeout_ms = atoll(optarg);
+            break;
+        case 's':
+            seed = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage_error = 1;
+        }
+    }
+    for (int i = optind; i < argc && !usage_error; i++)
+    {
+        usage_error = parse_target(argv[i]) == -1;
+    }
+    if (usage_error || num_targets == 0 || rate < 0 || concurrency < 1 || num_names < 1 || faces_per_target < 1 ||
+        duration_s <= 0 || timeout_ms <= 0)
+    {
+        fprintf(stderr, "Uso: %s [-r <pedidos/s> | -c <em curso>] [-d <s>] [-n <nomes>] [-a <expoente>] [-p <prefixo>]\n"
+                        "          [-f <interfaces por nó>] [-w <ms>] [-s <semente>] [-o <ficheiro>] <ip:porto>...\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    srand(seed);
+    histogram_reset(&latency);
+    if (build_zipf(exponent) == -1)
+    {
+        fprintf(stderr, "Memória insuficiente.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < num_targets; i++)
+    {
+        targets[i].have_metrics = read_hit_counters(&targets[i], targets[i].before) == 0;
+        if (connect_target(i, faces_per_target) == -1)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    poll_faces(now_us() + 200000); // O nó classifica as novas interfaces antes dos primeiros pedidos
+
+    if (rate > 0)
+    {
+        printf("Ciclo aberto: %.0f pedidos/s durante %.1f s", rate, duration_s);
+    }
+    else
+    {
+        printf("Ciclo fechado: %d pedido(s) em curso durante %.1f s", concurrency, duration_s);
+    }
+    printf(", %d nó(s), %d interface(s), %d nomes (Zipf %.2f).\n", num_targets, num_faces, num_names, exponent);
+    fflush(stdout);
+
+    long long start_us = now_us();
+    long long end_us = start_us + (long long)(duration_s * 1e6);
+    long long next_arrival_us = start_us;
+    long long next_expiry_us = start_us + TICK_MS * 1000;
+    while (now_us() < end_us && open_faces())
+    {
+        long long until_us = next_expiry_us < end_us ? next_expiry_us : end_us;
+        if (rate > 0)
+        {
+            // Chegadas de Poisson: não dependem das respostas; sem identificadores livres o pedido é descartado
+            while (next_arrival_us <= now_us())
+            {
+                if (!issue_request())
+                {
+                    dropped++;
+                }
+                next_arrival_us += (long long)(-log(uniform()) / rate * 1e6);
+            }
+            if (next_arrival_us < until_us)
+            {
+                until_us = next_arrival_us;
+            }
+        }
+        else
+        {
+            while (in_flight < concurrency && issue_request())
+            {
+            }
+        }
+        poll_faces(until_us);
+        if (now_us() >= next_expiry_us)
+        {
+            expire_requests(timeout_ms * 1000);
+            next_expiry_us = now_us() + TICK_MS * 1000;
+        }
+    }
+    double issue_s = (now_us() - start_us) / 1e6;
+
+    // Respostas ainda em curso
+    long long drain_end_us = now_us() + timeout_ms * 1000;
+    while (in_flight > 0 && open_faces() && now_us() < drain_end_us)
+    {
+        poll_faces(now_us() + TICK_MS * 1000);
+        expire_requests(timeout_ms * 1000);
+    }
+    expire_requests(0);
+
+    printf("Pedidos: %lu emitidos em %.2f s (%.0f/s), %lu respondidos (%.0f/s)", issued, issue_s, issued / issue_s,
+           answered, answered / issue_s);
+    if (dropped)
+    {
+        printf(", %lu descartados (sem identificadores livres)", dropped);
+    }
+    printf("\n");
+    printf("Respostas: OBJECT %lu, NOOBJECT %lu (%.1f%%), sem resposta %lu\n", objects, noobjects,
+           answered ? 100.0 * noobjects / answered : 0.0, timeouts);
+    printf("Latência: ");
+    histogram_print_summary(&latency);
+    printf("\n");
+
+    unsigned long long hits[3] = {0, 0, 0};
+    int with_metrics = 0;
+    for (int i = 0; i < num_targets; i++)
+    {
+        if (targets[i].have_metrics && read_hit_counters(&targets[i], targets[i].after) == 0)
+        {
+            with_metrics++;
+            for (int k = 0; k < 3; k++)
+            {
+                hits[k] += targets[i].after[k] - targets[i].before[k];
+            }
+        }
+    }
+    unsigned long long lookups = hits[0] + hits[1] + hits[2];
+    if (with_metrics && lookups)
+    {
+        printf("Cache dos nós de entrada (%d de %d): %.1f%% de acertos (%llu na cache, %llu locais, %llu em falta)\n",
+               with_metrics, num_targets, 100.0 * hits[1] / lookups, hits[1], hits[0], hits[2]);
+    }
+    else
+    {
+        printf("Cache dos nós de entrada: métricas indisponíveis\n");
+    }
+    if (interests_from_nodes)
+    {
+        printf("INTEREST recebidos dos nós (respondidos com NOOBJECT): %lu\n", interests_from_nodes);
+    }
+
+    if (output)
+    {
+        char buffer[METRICS_RENDER_BUFFER];
+        size_t len = histogram_render(&latency, "ndn_load_latency_us", "", buffer, sizeof(buffer));
+        FILE *file = fopen(output, "w");
+        if (!file || fwrite(buffer, 1, len, file) != len)
+        {
+            perror(output);
+        }
+        if (file)
+        {
+            fclose(file);
+        }
+    }
+
+    for (int i = 0; i < num_faces; i++)
+    {
+        if (faces[i].sd != -1)
+        {
+            close(faces[i].sd);
+        }
+    }
+    free(zipf_cdf);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,672 @@
+// Simulador de muitos nós num só processo, para medir a rede a uma escala que não cabe em terminais.
+//
+// Uso: ndn_sim [-n <nós>] [-t chain|star|tree] [-o <objetos>] [-r <pesquisas>] [-c <em simultâneo>]
+//              [-s <semente>] [-H <ms>] [-S <atalhos>] [-v]
+//   -n número de nós (omissão 100); -t topologia da entrada na rede: cadeia, estrela ou árvore aleatória
+//   -o objetos distribuídos ao acaso pelos nós (omissão 20); -r pesquisas de nós ao acaso (omissão 200)
+//   -c pesquisas em curso ao mesmo tempo (omissão 1); -s semente (omissão: o relógio)
+//   -H intervalo dos heartbeats em ms (omissão 0, desligados); -S atalhos pretendidos por nó (omissão 0)
+//   -v mostra a saída dos nós (por omissão vai para /dev/null)
+//
+// Cada nó é uma NDNNode sem sockets de rede: as conexões entre nós são socketpairs criados pelo
+// transporte do simulador e o servidor de registo é substituído por uma versão mínima embutida
+// (NODES responde com o pai escolhido pela topologia; REG/UNREG/UPDATE são confirmados, sem validade,
+// como num servidor antigo). Os nós entram na rede um a um e todos avançam no mesmo select.
+// No fim são mostradas a latência das pesquisas, as mensagens trocadas e o diâmetro da rede.
+
+#include "../src/ndn_node.h"
+#include "../src/ndn_protocol.h"
+#include "../src/registration_protocol.h"
+#include "../src/topology_protocol.h"
+#include "../src/histogram.h"
+#include "../src/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#define SIM_NET_ID 1
+#define SIM_IP "127.0.0.1"
+#define SIM_BASE_PORT 20000
+#define SIM_JOIN_TIMEOUT_MS 2000
+#define SIM_SETTLE_MS 200      // Sem atividade durante este tempo: a rede estabilizou
+#define SIM_RETRIEVE_IDLE_MS 30000 // Limite sem nenhuma pesquisa concluída
+#define MAX_REG_REPLY_LEN 128
+
+typedef enum
+{
+    TOPOLOGY_CHAIN,
+    TOPOLOGY_STAR,
+    TOPOLOGY_TREE
+} Topology;
+
+// Resposta do servidor de registo embutido, entregue na volta seguinte do loop
+typedef struct
+{
+    int node;
+    char message[MAX_REG_REPLY_LEN];
+} RegReply;
+
+static NDNNode *nodes;
+static int num_nodes;
+static int *parent;       // Nó a que cada nó se liga ao entrar (-1: cria a rede)
+static int *registered;   // REG recebido pelo servidor embutido
+static int owner[FD_SETSIZE]; // Nó dono de cada descritor, para só acordar os nós com atividade
+
+static RegReply *replies;
+static int num_replies;
+static int max_replies;
+
+static int *object_holder;
+static unsigned long retrieves_done;
+static unsigned long results[RETRIEVE_RESULT_TIMEOUT + 1];
+static unsigned long answered_at_origin; // Objeto local ou em cache no nó que pesquisou
+static LatencyHistogram retrieve_latency;
+
+static int node_index(const char *ip, int tcp_port)
+{
+    int index = tcp_port - SIM_BASE_PORT;
+    if (strcmp(ip, SIM_IP) != 0 || index < 0 || index >= num_nodes)
+    {
+        return -1;
+    }
+    return index;
+}
+
+static void queue_reply(int node, const char *message)
+{
+    if (num_replies == max_replies)
+    {
+        max_replies = max_replies ? max_replies * 2 : 64;
+        replies = realloc(replies, max_replies * sizeof(RegReply));
+        if (!replies)
+        {
+            fprintf(stderr, "Memória insuficiente.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    replies[num_replies].node = node;
+    snprintf(replies[num_replies].message, MAX_REG_REPLY_LEN, "%s", message);
+    num_replies++;
+}
+
+// Conexão de um nó a outro: um socketpair, com a outra ponta aceite de imediato pelo nó alvo
+static int sim_connect_node(NDNNode *node, const char *ip, int tcp_port, void *ctx)
+{
+    (void)ctx;
+    int target = node_index(ip, tcp_port);
+    if (target == -1 || &nodes[target] == node || ndn_node_finished(&nodes[target]))
+    {
+        return -1;
+    }
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1)
+    {
+        perror("socketpair");
+        return -1;
+    }
+    if (sv[0] >= FD_SETSIZE || sv[1] >= FD_SETSIZE)
+    {
+        fprintf(stderr, "Descritores esgotados (limite do select: %d).\n", FD_SETSIZE);
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    process_incoming_connection(&nodes[target], sv[1], node->ip, node->tcp_port);
+    return sv[0];
+}
+
+// Servidor de registo embutido: só o necessário para a entrada na rede
+static void sim_send_to_reg_server(NDNNode *node, const char *message, void *ctx)
+{
+    (void)ctx;
+    int index = (int)(node - nodes);
+    char cmd[20];
+    int net_id = SIM_NET_ID;
+    int cursor;
+    char reply[MAX_REG_REPLY_LEN];
+    if (sscanf(message, "%19s %d", cmd, &net_id) < 1)
+    {
+        return;
+    }
+
+    if (strcmp(cmd, "REG") == 0)
+    {
+        registered[index] = 1;
+        queue_reply(index, "OKREG"); // Sem validade: não há renovações nem subscrições
+    }
+    else if (strcmp(cmd, "UNREG") == 0)
+    {
+        registered[index] = 0;
+        snprintf(reply, sizeof(reply), "OKUNREG %03d", net_id);
+        queue_reply(index, reply);
+    }
+    else if (strcmp(cmd, "UPDATE") == 0)
+    {
+        snprintf(reply, sizeof(reply), "OKUPDATE %03d", net_id);
+        queue_reply(index, reply);
+    }
+    else if (strcmp(cmd, "NODES") == 0 && sscanf(message, "%*s %*d %d", &cursor) == 1)
+    {
+        snprintf(reply, sizeof(reply), "NODESLIST %03d -1 0\n", net_id); // Listagem por páginas: vazia
+        queue_reply(index, reply);
+    }
+    else if (strcmp(cmd, "NODES") == 0)
+    {
+        if (parent[index] == -1)
+        {
+            snprintf(reply, sizeof(reply), "NODESLIST %03d\n", net_id);
+        }
+        else
+        {
+            snprintf(reply, sizeof(reply), "NODESLIST %03d\n%s %d\n", net_id, SIM_IP, SIM_BASE_PORT + parent[index]);
+        }
+        queue_reply(index, reply);
+    }
+    // SUBSCRIBE/UNSUBSCRIBE: ignorados (os nós não os enviam a um servidor sem validade)
+}
+
+static const NodeTransport sim_transport = {sim_connect_node, sim_send_to_reg_server, NULL};
+
+static void sim_retrieve_done(NDNNode *node, const char *object_name, RetrieveResult result, long long latency_us,
+                              void *ctx)
+{
+    (void)node;
+    (void)object_name;
+    (void)ctx;
+    retrieves_done++;
+    results[result]++;
+    if (result == RETRIEVE_RESULT_FOUND && latency_us == 0)
+    {
+        answered_at_origin++;
+        return;
+    }
+    histogram_record(&retrieve_latency, latency_us);
+}
+
+static void deliver_replies(void)
+{
+    // As respostas podem gerar novos pedidos: entregar só as que já estavam na fila
+    int count = num_replies;
+    RegReply *pending = malloc(count * sizeof(RegReply));
+    if (!pending)
+    {
+        return;
+    }
+    memcpy(pending, replies, count * sizeof(RegReply));
+    memmove(replies, replies + count, (num_replies - count) * sizeof(RegReply));
+    num_replies -= count;
+    for (int i = 0; i < count; i++)
+    {
+        if (!ndn_node_finished(&nodes[pending[i].node]))
+        {
+            process_udp_registration_message(&nodes[pending[i].node], pending[i].message);
+        }
+    }
+    free(pending);
+}
+
+// Uma volta do loop comum a todos os nós; devolve o número de nós com atividade
+static int sim_step(long long max_wait_ms)
+{
+    fd_set read_fds, write_fds;
+    FD_ZERO(&read_fds);
+    FD_ZERO(&write_fds);
+    int max_fd = -1;
+    long long deadline_ms = -1;
+    for (int i = 0; i < num_nodes; i++)
+    {
+        NDNNode *node = &nodes[i];
+        if (ndn_node_finished(node))
+        {
+            continue;
+        }
+        max_fd = ndn_node_fill_fds(node, &read_fds, &write_fds, max_fd);
+        for (int j = 0; j < MAX_NEIGHBORS; j++)
+        {
+            if (node->neighbors[j].is_valid && node->neighbors[j].socket_sd != -1)
+            {
+                owner[node->neighbors[j].socket_sd] = i;
+            }
+        }
+        long long node_deadline = ndn_node_next_deadline_ms(node);
+        if (node_deadline != -1 && (deadline_ms == -1 || node_deadline < deadline_ms))
+        {
+            deadline_ms = node_deadline;
+        }
+    }
+
+    long long wait_ms = max_wait_ms;
+    if (num_replies > 0)
+    {
+        wait_ms = 0;
+    }
+    else if (deadline_ms != -1 && deadline_ms - ndn_now_ms() < wait_ms)
+    {
+        wait_ms = deadline_ms - ndn_now_ms();
+    }
+    if (wait_ms < 0)
+    {
+        wait_ms = 0;
+    }
+    struct timeval timeout = {wait_ms / 1000, (wait_ms % 1000) * 1000};
+    int ready = select(max_fd + 1, &read_fds, &write_fds, NULL, &timeout);
+    if (ready < 0 && errno != EINTR)
+    {
+        perror("select");
+        exit(EXIT_FAILURE);
+    }
+
+    int active_nodes = num_replies > 0;
+    deliver_replies();
+
+    char *active = calloc(num_nodes, 1);
+    if (!active)
+    {
+        return active_nodes;
+    }
+    for (int fd = 0; ready > 0 && fd <= max_fd; fd++)
+    {
+        if (FD_ISSET(fd, &read_fds))
+        {
+            active[owner[fd]] = 1;
+        }
+    }
+    long long now_ms = ndn_now_ms();
+    for (int i = 0; i < num_nodes; i++)
+    {
+        NDNNode *node = &nodes[i];
+        if (ndn_node_finished(node))
+        {
+            continue;
+        }
+        long long node_deadline = ndn_node_next_deadline_ms(node);
+        if (!active[i] && (node_deadline == -1 || node_deadline > now_ms))
+        {
+            continue;
+        }
+        // Os nós anteriores podem ter fechado e reaberto descritores nesta volta: consultar de novo só os deste nó
+        fd_set node_read, node_write;
+        FD_ZERO(&node_read);
+        FD_ZERO(&node_write);
+        int node_max = ndn_node_fill_fds(node, &node_read, &node_write, -1);
+        struct timeval no_wait = {0, 0};
+        if (select(node_max + 1, &node_read, &node_write, NULL, &no_wait) < 0)
+        {
+            FD_ZERO(&node_read);
+            FD_ZERO(&node_write);
+        }
+        ndn_node_handle_events(node, &node_read, &node_write);
+        active_nodes += active[i];
+    }
+    free(active);
+    return active_nodes;
+}
+
+// Avança todos os nós até não haver atividade durante SIM_SETTLE_MS
+static void sim_settle(void)
+{
+    long long idle_since = ndn_now_ms();
+    while (ndn_now_ms() - idle_since < SIM_SETTLE_MS)
+    {
+        if (sim_step(SIM_SETTLE_MS) > 0)
+        {
+            idle_since = ndn_now_ms();
+        }
+    }
+}
+
+static int choose_parent(Topology topology, int index, int *degree)
+{
+    if (index == 0)
+    {
+        return -1;
+    }
+    switch (topology)
+    {
+    case TOPOLOGY_CHAIN:
+        return index - 1;
+    case TOPOLOGY_STAR:
+        return 0;
+    default:
+        // Árvore aleatória: um nó anterior com espaço na tabela de vizinhos (um lugar fica para atalhos)
+        for (int attempt = 0; attempt < 64; attempt++)
+        {
+            int candidate = rand() % index;
+            if (degree[candidate] < MAX_NEIGHBORS - 1)
+            {
+                return candidate;
+            }
+        }
+        for (int candidate = 0; candidate < index; candidate++)
+        {
+            if (degree[candidate] < MAX_NEIGHBORS - 1)
+            {
+                return candidate;
+            }
+        }
+        return -1;
+    }
+}
+
+// Diâmetro e distância média da rede (em saltos), por pesquisas em largura sobre as tabelas de vizinhos
+static void measure_overlay(int *diameter, double *mean_hops, int *unreachable_pairs)
+{
+    int *dist = malloc(num_nodes * sizeof(int));
+    int *queue = malloc(num_nodes * sizeof(int));
+    *diameter = 0;
+    *unreachable_pairs = 0;
+    long long hops_sum = 0, pairs = 0;
+    if (!dist || !queue)
+    {
+        free(dist);
+        free(queue);
+        *mean_hops = 0;
+        return;
+    }
+    for (int source = 0; source < num_nodes; source++)
+    {
+        for (int i = 0; i < num_nodes; i++)
+        {
+            dist[i] = -1;
+        }
+        int head = 0, tail = 0;
+        dist[source] = 0;
+        queue[tail++] = source;
+        while (head < tail)
+        {
+            int current = queue[head++];
+            for (int j = 0; j < MAX_NEIGHBORS; j++)
+            {
+                Neighbor *neighbor = &nodes[current].neighbors[j];
+                if (!neighbor->is_valid || neighbor->type == NEIGHBOR_TYPE_PENDING_INCOMING)
+                {
+                    continue;
+                }
+                int next = node_index(neighbor->ip, neighbor->tcp_port);
+                if (next != -1 && dist[next] == -1)
+                {
+                    dist[next] = dist[current] + 1;
+                    queue[tail++] = next;
+                }
+            }
+        }
+        for (int i = 0; i < num_nodes; i++)
+        {
+            if (i == source)
+            {
+                continue;
+            }
+            if (dist[i] == -1)
+            {
+                (*unreachable_pairs)++;
+                continue;
+            }
+            hops_sum += dist[i];
+            pairs++;
+            if (dist[i] > *diameter)
+            {
+                *diameter = dist[i];
+            }
+        }
+    }
+    *mean_hops = pairs ? (double)hops_sum / pairs : 0;
+    free(dist);
+    free(queue);
+}
+
+static void sum_metrics(unsigned long long *totals)
+{
+    memset(totals, 0, METRIC_COUNT * sizeof(unsigned long long));
+    for (int i = 0; i < num_nodes; i++)
+    {
+        for (int m = 0; m < METRIC_COUNT; m++)
+        {
+            totals[m] += nodes[i].metrics[m];
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int count = 100, num_objects = 20, concurrency = 1, heartbeat_ms = 0, shortcuts = 0, verbose = 0;
+    long num_retrieves = 200;
+    unsigned int seed = (unsigned int)time(NULL);
+    Topology topology = TOPOLOGY_TREE;
+    const char *topology_name = "tree";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:o:r:c:s:H:S:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 't':
+            topology_name = optarg;
+            if (strcmp(optarg, "chain") == 0)
+                topology = TOPOLOGY_CHAIN;
+            else if (strcmp(optarg, "star") == 0)
+                topology = TOPOLOGY_STAR;
+            else if (strcmp(optarg, "tree") == 0)
+                topology = TOPOLOGY_TREE;
+            else
+                count = -1;
+            break;
+        case 'o':
+            num_objects = atoi(optarg);
+            break;
+        case 'r':
+            num_retrieves = atol(optarg);
+            break;
+        case 'c':
+            concurrency = atoi(optarg);
+            break;
+        case 's':
+            seed = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'H':
+            heartbeat_ms = atoi(optarg);
+            break;
+        case 'S':
+            shortcuts = atoi(optarg);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            count = -1;
+        }
+    }
+    if (count < 1 || num_objects < 1 || num_retrieves < 0 || concurrency < 1 || optind != argc)
+    {
+        fprintf(stderr, "Uso: %s [-n <nós>] [-t chain|star|tree] [-o <objetos>] [-r <pesquisas>] [-c <em simultâneo>]\n"
+                        "          [-s <semente>] [-H <ms>] [-S <atalhos>] [-v]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (topology == TOPOLOGY_STAR && count > MAX_NEIGHBORS + 1)
+    {
+        fprintf(stderr, "Uma estrela tem no máximo %d nós (MAX_NEIGHBORS = %d).\n", MAX_NEIGHBORS + 1, MAX_NEIGHBORS);
+        return EXIT_FAILURE;
+    }
+
+    // O relatório vai para a saída original; a dos nós só com -v
+    FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report || (!verbose && !freopen("/dev/null", "w", stdout)))
+    {
+        perror("stdout");
+        return EXIT_FAILURE;
+    }
+    signal(SIGPIPE, SIG_IGN); // Escritas para nós que já fecharam a conexão
+    srand(seed);
+    logger_init();
+    logger_set_level(verbose ? LOG_LEVEL_INFO : LOG_LEVEL_ERROR);
+
+    num_nodes = count;
+    nodes = calloc(num_nodes, sizeof(NDNNode));
+    parent = calloc(num_nodes, sizeof(int));
+    registered = calloc(num_nodes, sizeof(int));
+    object_holder = calloc(num_objects, sizeof(int));
+    int *degree = calloc(num_nodes, sizeof(int));
+    if (!nodes || !parent || !registered || !object_holder || !degree)
+    {
+        fprintf(stderr, "Memória insuficiente.\n");
+        return EXIT_FAILURE;
+    }
+    histogram_reset(&retrieve_latency);
+
+    for (int i = 0; i < num_nodes; i++)
+    {
+        NDNNode *node = &nodes[i];
+        ndn_node_init_state(node, SIM_IP, SIM_BASE_PORT + i);
+        node->transport = &sim_transport;
+        node->on_retrieve_done = sim_retrieve_done;
+        node->heartbeat_interval_ms = heartbeat_ms;
+        node->shortcut_target = shortcuts;
+    }
+
+    // 1. Entrada dos nós na rede, um de cada vez
+    long long start_ms = ndn_now_ms();
+    for (int i = 0; i < num_nodes; i++)
+    {
+        NDNNode *node = &nodes[i];
+        parent[i] = choose_parent(topology, i, degree);
+        if (parent[i] != -1)
+        {
+            degree[parent[i]]++;
+            degree[i]++;
+        }
+        node->current_net_id = SIM_NET_ID;
+        join_network(node, SIM_NET_ID);
+
+        long long deadline = ndn_now_ms() + SIM_JOIN_TIMEOUT_MS;
+        while (!registered[i] && ndn_now_ms() < deadline)
+        {
+            sim_step(10);
+        }
+        if (!registered[i])
+        {
+            fprintf(stderr, "O nó %d não conseguiu entrar na rede.\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    sim_settle();
+    long long join_ms = ndn_now_ms() - start_ms;
+
+    int diameter, unreachable_pairs;
+    double mean_hops;
+    measure_overlay(&diameter, &mean_hops, &unreachable_pairs);
+
+    // 2. Objetos ao acaso e pesquisas de nós ao acaso, com até 'concurrency' em curso
+    for (int k = 0; k < num_objects; k++)
+    {
+        char name[MAX_OBJECT_NAME_LEN + 1];
+        snprintf(name, sizeof(name), "obj%d", k);
+        object_holder[k] = rand() % num_nodes;
+        create_local_object(&nodes[object_holder[k]], name);
+    }
+
+    unsigned long long before[METRIC_COUNT], after[METRIC_COUNT];
+    sum_metrics(before);
+    long long retrieve_start_us = ndn_now_us();
+    long issued = 0;
+    unsigned long last_done = 0;
+    long long last_progress_ms = ndn_now_ms();
+    while (retrieves_done < (unsigned long)num_retrieves)
+    {
+        while (issued < num_retrieves && issued - (long)retrieves_done < concurrency)
+        {
+            int k = rand() % num_objects;
+            int origin = rand() % num_nodes;
+            if (num_nodes > 1 && origin == object_holder[k])
+            {
+                origin = (origin + 1 + rand() % (num_nodes - 1)) % num_nodes;
+            }
+            char name[MAX_OBJECT_NAME_LEN + 1];
+            snprintf(name, sizeof(name), "obj%d", k);
+            issued++;
+            ndn_retrieve(&nodes[origin], name, 0, NULL, NULL);
+        }
+        sim_step(100);
+        if (retrieves_done != last_done)
+        {
+            last_done = retrieves_done;
+            last_progress_ms = ndn_now_ms();
+        }
+        else if (ndn_now_ms() - last_progress_ms > SIM_RETRIEVE_IDLE_MS)
+        {
+            fprintf(stderr, "Pesquisas sem progresso há %d ms: %lu de %ld concluídas.\n", SIM_RETRIEVE_IDLE_MS,
+                    retrieves_done, num_retrieves);
+            break;
+        }
+    }
+    double retrieve_s = (ndn_now_us() - retrieve_start_us) / 1e6;
+    sum_metrics(after);
+
+    // 3. Relatório
+    fprintf(report, "Simulação: %d nó(s), topologia %s, semente %u, %d objeto(s), atalhos %d, heartbeats %d ms\n",
+            num_nodes, topology_name, seed, num_objects, shortcuts, heartbeat_ms);
+    fprintf(report, "Entrada na rede: %lld ms; diâmetro %d salto(s), distância média %.2f", join_ms, diameter, mean_hops);
+    if (unreachable_pairs)
+    {
+        fprintf(report, ", %d par(es) sem caminho", unreachable_pairs);
+    }
+    fprintf(report, "\n");
+    fprintf(report, "Pesquisas: %lu em %.3f s (%.0f/s, %d em simultâneo): %lu encontradas (%lu na origem), "
+                    "%lu não encontradas, %lu sem resposta\n",
+            retrieves_done, retrieve_s, retrieve_s > 0 ? retrieves_done / retrieve_s : 0.0, concurrency,
+            results[RETRIEVE_RESULT_FOUND], answered_at_origin, results[RETRIEVE_RESULT_NOT_FOUND],
+            results[RETRIEVE_RESULT_TIMEOUT]);
+    fprintf(report, "Latência (pela rede): ");
+    fflush(report);
+    // histogram_print_summary escreve no stdout, que pode estar em /dev/null
+    if (retrieve_latency.total == 0)
+    {
+        fprintf(report, "sem amostras\n");
+    }
+    else
+    {
+        fprintf(report, "p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, máx %.3f ms (%llu amostra(s))\n",
+                histogram_percentile(&retrieve_latency, 0.5) / 1000.0, histogram_percentile(&retrieve_latency, 0.9) / 1000.0,
+                histogram_percentile(&retrieve_latency, 0.99) / 1000.0, retrieve_latency.max_us / 1000.0,
+                (unsigned long long)retrieve_latency.total);
+    }
+
+    unsigned long long ndn_messages = 0;
+    fprintf(report, "Mensagens durante as pesquisas:");
+    for (int m = METRIC_INTERESTS_OUT; m <= METRIC_CONTROL_OUT; m += 2)
+    {
+        static const char *labels[] = {"INTEREST", "OBJECT", "NOOBJECT", "CANCEL", "controlo"};
+        unsigned long long sent = after[m] - before[m];
+        fprintf(report, " %s %llu", labels[(m - METRIC_INTERESTS_OUT) / 2], sent);
+        if (m != METRIC_CONTROL_OUT)
+        {
+            ndn_messages += sent;
+        }
+    }
+    fprintf(report, "\n");
+    if (retrieves_done > 0)
+    {
+        fprintf(report, "Mensagens NDN por pesquisa: %.1f\n", (double)ndn_messages / retrieves_done);
+    }
+    fprintf(report, "Mensagens na entrada na rede: %llu\n", before[METRIC_MESSAGES_OUT]);
+    fclose(report);
+
+    for (int i = 0; i < num_nodes; i++)
+    {
+        ndn_node_cleanup(&nodes[i]);
+    }
+    logger_shutdown();
+    free(nodes);
+    free(parent);
+    free(registered);
+    free(object_holder);
+    free(degree);
+    free(replies);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,402 @@
+// Reproduz contra um nó as mensagens capturadas (comando "capture" do nó ou NDN_CAPTURE_FILE).
+//
+// Uso: replay [-s <velocidade>] [-w <ms>] <captura> <ip do nó> <porto do nó>
+//   -s 1 reproduz ao ritmo original (omissão), -s 10 dez vezes mais depressa, -s 0 sem esperas.
+//   -w tempo de espera pelas respostas depois da última mensagem (omissão 1000 ms).
+//
+// Cada interface da captura passa a ser uma ligação TCP ao nó, apresentada com ENTRY com o endereço
+// original; por ela são enviadas, pela ordem e com os intervalos originais, as mensagens NDN que o nó
+// capturado recebeu dessa interface. O nó em teste não deve estar numa rede, para que só tenha estas
+// interfaces. No fim são comparadas as mensagens que o nó enviou com as da captura e é mostrada a
+// latência entre cada INTEREST reproduzido e a resposta na mesma interface.
+
+#include "../src/histogram.h"
+#include "../src/capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_REPLAY_FACES 9 // Uma abaixo de MAX_NEIGHBORS do nó
+#define MAX_LINE_LEN 1024
+#define MAX_FACE_LEN 32
+#define ENTRY_SETTLE_MS 200 // Espera para o nó classificar as ligações antes da reprodução
+
+enum
+{
+    KIND_INTEREST,
+    KIND_OBJECT,
+    KIND_NOOBJECT,
+    KIND_CANCEL,
+    KIND_COUNT
+};
+static const char *kind_names[KIND_COUNT] = {"INTEREST", "OBJECT", "NOOBJECT", "CANCEL"};
+
+typedef struct
+{
+    long long offset_us;
+    int face;
+    char *message; // Com o fim de linha
+} ReplayMessage;
+
+typedef struct
+{
+    char address[MAX_FACE_LEN]; // ip:porto da interface capturada
+    int sd;
+    char recv_buffer[8192];
+    size_t recv_len;
+    long long interest_sent_us[256]; // Instante do último INTEREST enviado por identificador (0 se respondido)
+    char interest_name[256][128];
+} ReplayFace;
+
+static ReplayMessage *messages = NULL;
+static long num_messages = 0;
+static ReplayFace faces[MAX_REPLAY_FACES];
+static int num_faces = 0;
+
+static unsigned long captured_out[KIND_COUNT]; // Enviadas pelo nó capturado
+static unsigned long replayed_in[KIND_COUNT];  // Enviadas ao nó nesta reprodução
+static unsigned long replayed_out[KIND_COUNT]; // Enviadas pelo nó nesta reprodução
+static LatencyHistogram answer_latency;
+
+static long long now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int message_kind(const char *message)
+{
+    for (int k = 0; k < KIND_COUNT; k++)
+    {
+        size_t len = strlen(kind_names[k]);
+        if (strncmp(message, kind_names[k], len) == 0 && message[len] == ' ')
+        {
+            return k;
+        }
+    }
+    return -1;
+}
+
+static int find_face(const char *address)
+{
+    for (int i = 0; i < num_faces; i++)
+    {
+        if (strcmp(faces[i].address, address) == 0)
+        {
+            return i;
+        }
+    }
+    if (num_faces == MAX_REPLAY_FACES)
+    {
+        return -1;
+    }
+    snprintf(faces[num_faces].address, MAX_FACE_LEN, "%s", address);
+    faces[num_faces].sd = -1;
+    return num_faces++;
+}
+
+static int load_capture(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror(path);
+        return -1;
+    }
+    char line[MAX_LINE_LEN];
+    int version = 0;
+    if (!fgets(line, sizeof(line), file) || sscanf(line, "# ndn-capture %d", &version) != 1 || version != CAPTURE_VERSION)
+    {
+        fprintf(stderr, "%s: não é uma captura (versão %d).\n", path, CAPTURE_VERSION);
+        fclose(file);
+        return -1;
+    }
+
+    long capacity = 0;
+    unsigned long skipped_faces = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        long long offset_us;
+        char direction;
+        char address[MAX_FACE_LEN];
+        int consumed = 0;
+        if (sscanf(line, "%lld %c %31s %n", &offset_us, &direction, address, &consumed) != 3 || consumed == 0)
+        {
+            continue;
+        }
+        const char *message = line + consumed;
+        int kind = message_kind(message);
+        if (kind == -1)
+        {
+            continue; // Mensagens de topologia: a reprodução só recria o tráfego NDN
+        }
+        if (direction == 'O')
+        {
+            captured_out[kind]++;
+            continue;
+        }
+        int face = find_face(address);
+        if (face == -1)
+        {
+            skipped_faces++;
+            continue;
+        }
+        if (num_messages == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 4096;
+            ReplayMessage *grown = realloc(messages, capacity * sizeof(ReplayMessage));
+            if (!grown)
+            {
+                fprintf(stderr, "Memória insuficiente.\n");
+                exit(1);
+            }
+            messages = grown;
+        }
+        messages[num_messages].offset_us = offset_us;
+        messages[num_messages].face = face;
+        messages[num_messages].message = strdup(message);
+        num_messages++;
+    }
+    fclose(file);
+    if (skipped_faces > 0)
+    {
+        fprintf(stderr, "Aviso: %lu mensagem(ns) de interfaces além de %d ignorada(s).\n", skipped_faces, MAX_REPLAY_FACES);
+    }
+    return 0;
+}
+
+static int connect_faces(const char *node_ip, int node_port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(node_port);
+    if (inet_pton(AF_INET, node_ip, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "Endereço inválido: %s\n", node_ip);
+        return -1;
+    }
+    for (int i = 0; i < num_faces; i++)
+    {
+        ReplayFace *face = &faces[i];
+        face->sd = socket(AF_INET, SOCK_STREAM, 0);
+        if (face->sd == -1 || connect(face->sd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+        {
+            fprintf(stderr, "Erro ao ligar a %s:%d: %s\n", node_ip, node_port, strerror(errno));
+            return -1;
+        }
+        // A interface apresenta-se com o endereço capturado
+        char ip[MAX_FACE_LEN];
+        int port = 0;
+        snprintf(ip, sizeof(ip), "%s", face->address);
+        char *colon = strrchr(ip, ':');
+        if (colon)
+        {
+            *colon = '\0';
+            port = atoi(colon + 1);
+        }
+        char entry[64];
+        int len = snprintf(entry, sizeof(entry), "ENTRY %s %d\n", ip, port);
+        if (write(face->sd, entry, len) != len)
+        {
+            perror("Erro ao enviar ENTRY");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void handle_answer(ReplayFace *face, const char *line)
+{
+    int kind = message_kind(line);
+    if (kind == -1)
+    {
+        return;
+    }
+    replayed_out[kind]++;
+    unsigned int id;
+    char name[128];
+    if ((kind == KIND_OBJECT || kind == KIND_NOOBJECT) && sscanf(line, "%*s %u %127s", &id, name) == 2 && id < 256 &&
+        face->interest_sent_us[id] != 0 && strcmp(face->interest_name[id], name) == 0)
+    {
+        histogram_record(&answer_latency, now_us() - face->interest_sent_us[id]);
+        face->interest_sent_us[id] = 0;
+    }
+}
+
+// Lê o que o nó enviou até ao instante limite (ou até ao primeiro dado, se limite é 0)
+static void poll_faces(long long until_us)
+{
+    do
+    {
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        int max_fd = -1;
+        for (int i = 0; i < num_faces; i++)
+        {
+            if (faces[i].sd != -1)
+            {
+                FD_SET(faces[i].sd, &read_fds);
+                max_fd = faces[i].sd > max_fd ? faces[i].sd : max_fd;
+            }
+        }
+        if (max_fd == -1)
+        {
+            return;
+        }
+        long long wait_us = until_us - now_us();
+        if (wait_us < 0)
+        {
+            wait_us = 0;
+        }
+        struct timeval timeout = {wait_us / 1000000, wait_us % 1000000};
+        if (select(max_fd + 1, &read_fds, NULL, NULL, &timeout) <= 0)
+        {
+            return;
+        }
+        for (int i = 0; i < num_faces; i++)
+        {
+            ReplayFace *face = &faces[i];
+            if (face->sd == -1 || !FD_ISSET(face->sd, &read_fds))
+            {
+                continue;
+            }
+            ssize_t n = read(face->sd, face->recv_buffer + face->recv_len, sizeof(face->recv_buffer) - 1 - face->recv_len);
+            if (n <= 0)
+            {
+                fprintf(stderr, "O nó fechou a ligação da interface %s.\n", face->address);
+                close(face->sd);
+                face->sd = -1;
+                continue;
+            }
+            face->recv_len += n;
+            face->recv_buffer[face->recv_len] = '\0';
+            char *start = face->recv_buffer;
+            char *end;
+            while ((end = strchr(start, '\n')) != NULL)
+            {
+                *end = '\0';
+                handle_answer(face, start);
+                start = end + 1;
+            }
+            face->recv_len = strlen(start);
+            memmove(face->recv_buffer, start, face->recv_len + 1);
+        }
+    } while (now_us() < until_us);
+}
+
+static void send_replay_message(ReplayMessage *message)
+{
+    ReplayFace *face = &faces[message->face];
+    if (face->sd == -1)
+    {
+        return;
+    }
+    size_t len = strlen(message->message);
+    if (write(face->sd, message->message, len) != (ssize_t)len)
+    {
+        perror("Erro ao enviar mensagem");
+        return;
+    }
+    int kind = message_kind(message->message);
+    replayed_in[kind]++;
+    unsigned int id;
+    char name[128];
+    if (kind == KIND_INTEREST && sscanf(message->message, "%*s %u %127s", &id, name) == 2 && id < 256)
+    {
+        face->interest_sent_us[id] = now_us();
+        snprintf(face->interest_name[id], sizeof(face->interest_name[id]), "%s", name);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    double speed = 1.0;
+    long long wait_ms = 1000;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:w:")) != -1)
+    {
+        if (opt == 's')
+        {
+            speed = atof(optarg);
+        }
+        else if (opt == 'w')
+        {
+            wait_ms = atoll(optarg);
+        }
+        else
+        {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (argc - optind != 3 || speed < 0)
+    {
+        fprintf(stderr, "Uso: %s [-s <velocidade>] [-w <ms>] <captura> <ip do nó> <porto do nó>\n", argv[0]);
+        return 1;
+    }
+    if (load_capture(argv[optind]) == -1)
+    {
+        return 1;
+    }
+    if (num_messages == 0)
+    {
+        printf("A captura não tem mensagens NDN recebidas pelo nó.\n");
+        return 0;
+    }
+    if (connect_faces(argv[optind + 1], atoi(argv[optind + 2])) == -1)
+    {
+        return 1;
+    }
+    histogram_reset(&answer_latency);
+    poll_faces(now_us() + ENTRY_SETTLE_MS * 1000);
+
+    printf("A reproduzir %ld mensagem(ns) de %d interface(s) (velocidade %s%g).\n", num_messages, num_faces,
+           speed == 0 ? "sem esperas, " : "", speed);
+    long long first_offset_us = messages[0].offset_us;
+    long long start_us = now_us();
+    for (long i = 0; i < num_messages; i++)
+    {
+        if (speed > 0)
+        {
+            long long due_us = start_us + (long long)((messages[i].offset_us - first_offset_us) / speed);
+            poll_faces(due_us);
+        }
+        send_replay_message(&messages[i]);
+    }
+    long long sent_us = now_us();
+    poll_faces(sent_us + wait_ms * 1000);
+
+    double elapsed_s = (sent_us - start_us) / 1e6;
+    printf("Enviadas em %.3f s (%.0f mensagens/s).\n", elapsed_s, elapsed_s > 0 ? num_messages / elapsed_s : 0.0);
+    printf("%-10s %12s %12s %12s\n", "", "reproduzidas", "nó (captura)", "nó (agora)");
+    for (int k = 0; k < KIND_COUNT; k++)
+    {
+        printf("%-10s %12lu %12lu %12lu\n", kind_names[k], replayed_in[k], captured_out[k], replayed_out[k]);
+    }
+    printf("Latência INTEREST -> resposta: ");
+    histogram_print_summary(&answer_latency);
+    printf("\n");
+
+    for (int i = 0; i < num_faces; i++)
+    {
+        if (faces[i].sd != -1)
+        {
+            close(faces[i].sd);
+        }
+    }
+    for (long i = 0; i < num_messages; i++)
+    {
+        free(messages[i].message);
+    }
+    free(messages);
+    return 0;
+}
@@ -0,0 +1,688 @@
+// Teste de escala com processos reais: um servidor de registo local e N nós ndn no loopback.
+//
+// Uso: scale_test [-n <nós>[,<nós>...]] [-r <pesquisas>] [-l <fração>] [-j <ms>] [-p <porto>]
+//                 [-w <s>] [-s <semente>] [-b <diretoria>]
+//   -n tamanhos da rede a medir (omissão 5,10,20,40); cada tamanho é uma rede nova com processos novos
+//   -r pesquisas por tamanho, uma de cada vez, de um nó ao acaso (omissão 100)
+//   -l fração dos nós que sai ao mesmo tempo com "leave" (omissão 0.25)
+//   -j intervalo entre os "join" dos nós, em ms (omissão 20; com 0 entram todos de uma vez e os
+//      primeiros nós listados pelo servidor enchem-se de vizinhos antes de os outros estarem registados)
+//   -p porto UDP do servidor de registo; os nós usam os portos TCP seguintes (omissão 30000)
+//   -w espera máxima por cada fase, em s (omissão 30); -s semente (omissão: o relógio)
+//   -b diretoria com os executáveis ndn e reg_server (omissão ".")
+//
+// Para cada tamanho: o primeiro nó cria a rede e os restantes entram; depois cada nó cria um objeto
+// e são feitas as pesquisas de objetos de outros nós; por fim uma parte dos nós sai de uma vez.
+// O estado dos nós é lido dos sockets de métricas (/tmp/ndn-<porto>.metrics): a rede está formada
+// quando todos estão na rede e as ligações entre eles (interfaces não pendentes) formam um grafo
+// ligado; depois do LEAVE, quando os restantes voltam a estar ligados e já nenhum tem interfaces
+// para os nós que saíram. A latência das pesquisas é a medida pelos próprios nós.
+//
+// Saída (CSV, uma linha por tamanho; o progresso vai para stderr):
+//   nodes,join_ms,retrieves,found,not_found,timeouts,p50_us,p90_us,p99_us,max_us,left,converge_ms
+// Um tempo de -1 indica que a fase não terminou dentro da espera máxima.
+
+#define _GNU_SOURCE // prctl
+#include "../src/histogram.h"
+#include "../src/metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define SCALE_IP "127.0.0.1"
+#define SCALE_BASE_PORT 30000 // Abaixo dos portos efémeros do Linux (32768-60999), usados pelas ligações de saída
+#define SCALE_FIRST_NET 100  // Cada tamanho usa a sua rede (100, 101, ...)
+#define MAX_SIZES 16
+#define MAX_SCALE_NODES 1000
+#define MAX_SCALE_FACES 16
+#define POLL_INTERVAL_MS 10
+#define REG_STARTUP_MS 200   // Tempo para o servidor de registo abrir o socket
+#define EXIT_GRACE_MS 2000   // Depois do "exit", os nós que ainda correm são terminados
+
+typedef struct
+{
+    pid_t pid;
+    int port;
+    int stdin_fd;   // Comandos para o nó (um de cada vez: o nó lê o stdin com fgets depois do select)
+    int departed;   // Saiu da rede com "leave"
+    int busy;       // Pesquisa enviada e ainda não concluída
+    long long busy_since_ms;
+    unsigned long long retrieves_done; // Pesquisas concluídas quando a atual foi enviada
+} ScaleNode;
+
+// Estado de um nó lido do socket de métricas
+typedef struct
+{
+    int network;
+    int local_objects;
+    unsigned long long retrieves[3]; // Por RetrieveResult
+    int num_faces;
+    int face_ports[MAX_SCALE_FACES]; // Interfaces classificadas (pendentes ignoradas)
+} NodeSample;
+
+typedef struct
+{
+    int nodes;
+    long long join_ms;
+    int retrieves;
+    unsigned long long results[3];
+    LatencyHistogram latency;
+    int left;
+    long long converge_ms;
+} ScaleResult;
+
+static ScaleNode *nodes;
+static int num_nodes;
+static NodeSample *samples;
+static const char *bin_dir = ".";
+static int reg_port = SCALE_BASE_PORT;
+static long long phase_timeout_ms = 30000;
+static pid_t reg_pid = -1;
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+// Processo filho com a saída para /dev/null, terminado se este programa terminar
+static pid_t spawn(char *const argv[], int *stdin_fd)
+{
+    int fds[2] = {-1, -1};
+    if (stdin_fd && pipe(fds) == -1)
+    {
+        perror("pipe");
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        int null_fd = open("/dev/null", O_RDWR);
+        dup2(stdin_fd ? fds[0] : null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        if (stdin_fd)
+        {
+            close(fds[0]);
+            close(fds[1]);
+        }
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    if (stdin_fd)
+    {
+        close(fds[0]);
+        if (pid == -1)
+        {
+            close(fds[1]);
+        }
+        else
+        {
+            *stdin_fd = fds[1];
+            fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        }
+    }
+    if (pid == -1)
+    {
+        perror("fork");
+    }
+    return pid;
+}
+
+static void send_command(ScaleNode *node, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void send_command(ScaleNode *node, const char *format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (len < 0 || len > (int)sizeof(line) - 2)
+    {
+        return;
+    }
+    line[len++] = '\n';
+    if (node->stdin_fd == -1 || write(node->stdin_fd, line, len) != len)
+    {
+        fprintf(stderr, "Aviso: não foi possível enviar '%.*s' ao nó %d.\n", len - 1, line, node->port);
+    }
+}
+
+// Lê as métricas do nó; junta o histograma de latência das pesquisas a latency, se não for NULL.
+// Devolve -1 se o nó não responde.
+static int sample_node(ScaleNode *node, NodeSample *sample, LatencyHistogram *latency)
+{
+    static char buffer[METRICS_RENDER_BUFFER];
+    int sd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), METRICS_SOCKET_FORMAT, node->port);
+    if (sd == -1 || connect(sd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        if (sd != -1)
+        {
+            close(sd);
+        }
+        return -1;
+    }
+    size_t len = 0;
+    ssize_t n;
+    while (len < sizeof(buffer) - 1 && (n = read(sd, buffer + len, sizeof(buffer) - 1 - len)) > 0)
+    {
+        len += n;
+    }
+    close(sd);
+    buffer[len] = '\0';
+
+    memset(sample, 0, sizeof(*sample));
+    sample->network = -1;
+    for (char *line = strtok(buffer, "\n"); line; line = strtok(NULL, "\n"))
+    {
+        char face_ip[32], type[32];
+        int face_port;
+        long long lo;
+        unsigned long long count;
+        if (sscanf(line, "ndn_network %d", &sample->network) == 1 ||
+            sscanf(line, "ndn_local_objects %d", &sample->local_objects) == 1 ||
+            sscanf(line, "ndn_retrieves_found_total %llu", &sample->retrieves[0]) == 1 ||
+            sscanf(line, "ndn_retrieves_not_found_total %llu", &sample->retrieves[1]) == 1 ||
+            sscanf(line, "ndn_retrieves_timeout_total %llu", &sample->retrieves[2]) == 1)
+        {
+            continue;
+        }
+        // Uma linha por interface com o contador de mensagens recebidas
+        if (sscanf(line, "ndn_face_messages_in_total{face=\"%31[^:]:%d\",sd=\"%*d\",type=\"%31[^\"]\"}",
+                   face_ip, &face_port, type) == 3)
+        {
+            if (strcmp(type, "pending") != 0 && sample->num_faces < MAX_SCALE_FACES)
+            {
+                sample->face_ports[sample->num_faces++] = face_port;
+            }
+            continue;
+        }
+        if (latency && sscanf(line, "ndn_retrieve_latency_us_bucket{lo=\"%lld\"} %llu", &lo, &count) == 2)
+        {
+            latency->counts[histogram_bucket_index(lo)] += count;
+            latency->total += count;
+            latency->sum_us += count * (unsigned long long)((lo + histogram_bucket_upper(histogram_bucket_index(lo))) / 2);
+        }
+        else if (latency && sscanf(line, "ndn_retrieve_latency_us_max %lld", &lo) == 1 && lo > latency->max_us)
+        {
+            latency->max_us = lo;
+        }
+    }
+    return 0;
+}
+
+static int node_index_by_port(int port)
+{
+    int index = port - nodes[0].port;
+    return (index >= 0 && index < num_nodes) ? index : -1;
+}
+
+// Estado da rede visto pelas métricas dos nós que não saíram
+typedef struct
+{
+    int outside;    // Nós sem métricas ou fora da rede
+    int stale;      // Interfaces para nós que saíram (ou desconhecidos)
+    int components; // Partes ligadas (as ligações valem nos dois sentidos)
+} NetworkState;
+
+static void sample_network(int net_id, NetworkState *state)
+{
+    int *stack = malloc(num_nodes * sizeof(int));
+    char *seen = calloc(num_nodes, 1);
+    memset(state, 0, sizeof(*state));
+    if (!stack || !seen)
+    {
+        state->outside = num_nodes;
+    }
+
+    for (int i = 0; i < num_nodes && stack && seen; i++)
+    {
+        if (nodes[i].departed)
+        {
+            continue;
+        }
+        if (sample_node(&nodes[i], &samples[i], NULL) == -1 || samples[i].network != net_id)
+        {
+            state->outside++;
+        }
+        for (int f = 0; f < samples[i].num_faces; f++)
+        {
+            int peer = node_index_by_port(samples[i].face_ports[f]);
+            state->stale += peer == -1 || nodes[peer].departed;
+        }
+    }
+
+    // Pesquisa em profundidade a partir de cada nó presente ainda não visitado
+    for (int first = 0; first < num_nodes && stack && seen; first++)
+    {
+        if (nodes[first].departed || seen[first])
+        {
+            continue;
+        }
+        int top = 0;
+        stack[top++] = first;
+        seen[first] = 1;
+        state->components++;
+        while (top > 0)
+        {
+            int i = stack[--top];
+            for (int f = 0; f < samples[i].num_faces; f++)
+            {
+                int peer = node_index_by_port(samples[i].face_ports[f]);
+                if (peer != -1 && !nodes[peer].departed && !seen[peer])
+                {
+                    seen[peer] = 1;
+                    stack[top++] = peer;
+                }
+            }
+        }
+    }
+    free(stack);
+    free(seen);
+}
+
+// Espera até todos os nós presentes estarem na rede e ligados entre si, sem interfaces para nós que
+// saíram; devolve o tempo desde start_ms, ou -1 se a espera esgotou
+static long long wait_network_formed(int net_id, long long start_ms)
+{
+    NetworkState state;
+    while (now_ms() - start_ms < phase_timeout_ms)
+    {
+        sample_network(net_id, &state);
+        if (state.outside == 0 && state.stale == 0 && state.components == 1)
+        {
+            return now_ms() - start_ms;
+        }
+        sleep_ms(POLL_INTERVAL_MS);
+    }
+    fprintf(stderr, "   rede por formar: %d nó(s) fora da rede, %d interface(s) para nós que saíram, %d parte(s)\n",
+            state.outside, state.stale, state.components);
+    return -1;
+}
+
+static int start_nodes(int count, int first_port)
+{
+    char ndn_path[512], ip[] = SCALE_IP, port_arg[16], reg_ip[] = SCALE_IP, reg_port_arg[16];
+    snprintf(ndn_path, sizeof(ndn_path), "%s/ndn", bin_dir);
+    snprintf(reg_port_arg, sizeof(reg_port_arg), "%d", reg_port);
+    char *argv[] = {ndn_path, ip, port_arg, reg_ip, reg_port_arg, NULL};
+
+    nodes = calloc(count, sizeof(ScaleNode));
+    samples = calloc(count, sizeof(NodeSample));
+    if (!nodes || !samples)
+    {
+        return -1;
+    }
+    num_nodes = count;
+    for (int i = 0; i < count; i++)
+    {
+        nodes[i].port = first_port + i;
+        nodes[i].stdin_fd = -1;
+        snprintf(port_arg, sizeof(port_arg), "%d", nodes[i].port);
+        nodes[i].pid = spawn(argv, &nodes[i].stdin_fd);
+        if (nodes[i].pid == -1)
+        {
+            return -1;
+        }
+    }
+
+    // Os nós estão prontos quando respondem no socket de métricas
+    long long start = now_ms();
+    for (int i = 0; i < count; i++)
+    {
+        while (sample_node(&nodes[i], &samples[i], NULL) == -1)
+        {
+            if (now_ms() - start > phase_timeout_ms)
+            {
+                fprintf(stderr, "Erro: o nó %d não arrancou (%s).\n", nodes[i].port, ndn_path);
+                return -1;
+            }
+            sleep_ms(POLL_INTERVAL_MS);
+        }
+    }
+    return 0;
+}
+
+static void stop_nodes(void)
+{
+    for (int i = 0; i < num_nodes; i++)
+    {
+        if (!nodes[i].departed)
+        {
+            send_command(&nodes[i], "exit");
+        }
+        if (nodes[i].stdin_fd != -1)
+        {
+            close(nodes[i].stdin_fd);
+        }
+    }
+    long long start = now_ms();
+    int running = num_nodes;
+    while (running > 0)
+    {
+        running = 0;
+        for (int i = 0; i < num_nodes; i++)
+        {
+            if (nodes[i].pid > 0 && waitpid(nodes[i].pid, NULL, WNOHANG) == 0)
+            {
+                if (now_ms() - start < EXIT_GRACE_MS)
+                {
+                    running++;
+                    continue;
+                }
+                kill(nodes[i].pid, SIGKILL);
+                waitpid(nodes[i].pid, NULL, 0);
+            }
+            nodes[i].pid = 0;
+        }
+        if (running > 0)
+        {
+            sleep_ms(POLL_INTERVAL_MS);
+        }
+    }
+    free(nodes);
+    free(samples);
+    nodes = NULL;
+    samples = NULL;
+    num_nodes = 0;
+}
+
+// Pesquisas uma de cada vez: cada nó tem um objeto e pesquisa o de outro nó ao acaso
+static int run_retrieves(int net_id, int count, ScaleResult *result)
+{
+    for (int i = 0; i < num_nodes; i++)
+    {
+        send_command(&nodes[i], "create s%03do%d", net_id, i);
+    }
+    long long start = now_ms();
+    for (int i = 0; i < num_nodes; i++)
+    {
+        while (sample_node(&nodes[i], &samples[i], NULL) == -1 || samples[i].local_objects < 1)
+        {
+            if (now_ms() - start > phase_timeout_ms)
+            {
+                fprintf(stderr, "Erro: o nó %d não criou o objeto.\n", nodes[i].port);
+                return -1;
+            }
+            sleep_ms(POLL_INTERVAL_MS);
+        }
+    }
+
+    for (int r = 0; r < count; r++)
+    {
+        int i = rand() % num_nodes;
+        int target = (i + 1 + rand() % (num_nodes - 1)) % num_nodes;
+        ScaleNode *node = &nodes[i];
+        if (sample_node(node, &samples[i], NULL) == -1)
+        {
+            return -1;
+        }
+        node->retrieves_done = samples[i].retrieves[0] + samples[i].retrieves[1] + samples[i].retrieves[2];
+        node->busy_since_ms = now_ms();
+        node->busy = 1;
+        send_command(node, "retrieve s%03do%d", net_id, target);
+        while (node->busy)
+        {
+            sleep_ms(1);
+            if (sample_node(node, &samples[i], NULL) == 0 &&
+                samples[i].retrieves[0] + samples[i].retrieves[1] + samples[i].retrieves[2] > node->retrieves_done)
+            {
+                node->busy = 0;
+            }
+            else if (now_ms() - node->busy_since_ms > phase_timeout_ms)
+            {
+                fprintf(stderr, "Erro: a pesquisa do nó %d não terminou.\n", node->port);
+                return -1;
+            }
+        }
+        result->retrieves++;
+    }
+
+    histogram_reset(&result->latency);
+    for (int i = 0; i < num_nodes; i++)
+    {
+        if (sample_node(&nodes[i], &samples[i], &result->latency) == 0)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                result->results[k] += samples[i].retrieves[k];
+            }
+        }
+    }
+    return 0;
+}
+
+static void run_size(int size, int net_id, int first_port, double leave_fraction, int join_gap_ms, int num_retrieves,
+                     ScaleResult *result)
+{
+    memset(result, 0, sizeof(*result));
+    result->nodes = size;
+    result->join_ms = -1;
+    result->converge_ms = -1;
+    histogram_reset(&result->latency);
+
+    fprintf(stderr, "== %d nós (rede %03d, portos %d-%d)\n", size, net_id, first_port, first_port + size - 1);
+    if (start_nodes(size, first_port) == -1)
+    {
+        stop_nodes();
+        return;
+    }
+
+    // O primeiro nó cria a rede; os outros entram quando ele já está registado
+    long long start = now_ms();
+    send_command(&nodes[0], "join %03d", net_id);
+    while (now_ms() - start < phase_timeout_ms &&
+           (sample_node(&nodes[0], &samples[0], NULL) == -1 || samples[0].network != net_id))
+    {
+        sleep_ms(POLL_INTERVAL_MS);
+    }
+    for (int i = 1; i < size; i++)
+    {
+        send_command(&nodes[i], "join %03d", net_id);
+        if (join_gap_ms > 0)
+        {
+            sleep_ms(join_gap_ms);
+        }
+    }
+    result->join_ms = wait_network_formed(net_id, start);
+    fprintf(stderr, "   entrada: %lld ms\n", result->join_ms);
+    if (result->join_ms == -1)
+    {
+        stop_nodes();
+        return;
+    }
+
+    if (size > 1 && num_retrieves > 0)
+    {
+        if (run_retrieves(net_id, num_retrieves, result) == -1)
+        {
+            stop_nodes();
+            return;
+        }
+        fprintf(stderr, "   pesquisas: %d (%llu sem objeto, %llu sem resposta), p50 %.1f ms, p99 %.1f ms\n",
+                result->retrieves, result->results[1], result->results[2],
+                histogram_percentile(&result->latency, 0.50) / 1000.0, histogram_percentile(&result->latency, 0.99) / 1000.0);
+    }
+
+    // Saída simultânea de uma parte dos nós, escolhidos ao acaso (fica sempre pelo menos um)
+    int to_leave = (int)(size * leave_fraction + 0.5);
+    to_leave = to_leave >= size ? size - 1 : to_leave;
+    for (int left = 0; left < to_leave;)
+    {
+        int i = rand() % size;
+        if (!nodes[i].departed)
+        {
+            nodes[i].departed = 1;
+            left++;
+        }
+    }
+    start = now_ms();
+    for (int i = 0; i < size; i++)
+    {
+        if (nodes[i].departed)
+        {
+            send_command(&nodes[i], "leave");
+        }
+    }
+    result->left = to_leave;
+    if (to_leave > 0)
+    {
+        result->converge_ms = wait_network_formed(net_id, start);
+        fprintf(stderr, "   saída de %d nós: rede ligada de novo em %lld ms\n", to_leave, result->converge_ms);
+    }
+    stop_nodes();
+}
+
+static int parse_sizes(char *arg, int *sizes)
+{
+    int count = 0;
+    for (char *item = strtok(arg, ","); item; item = strtok(NULL, ","))
+    {
+        int size = atoi(item);
+        if (count == MAX_SIZES || size < 1 || size > MAX_SCALE_NODES)
+        {
+            return -1;
+        }
+        sizes[count++] = size;
+    }
+    return count;
+}
+
+static void stop_reg_server(void)
+{
+    if (reg_pid > 0)
+    {
+        kill(reg_pid, SIGTERM);
+        waitpid(reg_pid, NULL, 0);
+        reg_pid = -1;
+    }
+}
+
+static void handle_signal(int sig)
+{
+    (void)sig;
+    _exit(EXIT_FAILURE); // Os filhos recebem SIGTERM (PR_SET_PDEATHSIG)
+}
+
+int main(int argc, char *argv[])
+{
+    int sizes[MAX_SIZES] = {5, 10, 20, 40};
+    int num_sizes = 4;
+    int num_retrieves = 100;
+    double leave_fraction = 0.25;
+    int join_gap_ms = 20;
+    unsigned int seed = (unsigned int)time(NULL);
+    int opt, usage_error = 0;
+
+    while ((opt = getopt(argc, argv, "n:r:l:j:p:w:s:b:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            num_sizes = parse_sizes(optarg, sizes);
+            usage_error |= num_sizes < 1;
+            break;
+        case 'r':
+            num_retrieves = atoi(optarg);
+            break;
+        case 'l':
+            leave_fraction = atof(optarg);
+            break;
+        case 'j':
+            join_gap_ms = atoi(optarg);
+            break;
+        case 'p':
+            reg_port = atoi(optarg);
+            break;
+        case 'w':
+            phase_timeout_ms = atol(optarg) * 1000;
+            break;
+        case 's':
+            seed = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            bin_dir = optarg;
+            break;
+        default:
+            usage_error = 1;
+        }
+    }
+    int total_ports = 0;
+    for (int i = 0; i < num_sizes && !usage_error; i++)
+    {
+        total_ports += sizes[i];
+    }
+    if (usage_error || optind != argc || num_retrieves < 0 || leave_fraction < 0 || leave_fraction > 1 ||
+        join_gap_ms < 0 || phase_timeout_ms <= 0 || reg_port < 1 || reg_port + total_ports > 65535)
+    {
+        fprintf(stderr, "Uso: %s [-n <nós>[,<nós>...]] [-r <pesquisas>] [-l <fração>] [-j <ms>] [-p <porto>] "
+                        "[-w <s>] [-s <semente>] [-b <diretoria>]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    srand(seed);
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    signal(SIGPIPE, SIG_IGN); // Um nó que terminou não deve terminar o teste
+
+    char reg_path[512], port_arg[16], port_opt[] = "-p";
+    snprintf(reg_path, sizeof(reg_path), "%s/reg_server", bin_dir);
+    snprintf(port_arg, sizeof(port_arg), "%d", reg_port);
+    char *reg_argv[] = {reg_path, port_opt, port_arg, NULL};
+    reg_pid = spawn(reg_argv, NULL);
+    sleep_ms(REG_STARTUP_MS);
+    if (reg_pid == -1 || waitpid(reg_pid, NULL, WNOHANG) != 0)
+    {
+        fprintf(stderr, "Erro: o servidor de registo (%s) não arrancou no porto %d.\n", reg_path, reg_port);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "Servidor de registo em %s:%d (semente %u)\n", SCALE_IP, reg_port, seed);
+
+    ScaleResult *results = calloc(num_sizes, sizeof(ScaleResult));
+    if (!results)
+    {
+        stop_reg_server();
+        return EXIT_FAILURE;
+    }
+    int first_port = reg_port + 1;
+    for (int s = 0; s < num_sizes; s++)
+    {
+        run_size(sizes[s], SCALE_FIRST_NET + s, first_port, leave_fraction, join_gap_ms, num_retrieves, &results[s]);
+        first_port += sizes[s]; // Portos novos: os anteriores podem estar em TIME_WAIT
+    }
+    stop_reg_server();
+
+    printf("nodes,join_ms,retrieves,found,not_found,timeouts,p50_us,p90_us,p99_us,max_us,left,converge_ms\n");
+    for (int s = 0; s < num_sizes; s++)
+    {
+        ScaleResult *r = &results[s];
+        printf("%d,%lld,%d,%llu,%llu,%llu,%lld,%lld,%lld,%lld,%d,%lld\n", r->nodes, r->join_ms, r->retrieves,
+               r->results[0], r->results[1], r->results[2], histogram_percentile(&r->latency, 0.50),
+               histogram_percentile(&r->latency, 0.90), histogram_percentile(&r->latency, 0.99), r->latency.max_us,
+               r->left, r->converge_ms);
+    }
+    free(results);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+// Junta os ficheiros de rastreio de vários nós numa linha temporal por pesquisa.
+//
+// Uso: trace_stitch [-t <id>] <ficheiro>...
+//   <ficheiro> é o ficheiro de rastreio de um nó (/tmp/ndn-<porto>.trace por omissão).
+//   -t mostra só a pesquisa com o identificador indicado (o T=<hex> das mensagens).
+//
+// Os instantes são os do relógio de parede de cada nó: entre máquinas diferentes a ordem só é exata
+// se os relógios estiverem sincronizados. Para cada pesquisa é indicado o maior intervalo entre dois
+// eventos consecutivos, que aponta o salto onde a pesquisa esteve parada.
+
+#include "../src/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    unsigned long long trace_id;
+    long long time_us;
+    unsigned long node_ip;
+    int node_port;
+    unsigned long peer_ip;
+    int peer_port;
+    int event;
+    int interest_id;
+    char name[256];
+    long order; // Posição de leitura (desempate entre eventos com o mesmo instante)
+} TraceRecord;
+
+static TraceRecord *records = NULL;
+static long num_records = 0;
+static long records_capacity = 0;
+
+static const char *event_names[TRACE_EVENT_COUNT] = {
+    [TRACE_ISSUED] = "pesquisa emitida",
+    [TRACE_INTEREST_RECEIVED] = "INTEREST recebido",
+    [TRACE_PIT_HIT] = "já na PIT",
+    [TRACE_LOCAL_HIT] = "objeto local",
+    [TRACE_CACHE_HIT] = "objeto na cache",
+    [TRACE_FORWARDED] = "INTEREST enviado",
+    [TRACE_OBJECT_RECEIVED] = "OBJECT recebido",
+    [TRACE_NOOBJECT_RECEIVED] = "NOOBJECT recebido",
+    [TRACE_OBJECT_SENT] = "OBJECT enviado",
+    [TRACE_NOOBJECT_SENT] = "NOOBJECT enviado",
+    [TRACE_DELIVERED] = "entregue ao utilizador",
+    [TRACE_NOT_FOUND] = "não encontrado",
+    [TRACE_TIMEOUT] = "sem resposta",
+};
+
+static unsigned long long get_le(const unsigned char *p, int bytes)
+{
+    unsigned long long value = 0;
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static TraceRecord *new_record(void)
+{
+    if (num_records == records_capacity)
+    {
+        records_capacity = records_capacity ? records_capacity * 2 : 1024;
+        TraceRecord *grown = realloc(records, records_capacity * sizeof(TraceRecord));
+        if (!grown)
+        {
+            fprintf(stderr, "Memória insuficiente.\n");
+            exit(1);
+        }
+        records = grown;
+    }
+    TraceRecord *record = &records[num_records];
+    record->order = num_records++;
+    return record;
+}
+
+static int read_trace_file(const char *path, unsigned long long only_id)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        perror(path);
+        return -1;
+    }
+    char magic[TRACE_MAGIC_LEN];
+    if (fread(magic, 1, TRACE_MAGIC_LEN, file) != TRACE_MAGIC_LEN || memcmp(magic, TRACE_FILE_MAGIC, TRACE_MAGIC_LEN) != 0)
+    {
+        fprintf(stderr, "%s: não é um ficheiro de rastreio.\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    unsigned char header[TRACE_RECORD_HEADER_LEN];
+    while (fread(header, 1, TRACE_RECORD_HEADER_LEN, file) == TRACE_RECORD_HEADER_LEN)
+    {
+        int name_len = header[30];
+        char name[256];
+        if (fread(name, 1, name_len, file) != (size_t)name_len)
+        {
+            fprintf(stderr, "%s: último registo incompleto ignorado.\n", path);
+            break;
+        }
+        unsigned long long trace_id = get_le(header, 8);
+        if (only_id && trace_id != only_id)
+        {
+            continue;
+        }
+        TraceRecord *record = new_record();
+        record->trace_id = trace_id;
+        record->time_us = (long long)get_le(header + 8, 8);
+        record->node_ip = (unsigned long)get_le(header + 16, 4);
+        record->node_port = (int)get_le(header + 20, 2);
+        record->peer_ip = (unsigned long)get_le(header + 22, 4);
+        record->peer_port = (int)get_le(header + 26, 2);
+        record->event = header[28];
+        record->interest_id = header[29];
+        memcpy(record->name, name, name_len);
+        record->name[name_len] = '\0';
+    }
+    fclose(file);
+    return 0;
+}
+
+static int compare_records(const void *a, const void *b)
+{
+    const TraceRecord *ra = a;
+    const TraceRecord *rb = b;
+    if (ra->trace_id != rb->trace_id)
+    {
+        return ra->trace_id < rb->trace_id ? -1 : 1;
+    }
+    if (ra->time_us != rb->time_us)
+    {
+        return ra->time_us < rb->time_us ? -1 : 1;
+    }
+    return ra->order < rb->order ? -1 : (ra->order > rb->order);
+}
+
+static void format_endpoint(char *buffer, size_t size, unsigned long ip, int port)
+{
+    snprintf(buffer, size, "%lu.%lu.%lu.%lu:%d", (ip >> 24) & 0xff, (ip >> 16) & 0xff, (ip >> 8) & 0xff, ip & 0xff, port);
+}
+
+static int is_outgoing(int event)
+{
+    return event == TRACE_FORWARDED || event == TRACE_OBJECT_SENT || event == TRACE_NOOBJECT_SENT;
+}
+
+// Eventos [first, last) de uma pesquisa, já ordenados por instante
+static void print_timeline(long first, long last)
+{
+    TraceRecord *start = &records[first];
+    int nodes = 0;
+    for (long i = first; i < last; i++)
+    {
+        int seen = 0;
+        for (long j = first; j < i && !seen; j++)
+        {
+            seen = records[j].node_ip == records[i].node_ip && records[j].node_port == records[i].node_port;
+        }
+        nodes += !seen;
+    }
+    printf("Pesquisa T=%llx '%s': %ld evento(s) em %d nó(s), %.3f ms\n", start->trace_id, start->name, last - first, nodes,
+           (records[last - 1].time_us - start->time_us) / 1000.0);
+
+    long long largest_gap = -1;
+    long largest_gap_at = first;
+    for (long i = first; i < last; i++)
+    {
+        TraceRecord *record = &records[i];
+        long long gap = (i > first) ? record->time_us - records[i - 1].time_us : 0;
+        if (gap > largest_gap)
+        {
+            largest_gap = gap;
+            largest_gap_at = i;
+        }
+
+        char node[32], peer[40] = "";
+        format_endpoint(node, sizeof(node), record->node_ip, record->node_port);
+        if (record->peer_port != 0)
+        {
+            char endpoint[32];
+            format_endpoint(endpoint, sizeof(endpoint), record->peer_ip, record->peer_port);
+            snprintf(peer, sizeof(peer), "%s %s", is_outgoing(record->event) ? "->" : "<-", endpoint);
+        }
+        const char *event = (record->event > 0 && record->event < TRACE_EVENT_COUNT && event_names[record->event])
+                                ? event_names[record->event]
+                                : "?";
+        printf("  %10.3f ms (+%8.3f)  %-21s %-22s ID %3d %s\n", (record->time_us - start->time_us) / 1000.0, gap / 1000.0,
+               node, event, record->interest_id, peer);
+    }
+    if (last - first > 1)
+    {
+        char node[32];
+        format_endpoint(node, sizeof(node), records[largest_gap_at].node_ip, records[largest_gap_at].node_port);
+        printf("  Maior intervalo: %.3f ms antes de '%s' em %s\n", largest_gap / 1000.0,
+               event_names[records[largest_gap_at].event] ? event_names[records[largest_gap_at].event] : "?", node);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long long only_id = 0;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "-t") == 0)
+    {
+        only_id = strtoull(argv[2], NULL, 16);
+        first = 3;
+    }
+    if (first >= argc)
+    {
+        fprintf(stderr, "Uso: %s [-t <id>] <ficheiro de rastreio>...\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = first; i < argc; i++)
+    {
+        failed |= (read_trace_file(argv[i], only_id) == -1);
+    }
+    if (num_records == 0)
+    {
+        printf("Nenhum evento de rastreio.\n");
+        free(records);
+        return failed;
+    }
+
+    qsort(records, num_records, sizeof(TraceRecord), compare_records);
+    long start = 0;
+    for (long i = 1; i <= num_records; i++)
+    {
+        if (i == num_records || records[i].trace_id != records[start].trace_id)
+        {
+            print_timeline(start, i);
+            start = i;
+        }
+    }
+    free(records);
+    return failed;
+}